@@ -109,45 +109,6 @@ function frameDicer(encoder, isAudio) {
   };
 }
 
-function serialBalancer(numStreams) {
-  let pending = [];
-  // initialise with negative ts and no pkt
-  // - there should be no output until each stream has sent its first packet
-  for (let s = 0; s < numStreams; ++s)
-    pending.push({ ts: -Number.MAX_VALUE, streamIndex: s });
-
-  const adjustTS = (pkt, srcTB, dstTB) => {
-    const adj = (srcTB[0] * dstTB[1]) / (srcTB[1] * dstTB[0]);
-    pkt.pts = Math.round(pkt.pts * adj);
-    pkt.dts = Math.round(pkt.dts * adj);
-    pkt.duration > 0 ? Math.round(pkt.duration * adj) : Math.round(adj);
-  };
-    
-  const pullPkts = (pkt, streamIndex, ts) => {
-    return new Promise(resolve => {
-      Object.assign(pending[streamIndex], { pkt: pkt, ts: ts, resolve: resolve });
-      const minTS = pending.reduce((acc, pend) => Math.min(acc, pend.ts), Number.MAX_VALUE);
-      // console.log(streamIndex, pending.map(p => p.ts), minTS);
-      const nextPend = pending.find(pend => pend.pkt && (pend.ts === minTS));
-      if (nextPend) nextPend.resolve(nextPend.pkt);
-      if (!pkt) resolve();
-    });
-  };
-
-  this.writePkts = (packets, srcStream, dstStream, writeFn, final = false) => {
-    if (packets && packets.packets.length) {
-      return packets.packets.reduce(async (promise, pkt) => {
-        await promise;
-        pkt.stream_index = dstStream.index;
-        adjustTS(pkt, srcStream.time_base, dstStream.time_base);
-        const pktTS = pkt.pts * dstStream.time_base[0] / dstStream.time_base[1];
-        return writeFn(await pullPkts(pkt, dstStream.index, pktTS));
-      }, Promise.resolve());
-    } else if (final)
-      return pullPkts(null, dstStream.index, Number.MAX_VALUE);
-  };
-}
-
 function parallelBalancer(params, streamType, numStreams) {
   let resolveGet = null;
   const tag = 'video' === streamType ? 'v' : 'a';
@@ -466,17 +427,21 @@ async function makeSources(params) {
     if (src.input_stream) {
       const demuxerStream = beamcoder.demuxerStream({ highwaterMark: 1024 });
       src.input_stream.pipe(demuxerStream);
-      src.format = demuxerStream.demuxer({ iformat: src.iformat, options: src.options });
+      src.format = demuxerStream.demuxer({ iformat: src.iformat, options: src.options,
+        lowLatency: src.lowLatency });
     } else
-      src.format = beamcoder.demuxer({ url: src.url, iformat: src.iformat, options: src.options });
+      src.format = beamcoder.demuxer({ url: src.url, iformat: src.iformat, options: src.options,
+        lowLatency: src.lowLatency });
   }));
   params.audio.forEach(p => p.sources.forEach(src => {
     if (src.input_stream) {
       const demuxerStream = beamcoder.demuxerStream({ highwaterMark: 1024 });
       src.input_stream.pipe(demuxerStream);
-      src.format = demuxerStream.demuxer({ iformat: src.iformat, options: src.options });
+      src.format = demuxerStream.demuxer({ iformat: src.iformat, options: src.options,
+        lowLatency: src.lowLatency });
     } else
-      src.format = beamcoder.demuxer({ url: src.url, iformat: src.iformat, options: src.options });
+      src.format = beamcoder.demuxer({ url: src.url, iformat: src.iformat, options: src.options,
+        lowLatency: src.lowLatency });
   }));
 
   await params.video.reduce(async (promise, p) => {
@@ -506,7 +471,7 @@ async function makeSources(params) {
     src.stream = readStream({ highWaterMark : 1 }, src.format, src.ms, src.streamIndex)));
 }
 
-function runStreams(streamType, sources, filterer, streams, mux, muxBalancer) {
+function runStreams(streamType, sources, filterer, streams, mux) {
   return new Promise((resolve, reject) => {
     if (!sources.length)
       return resolve();
@@ -541,8 +506,8 @@ function runStreams(streamType, sources, filterer, streams, mux, muxBalancer) {
       const encStream = transformStream({ name: 'encode', highWaterMark : 1 },
         frms => str.encoder.encode(frms), () => str.encoder.flush(), reject);
       const muxStream = writeStream({ name: 'mux', highWaterMark : 1 },
-        pkts => muxBalancer.writePkts(pkts, timeBaseStream, str.stream, pkts => mux.writeFrame(pkts)),
-        () => muxBalancer.writePkts(null, timeBaseStream, str.stream, pkts => mux.writeFrame(pkts), true), reject);
+        pkts => mux.interleave({ packets: pkts, stream_index: str.stream.index, time_base: timeBaseStream.time_base }),
+        () => mux.interleave({ stream_index: str.stream.index, final: true }), reject);
       muxStream.on('finish', resolve);
 
       streamTee[i].pipe(diceStream).pipe(encStream).pipe(muxStream);
@@ -673,10 +638,9 @@ async function makeStreams(params) {
       });
       await mux.writeHeader({ options: params.out.options ? params.out.options : {} });
 
-      const muxBalancer = new serialBalancer(mux.streams.length);
       const muxStreamPromises = [];
-      params.video.forEach(p => muxStreamPromises.push(runStreams('video', p.sources, p.filter, p.streams, mux, muxBalancer)));
-      params.audio.forEach(p => muxStreamPromises.push(runStreams('audio', p.sources, p.filter, p.streams, mux, muxBalancer)));
+      params.video.forEach(p => muxStreamPromises.push(runStreams('video', p.sources, p.filter, p.streams, mux)));
+      params.audio.forEach(p => muxStreamPromises.push(runStreams('audio', p.sources, p.filter, p.streams, mux)));
       await Promise.all(muxStreamPromises);
 
       await mux.writeTrailer();
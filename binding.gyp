@@ -8,7 +8,16 @@
                   "src/encode.cc", "src/mux.cc",
                   "src/packet.cc", "src/frame.cc",
                   "src/codec_par.cc", "src/format.cc",
-                  "src/codec.cc", "src/hwcontext.cc"],
+                  "src/codec.cc", "src/hwcontext.cc",
+                  "src/slicepool.cc", "src/bufferpool.cc",
+                  "src/segmenter.cc", "src/packager.cc",
+                  "src/bufferinput.cc", "src/memoryoutput.cc",
+                  "src/decodestream.cc", "src/converter.cc",
+                  "src/thumbnail.cc", "src/threadbudget.cc",
+                  "src/framepool.cc", "src/scan.cc",
+                  "src/analysis.cc", "src/instance.cc",
+                  "src/transfer.cc", "src/framering.cc",
+                  "src/interrupt.cc"],
     "conditions": [
       ['OS!="win"', {
         "defines": [
@@ -85,7 +94,8 @@
         "<!(pkg-config --libs libavutil)",
         "<!(pkg-config --libs libpostproc)",
         "<!(pkg-config --libs libswresample)",
-        "<!(pkg-config --libs libswscale)"
+        "<!(pkg-config --libs libswscale)",
+        "-lrt"
       ]
     }],
     ['OS=="mac"', {
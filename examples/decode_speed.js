@@ -0,0 +1,117 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+/* Benchmark the decoder speed profiles on synthetic content.
+
+  Usage: node decode_speed.js [codec] [frames]
+
+  Encodes a moving test pattern with the given encoder (default libx264, or
+  mpeg4 if libx264 is not available), then decodes it with each of the
+  decoder speed profiles. Reports decoding frames per second, the number of
+  frames output, the decoded size and the mean luma PSNR against the source
+  pattern. Decoded pictures are scaled back to full size for the comparison.
+*/
+
+const beamcoder = require('../index.js'); // Use require('beamcoder') externally
+
+const width = 1280;
+const height = 720;
+
+function pattern(i) {
+  let luma = Buffer.alloc(width * height);
+  for ( let y = 0 ; y < height ; y++ ) {
+    for ( let x = 0 ; x < width ; x++ ) {
+      // Gradient with moving detail, so that the filters have work to do
+      luma[y * width + x] = (x + y + i * 3 + ((x * y + i * 7) % 29) * 2) & 0xff;
+    }
+  }
+  return luma;
+}
+
+async function encode(name, count, sources) {
+  let encoder = beamcoder.encoder({
+    name, width, height,
+    bit_rate: 4000000,
+    time_base: [1, 25],
+    framerate: [25, 1],
+    gop_size: 25,
+    max_b_frames: 2,
+    pix_fmt: 'yuv420p'
+  });
+  let packets = [];
+  for ( let i = 0 ; i < count ; i++ ) {
+    let frame = beamcoder.frame({ width, height, format: 'yuv420p', pts: i }).alloc();
+    let [ ydata, udata, vdata ] = frame.data;
+    let linesize = frame.linesize;
+    for ( let y = 0 ; y < height ; y++ )
+      sources[i].copy(ydata, y * linesize[0], y * width, (y + 1) * width);
+    udata.fill(128);
+    vdata.fill(128);
+    packets = packets.concat((await encoder.encode(frame)).packets);
+  }
+  return packets.concat((await encoder.flush()).packets);
+}
+
+function psnr(frame, source) {
+  let sse = 0;
+  let [ data ] = frame.data;
+  let linesize = frame.linesize[0];
+  for ( let y = 0 ; y < height ; y++ ) {
+    for ( let x = 0 ; x < width ; x++ ) {
+      let d = data[y * linesize + x] - source[y * width + x];
+      sse += d * d;
+    }
+  }
+  let mse = sse / (width * height);
+  return mse === 0 ? 100 : 10 * Math.log10(255 * 255 / mse);
+}
+
+async function run() {
+  let codec = process.argv[2] || (beamcoder.encoders().libx264 ? 'libx264' : 'mpeg4');
+  let count = +process.argv[3] || 100;
+  let sources = [];
+  for ( let i = 0 ; i < count ; i++ ) sources.push(pattern(i));
+  let packets = await encode(codec, count, sources);
+  let decoderName = codec === 'libx264' ? 'h264' : codec;
+  console.log(`Encoded ${count} frames of ${width}x${height} with ${codec}, decoding with ${decoderName}.`);
+
+  for ( let profile of [ 'quality', 'fast', 'faster', 'fastest' ] ) {
+    let timing = beamcoder.decoder({ name: decoderName, speed_profile: profile });
+    let start = process.hrtime.bigint();
+    let frames = (await timing.decode(packets)).frames;
+    frames = frames.concat((await timing.flush()).frames);
+    let seconds = Number(process.hrtime.bigint() - start) / 1e9;
+    let decodedSize = frames.length ? `${frames[0].width}x${frames[0].height}` : '-';
+
+    // Decode again, scaled to full size, to measure quality
+    let measure = beamcoder.decoder({ name: decoderName, speed_profile: profile,
+      output_format: { pix_fmt: 'gray', width, height } });
+    let scaled = (await measure.decode(packets)).frames;
+    scaled = scaled.concat((await measure.flush()).frames);
+    let total = scaled.reduce((sum, f) => sum + psnr(f, sources[f.pts]), 0);
+
+    console.log(`${profile.padEnd(8)} ${(frames.length / seconds).toFixed(1).padStart(8)} fps`,
+      `${String(frames.length).padStart(4)} frames ${decodedSize.padStart(9)}`,
+      `PSNR ${(total / scaled.length).toFixed(2)} dB`);
+  }
+}
+
+run().catch(console.error);
@@ -79,5 +79,75 @@ export function protocols(): { inputs: Array<string>, outputs: Array<string> }
  * `trace` - extremely verbose debugging for libav* developers
  */
 export function logging(level?: string): string | undefined
+/**
+ * Send FFmpeg log messages to a callback rather than FFmpeg's own logger.
+ * Each main or worker thread has its own callback. Pass null to remove it.
+ */
+export function setLoggingCallback(callback: ((message: string) => void) | null): void
+
+/** Handle to a frame or packet that can be sent to another worker thread */
+export interface TransferHandle {
+	readonly type: 'TransferHandle'
+	readonly kind: 'frame' | 'packet'
+	readonly id: bigint
+}
+/**
+ * Detach a frame or packet into a handle that can be posted to another worker
+ * thread, sharing rather than copying its data.
+ * https://github.com/Streampunk/beamcoder#worker-threads
+ */
+export function transfer(item: import("./types/Frame").Frame | import("./types/Packet").Packet): TransferHandle
+/** Receive a frame or packet from a handle made by transfer. Each handle can be received once. */
+export function receive(handle: TransferHandle): import("./types/Frame").Frame | import("./types/Packet").Packet
+/** Free a handle that will not be received, returning true if it was still pending */
+export function releaseTransfer(handle: TransferHandle): boolean
+
+/** Ring of frame slots in POSIX shared memory, for passing frames between processes */
+export interface FrameRing {
+	readonly type: 'FrameRing'
+	readonly name: string
+	readonly slots: number
+	/** Bytes of frame data per slot */
+	readonly slot_size: number
+	/** Copy a frame into the next slot, returning false if the slot is still in use */
+	write(frame: import("./types/Frame").Frame): boolean
+	/** Wrap the next frame in place, or null if none is ready. Throws for a slot that is dropped as invalid. */
+	read(): import("./types/Frame").Frame | null
+	/**
+	 * Empty a read frame and hand its slot back to the writer. Returns false when others still
+	 * hold the frame's data, and the slot is handed back once they have finished with it.
+	 */
+	release(frame: import("./types/Frame").Frame): boolean
+	/** Number of frames written but not yet read */
+	readable(): number
+	/** Stop using the ring. Frames already read stay valid. */
+	close(): void
+	/** Remove the shared memory name, returning true if it existed */
+	unlink(): boolean
+}
+/**
+ * Create or open a shared memory frame ring.
+ * https://github.com/Streampunk/beamcoder#shared-memory-frame-rings
+ */
+export function frameRing(options: {
+	/** POSIX shared memory name, such as '/beamcoder-ring' */
+	name: string
+	/** Create a new ring rather than open an existing one */
+	create?: boolean
+	/** Number of slots when creating, default 8 */
+	slots?: number
+	/** Bytes of frame data per slot when creating */
+	slot_size?: number
+	/** Size slots for pictures of this size and format when slot_size is not given */
+	width?: number
+	height?: number
+	pix_fmt?: string
+}): FrameRing
+
+/**
+ * Current monotonic time in microseconds, on the clock used to stamp packet arrival_time.
+ * https://github.com/Streampunk/beamcoder#low-latency-live-input
+ */
+export function monotonicTime(): number
 
 export as namespace Beamcoder
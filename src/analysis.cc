@@ -0,0 +1,380 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#include "analysis.h"
+#include <deque>
+#include <algorithm>
+#include <cmath>
+
+// Packets looked back over to find how far presentation order is reordered
+#define REORDER_LOOKBACK 32
+// Limit on windowed bitrate bins, guarding against wild timestamps
+#define MAX_WINDOWS (1 << 24)
+
+void analyseStream(const packetColumns& columns, const analysisSettings& settings,
+    streamAnalysis& r) {
+  double tb = av_q2d(r.timeBase);
+  bool video = r.codecType == AVMEDIA_TYPE_VIDEO;
+  bool vbv = (settings.vbvMaxRate > 0.0) && (settings.vbvBufferSize > 0.0);
+  int64_t firstTs = AV_NOPTS_VALUE, endTs = AV_NOPTS_VALUE;
+  int64_t prevTs = AV_NOPTS_VALUE, prevDuration = 0;
+  int64_t gopKeyPts = AV_NOPTS_VALUE, prevKeyPts = AV_NOPTS_VALUE;
+  int32_t gopLength = 0;
+  bool inGop = false, open = false;
+  std::deque<int64_t> recentPts;
+  // VBV buffer starts full and fills at the maximum rate between decode times
+  double vbvLevel = settings.vbvBufferSize;
+  int64_t vbvTs = AV_NOPTS_VALUE;
+  std::vector<double> windowBits;
+
+  for ( size_t i = 0 ; i < columns.count() ; i++ ) {
+    if (columns.streamIndex[i] != r.index) continue;
+    int64_t pts = columns.pts[i];
+    int64_t duration = std::max<int64_t>(columns.duration[i], 0);
+    int64_t ts = (columns.dts[i] != AV_NOPTS_VALUE) ? columns.dts[i] : pts;
+    double bits = columns.size[i] * 8.0;
+    int32_t n = (int32_t) r.packets++;
+    r.bytes += columns.size[i];
+    r.instantBitrate.push_back((duration > 0) ? (float) (bits / (duration * tb)) : 0.0f);
+
+    if (ts != AV_NOPTS_VALUE) {
+      if ((prevTs != AV_NOPTS_VALUE) &&
+          ((ts <= prevTs) || ((ts - prevTs - prevDuration) * tb > settings.gap))) {
+        r.discontinuities.push_back(n);
+      }
+      prevTs = ts;
+      prevDuration = duration;
+      if (firstTs == AV_NOPTS_VALUE) firstTs = ts;
+      if ((endTs == AV_NOPTS_VALUE) || (ts + duration > endTs)) endTs = ts + duration;
+      if (ts >= firstTs) {
+        double bin = std::floor((ts - firstTs) * tb / settings.window);
+        if (bin < MAX_WINDOWS) {
+          if ((size_t) bin >= windowBits.size()) windowBits.resize((size_t) bin + 1, 0.0);
+          windowBits[(size_t) bin] += bits;
+        }
+      }
+    }
+
+    if (vbv) {
+      if (ts != AV_NOPTS_VALUE) {
+        if ((vbvTs != AV_NOPTS_VALUE) && (ts > vbvTs)) {
+          vbvLevel = std::min(settings.vbvBufferSize,
+            vbvLevel + (ts - vbvTs) * tb * settings.vbvMaxRate);
+        }
+        vbvTs = ts;
+      }
+      vbvLevel -= bits;
+      if (vbvLevel < 0.0) {
+        r.vbvUnderflows++;
+        vbvLevel = 0.0;
+      }
+      r.vbvFullness.push_back((float) (vbvLevel / settings.vbvBufferSize));
+    }
+
+    if (!video) continue;
+    if (columns.flags[i] & AV_PKT_FLAG_KEY) {
+      if (inGop) {
+        r.gopLengths.push_back(gopLength);
+        r.gopOpen.push_back(open ? 1 : 0);
+      }
+      if (pts != AV_NOPTS_VALUE) {
+        if (prevKeyPts != AV_NOPTS_VALUE) r.keyframeIntervals.push_back((pts - prevKeyPts) * tb);
+        prevKeyPts = pts;
+      }
+      inGop = true;
+      gopLength = 1;
+      open = false;
+      gopKeyPts = pts;
+    } else if (inGop) {
+      gopLength++;
+      // Leading pictures shown before the key frame reference the previous GOP
+      if ((pts != AV_NOPTS_VALUE) && (gopKeyPts != AV_NOPTS_VALUE) && (pts < gopKeyPts))
+        open = true;
+    }
+    if (pts != AV_NOPTS_VALUE) {
+      int depth = 0;
+      for ( auto p : recentPts ) {
+        if (p > pts) depth++;
+      }
+      r.reorderDepth = std::max(r.reorderDepth, depth);
+      recentPts.push_back(pts);
+      if (recentPts.size() > REORDER_LOOKBACK) recentPts.pop_front();
+    }
+  }
+  if (inGop) {
+    r.gopLengths.push_back(gopLength);
+    r.gopOpen.push_back(open ? 1 : 0);
+  }
+
+  if (firstTs != AV_NOPTS_VALUE) r.duration = (endTs - firstTs) * tb;
+  if (r.duration > 0.0) r.averageBitrate = r.bytes * 8.0 / r.duration;
+  for ( auto b : windowBits ) {
+    r.windowBitrate.push_back(b / settings.window);
+    r.peakBitrate = std::max(r.peakBitrate, b / settings.window);
+  }
+}
+
+void analyseExecute(napi_env env, void* data) {
+  analysisCarrier* c = (analysisCarrier*) data;
+  packetColumns columns;
+  HR_TIME_POINT analyseStart = NOW;
+
+  int ret = scanPackets(c->formatRef, c->range, columns);
+  if (ret < 0) {
+    c->status = BEAMCODER_ERROR_READ_FRAME;
+    c->errorMsg = interruptErrorMsg(c->formatRef->interrupter,
+      "Problem scanning packets for analysis: ", ret);
+    return;
+  }
+  for ( auto &s : c->streams ) analyseStream(columns, c->settings, s);
+  c->totalTime = microTime(analyseStart);
+}
+
+// Hands the storage of the per-packet and per-GOP arrays over to Javascript
+static napi_status fromStreamAnalysis(napi_env env, streamAnalysis& s, napi_value* result) {
+  napi_status status;
+  napi_value value;
+  status = napi_create_object(env, result);
+  PASS_STATUS;
+  status = beam_set_int32(env, *result, "index", s.index);
+  PASS_STATUS;
+  status = beam_set_string_utf8(env, *result, "codec_type", av_get_media_type_string(s.codecType));
+  PASS_STATUS;
+  status = beam_set_int64(env, *result, "packets", s.packets);
+  PASS_STATUS;
+  status = beam_set_int64(env, *result, "bytes", s.bytes);
+  PASS_STATUS;
+  status = beam_set_double(env, *result, "duration", s.duration);
+  PASS_STATUS;
+  status = beam_set_double(env, *result, "average_bitrate", s.averageBitrate);
+  PASS_STATUS;
+  status = beam_set_double(env, *result, "peak_bitrate", s.peakBitrate);
+  PASS_STATUS;
+
+  if (s.codecType == AVMEDIA_TYPE_VIDEO) {
+    int32_t gopMin = 0, gopMax = 0, openGops = 0;
+    double gopMean = 0.0, intervalMean = 0.0;
+    for ( size_t g = 0 ; g < s.gopLengths.size() ; g++ ) {
+      gopMin = (g == 0) ? s.gopLengths[g] : std::min(gopMin, s.gopLengths[g]);
+      gopMax = std::max(gopMax, s.gopLengths[g]);
+      gopMean += s.gopLengths[g];
+      openGops += s.gopOpen[g];
+    }
+    if (s.gopLengths.size() > 0) gopMean /= s.gopLengths.size();
+    for ( auto k : s.keyframeIntervals ) intervalMean += k;
+    if (s.keyframeIntervals.size() > 0) intervalMean /= s.keyframeIntervals.size();
+
+    status = napi_create_object(env, &value);
+    PASS_STATUS;
+    status = beam_set_int32(env, value, "count", (int32_t) s.gopLengths.size());
+    PASS_STATUS;
+    status = beam_set_int32(env, value, "min", gopMin);
+    PASS_STATUS;
+    status = beam_set_int32(env, value, "max", gopMax);
+    PASS_STATUS;
+    status = beam_set_double(env, value, "mean", gopMean);
+    PASS_STATUS;
+    status = beam_set_int32(env, value, "open", openGops);
+    PASS_STATUS;
+    status = beam_set_int32(env, value, "closed", (int32_t) s.gopLengths.size() - openGops);
+    PASS_STATUS;
+    status = beam_set_double(env, value, "keyframe_interval", intervalMean);
+    PASS_STATUS;
+    status = setColumn(env, value, "lengths", napi_int32_array, s.gopLengths);
+    PASS_STATUS;
+    status = setColumn(env, value, "open_flags", napi_uint8_array, s.gopOpen);
+    PASS_STATUS;
+    status = setColumn(env, value, "keyframe_intervals", napi_float64_array, s.keyframeIntervals);
+    PASS_STATUS;
+    status = napi_set_named_property(env, *result, "gop", value);
+    PASS_STATUS;
+    status = beam_set_int32(env, *result, "reorder_depth", s.reorderDepth);
+    PASS_STATUS;
+  } else {
+    status = beam_set_null(env, *result, "gop");
+    PASS_STATUS;
+  }
+
+  status = setColumn(env, *result, "instant_bitrate", napi_float32_array, s.instantBitrate);
+  PASS_STATUS;
+  status = setColumn(env, *result, "window_bitrate", napi_float64_array, s.windowBitrate);
+  PASS_STATUS;
+  status = setColumn(env, *result, "discontinuities", napi_int32_array, s.discontinuities);
+  PASS_STATUS;
+  if (s.vbvFullness.size() > 0) {
+    status = napi_create_object(env, &value);
+    PASS_STATUS;
+    status = beam_set_int32(env, value, "underflows", s.vbvUnderflows);
+    PASS_STATUS;
+    status = beam_set_double(env, value, "min_fullness",
+      *std::min_element(s.vbvFullness.begin(), s.vbvFullness.end()));
+    PASS_STATUS;
+    status = setColumn(env, value, "fullness", napi_float32_array, s.vbvFullness);
+    PASS_STATUS;
+    status = napi_set_named_property(env, *result, "vbv", value);
+  } else {
+    status = beam_set_null(env, *result, "vbv");
+  }
+  PASS_STATUS;
+  return napi_ok;
+}
+
+void analyseComplete(napi_env env, napi_status asyncStatus, void* data) {
+  analysisCarrier* c = (analysisCarrier*) data;
+  napi_value result, streams, stream;
+  uint32_t index = 0;
+
+  if (asyncStatus != napi_ok) {
+    c->status = asyncStatus;
+    c->errorMsg = "Packet analysis failed to complete.";
+  }
+  REJECT_STATUS;
+
+  // tidy up adaptor chunks if required
+  if (c->adaptor) {
+    c->status = c->adaptor->finaliseBufs(env);
+    REJECT_STATUS;
+  }
+
+  c->status = napi_create_object(env, &result);
+  REJECT_STATUS;
+  c->status = beam_set_string_utf8(env, result, "type", "analysis");
+  REJECT_STATUS;
+  c->status = beam_set_double(env, result, "window", c->settings.window);
+  REJECT_STATUS;
+  c->status = napi_create_array(env, &streams);
+  REJECT_STATUS;
+  for ( auto &s : c->streams ) {
+    c->status = fromStreamAnalysis(env, s, &stream);
+    REJECT_STATUS;
+    c->status = napi_set_element(env, streams, index++, stream);
+    REJECT_STATUS;
+  }
+  c->status = napi_set_named_property(env, result, "streams", streams);
+  REJECT_STATUS;
+  c->status = beam_set_int64(env, result, "total_time", c->totalTime);
+  REJECT_STATUS;
+
+  napi_status status;
+  status = napi_resolve_deferred(env, c->_deferred, result);
+  FLOATING_STATUS;
+
+  tidyCarrier(env, c);
+}
+
+/*
+  let report = await demuxer.analyse({
+    streams: [ 0 ], start: 10.0, end: 20.0, // As for scan
+    window: 1.0, // Seconds per windowed bitrate value
+    gap: 1.0, // Seconds of timestamp jump reported as a discontinuity
+    vbv: { max_rate: 8000000, buffer_size: 16000000 } // Optional VBV model in bits
+  });
+*/
+
+napi_value analyse(napi_env env, napi_callback_info info) {
+  napi_value resourceName, promise, formatJS, formatRefExt, adaptorExt, options, value;
+  napi_valuetype type;
+  const char* error = nullptr;
+  AVFormatContext* fmtCtx;
+  analysisCarrier* c = new analysisCarrier;
+
+  c->status = napi_create_promise(env, &c->_deferred, &promise);
+  REJECT_RETURN;
+
+  size_t argc = 1;
+  napi_value args[1];
+  c->status = napi_get_cb_info(env, info, &argc, args, &formatJS, nullptr);
+  REJECT_RETURN;
+  c->status = napi_get_named_property(env, formatJS, "_formatContextRef", &formatRefExt);
+  REJECT_RETURN;
+  c->status = napi_get_value_external(env, formatRefExt, (void**) &c->formatRef);
+  REJECT_RETURN;
+  fmtCtx = c->formatRef->fmtCtx;
+  if (fmtCtx == nullptr) {
+    REJECT_ERROR_RETURN("Cannot analyse a closed demuxer.", BEAMCODER_INVALID_ARGS);
+  }
+
+  c->status = napi_get_named_property(env, formatJS, "_adaptor", &adaptorExt);
+  REJECT_RETURN;
+  c->status = napi_get_value_external(env, adaptorExt, (void**)&c->adaptor);
+  REJECT_RETURN;
+
+  if (argc >= 1) {
+    options = args[0];
+  } else {
+    c->status = napi_get_undefined(env, &options);
+    REJECT_RETURN;
+  }
+  c->status = getScanRange(env, options, fmtCtx, c->range, &error);
+  REJECT_RETURN;
+  if (error != nullptr) {
+    REJECT_ERROR_RETURN(error, BEAMCODER_INVALID_ARGS);
+  }
+
+  c->status = napi_typeof(env, options, &type);
+  REJECT_RETURN;
+  if (type == napi_object) {
+    c->status = beam_get_double(env, options, "window", &c->settings.window);
+    REJECT_RETURN;
+    c->status = beam_get_double(env, options, "gap", &c->settings.gap);
+    REJECT_RETURN;
+    if (!(c->settings.window > 0.0) || !(c->settings.gap > 0.0)) {
+      REJECT_ERROR_RETURN("Analysis window and gap must be positive numbers of seconds.",
+        BEAMCODER_INVALID_ARGS);
+    }
+    c->status = napi_get_named_property(env, options, "vbv", &value);
+    REJECT_RETURN;
+    c->status = napi_typeof(env, value, &type);
+    REJECT_RETURN;
+    if (type == napi_object) {
+      c->status = beam_get_double(env, value, "max_rate", &c->settings.vbvMaxRate);
+      REJECT_RETURN;
+      c->status = beam_get_double(env, value, "buffer_size", &c->settings.vbvBufferSize);
+      REJECT_RETURN;
+      if (!(c->settings.vbvMaxRate > 0.0) || !(c->settings.vbvBufferSize > 0.0)) {
+        REJECT_ERROR_RETURN("Analysis VBV model requires a positive max_rate and buffer_size in bits.",
+          BEAMCODER_INVALID_ARGS);
+      }
+    }
+  }
+
+  for ( uint32_t s = 0 ; s < fmtCtx->nb_streams ; s++ ) {
+    if (!c->range.wants(s)) continue;
+    streamAnalysis a;
+    a.index = s;
+    a.codecType = fmtCtx->streams[s]->codecpar->codec_type;
+    a.timeBase = fmtCtx->streams[s]->time_base;
+    c->streams.push_back(a);
+  }
+
+  c->status = napi_create_reference(env, formatJS, 1, &c->passthru);
+  REJECT_RETURN;
+
+  c->status = napi_create_string_utf8(env, "Analyse", NAPI_AUTO_LENGTH, &resourceName);
+  REJECT_RETURN;
+  c->status = napi_create_async_work(env, nullptr, resourceName, analyseExecute,
+    analyseComplete, c, &c->_request);
+  REJECT_RETURN;
+  c->status = napi_queue_async_work(env, c->_request);
+  REJECT_RETURN;
+
+  return promise;
+}
@@ -0,0 +1,81 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include "node_api.h"
+#include "beamcoder_util.h"
+#include "scan.h"
+#include <vector>
+
+extern "C" {
+  #include <libavformat/avformat.h>
+}
+
+// Settings for the analysis of a set of scanned packets
+struct analysisSettings {
+  double window = 1.0; // seconds per windowed bitrate bin
+  double gap = 1.0; // seconds of forward timestamp jump counted as a discontinuity
+  double vbvMaxRate = 0.0; // bits per second, zero for no VBV model
+  double vbvBufferSize = 0.0; // bits
+};
+
+// Structure and bitrate of one stream, computed in a single pass
+struct streamAnalysis {
+  int index = 0;
+  AVMediaType codecType = AVMEDIA_TYPE_UNKNOWN;
+  AVRational timeBase = { 1, AV_TIME_BASE };
+  int64_t packets = 0;
+  int64_t bytes = 0;
+  double duration = 0.0;
+  double averageBitrate = 0.0;
+  double peakBitrate = 0.0;
+  int reorderDepth = 0;
+  int vbvUnderflows = 0;
+  std::vector<int32_t> gopLengths;
+  std::vector<uint8_t> gopOpen;
+  std::vector<double> keyframeIntervals;
+  std::vector<float> instantBitrate;
+  std::vector<double> windowBitrate;
+  std::vector<int32_t> discontinuities;
+  std::vector<float> vbvFullness;
+};
+
+// Analyse the scanned packets of the stream with the index, codec type and time
+// base set in result. Called on a worker thread.
+void analyseStream(const packetColumns& columns, const analysisSettings& settings,
+  streamAnalysis& result);
+
+struct analysisCarrier : carrier {
+  fmtCtxRef* formatRef = nullptr;
+  Adaptor *adaptor = nullptr;
+  scanRange range;
+  analysisSettings settings;
+  std::vector<streamAnalysis> streams;
+  ~analysisCarrier() { }
+};
+
+void analyseExecute(napi_env env, void* data);
+void analyseComplete(napi_env env, napi_status asyncStatus, void* data);
+napi_value analyse(napi_env env, napi_callback_info info);
+
+#endif // ANALYSIS_H
@@ -31,6 +31,12 @@
 #include "mux.h"
 #include "packet.h"
 #include "codec_par.h"
+#include "slicepool.h"
+#include "thumbnail.h"
+#include "threadbudget.h"
+#include "instance.h"
+#include "transfer.h"
+#include "framering.h"
 #include <stdio.h>
 
 extern "C" {
@@ -879,6 +885,9 @@ napi_value sampleFormats(napi_env env, napi_callback_info info) {
 napi_value Init(napi_env env, napi_value exports) {
   napi_status status;
   napi_value padSize, noopts;
+  // Each main or worker thread environment that loads the addon gets its own state
+  status = initInstance(env);
+  CHECK_STATUS;
   status = napi_create_int32(env, AV_INPUT_BUFFER_PADDING_SIZE, &padSize);
   CHECK_STATUS;
   status = napi_create_int64(env, AV_NOPTS_VALUE, &noopts);
@@ -913,16 +922,23 @@ napi_value Init(napi_env env, napi_value exports) {
     DECLARE_NAPI_METHOD("demuxer", demuxer),
     DECLARE_NAPI_METHOD("muxer", muxer),
     DECLARE_NAPI_METHOD("guessFormat", guessFormat),
+    DECLARE_NAPI_METHOD("filterThreads", filterThreads),
+    DECLARE_NAPI_METHOD("thumbnails", thumbnails),
+    DECLARE_NAPI_METHOD("codecThreads", codecThreads),
+    DECLARE_NAPI_METHOD("transfer", transfer),
+    DECLARE_NAPI_METHOD("receive", receive),
+    DECLARE_NAPI_METHOD("releaseTransfer", releaseTransfer),
+    DECLARE_NAPI_METHOD("frameRing", frameRing),
+    DECLARE_NAPI_METHOD("monotonicTime", monotonicTime),
     { "AV_INPUT_BUFFER_PADDING_SIZE", nullptr, nullptr, nullptr, nullptr,
       padSize, napi_enumerable, nullptr },
     { "AV_NOPTS_VALUE", nullptr, nullptr, nullptr, nullptr,
       noopts, napi_enumerable, nullptr }
   };
-  status = napi_define_properties(env, exports, 29, desc);
+  status = napi_define_properties(env, exports, 37, desc);
   CHECK_STATUS;
 
   avdevice_register_all();
-  avformat_network_init();
 
   // Iterate over all codecs to makes sure they are registered
   void* opaque = nullptr;
@@ -24,6 +24,8 @@
 #include <stdlib.h>
 #include <chrono>
 #include <string>
+#include <mutex>
+#include <unordered_set>
 #include "beamcoder_util.h"
 #include "node_api.h"
 
@@ -280,7 +282,10 @@ napi_status beam_get_string_utf8(napi_env env, napi_value target, const char* na
   PASS_STATUS;
   str = (char*) malloc(sizeof(char) * (len + 1));
   status = napi_get_value_string_utf8(env, prop, str, len + 1, &len);
-  PASS_STATUS;
+  if (status != napi_ok) {
+    free(str);
+    return status;
+  }
   *value = str;
   return napi_ok;
 }
@@ -561,6 +566,22 @@ napi_status fromAVClass(napi_env env, const AVClass* cls, napi_value* result) {
   return napi_ok;
 }
 
+// Opaque values of the AVBufferRefs that wrap Javascript Buffers
+static std::mutex jsBufferLock;
+static std::unordered_set<const void*> jsBuffers;
+
+void beam_track_js_buffer(const avBufRef* avr, bool live) {
+  std::lock_guard<std::mutex> lk(jsBufferLock);
+  if (live) jsBuffers.insert(avr);
+  else jsBuffers.erase(avr);
+}
+
+bool beam_is_js_buffer(AVBufferRef* buf) {
+  if (buf == nullptr) return false;
+  std::lock_guard<std::mutex> lk(jsBufferLock);
+  return jsBuffers.count(av_buffer_get_opaque(buf)) > 0;
+}
+
 napi_status makeAVDictionary(napi_env env, napi_value options, AVDictionary** metadata) {
   napi_status status;
   napi_value names, key, value, valueS;
@@ -197,6 +197,11 @@ struct avBufRef {
   int64_t pts = -1;
 };
 
+// Buffers wrapping Javascript memory belong to the environment that made them,
+// so must be copied before their frame or packet is used by another environment
+void beam_track_js_buffer(const avBufRef* avr, bool live);
+bool beam_is_js_buffer(AVBufferRef* buf);
+
 napi_status fromAVClass(napi_env env, const AVClass* cls, napi_value* result);
 napi_status makeAVDictionary(napi_env env, napi_value options, AVDictionary** dict);
 
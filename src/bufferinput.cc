@@ -0,0 +1,114 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#include "bufferinput.h"
+#include <cstring>
+
+static const int IO_BUFFER_SIZE = 32768;
+
+napi_status BufferInput::create(napi_env env, napi_value buffer, BufferInput **result) {
+  napi_status status;
+  void *data;
+  size_t size;
+  BufferInput *input = new BufferInput(env);
+
+  status = napi_get_buffer_info(env, buffer, &data, &size);
+  if (status != napi_ok) {
+    delete input;
+    return status;
+  }
+  status = napi_create_reference(env, buffer, 1, &input->mRef);
+  if (status != napi_ok) {
+    delete input;
+    return status;
+  }
+  input->mData = (const uint8_t *)data;
+  input->mSize = size;
+  *result = input;
+  return napi_ok;
+}
+
+BufferInput::~BufferInput() {
+  if (mRef != nullptr) napi_delete_reference(mEnv, mRef);
+}
+
+AVIOContext *BufferInput::allocContext() {
+  uint8_t *ioBuf = (uint8_t *)av_malloc(IO_BUFFER_SIZE);
+  if (nullptr == ioBuf) return nullptr;
+  AVIOContext *pb = avio_alloc_context(ioBuf, IO_BUFFER_SIZE, 0, this,
+    &BufferInput::readPacket, nullptr, &BufferInput::seek);
+  if (nullptr == pb) {
+    av_free(ioBuf);
+    return nullptr;
+  }
+  // Large reads such as packet payloads go straight from the Buffer into
+  // the destination rather than through the I/O buffer
+  pb->direct = 1;
+  return pb;
+}
+
+bool BufferInput::owns(const AVIOContext *pb) {
+  return (pb != nullptr) && (pb->read_packet == &BufferInput::readPacket);
+}
+
+void BufferInput::freeContext(AVIOContext **pb) {
+  if (*pb == nullptr) return;
+  av_freep(&(*pb)->buffer);
+  avio_context_free(pb);
+}
+
+int BufferInput::readPacket(void *opaque, uint8_t *buf, int bufSize) {
+  BufferInput *input = (BufferInput *)opaque;
+  size_t remaining = input->mSize - input->mPos;
+  if (0 == remaining) return AVERROR_EOF;
+  size_t numBytes = ((size_t)bufSize < remaining) ? (size_t)bufSize : remaining;
+  memcpy(buf, input->mData + input->mPos, numBytes);
+  input->mPos += numBytes;
+  return (int)numBytes;
+}
+
+int64_t BufferInput::seek(void *opaque, int64_t offset, int whence) {
+  BufferInput *input = (BufferInput *)opaque;
+  int64_t pos;
+  switch (whence & ~AVSEEK_FORCE) {
+    case AVSEEK_SIZE:
+      return (int64_t)input->mSize;
+    case SEEK_SET:
+      pos = offset;
+      break;
+    case SEEK_CUR:
+      pos = (int64_t)input->mPos + offset;
+      break;
+    case SEEK_END:
+      pos = (int64_t)input->mSize + offset;
+      break;
+    default:
+      return AVERROR(EINVAL);
+  }
+  if ((pos < 0) || (pos > (int64_t)input->mSize)) return AVERROR(EINVAL);
+  input->mPos = (size_t)pos;
+  return pos;
+}
+
+void bufferInputFinalizer(napi_env env, void* data, void* hint) {
+  BufferInput *input = (BufferInput *)data;
+  delete input;
+}
@@ -0,0 +1,61 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#ifndef BUFFERINPUT_H
+#define BUFFERINPUT_H
+
+#include "node_api.h"
+
+extern "C" {
+  #include <libavformat/avformat.h>
+}
+
+// Demuxer input read directly from a Node.js Buffer through a custom
+// AVIOContext. The Buffer is kept alive by a reference for the lifetime of
+// the input, and reads and seeks are plain memory operations on the worker.
+class BufferInput {
+public:
+  static napi_status create(napi_env env, napi_value buffer, BufferInput **result);
+  ~BufferInput();
+
+  // Allocate the AVIOContext that reads from this input
+  AVIOContext *allocContext();
+  // Whether an AVIOContext was allocated by a BufferInput
+  static bool owns(const AVIOContext *pb);
+  // Free an AVIOContext allocated by allocContext() along with its buffer
+  static void freeContext(AVIOContext **pb);
+
+  static int readPacket(void *opaque, uint8_t *buf, int bufSize);
+  static int64_t seek(void *opaque, int64_t offset, int whence);
+
+private:
+  BufferInput(napi_env env) : mEnv(env) {}
+
+  napi_env mEnv;
+  napi_ref mRef = nullptr;
+  const uint8_t *mData = nullptr;
+  size_t mSize = 0;
+  size_t mPos = 0;
+};
+
+void bufferInputFinalizer(napi_env env, void* data, void* hint);
+
+#endif // BUFFERINPUT_H
@@ -0,0 +1,99 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#include "bufferpool.h"
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+
+static const size_t minBlockSize = 64 * 1024;
+static const size_t maxFreePerSize = 8;
+
+BufferPool& BufferPool::instance() {
+  static BufferPool pool;
+  return pool;
+}
+
+BufferPool::~BufferPool() {
+  for (auto &f : mFree)
+    for (auto block : f.second) free(block);
+}
+
+uint8_t *BufferPool::acquire(size_t size, size_t *capacity) {
+  size_t blockSize = minBlockSize;
+  while (blockSize < size) blockSize <<= 1;
+  *capacity = blockSize;
+  {
+    std::lock_guard<std::mutex> lk(m);
+    auto f = mFree.find(blockSize);
+    if ((f != mFree.end()) && !f->second.empty()) {
+      uint8_t *block = f->second.back();
+      f->second.pop_back();
+      return block;
+    }
+  }
+  return (uint8_t *)malloc(blockSize);
+}
+
+void BufferPool::release(uint8_t *block, size_t capacity) {
+  if (nullptr == block) return;
+  {
+    std::lock_guard<std::mutex> lk(m);
+    std::vector<uint8_t *> &f = mFree[capacity];
+    if (f.size() < maxFreePerSize) {
+      f.push_back(block);
+      return;
+    }
+  }
+  free(block);
+}
+
+uint8_t *growPooled(uint8_t *block, size_t used, size_t size, size_t *capacity) {
+  if ((block != nullptr) && (size <= *capacity)) return block;
+  size_t newCapacity;
+  uint8_t *newBlock = BufferPool::instance().acquire(size, &newCapacity);
+  if (nullptr == newBlock) return nullptr;
+  if (used > 0) memcpy(newBlock, block, used);
+  BufferPool::instance().release(block, *capacity);
+  *capacity = newCapacity;
+  return newBlock;
+}
+
+void pooledBufferFinalizer(napi_env env, void* data, void* hint) {
+  int64_t externalMemory;
+  size_t capacity = (size_t)(uint64_t)hint;
+  BufferPool::instance().release((uint8_t *)data, capacity);
+  if (napi_ok != napi_adjust_external_memory(env, -(int64_t)capacity, &externalMemory))
+    printf("Error finalising pooled buffer %p, capacity %zu\n", data, capacity);
+}
+
+napi_status makePooledBuffer(napi_env env, uint8_t *block, size_t size,
+    size_t capacity, napi_value *result) {
+  napi_status status;
+  int64_t externalMemory;
+  status = napi_create_external_buffer(env, size, block, pooledBufferFinalizer,
+    (void*)(uint64_t)capacity, result);
+  if (status != napi_ok) {
+    BufferPool::instance().release(block, capacity);
+    return status;
+  }
+  return napi_adjust_external_memory(env, (int64_t)capacity, &externalMemory);
+}
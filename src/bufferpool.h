@@ -0,0 +1,55 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include "node_api.h"
+#include <map>
+#include <vector>
+#include <mutex>
+
+// Process-wide pool of memory blocks for output buffers handed to Javascript.
+// Blocks are sized in powers of two and returned to the pool when the
+// Buffer that wraps them is garbage collected.
+class BufferPool {
+public:
+  static BufferPool& instance();
+
+  uint8_t *acquire(size_t size, size_t *capacity);
+  void release(uint8_t *block, size_t capacity);
+
+private:
+  BufferPool() {}
+  ~BufferPool();
+
+  std::mutex m;
+  std::map<size_t, std::vector<uint8_t *> > mFree;
+};
+
+// Grow a pooled block to hold at least size bytes, keeping the first used bytes
+uint8_t *growPooled(uint8_t *block, size_t used, size_t size, size_t *capacity);
+
+// Wrap a pooled block as a Buffer that returns the block to the pool when collected
+napi_status makePooledBuffer(napi_env env, uint8_t *block, size_t size,
+  size_t capacity, napi_value *result);
+
+#endif // BUFFERPOOL_H
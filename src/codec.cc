@@ -7249,6 +7249,7 @@ napi_status fromAVCodecContext(napi_env env, AVCodecContext* codec,
 void codecContextFinalizer(napi_env env, void* data, void* hint) {
   AVCodecContext* codecCtx = (AVCodecContext*) data;
   bool* encodingRef = (bool*) hint;
+  ThreadBudget::instance().release(codecCtx);
   if ((codecCtx->extradata_size > 0) && (codecCtx->extradata != nullptr)) {
     av_freep(&codecCtx->extradata);
     codecCtx->extradata_size = 0;
@@ -7274,8 +7275,10 @@ void codecContextFinalizer(napi_env env, void* data, void* hint) {
     av_freep(&codecCtx->subtitle_header);
     codecCtx->subtitle_header_size = 0;
   }
+  FramePool *framePool = FramePool::of(codecCtx);
   avcodec_close(codecCtx);
   avcodec_free_context(&codecCtx);
+  delete framePool;
 }
 
 napi_status fromAVCodecDescriptor(napi_env env, const AVCodecDescriptor* codecDesc,
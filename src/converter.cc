@@ -0,0 +1,345 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#include "converter.h"
+#include <cstring>
+
+extern "C" {
+  #include <libavutil/imgutils.h>
+  #include <libavutil/samplefmt.h>
+  #include <libavutil/channel_layout.h>
+  #include <libavutil/pixdesc.h>
+}
+
+static const struct { const char *name; int flags; } scaleAlgorithms[] = {
+  { "fast_bilinear", SWS_FAST_BILINEAR },
+  { "bilinear", SWS_BILINEAR },
+  { "bicubic", SWS_BICUBIC },
+  { "experimental", SWS_X },
+  { "neighbor", SWS_POINT },
+  { "point", SWS_POINT },
+  { "area", SWS_AREA },
+  { "bicublin", SWS_BICUBLIN },
+  { "gauss", SWS_GAUSS },
+  { "sinc", SWS_SINC },
+  { "lanczos", SWS_LANCZOS },
+  { "spline", SWS_SPLINE }
+};
+
+int scaleAlgorithm(const char *name) {
+  for ( auto &a : scaleAlgorithms ) {
+    if (strcmp(a.name, name) == 0) return a.flags;
+  }
+  return -1;
+}
+
+// Output plane alignment, matching av_frame_get_buffer
+#define CONVERT_ALIGN 32
+
+Converter *Converter::create(napi_env env, napi_value options,
+    AVMediaType type, const char **error) {
+  napi_status status;
+  char *name = nullptr;
+  uint32_t value;
+  Converter *c = new Converter(type);
+
+  if (type == AVMEDIA_TYPE_VIDEO) {
+    status = beam_get_string_utf8(env, options, "pix_fmt", &name);
+    if (status != napi_ok) goto invalid;
+    if (name != nullptr) {
+      c->mPixFmt = av_get_pix_fmt(name);
+      free(name);
+      if (c->mPixFmt == AV_PIX_FMT_NONE) {
+        *error = "Output format pix_fmt is not a known pixel format.";
+        goto fail;
+      }
+      if (!sws_isSupportedOutput(c->mPixFmt)) {
+        *error = "Output format pix_fmt is not supported for conversion.";
+        goto fail;
+      }
+    }
+    value = 0;
+    status = beam_get_uint32(env, options, "width", &value);
+    if (status != napi_ok) goto invalid;
+    c->mWidth = (int) value;
+    value = 0;
+    status = beam_get_uint32(env, options, "height", &value);
+    if (status != napi_ok) goto invalid;
+    c->mHeight = (int) value;
+    status = beam_get_string_utf8(env, options, "algorithm", &name);
+    if (status != napi_ok) goto invalid;
+    if (name != nullptr) {
+      c->mFlags = scaleAlgorithm(name);
+      free(name);
+      if (c->mFlags < 0) {
+        *error = "Output format algorithm is not a known scaling algorithm.";
+        goto fail;
+      }
+    }
+    if ((c->mPixFmt == AV_PIX_FMT_NONE) && (c->mWidth == 0) && (c->mHeight == 0)) {
+      *error = "Video output format requires one of pix_fmt, width or height.";
+      goto fail;
+    }
+  } else if (type == AVMEDIA_TYPE_AUDIO) {
+    status = beam_get_string_utf8(env, options, "sample_fmt", &name);
+    if (status != napi_ok) goto invalid;
+    if (name != nullptr) {
+      c->mSampleFmt = av_get_sample_fmt(name);
+      free(name);
+      if (c->mSampleFmt == AV_SAMPLE_FMT_NONE) {
+        *error = "Output format sample_fmt is not a known sample format.";
+        goto fail;
+      }
+    }
+    value = 0;
+    status = beam_get_uint32(env, options, "sample_rate", &value);
+    if (status != napi_ok) goto invalid;
+    c->mSampleRate = (int) value;
+    status = beam_get_string_utf8(env, options, "channel_layout", &name);
+    if (status != napi_ok) goto invalid;
+    if (name != nullptr) {
+      c->mChannelLayout = av_get_channel_layout(name);
+      free(name);
+      if (c->mChannelLayout == 0) {
+        *error = "Output format channel_layout is not a known channel layout.";
+        goto fail;
+      }
+    }
+    if ((c->mSampleFmt == AV_SAMPLE_FMT_NONE) && (c->mSampleRate == 0) &&
+        (c->mChannelLayout == 0)) {
+      *error = "Audio output format requires one of sample_fmt, sample_rate or channel_layout.";
+      goto fail;
+    }
+  } else {
+    *error = "Output format can only be set for video and audio decoders.";
+    goto fail;
+  }
+  return c;
+
+invalid:
+  *error = "Output format options could not be read.";
+fail:
+  delete c;
+  return nullptr;
+}
+
+Converter *Converter::video(AVPixelFormat pixFmt, int width, int height, int flags) {
+  Converter *c = new Converter(AVMEDIA_TYPE_VIDEO);
+  c->mPixFmt = pixFmt;
+  c->mWidth = width;
+  c->mHeight = height;
+  c->mFlags = flags;
+  return c;
+}
+
+Converter::~Converter() {
+  sws_freeContext(mSws);
+  swr_free(&mSwr);
+  av_frame_free(&mLast);
+  // Buffers still referenced by frames keep the pool alive until released
+  av_buffer_pool_uninit(&mPool);
+}
+
+AVBufferRef *Converter::getBuffer(int size) {
+  if ((mPool == nullptr) || (size > mPoolSize)) {
+    av_buffer_pool_uninit(&mPool);
+    mPool = av_buffer_pool_init(size, nullptr);
+    mPoolSize = size;
+    if (mPool == nullptr) return nullptr;
+  }
+  return av_buffer_pool_get(mPool);
+}
+
+int Converter::convert(AVFrame *frame, std::vector<AVFrame*> &frames) {
+  return (mType == AVMEDIA_TYPE_VIDEO) ?
+    convertVideo(frame, frames) : convertAudio(frame, frames);
+}
+
+int Converter::convertVideo(AVFrame *frame, std::vector<AVFrame*> &frames) {
+  int ret;
+  AVPixelFormat inFmt = (AVPixelFormat) frame->format;
+  AVPixelFormat outFmt = (mPixFmt != AV_PIX_FMT_NONE) ? mPixFmt : inFmt;
+  int outWidth = mWidth;
+  int outHeight = mHeight;
+  // One dimension given - keep the display aspect ratio, rounded to even
+  if ((outWidth == 0) && (outHeight == 0)) {
+    outWidth = frame->width;
+    outHeight = frame->height;
+  } else if (outWidth == 0) {
+    outWidth = (int) av_rescale(frame->width, outHeight, frame->height) & ~1;
+  } else if (outHeight == 0) {
+    outHeight = (int) av_rescale(frame->height, outWidth, frame->width) & ~1;
+  }
+
+  if ((outFmt == inFmt) && (outWidth == frame->width) && (outHeight == frame->height)) {
+    frames.push_back(frame);
+    return 0;
+  }
+
+  mSws = sws_getCachedContext(mSws, frame->width, frame->height, inFmt,
+    outWidth, outHeight, outFmt, mFlags, nullptr, nullptr, nullptr);
+  if (mSws == nullptr) {
+    av_frame_free(&frame);
+    return AVERROR(EINVAL);
+  }
+  if (frame->colorspace != AVCOL_SPC_UNSPECIFIED) {
+    int *invTable, *table, srcRange, dstRange, brightness, contrast, saturation;
+    if (sws_getColorspaceDetails(mSws, &invTable, &srcRange, &table, &dstRange,
+        &brightness, &contrast, &saturation) >= 0) {
+      sws_setColorspaceDetails(mSws, sws_getCoefficients(frame->colorspace),
+        frame->color_range == AVCOL_RANGE_JPEG, table, dstRange,
+        brightness, contrast, saturation);
+    }
+  }
+
+  int size = av_image_get_buffer_size(outFmt, outWidth, outHeight, CONVERT_ALIGN);
+  if (size < 0) {
+    av_frame_free(&frame);
+    return size;
+  }
+  AVFrame *out = av_frame_alloc();
+  out->buf[0] = getBuffer(size);
+  if (out->buf[0] == nullptr) {
+    av_frame_free(&out);
+    av_frame_free(&frame);
+    return AVERROR(ENOMEM);
+  }
+  av_image_fill_arrays(out->data, out->linesize, out->buf[0]->data,
+    outFmt, outWidth, outHeight, CONVERT_ALIGN);
+  out->format = outFmt;
+  out->width = outWidth;
+  out->height = outHeight;
+  av_frame_copy_props(out, frame);
+  if (outFmt != inFmt) {
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(outFmt);
+    if (desc->flags & AV_PIX_FMT_FLAG_RGB) {
+      out->colorspace = AVCOL_SPC_RGB;
+      out->color_range = AVCOL_RANGE_JPEG;
+    }
+  }
+
+  ret = sws_scale(mSws, frame->data, frame->linesize, 0, frame->height,
+    out->data, out->linesize);
+  av_frame_free(&frame);
+  if (ret < 0) {
+    av_frame_free(&out);
+    return ret;
+  }
+  frames.push_back(out);
+  return 0;
+}
+
+int Converter::setupResampler(AVFrame *frame) {
+  uint64_t inLayout = frame->channel_layout ?
+    frame->channel_layout : av_get_default_channel_layout(frame->channels);
+  if ((mSwr != nullptr) && (mInSampleFmt == frame->format) &&
+      (mInSampleRate == frame->sample_rate) && (mInChannelLayout == inLayout))
+    return 0;
+
+  swr_free(&mSwr);
+  mInSampleFmt = (AVSampleFormat) frame->format;
+  mInSampleRate = frame->sample_rate;
+  mInChannelLayout = inLayout;
+  mSwr = swr_alloc_set_opts(nullptr,
+    mChannelLayout ? mChannelLayout : inLayout,
+    (mSampleFmt != AV_SAMPLE_FMT_NONE) ? mSampleFmt : mInSampleFmt,
+    mSampleRate ? mSampleRate : mInSampleRate,
+    inLayout, mInSampleFmt, mInSampleRate, 0, nullptr);
+  if (mSwr == nullptr) return AVERROR(ENOMEM);
+  return swr_init(mSwr);
+}
+
+int Converter::convertAudio(AVFrame *frame, std::vector<AVFrame*> &frames) {
+  int ret;
+  uint64_t inLayout = frame->channel_layout ?
+    frame->channel_layout : av_get_default_channel_layout(frame->channels);
+  if ((mSwr == nullptr) &&
+      ((mSampleFmt == AV_SAMPLE_FMT_NONE) || (mSampleFmt == frame->format)) &&
+      ((mSampleRate == 0) || (mSampleRate == frame->sample_rate)) &&
+      ((mChannelLayout == 0) || (mChannelLayout == inLayout))) {
+    frames.push_back(frame);
+    return 0;
+  }
+
+  if ((ret = setupResampler(frame)) < 0) {
+    av_frame_free(&frame);
+    return ret;
+  }
+  if (mLast == nullptr) mLast = av_frame_alloc();
+  av_frame_unref(mLast);
+  av_frame_copy_props(mLast, frame);
+  ret = resample(frame, frames);
+  av_frame_free(&frame);
+  return ret;
+}
+
+// Convert a frame, or drain the resampler when frame is null
+int Converter::resample(AVFrame *frame, std::vector<AVFrame*> &frames) {
+  AVSampleFormat outFmt = (mSampleFmt != AV_SAMPLE_FMT_NONE) ? mSampleFmt : mInSampleFmt;
+  uint64_t outLayout = mChannelLayout ? mChannelLayout : mInChannelLayout;
+  int outRate = mSampleRate ? mSampleRate : mInSampleRate;
+  int channels = av_get_channel_layout_nb_channels(outLayout);
+  int capacity = swr_get_out_samples(mSwr, frame ? frame->nb_samples : 0);
+  int ret;
+  if (capacity <= 0) return capacity;
+
+  AVFrame *out = av_frame_alloc();
+  out->format = outFmt;
+  out->channel_layout = outLayout;
+  out->channels = channels;
+  out->sample_rate = outRate;
+  out->nb_samples = capacity;
+  if (av_sample_fmt_is_planar(outFmt) && (channels > AV_NUM_DATA_POINTERS)) {
+    ret = av_frame_get_buffer(out, 0); // needs extended_data, not pooled
+  } else {
+    int size = av_samples_get_buffer_size(nullptr, channels, capacity, outFmt, 0);
+    out->buf[0] = (size < 0) ? nullptr : getBuffer(size);
+    ret = (out->buf[0] == nullptr) ? AVERROR(ENOMEM) :
+      av_samples_fill_arrays(out->data, out->linesize, out->buf[0]->data,
+        channels, capacity, outFmt, 0);
+  }
+  if (ret < 0) {
+    av_frame_free(&out);
+    return ret;
+  }
+  av_frame_copy_props(out, frame ? frame : mLast);
+
+  ret = swr_convert(mSwr, out->extended_data, capacity,
+    frame ? (const uint8_t**) frame->extended_data : nullptr,
+    frame ? frame->nb_samples : 0);
+  if (ret <= 0) { // resampler is holding all the samples, or failed
+    av_frame_free(&out);
+    return ret;
+  }
+  out->nb_samples = ret;
+  frames.push_back(out);
+  return 0;
+}
+
+int Converter::drain(std::vector<AVFrame*> &frames) {
+  if ((mType != AVMEDIA_TYPE_AUDIO) || (mSwr == nullptr)) return 0;
+  return resample(nullptr, frames);
+}
+
+void converterFinalizer(napi_env env, void* data, void* hint) {
+  Converter *c = (Converter *) data;
+  delete c;
+}
@@ -0,0 +1,91 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#ifndef CONVERTER_H
+#define CONVERTER_H
+
+#include "node_api.h"
+#include "beamcoder_util.h"
+#include <vector>
+
+extern "C" {
+  #include <libavcodec/avcodec.h>
+  #include <libavutil/buffer.h>
+  #include <libswscale/swscale.h>
+  #include <libswresample/swresample.h>
+}
+
+// Converts decoded frames to a fixed output format on the decoding thread,
+// so that only converted frames reach Javascript. Video is scaled and
+// converted with a cached swscale context, audio resampled with swresample.
+// Output frames are allocated from a buffer pool that is reused while the
+// output size stays the same.
+class Converter {
+public:
+  // Parse an output_format options object for a decoder of the given type.
+  // Returns nullptr and sets error for invalid options.
+  static Converter *create(napi_env env, napi_value options,
+    AVMediaType type, const char **error);
+  // Video-only converter for use from native code
+  static Converter *video(AVPixelFormat pixFmt, int width, int height, int flags);
+  ~Converter();
+
+  // Converts frame, taking ownership of it, and appends any output frames.
+  // Returns 0 or a negative AVERROR.
+  int convert(AVFrame *frame, std::vector<AVFrame*> &frames);
+  // Appends any samples still buffered in the resampler.
+  int drain(std::vector<AVFrame*> &frames);
+
+private:
+  Converter(AVMediaType type) : mType(type) {}
+  int convertVideo(AVFrame *frame, std::vector<AVFrame*> &frames);
+  int convertAudio(AVFrame *frame, std::vector<AVFrame*> &frames);
+  int setupResampler(AVFrame *frame);
+  int resample(AVFrame *frame, std::vector<AVFrame*> &frames);
+  AVBufferRef *getBuffer(int size);
+
+  AVMediaType mType;
+
+  AVPixelFormat mPixFmt = AV_PIX_FMT_NONE;
+  int mWidth = 0;
+  int mHeight = 0;
+  int mFlags = SWS_BICUBIC;
+  SwsContext *mSws = nullptr;
+
+  AVSampleFormat mSampleFmt = AV_SAMPLE_FMT_NONE;
+  int mSampleRate = 0;
+  uint64_t mChannelLayout = 0;
+  SwrContext *mSwr = nullptr;
+  AVSampleFormat mInSampleFmt = AV_SAMPLE_FMT_NONE;
+  int mInSampleRate = 0;
+  uint64_t mInChannelLayout = 0;
+  AVFrame *mLast = nullptr; // properties for drained samples
+
+  AVBufferPool *mPool = nullptr;
+  int mPoolSize = 0;
+};
+
+// swscale flags for a scaling algorithm name, or -1 if unknown
+int scaleAlgorithm(const char *name);
+
+void converterFinalizer(napi_env env, void* data, void* hint);
+
+#endif // CONVERTER_H
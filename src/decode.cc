@@ -20,6 +20,7 @@
 */
 
 #include "decode.h"
+#include "decodestream.h"
 
 AVPixelFormat get_format(AVCodecContext *s, const AVPixelFormat *pix_fmts)
 {
@@ -57,12 +58,58 @@ AVPixelFormat get_format(AVCodecContext *s, const AVPixelFormat *pix_fmts)
   return *p;
 }
 
+// Speed profiles trade picture quality for decoding speed, e.g. for proxies.
+// Each step keeps the settings of the one before and adds to them.
+static const struct {
+  const char* name;
+  bool fast;
+  AVDiscard skipLoopFilter;
+  AVDiscard skipIdct;
+  AVDiscard skipFrame;
+  int lowres;
+} speedProfiles[] = {
+  { "quality", false, AVDISCARD_DEFAULT, AVDISCARD_DEFAULT, AVDISCARD_DEFAULT, 0 },
+  { "fast", true, AVDISCARD_NONREF, AVDISCARD_DEFAULT, AVDISCARD_DEFAULT, 0 },
+  { "faster", true, AVDISCARD_ALL, AVDISCARD_NONREF, AVDISCARD_DEFAULT, 1 },
+  { "fastest", true, AVDISCARD_ALL, AVDISCARD_NONKEY, AVDISCARD_NONREF, 2 }
+};
+
+// Apply a speed profile before the decoder is opened. Returns an error message
+// for an unknown profile. The settings only apply to video, and lowres is
+// limited to what the codec supports and not used with hardware decoding.
+// FFmpeg has no capability flags for the FAST flag or the skip_ options, so
+// these are set for every video codec and ignored by those without support.
+static const char* applySpeedProfile(AVCodecContext* decoder, const char* name, bool hwaccel) {
+  for ( auto &p : speedProfiles ) {
+    if (strcmp(p.name, name) != 0) continue;
+    if (decoder->codec_type != AVMEDIA_TYPE_VIDEO) return nullptr;
+    if (p.fast) decoder->flags2 |= AV_CODEC_FLAG2_FAST;
+    decoder->skip_loop_filter = p.skipLoopFilter;
+    decoder->skip_idct = p.skipIdct;
+    decoder->skip_frame = p.skipFrame;
+    decoder->lowres = hwaccel ? 0 : FFMIN(p.lowres, (int) decoder->codec->max_lowres);
+    return nullptr;
+  }
+  return "Decoder speed_profile must be one of 'quality', 'fast', 'faster' or 'fastest'.";
+}
+
+// Free a decoder that was never handed to Javascript, with any frame pool
+// installed on it, as codecContextFinalizer does
+static void freeDecoder(AVCodecContext** decoder) {
+  FramePool *framePool = FramePool::of(*decoder);
+  avcodec_close(*decoder);
+  avcodec_free_context(decoder);
+  delete framePool;
+}
+
 napi_value decoder(napi_env env, napi_callback_info info) {
   napi_status status;
   napi_value result, value, formatJS, formatExt, global, jsObject, assign, jsParams;
   napi_valuetype type;
-  bool isArray, hasName, hasID, hasFormat, hasStream, hasParams, hasHWaccel;
+  bool isArray, hasName, hasID, hasFormat, hasStream, hasParams, hasHWaccel, hasOutput, hasThreads;
   AVCodecContext* decoder = nullptr;
+  Converter* converter = nullptr;
+  char* profileName = nullptr;
   AVFormatContext* format = nullptr;
   const AVCodec* codec = nullptr;
   int ret = 0, streamIdx = -1;
@@ -72,6 +119,7 @@ napi_value decoder(napi_env env, napi_callback_info info) {
   size_t codecNameLen = 0;
   int32_t codecID = -1;
   bool hwaccel = false;
+  bool hasFramePool, framePool = false;
 
   size_t argc = 1;
   napi_value args[1];
@@ -196,6 +244,42 @@ create:
       decoder->get_format = get_format;
   }
 
+  status = beam_get_bool(env, args[0], "frame_pool", &hasFramePool, &framePool);
+  CHECK_STATUS;
+  if (hasFramePool && framePool) {
+    FramePool::install(decoder);
+  }
+
+  status = beam_get_string_utf8(env, args[0], "speed_profile", &profileName);
+  CHECK_STATUS;
+  if (profileName != nullptr) {
+    const char* profileError = applySpeedProfile(decoder, profileName, hwaccel);
+    free(profileName);
+    if (profileError != nullptr) {
+      freeDecoder(&decoder);
+      NAPI_THROW_ERROR(profileError);
+    }
+  }
+
+  status = napi_has_named_property(env, args[0], "output_format", &hasOutput);
+  CHECK_STATUS;
+  if (hasOutput) {
+    status = napi_get_named_property(env, args[0], "output_format", &value);
+    CHECK_STATUS;
+    status = napi_typeof(env, value, &type);
+    CHECK_STATUS;
+    if (type != napi_object) {
+      freeDecoder(&decoder);
+      NAPI_THROW_ERROR("Decoder output_format must be an options object.");
+    }
+    const char* convertError = nullptr;
+    converter = Converter::create(env, value, codec->type, &convertError);
+    if (converter == nullptr) {
+      freeDecoder(&decoder);
+      NAPI_THROW_ERROR(convertError);
+    }
+  }
+
   status = fromAVCodecContext(env, decoder, &result, false);
   const napi_value fargs[2] = { result, args[0] };
   CHECK_BAIL;
@@ -210,13 +294,50 @@ create:
   status = napi_call_function(env, result, assign, 2, fargs, &result);
   CHECK_BAIL;
 
+  status = napi_has_named_property(env, args[0], "thread_count", &hasThreads);
+  CHECK_BAIL;
+  ThreadBudget::instance().allocate(decoder, false, hasThreads);
+
+  if (format != nullptr) {
+    napi_value streamValue;
+    status = napi_create_int32(env, streamIdx, &streamValue);
+    CHECK_BAIL;
+    napi_property_descriptor desc[] = {
+      { "_demuxer", nullptr, nullptr, nullptr, nullptr, formatJS, napi_default, nullptr },
+      { "_streamIndex", nullptr, nullptr, nullptr, nullptr, streamValue, napi_default, nullptr }
+    };
+    status = napi_define_properties(env, result, 2, desc);
+    CHECK_BAIL;
+  }
+  if (converter != nullptr) {
+    napi_value converterExt;
+    status = napi_create_external(env, converter, converterFinalizer, nullptr, &converterExt);
+    CHECK_BAIL;
+    converter = nullptr; // now owned by the external
+    napi_property_descriptor desc[] = {
+      { "_converter", nullptr, nullptr, nullptr, nullptr, converterExt, napi_default, nullptr }
+    };
+    status = napi_define_properties(env, result, 1, desc);
+    CHECK_BAIL;
+  }
+  status = napi_create_function(env, "pull", NAPI_AUTO_LENGTH, pull, nullptr, &value);
+  CHECK_BAIL;
+  status = napi_set_named_property(env, result, "pull", value);
+  CHECK_BAIL;
+  status = napi_create_function(env, "decodeStream", NAPI_AUTO_LENGTH,
+    DecodeStream::create, nullptr, &value);
+  CHECK_BAIL;
+  status = napi_set_named_property(env, result, "decodeStream", value);
+  CHECK_BAIL;
+
   if (decoder != nullptr) return result;
 
 bail:
   if (decoder != nullptr) {
-    avcodec_close(decoder);
-    avcodec_free_context(&decoder);
+    ThreadBudget::instance().release(decoder);
+    freeDecoder(&decoder);
   }
+  if (converter != nullptr) delete converter;
   return nullptr;
 }
 
@@ -240,8 +361,13 @@ void decodeExecute(napi_env env, void* data) {
       case AVERROR(EAGAIN):
         // printf("Input is not accepted in the current state - user must read output with avcodec_receive_frame().\n");
         frame = av_frame_alloc();
-        avcodec_receive_frame(c->decoder, frame);
-        c->frames.push_back(frame);
+        if (avcodec_receive_frame(c->decoder, frame) != 0) {
+          c->frames.push_back(frame);
+        } else if ((ret = keepFrame(c->converter, frame, c->frames)) < 0) {
+          c->status = BEAMCODER_ERROR_DECODE;
+          c->errorMsg = avErrorMsg("Error converting frame: ", ret);
+          return;
+        }
         goto bump;
       case AVERROR_EOF:
         c->status = BEAMCODER_ERROR_EOF;
@@ -281,18 +407,33 @@ void decodeExecute(napi_env env, void* data) {
         if ((ret = av_hwframe_transfer_data(sw_frame, frame, 0)) < 0) {
           printf("Error transferring hw data to system memory\n");
         }
-        c->frames.push_back(sw_frame);
         av_frame_free(&frame);
-      } else
-        c->frames.push_back(frame);
+        frame = sw_frame;
+        sw_frame = nullptr;
+      }
+      if ((ret = keepFrame(c->converter, frame, c->frames)) < 0) {
+        c->status = BEAMCODER_ERROR_DECODE;
+        c->errorMsg = avErrorMsg("Error converting frame: ", ret);
+        frame = nullptr;
+        break;
+      }
 
       frame = av_frame_alloc();
-      sw_frame = av_frame_alloc();
+      if (sw_frame == nullptr) sw_frame = av_frame_alloc();
     }
   } while (ret == 0);
   av_frame_free(&frame);
   av_frame_free(&sw_frame);
 
+  // A flush also empties the resampler
+  if ((c->converter != nullptr) && (c->status == BEAMCODER_SUCCESS) &&
+      !c->packets.empty() && (c->packets.back() == nullptr)) {
+    if ((ret = c->converter->drain(c->frames)) < 0) {
+      c->status = BEAMCODER_ERROR_DECODE;
+      c->errorMsg = avErrorMsg("Error converting frame: ", ret);
+    }
+  }
+
   c->totalTime = microTime(decodeStart);
 };
 
@@ -364,6 +505,11 @@ napi_value decode(napi_env env, napi_callback_info info) {
   REJECT_RETURN;
   c->status = napi_get_value_external(env, decoderExt, (void**) &c->decoder);
   REJECT_RETURN;
+  c->converter = getConverter(env, decoderJS);
+  if (c->converter != nullptr) { // Keeps the converter alive while decoding
+    c->status = napi_create_reference(env, decoderJS, 1, &c->passthru);
+    REJECT_RETURN;
+  }
 
   if (argc == 0) {
     REJECT_ERROR_RETURN("Decode call requires one or more packets.",
@@ -462,6 +608,28 @@ napi_status isPacket(napi_env env, napi_value packet) {
   return napi_ok;
 }
 
+Converter* getConverter(napi_env env, napi_value decoder) {
+  napi_status status;
+  napi_value value;
+  bool hasConverter;
+  Converter* result = nullptr;
+  status = napi_has_named_property(env, decoder, "_converter", &hasConverter);
+  if ((status != napi_ok) || !hasConverter) return nullptr;
+  status = napi_get_named_property(env, decoder, "_converter", &value);
+  if (status != napi_ok) return nullptr;
+  status = napi_get_value_external(env, value, (void**) &result);
+  if (status != napi_ok) return nullptr;
+  return result;
+}
+
+int keepFrame(Converter* converter, AVFrame* frame, std::vector<AVFrame*> &frames) {
+  if (converter == nullptr) {
+    frames.push_back(frame);
+    return 0;
+  }
+  return converter->convert(frame, frames);
+}
+
 AVPacket* getPacket(napi_env env, napi_value packet) {
   napi_status status;
   napi_value value;
@@ -490,6 +658,11 @@ napi_value flushDec(napi_env env, napi_callback_info info) {
   REJECT_RETURN;
   c->status = napi_get_value_external(env, decoderExt, (void**) &c->decoder);
   REJECT_RETURN;
+  c->converter = getConverter(env, decoderJS);
+  if (c->converter != nullptr) {
+    c->status = napi_create_reference(env, decoderJS, 1, &c->passthru);
+    REJECT_RETURN;
+  }
 
   if (argc != 0) {
     REJECT_ERROR_RETURN("Decode flush takes no arguments.",
@@ -509,6 +682,217 @@ napi_value flushDec(napi_env env, napi_callback_info info) {
   return promise;
 }
 
+void pullExecute(napi_env env, void* data) {
+  pullCarrier* c = (pullCarrier*) data;
+  int ret = 0;
+  AVFrame* frame = nullptr;
+  AVPacket* packet = nullptr;
+  bool draining = false;
+  HR_TIME_POINT pullStart = NOW;
+
+  if (!avcodec_is_open(c->decoder)) {
+    if ((ret = avcodec_open2(c->decoder, c->decoder->codec, nullptr))) {
+      c->status = BEAMCODER_ERROR_ALLOC_DECODER;
+      c->errorMsg = avErrorMsg("Problem opening decoder: ", ret);
+      return;
+    }
+  }
+
+  AVPixelFormat frame_hw_pix_fmt = AV_PIX_FMT_NONE;
+  packet = av_packet_alloc();
+  frame = av_frame_alloc();
+  while (c->frames.size() < c->maxFrames) {
+    ret = avcodec_receive_frame(c->decoder, frame);
+    if (ret == 0) {
+      if (c->decoder->hw_frames_ctx)
+        frame_hw_pix_fmt = ((AVHWFramesContext*)c->decoder->hw_frames_ctx->data)->format;
+      if (frame->format == frame_hw_pix_fmt) {
+        AVFrame* sw_frame = av_frame_alloc();
+        ret = av_hwframe_transfer_data(sw_frame, frame, 0);
+        av_frame_unref(frame);
+        if (ret < 0) {
+          av_frame_free(&sw_frame);
+          c->status = BEAMCODER_ERROR_DECODE;
+          c->errorMsg = avErrorMsg("Error transferring hardware frame to system memory: ", ret);
+          break;
+        }
+        ret = keepFrame(c->converter, sw_frame, c->frames);
+      } else {
+        ret = keepFrame(c->converter, frame, c->frames);
+        frame = av_frame_alloc();
+      }
+      if (ret < 0) {
+        c->status = BEAMCODER_ERROR_DECODE;
+        c->errorMsg = avErrorMsg("Error converting frame: ", ret);
+        break;
+      }
+      continue;
+    }
+    if (ret == AVERROR_EOF) {
+      c->eof = true;
+      if ((c->converter != nullptr) && ((ret = c->converter->drain(c->frames)) < 0)) {
+        c->status = BEAMCODER_ERROR_DECODE;
+        c->errorMsg = avErrorMsg("Error converting frame: ", ret);
+      }
+      break;
+    }
+    if ((ret != AVERROR(EAGAIN)) || draining) {
+      c->status = BEAMCODER_ERROR_DECODE;
+      c->errorMsg = avErrorMsg("Error receiving frame: ", ret);
+      break;
+    }
+
+    // Decoder needs more input - read the next packet for this stream
+    ret = readStreamPacket(c->formatRef, c->streamIndex, packet);
+    if (ret == AVERROR_EOF) {
+      draining = true;
+      ret = avcodec_send_packet(c->decoder, nullptr);
+      if (ret == AVERROR_EOF) ret = 0; // already flushed
+    } else if (ret == AVERROR(ENOBUFS)) {
+      c->status = BEAMCODER_ERROR_READ_FRAME;
+      c->errorMsg = "Too many packets held for other streams. Read them, or set the discard "
+        "property of unused demuxer streams to 'all'.";
+      break;
+    } else if (ret < 0) {
+      c->status = BEAMCODER_ERROR_READ_FRAME;
+      c->errorMsg = interruptErrorMsg(c->formatRef->interrupter, "Problem reading frame: ", ret);
+      break;
+    } else {
+      c->packetsRead++;
+      ret = avcodec_send_packet(c->decoder, packet);
+      av_packet_unref(packet);
+    }
+    if (ret < 0) {
+      c->status = BEAMCODER_ERROR_DECODE;
+      c->errorMsg = avErrorMsg("Error sending packet: ", ret);
+      break;
+    }
+  }
+  av_frame_free(&frame);
+  av_packet_free(&packet);
+
+  c->totalTime = microTime(pullStart);
+}
+
+void pullComplete(napi_env env, napi_status asyncStatus, void* data) {
+  pullCarrier* c = (pullCarrier*) data;
+  napi_value result, frames, frame, prop;
+
+  if (asyncStatus != napi_ok) {
+    c->status = asyncStatus;
+    c->errorMsg = "Pull failed to complete.";
+  }
+  REJECT_STATUS;
+
+  c->status = napi_create_object(env, &result);
+  REJECT_STATUS;
+  c->status = beam_set_string_utf8(env, result, "type", "frames");
+  REJECT_STATUS;
+
+  c->status = napi_create_array(env, &frames);
+  REJECT_STATUS;
+  c->status = napi_set_named_property(env, result, "frames", frames);
+  REJECT_STATUS;
+
+  uint32_t frameCount = 0;
+  for ( auto it = c->frames.begin() ; it != c->frames.end() ; it++ ) {
+    frameData* f = new frameData;
+    f->frame = *it;
+    *it = nullptr;
+
+    c->status = fromAVFrame(env, f, &frame);
+    REJECT_STATUS;
+
+    c->status = napi_set_element(env, frames, frameCount++, frame);
+    REJECT_STATUS;
+  }
+
+  c->status = beam_set_bool(env, result, "eof", c->eof);
+  REJECT_STATUS;
+  c->status = beam_set_uint32(env, result, "packets", c->packetsRead);
+  REJECT_STATUS;
+  c->status = napi_create_int64(env, c->totalTime, &prop);
+  REJECT_STATUS;
+  c->status = napi_set_named_property(env, result, "total_time", prop);
+  REJECT_STATUS;
+
+  napi_status status;
+  status = napi_resolve_deferred(env, c->_deferred, result);
+  FLOATING_STATUS;
+
+  tidyCarrier(env, c);
+}
+
+napi_value pull(napi_env env, napi_callback_info info) {
+  napi_value resourceName, promise, decoderJS, decoderExt, demuxerJS, formatRefExt, value;
+  napi_valuetype type;
+  bool hasProp;
+  pullCarrier* c = new pullCarrier;
+
+  c->status = napi_create_promise(env, &c->_deferred, &promise);
+  REJECT_RETURN;
+
+  size_t argc = 1;
+  napi_value args[1];
+
+  c->status = napi_get_cb_info(env, info, &argc, args, &decoderJS, nullptr);
+  REJECT_RETURN;
+  c->status = napi_get_named_property(env, decoderJS, "_CodecContext", &decoderExt);
+  REJECT_RETURN;
+  c->status = napi_get_value_external(env, decoderExt, (void**) &c->decoder);
+  REJECT_RETURN;
+
+  c->status = napi_has_named_property(env, decoderJS, "_demuxer", &hasProp);
+  REJECT_RETURN;
+  if (!hasProp) {
+    REJECT_ERROR_RETURN("Pull requires a decoder created with a demuxer and stream_index.",
+      BEAMCODER_INVALID_ARGS);
+  }
+  c->status = napi_get_named_property(env, decoderJS, "_demuxer", &demuxerJS);
+  REJECT_RETURN;
+  c->status = napi_get_named_property(env, demuxerJS, "_formatContextRef", &formatRefExt);
+  REJECT_RETURN;
+  c->status = napi_get_value_external(env, formatRefExt, (void**) &c->formatRef);
+  REJECT_RETURN;
+  c->status = napi_get_named_property(env, decoderJS, "_streamIndex", &value);
+  REJECT_RETURN;
+  c->status = napi_get_value_int32(env, value, &c->streamIndex);
+  REJECT_RETURN;
+  c->converter = getConverter(env, decoderJS);
+
+  if (argc > 0) {
+    c->status = napi_typeof(env, args[0], &type);
+    REJECT_RETURN;
+    if (type == napi_object) {
+      c->status = beam_get_uint32(env, args[0], "maxFrames", &c->maxFrames);
+      REJECT_RETURN;
+      c->status = beam_get_uint32(env, args[0], "max_frames", &c->maxFrames);
+      REJECT_RETURN;
+    } else if (type != napi_undefined) {
+      REJECT_ERROR_RETURN("Pull takes an optional options object.",
+        BEAMCODER_INVALID_ARGS);
+    }
+  }
+  if (c->maxFrames < 1) {
+    REJECT_ERROR_RETURN("Pull maxFrames must be at least 1.",
+      BEAMCODER_INVALID_ARGS);
+  }
+
+  // Keeps the decoder and, through it, the demuxer alive while pulling
+  c->status = napi_create_reference(env, decoderJS, 1, &c->passthru);
+  REJECT_RETURN;
+
+  c->status = napi_create_string_utf8(env, "DecodePull", NAPI_AUTO_LENGTH, &resourceName);
+  REJECT_RETURN;
+  c->status = napi_create_async_work(env, nullptr, resourceName, pullExecute,
+    pullComplete, c, &c->_request);
+  REJECT_RETURN;
+  c->status = napi_queue_async_work(env, c->_request);
+  REJECT_RETURN;
+
+  return promise;
+}
+
 /* napi_value getDecProperties(napi_env env, napi_callback_info info) {
   napi_status status;
   napi_value result, decoderJS, decoderExt;
@@ -26,6 +26,10 @@
 #include "packet.h"
 #include "frame.h"
 #include "codec.h"
+#include "demux.h"
+#include "converter.h"
+#include "threadbudget.h"
+#include "framepool.h"
 #include <vector>
 
 extern "C" {
@@ -42,6 +46,10 @@ void decodeComplete(napi_env env, napi_status asyncStatus, void* data);
 napi_value decode(napi_env env, napi_callback_info info);
 napi_value flushDec(napi_env env, napi_callback_info info);
 
+void pullExecute(napi_env env, void* data);
+void pullComplete(napi_env env, napi_status asyncStatus, void* data);
+napi_value pull(napi_env env, napi_callback_info info);
+
 void decoderFinalizer(napi_env env, void* data, void* hint);
 
 /* struct decoderCarrier : carrier {
@@ -61,6 +69,7 @@ void decoderFinalizer(napi_env env, void* data, void* hint);
 
 struct decodeCarrier : carrier {
   AVCodecContext* decoder;
+  Converter* converter = nullptr;
   std::vector<AVPacket*> packets;
   std::vector<AVFrame*> frames;
   std::vector<napi_ref> packetRefs;
@@ -69,7 +78,25 @@ struct decodeCarrier : carrier {
   }
 };
 
+struct pullCarrier : carrier {
+  AVCodecContext* decoder;
+  Converter* converter = nullptr;
+  fmtCtxRef* formatRef = nullptr;
+  int streamIndex = -1;
+  uint32_t maxFrames = 1;
+  std::vector<AVFrame*> frames;
+  bool eof = false;
+  uint32_t packetsRead = 0;
+  ~pullCarrier() {
+    for (auto it = frames.begin(); it != frames.end(); ++it) av_frame_free(&(*it));
+  }
+};
+
 napi_status isPacket(napi_env env, napi_value packet);
+// Output format converter set on a decoder, or nullptr
+Converter* getConverter(napi_env env, napi_value decoder);
+// Keep a decoded frame, converting it first when a converter is set
+int keepFrame(Converter* converter, AVFrame* frame, std::vector<AVFrame*> &frames);
 AVPacket* getPacket(napi_env env, napi_value packet);
 
 #endif // DECODE_H
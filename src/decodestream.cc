@@ -0,0 +1,621 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#include "decodestream.h"
+#include "decode.h"
+
+extern "C" {
+  #include <libavutil/hwcontext.h>
+}
+
+static napi_status iterResult(napi_env env, napi_value value, bool done, napi_value *result) {
+  napi_status status;
+  status = napi_create_object(env, result);
+  PASS_STATUS;
+  if (value == nullptr) {
+    status = napi_get_undefined(env, &value);
+    PASS_STATUS;
+  }
+  status = napi_set_named_property(env, *result, "value", value);
+  PASS_STATUS;
+  return beam_set_bool(env, *result, "done", done);
+}
+
+DecodeStream::~DecodeStream() {
+  for ( auto it = mHeld.begin() ; it != mHeld.end() ; it++ )
+    av_frame_free(&*it);
+}
+
+/*
+  for await (const frame of decoder.decodeStream(packets)) { ... }
+  await decoder.decodeStream(packets, frame => { ... });
+  await decoder.decodeStream(packets, { callback: frame => { ... }, highWaterMark: 8 });
+*/
+napi_value DecodeStream::create(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result, decoderJS, decoderExt, value, resourceName, callback = nullptr;
+  napi_valuetype type;
+  bool isArray;
+  uint32_t packetsLength, highWaterMark = 4;
+  AVCodecContext* decoder;
+
+  size_t argc = 2;
+  napi_value args[2];
+  status = napi_get_cb_info(env, info, &argc, args, &decoderJS, nullptr);
+  CHECK_STATUS;
+  status = napi_get_named_property(env, decoderJS, "_CodecContext", &decoderExt);
+  CHECK_STATUS;
+  status = napi_get_value_external(env, decoderExt, (void**) &decoder);
+  CHECK_STATUS;
+
+  if (argc < 1) {
+    NAPI_THROW_ERROR("Decode stream requires an array of packets.");
+  }
+  status = napi_is_array(env, args[0], &isArray);
+  CHECK_STATUS;
+  if (!isArray) {
+    NAPI_THROW_ERROR("Decode stream requires an array of packets.");
+  }
+  status = napi_get_array_length(env, args[0], &packetsLength);
+  CHECK_STATUS;
+  for ( uint32_t x = 0 ; x < packetsLength ; x++ ) {
+    status = napi_get_element(env, args[0], x, &value);
+    CHECK_STATUS;
+    if (isPacket(env, value) != napi_ok) {
+      NAPI_THROW_ERROR("All passed values in an array must be of type packet.");
+    }
+  }
+
+  if (argc > 1) {
+    status = napi_typeof(env, args[1], &type);
+    CHECK_STATUS;
+    if (type == napi_function) {
+      callback = args[1];
+    } else if (type == napi_object) {
+      status = beam_get_uint32(env, args[1], "highWaterMark", &highWaterMark);
+      CHECK_STATUS;
+      status = napi_get_named_property(env, args[1], "callback", &value);
+      CHECK_STATUS;
+      status = napi_typeof(env, value, &type);
+      CHECK_STATUS;
+      if (type == napi_function) {
+        callback = value;
+      } else if (type != napi_undefined) {
+        NAPI_THROW_ERROR("Decode stream callback must be a function.");
+      }
+    } else if (type != napi_undefined) {
+      NAPI_THROW_ERROR("Decode stream takes a callback function or an options object.");
+    }
+  }
+  if (highWaterMark < 1) {
+    NAPI_THROW_ERROR("Decode stream highWaterMark must be at least 1.");
+  }
+
+  DecodeStream *s = new DecodeStream;
+  s->mDecoder = decoder;
+  s->mConverter = getConverter(env, decoderJS);
+  s->mHighWaterMark = highWaterMark;
+  s->mCallback = callback != nullptr;
+  for ( uint32_t x = 0 ; x < packetsLength ; x++ ) {
+    napi_ref packetRef;
+    status = napi_get_element(env, args[0], x, &value);
+    CHECK_STATUS;
+    status = napi_create_reference(env, value, 1, &packetRef);
+    CHECK_STATUS;
+    s->mPacketRefs.push_back(packetRef);
+    s->mPackets.push_back(getPacket(env, value));
+  }
+  status = napi_create_reference(env, decoderJS, 1, &s->mDecoderRef);
+  CHECK_STATUS;
+
+  status = napi_create_string_utf8(env, "DecodeStream", NAPI_AUTO_LENGTH, &resourceName);
+  CHECK_STATUS;
+  status = napi_create_threadsafe_function(env, callback, nullptr, resourceName,
+    0, 1, s, tsfnFinalizer, s, callJs, &s->mTsfn);
+  CHECK_STATUS;
+
+  if (s->mCallback) {
+    status = napi_create_promise(env, &s->mDone, &result);
+    CHECK_STATUS;
+  } else {
+    napi_value external, global, symbol, asyncIterator;
+    s->mRefs++; // also held by the iterator
+    status = napi_create_object(env, &result);
+    CHECK_STATUS;
+    status = napi_create_external(env, s, iteratorFinalizer, nullptr, &external);
+    CHECK_STATUS;
+    status = napi_get_global(env, &global);
+    CHECK_STATUS;
+    status = napi_get_named_property(env, global, "Symbol", &symbol);
+    CHECK_STATUS;
+    status = napi_get_named_property(env, symbol, "asyncIterator", &asyncIterator);
+    CHECK_STATUS;
+    status = napi_create_function(env, "asyncIterator", NAPI_AUTO_LENGTH, self, nullptr, &value);
+    CHECK_STATUS;
+    status = napi_set_property(env, result, asyncIterator, value);
+    CHECK_STATUS;
+    napi_property_descriptor desc[] = {
+      { "next", nullptr, next, nullptr, nullptr, nullptr, napi_default, s },
+      { "return", nullptr, finish, nullptr, nullptr, nullptr, napi_default, s },
+      { "_decodeStream", nullptr, nullptr, nullptr, nullptr, external, napi_default, nullptr }
+    };
+    status = napi_define_properties(env, result, 3, desc);
+    CHECK_STATUS;
+  }
+
+  status = s->queueWork(env);
+  CHECK_STATUS;
+
+  return result;
+}
+
+napi_status DecodeStream::queueWork(napi_env env) {
+  napi_status status;
+  napi_value resourceName;
+  status = napi_create_string_utf8(env, "DecodeStream", NAPI_AUTO_LENGTH, &resourceName);
+  PASS_STATUS;
+  status = napi_create_async_work(env, nullptr, resourceName, execute, complete, this, &mWork);
+  PASS_STATUS;
+  return napi_queue_async_work(env, mWork);
+}
+
+void DecodeStream::execute(napi_env env, void* data) {
+  DecodeStream *s = (DecodeStream *) data;
+  s->mFinished = s->decode();
+  // End marker, delivered after every frame
+  if (s->mFinished)
+    napi_call_threadsafe_function(s->mTsfn, nullptr, napi_tsfn_blocking);
+}
+
+void DecodeStream::complete(napi_env env, napi_status asyncStatus, void* data) {
+  DecodeStream *s = (DecodeStream *) data;
+  napi_status status;
+  status = napi_delete_async_work(env, s->mWork);
+  FLOATING_STATUS;
+  s->mWork = nullptr;
+  if (!s->mFinished) { // Stopped at highWaterMark - wait for the consumer
+    s->mParked = true;
+    s->resume(env);
+    return;
+  }
+  // The threadsafe function finalizer runs once the end marker has been handled
+  status = napi_release_threadsafe_function(s->mTsfn, napi_tsfn_release);
+  FLOATING_STATUS;
+}
+
+// Restarts decoding that stopped at highWaterMark once the consumer has taken
+// a frame. If the stream has been cancelled, ends it without more work.
+void DecodeStream::resume(napi_env env) {
+  bool stop;
+  {
+    std::lock_guard<std::mutex> lk(m);
+    if (!mParked || (!mCancelled && (mOutstanding >= mHighWaterMark))) return;
+    stop = mCancelled;
+  }
+  mParked = false;
+  if (!stop && (queueWork(env) == napi_ok)) return;
+  if (!stop) {
+    mStatus = BEAMCODER_ERROR_START;
+    mErrorMsg = "Failed to queue more decoding work.";
+  }
+  for ( auto it = mHeld.begin() ; it != mHeld.end() ; it++ )
+    av_frame_free(&*it);
+  mHeld.clear();
+  mFinished = true;
+  napi_call_threadsafe_function(mTsfn, nullptr, napi_tsfn_nonblocking);
+  napi_release_threadsafe_function(mTsfn, napi_tsfn_release);
+}
+
+// Decodes until the packets are used up, the stream is cancelled or an error
+// occurs, returning true. Returns false when highWaterMark frames are in flight,
+// with any decoded frames not yet delivered held for the next call.
+bool DecodeStream::decode() {
+  int ret = 0;
+  AVFrame *frame;
+  HR_TIME_POINT decodeStart = NOW;
+
+  while (!cancelled()) {
+    // Deliver frames already decoded before receiving more
+    if (!mHeld.empty()) {
+      if (!emit(mHeld.front())) {
+        mTotalTime += microTime(decodeStart);
+        return false;
+      }
+      mHeld.pop_front();
+      continue;
+    }
+
+    AVPixelFormat frame_hw_pix_fmt = AV_PIX_FMT_NONE;
+    if (mDecoder->hw_frames_ctx)
+      frame_hw_pix_fmt = ((AVHWFramesContext*)mDecoder->hw_frames_ctx->data)->format;
+    frame = av_frame_alloc();
+    ret = avcodec_receive_frame(mDecoder, frame);
+    if (ret == 0) {
+      if (frame->format == frame_hw_pix_fmt) {
+        AVFrame *sw_frame = av_frame_alloc();
+        ret = av_hwframe_transfer_data(sw_frame, frame, 0);
+        av_frame_free(&frame);
+        if (ret < 0) {
+          av_frame_free(&sw_frame);
+          mStatus = BEAMCODER_ERROR_DECODE;
+          mErrorMsg = avErrorMsg("Error transferring hardware frame to system memory: ", ret);
+          break;
+        }
+        frame = sw_frame;
+      }
+      if (mConverter != nullptr) {
+        std::vector<AVFrame*> converted;
+        ret = mConverter->convert(frame, converted);
+        mHeld.insert(mHeld.end(), converted.begin(), converted.end());
+        if (ret < 0) {
+          mStatus = BEAMCODER_ERROR_DECODE;
+          mErrorMsg = avErrorMsg("Error converting frame: ", ret);
+          break;
+        }
+      } else {
+        mHeld.push_back(frame);
+      }
+      continue;
+    }
+    av_frame_free(&frame);
+    if ((ret == AVERROR(EINVAL)) && !avcodec_is_open(mDecoder))
+      ret = AVERROR(EAGAIN); // Opened when the first packet is sent
+    if ((ret != AVERROR(EAGAIN)) && (ret != AVERROR_EOF)) {
+      mStatus = BEAMCODER_ERROR_DECODE;
+      mErrorMsg = avErrorMsg("Error receiving frame: ", ret);
+      break;
+    }
+
+    // Decoder is drained - send it the next packet
+    if (mNext == mPackets.size()) break;
+    ret = avcodec_send_packet(mDecoder, mPackets[mNext]);
+    if ((ret == AVERROR(EINVAL)) && !avcodec_is_open(mDecoder)) {
+      if ((ret = avcodec_open2(mDecoder, mDecoder->codec, nullptr))) {
+        mStatus = BEAMCODER_ERROR_ALLOC_DECODER;
+        mErrorMsg = avErrorMsg("Problem opening decoder: ", ret);
+        break;
+      }
+      ret = avcodec_send_packet(mDecoder, mPackets[mNext]);
+    }
+    if (ret == AVERROR_EOF) {
+      mStatus = BEAMCODER_ERROR_EOF;
+      mErrorMsg = "The decoder has been flushed, and no new packets can be sent to it.";
+      break;
+    }
+    if (ret < 0) {
+      mStatus = BEAMCODER_ERROR_DECODE;
+      mErrorMsg = avErrorMsg("Error sending packet: ", ret);
+      break;
+    }
+    mNext++;
+  }
+
+  for ( auto it = mHeld.begin() ; it != mHeld.end() ; it++ )
+    av_frame_free(&*it);
+  mHeld.clear();
+  mTotalTime += microTime(decodeStart);
+  return true;
+}
+
+// Hands a frame to Javascript, returning false if highWaterMark frames are
+// already in flight. Frames are dropped once the stream is cancelled.
+bool DecodeStream::emit(AVFrame *frame) {
+  {
+    std::lock_guard<std::mutex> lk(m);
+    if (mCancelled) {
+      av_frame_free(&frame);
+      return true;
+    }
+    if (mOutstanding >= mHighWaterMark) return false;
+    mOutstanding++;
+  }
+  mFrameCount++;
+  if (napi_call_threadsafe_function(mTsfn, frame, napi_tsfn_blocking) != napi_ok) {
+    av_frame_free(&frame);
+    std::lock_guard<std::mutex> lk(m);
+    mCancelled = true;
+  }
+  return true;
+}
+
+bool DecodeStream::cancelled() {
+  std::lock_guard<std::mutex> lk(m);
+  return mCancelled;
+}
+
+void DecodeStream::ack(napi_env env) {
+  {
+    std::lock_guard<std::mutex> lk(m);
+    if (mOutstanding > 0) mOutstanding--;
+  }
+  resume(env);
+}
+
+void DecodeStream::cancel(napi_env env) {
+  {
+    std::lock_guard<std::mutex> lk(m);
+    mCancelled = true;
+  }
+  resume(env);
+}
+
+void DecodeStream::callJs(napi_env env, napi_value jsCallback, void* context, void* data) {
+  DecodeStream *s = (DecodeStream *) context;
+  AVFrame *frame = (AVFrame *) data;
+  napi_status status;
+  napi_value frameJS, result, undef;
+
+  if (env == nullptr) { // tearing down
+    if (frame != nullptr) av_frame_free(&frame);
+    return;
+  }
+  if (frame == nullptr) {
+    s->onEnd(env);
+    return;
+  }
+
+  if (s->mCallback) {
+    bool cancelled;
+    {
+      std::lock_guard<std::mutex> lk(s->m);
+      cancelled = s->mCancelled;
+    }
+    if (cancelled) { // Callback has asked to stop - drop frames already in flight
+      av_frame_free(&frame);
+      s->ack(env);
+      return;
+    }
+  }
+
+  frameData* f = new frameData;
+  f->frame = frame;
+  status = fromAVFrame(env, f, &frameJS);
+  if (status != napi_ok) {
+    s->ack(env);
+    return;
+  }
+
+  if (s->mCallback) {
+    status = napi_get_undefined(env, &undef);
+    FLOATING_STATUS;
+    status = napi_call_function(env, undef, jsCallback, 1, &frameJS, &result);
+    if (status == napi_pending_exception) {
+      napi_value exception;
+      napi_get_and_clear_last_exception(env, &exception);
+      if (s->mCallbackError == nullptr)
+        napi_create_reference(env, exception, 1, &s->mCallbackError);
+      s->cancel(env);
+    } else if (status == napi_ok) {
+      napi_valuetype type;
+      bool stop = false;
+      status = napi_typeof(env, result, &type);
+      if ((status == napi_ok) && (type == napi_boolean)) {
+        bool value;
+        napi_get_value_bool(env, result, &value);
+        stop = !value;
+      }
+      if (stop) s->cancel(env);
+    }
+    s->ack(env);
+  } else if (s->mReturned) {
+    s->ack(env); // Consumer has gone - drop the frame
+  } else if (!s->mWaiting.empty()) {
+    status = iterResult(env, frameJS, false, &result);
+    FLOATING_STATUS;
+    status = napi_resolve_deferred(env, s->mWaiting.front(), result);
+    FLOATING_STATUS;
+    s->mWaiting.pop_front();
+    s->ack(env);
+  } else {
+    napi_ref frameRef;
+    status = napi_create_reference(env, frameJS, 1, &frameRef);
+    FLOATING_STATUS;
+    s->mReady.push_back(frameRef);
+  }
+}
+
+napi_status DecodeStream::makeError(napi_env env, napi_value *result) {
+  napi_status status;
+  napi_value errorCode, errorMsg;
+  status = napi_create_string_utf8(env, std::to_string(mStatus).c_str(),
+    NAPI_AUTO_LENGTH, &errorCode);
+  PASS_STATUS;
+  status = napi_create_string_utf8(env, mErrorMsg.c_str(), NAPI_AUTO_LENGTH, &errorMsg);
+  PASS_STATUS;
+  return napi_create_error(env, errorCode, errorMsg, result);
+}
+
+void DecodeStream::onEnd(napi_env env) {
+  napi_status status;
+  napi_value result;
+  for ( auto it = mPacketRefs.cbegin() ; it != mPacketRefs.cend() ; it++ ) {
+    status = napi_delete_reference(env, *it);
+    FLOATING_STATUS;
+  }
+  mPacketRefs.clear();
+  mEnded = true;
+
+  if (mCallback) {
+    if (mCallbackError != nullptr) {
+      status = napi_get_reference_value(env, mCallbackError, &result);
+      FLOATING_STATUS;
+      status = napi_reject_deferred(env, mDone, result);
+      FLOATING_STATUS;
+      status = napi_delete_reference(env, mCallbackError);
+      FLOATING_STATUS;
+      mCallbackError = nullptr;
+    } else if (mStatus != BEAMCODER_SUCCESS) {
+      status = makeError(env, &result);
+      FLOATING_STATUS;
+      status = napi_reject_deferred(env, mDone, result);
+      FLOATING_STATUS;
+    } else {
+      bool cancelled;
+      {
+        std::lock_guard<std::mutex> lk(m);
+        cancelled = mCancelled;
+      }
+      status = napi_create_object(env, &result);
+      FLOATING_STATUS;
+      status = beam_set_string_utf8(env, result, "type", "frames");
+      FLOATING_STATUS;
+      status = beam_set_uint32(env, result, "frames", mFrameCount);
+      FLOATING_STATUS;
+      status = beam_set_bool(env, result, "cancelled", cancelled);
+      FLOATING_STATUS;
+      status = beam_set_int64(env, result, "total_time", mTotalTime);
+      FLOATING_STATUS;
+      status = napi_resolve_deferred(env, mDone, result);
+      FLOATING_STATUS;
+    }
+    mDone = nullptr;
+    return;
+  }
+
+  // Anyone still waiting has seen every frame
+  while (!mWaiting.empty()) {
+    if ((mStatus != BEAMCODER_SUCCESS) && !mErrorReported) {
+      status = makeError(env, &result);
+      FLOATING_STATUS;
+      status = napi_reject_deferred(env, mWaiting.front(), result);
+      mErrorReported = true;
+    } else {
+      status = iterResult(env, nullptr, true, &result);
+      FLOATING_STATUS;
+      status = napi_resolve_deferred(env, mWaiting.front(), result);
+    }
+    FLOATING_STATUS;
+    mWaiting.pop_front();
+  }
+}
+
+napi_value DecodeStream::next(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value promise, value, result;
+  napi_deferred deferred;
+  DecodeStream *s;
+
+  status = napi_get_cb_info(env, info, nullptr, nullptr, nullptr, (void**) &s);
+  CHECK_STATUS;
+  status = napi_create_promise(env, &deferred, &promise);
+  CHECK_STATUS;
+
+  if (!s->mReady.empty()) {
+    napi_ref frameRef = s->mReady.front();
+    s->mReady.pop_front();
+    status = napi_get_reference_value(env, frameRef, &value);
+    CHECK_STATUS;
+    status = napi_delete_reference(env, frameRef);
+    CHECK_STATUS;
+    status = iterResult(env, value, false, &result);
+    CHECK_STATUS;
+    status = napi_resolve_deferred(env, deferred, result);
+    CHECK_STATUS;
+    s->ack(env);
+  } else if (s->mEnded && (s->mStatus != BEAMCODER_SUCCESS) && !s->mErrorReported && !s->mReturned) {
+    status = s->makeError(env, &result);
+    CHECK_STATUS;
+    status = napi_reject_deferred(env, deferred, result);
+    CHECK_STATUS;
+    s->mErrorReported = true;
+  } else if (s->mEnded || s->mReturned) {
+    status = iterResult(env, nullptr, true, &result);
+    CHECK_STATUS;
+    status = napi_resolve_deferred(env, deferred, result);
+    CHECK_STATUS;
+  } else {
+    s->mWaiting.push_back(deferred);
+  }
+  return promise;
+}
+
+// Iterator return() - called by for await ... of on break or throw
+napi_value DecodeStream::finish(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value promise, result;
+  napi_deferred deferred;
+  DecodeStream *s;
+
+  status = napi_get_cb_info(env, info, nullptr, nullptr, nullptr, (void**) &s);
+  CHECK_STATUS;
+
+  s->mReturned = true;
+  s->cancel(env);
+  for ( auto it = s->mReady.cbegin() ; it != s->mReady.cend() ; it++ ) {
+    status = napi_delete_reference(env, *it);
+    CHECK_STATUS;
+  }
+  s->mReady.clear();
+  while (!s->mWaiting.empty()) {
+    status = iterResult(env, nullptr, true, &result);
+    CHECK_STATUS;
+    status = napi_resolve_deferred(env, s->mWaiting.front(), result);
+    CHECK_STATUS;
+    s->mWaiting.pop_front();
+  }
+
+  status = napi_create_promise(env, &deferred, &promise);
+  CHECK_STATUS;
+  status = iterResult(env, nullptr, true, &result);
+  CHECK_STATUS;
+  status = napi_resolve_deferred(env, deferred, result);
+  CHECK_STATUS;
+  return promise;
+}
+
+napi_value DecodeStream::self(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value thisArg;
+  status = napi_get_cb_info(env, info, nullptr, nullptr, &thisArg, nullptr);
+  CHECK_STATUS;
+  return thisArg;
+}
+
+void DecodeStream::unref(napi_env env) {
+  if (--mRefs == 0) delete this;
+}
+
+void DecodeStream::tsfnFinalizer(napi_env env, void* data, void* hint) {
+  DecodeStream *s = (DecodeStream *) data;
+  for ( auto it = s->mPacketRefs.cbegin() ; it != s->mPacketRefs.cend() ; it++ )
+    napi_delete_reference(env, *it);
+  s->mPacketRefs.clear();
+  if (s->mDecoderRef != nullptr) {
+    napi_delete_reference(env, s->mDecoderRef);
+    s->mDecoderRef = nullptr;
+  }
+  if (s->mCallbackError != nullptr) {
+    napi_delete_reference(env, s->mCallbackError);
+    s->mCallbackError = nullptr;
+  }
+  s->unref(env);
+}
+
+void DecodeStream::iteratorFinalizer(napi_env env, void* data, void* hint) {
+  DecodeStream *s = (DecodeStream *) data;
+  // Nobody can read any more frames, so let the worker finish
+  s->mReturned = true;
+  s->cancel(env);
+  for ( auto it = s->mReady.cbegin() ; it != s->mReady.cend() ; it++ )
+    napi_delete_reference(env, *it);
+  s->mReady.clear();
+  s->unref(env);
+}
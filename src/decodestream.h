@@ -0,0 +1,111 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#ifndef DECODESTREAM_H
+#define DECODESTREAM_H
+
+#include "node_api.h"
+#include "beamcoder_util.h"
+#include "frame.h"
+#include "converter.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+
+extern "C" {
+  #include <libavcodec/avcodec.h>
+}
+
+// Decodes a batch of packets on a worker thread and delivers each frame to
+// Javascript through a threadsafe function as soon as the decoder returns it.
+// At most highWaterMark frames are in flight between the worker and the
+// consumer at a time. When that many are waiting, the work returns its thread
+// to the pool and is queued again once the consumer has taken a frame. Frames
+// are delivered either to a callback or through an async iterator.
+class DecodeStream {
+public:
+  static napi_value create(napi_env env, napi_callback_info info);
+
+private:
+  DecodeStream() {}
+  ~DecodeStream();
+
+  static void execute(napi_env env, void* data);
+  static void complete(napi_env env, napi_status asyncStatus, void* data);
+  static void callJs(napi_env env, napi_value jsCallback, void* context, void* data);
+  static void tsfnFinalizer(napi_env env, void* data, void* hint);
+  static void iteratorFinalizer(napi_env env, void* data, void* hint);
+  static napi_value next(napi_env env, napi_callback_info info);
+  static napi_value finish(napi_env env, napi_callback_info info);
+  static napi_value self(napi_env env, napi_callback_info info);
+
+  // Worker thread
+  bool emit(AVFrame *frame);
+  bool cancelled();
+  bool decode();
+  // Main thread
+  napi_status queueWork(napi_env env);
+  void resume(napi_env env);
+  void ack(napi_env env);
+  void cancel(napi_env env);
+  void onEnd(napi_env env);
+  napi_status makeError(napi_env env, napi_value *result);
+  void unref(napi_env env);
+
+  AVCodecContext* mDecoder = nullptr;
+  Converter* mConverter = nullptr;
+  std::vector<AVPacket*> mPackets;
+  std::vector<napi_ref> mPacketRefs;
+  napi_ref mDecoderRef = nullptr;
+  napi_threadsafe_function mTsfn = nullptr;
+  napi_async_work mWork = nullptr;
+
+  std::mutex m;
+  uint32_t mHighWaterMark = 4;
+  uint32_t mOutstanding = 0;
+  bool mCancelled = false;
+
+  // Decoding state carried from one piece of work to the next
+  size_t mNext = 0;
+  std::deque<AVFrame*> mHeld;
+  bool mFinished = false;
+
+  // Written by the worker before the end marker is queued
+  int32_t mStatus = BEAMCODER_SUCCESS;
+  std::string mErrorMsg;
+  uint32_t mFrameCount = 0;
+  long long mTotalTime = 0;
+
+  // Main thread only
+  bool mCallback = false;
+  napi_deferred mDone = nullptr;
+  napi_ref mCallbackError = nullptr;
+  std::deque<napi_ref> mReady;
+  std::deque<napi_deferred> mWaiting;
+  bool mEnded = false;
+  bool mReturned = false;
+  bool mErrorReported = false;
+  bool mParked = false;
+  int mRefs = 1;
+};
+
+#endif // DECODESTREAM_H
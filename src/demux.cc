@@ -31,6 +31,35 @@ int read_packet(void *opaque, uint8_t *buf, int buf_size)
   return numBytes;
 }
 
+// True when the demuxer's header gives each stream enough to set up a decoder
+static bool streamParamsKnown(const AVFormatContext* fmtCtx) {
+  if (fmtCtx->nb_streams == 0) return false;
+  for ( uint32_t s = 0 ; s < fmtCtx->nb_streams ; s++ ) {
+    const AVCodecParameters* par = fmtCtx->streams[s]->codecpar;
+    if (par->codec_id == AV_CODEC_ID_NONE) return false;
+    if ((par->codec_type == AVMEDIA_TYPE_VIDEO) && ((par->width <= 0) || (par->height <= 0)))
+      return false;
+    if ((par->codec_type == AVMEDIA_TYPE_AUDIO) && ((par->sample_rate <= 0) || (par->channels <= 0)))
+      return false;
+  }
+  return true;
+}
+
+// Demuxer options for live sources, each applied unless set explicitly
+static void applyLowLatency(AVDictionary** options) {
+  static const char* defaults[][2] = {
+    { "fflags", "+nobuffer" },
+    { "probesize", "32" },
+    { "analyzeduration", "0" },
+    { "fpsprobesize", "0" },
+    { "avioflags", "direct" }
+  };
+  for ( auto &d : defaults ) {
+    if (av_dict_get(*options, d[0], nullptr, 0) == nullptr)
+      av_dict_set(options, d[0], d[1], 0);
+  }
+}
+
 void demuxerExecute(napi_env env, void* data) {
   demuxerCarrier* c = (demuxerCarrier*) data;
 
@@ -41,6 +70,7 @@ void demuxerExecute(napi_env env, void* data) {
     c->errorMsg = avErrorMsg("Problem allocating demuxer: ", AVERROR(ENOMEM));
     return;
   }
+  c->interrupter->install(c->format);
 
   if (c->adaptor) {
     AVIOContext* avio_ctx = avio_alloc_context(nullptr, 0, 0, c->adaptor, &read_packet, nullptr, nullptr);
@@ -50,15 +80,41 @@ void demuxerExecute(napi_env env, void* data) {
       return;
     }
     c->format->pb = avio_ctx;
+  } else if (c->bufferInput) {
+    AVIOContext* avio_ctx = c->bufferInput->allocContext();
+    if (!avio_ctx) {
+      c->status = BEAMCODER_ERROR_START;
+      c->errorMsg = avErrorMsg("Problem allocating demuxer context: ", AVERROR(ENOMEM));
+      return;
+    }
+    c->format->pb = avio_ctx;
   }
 
-  if ((ret = avformat_open_input(&c->format, c->filename, c->iformat, &c->options))) {
+  AVIOContext* pb = c->format->pb;
+  {
+    interruptScope scope(c->interrupter);
+    ret = avformat_open_input(&c->format, c->filename, c->iformat, &c->options);
+  }
+  if (ret) {
+    // On failure the format context is freed but a user-supplied pb is not
+    if (c->bufferInput) BufferInput::freeContext(&pb);
     c->status = BEAMCODER_ERROR_START;
-    c->errorMsg = avErrorMsg("Problem opening input format: ", ret);
+    c->errorMsg = interruptErrorMsg(c->interrupter, "Problem opening input format: ", ret);
     return;
   }
 
-  if ((ret = avformat_find_stream_info(c->format, nullptr))) {
+  // Decoding packets to find stream parameters delays a live start
+  if (c->lowLatency && streamParamsKnown(c->format)) return;
+
+  {
+    interruptScope scope(c->interrupter);
+    ret = avformat_find_stream_info(c->format, nullptr);
+  }
+  if (ret == AVERROR_EXIT) {
+    c->status = BEAMCODER_ERROR_START;
+    c->errorMsg = interruptErrorMsg(c->interrupter, "Problem finding stream info: ", ret);
+    return;
+  } else if (ret) {
     printf("DEBUG: Could not find stream info for file %s, return value %i.",
       c->filename, ret);
   }
@@ -90,6 +146,29 @@ void demuxerComplete(napi_env env,  napi_status asyncStatus, void* data) {
   c->format = nullptr;
   REJECT_STATUS;
 
+  {
+    napi_value formatRefExt;
+    fmtCtxRef* fmtRef;
+    c->status = napi_get_named_property(env, result, "_formatContextRef", &formatRefExt);
+    REJECT_STATUS;
+    c->status = napi_get_value_external(env, formatRefExt, (void**) &fmtRef);
+    REJECT_STATUS;
+    fmtRef->pendingLimit = c->maxPending;
+  }
+
+  {
+    napi_value bufferInputExt;
+    c->status = napi_create_external(env, c->bufferInput,
+      c->bufferInput ? bufferInputFinalizer : nullptr, nullptr, &bufferInputExt);
+    REJECT_STATUS;
+    c->bufferInput = nullptr;
+    napi_property_descriptor desc[] = {
+      { "_bufferInput", nullptr, nullptr, nullptr, nullptr, bufferInputExt, napi_default, nullptr }
+    };
+    c->status = napi_define_properties(env, result, 1, desc);
+    REJECT_STATUS;
+  }
+
   c->status = napi_create_function(env, "readFrame", NAPI_AUTO_LENGTH, readFrame,
     nullptr, &prop);
   REJECT_STATUS;
@@ -102,12 +181,27 @@ void demuxerComplete(napi_env env,  napi_status asyncStatus, void* data) {
   c->status = napi_set_named_property(env, result, "seek", prop);
   REJECT_STATUS;
 
+  c->status = napi_create_function(env, "scan", NAPI_AUTO_LENGTH, scan,
+    nullptr, &prop);
+  REJECT_STATUS;
+  c->status = napi_set_named_property(env, result, "scan", prop);
+  REJECT_STATUS;
+
+  c->status = napi_create_function(env, "analyse", NAPI_AUTO_LENGTH, analyse,
+    nullptr, &prop);
+  REJECT_STATUS;
+  c->status = napi_set_named_property(env, result, "analyse", prop);
+  REJECT_STATUS;
+
   c->status = napi_create_function(env, "forceClose", NAPI_AUTO_LENGTH, forceCloseInput,
     nullptr, &prop);
   REJECT_STATUS;
   c->status = napi_set_named_property(env, result, "forceClose", prop);
   REJECT_STATUS;
 
+  c->status = defineInterruptControls(env, result);
+  REJECT_STATUS;
+
   napi_status status;
   status = napi_resolve_deferred(env, c->_deferred, result);
   FLOATING_STATUS;
@@ -119,7 +213,7 @@ napi_value demuxer(napi_env env, napi_callback_info info) {
   napi_value resourceName, promise, value, subValue;
   napi_valuetype type;
   size_t strLen;
-  bool isArray;
+  bool isArray, isBuffer;
   demuxerCarrier* c = new demuxerCarrier;
 
   c->status = napi_create_promise(env, &c->_deferred, &promise);
@@ -168,6 +262,26 @@ napi_value demuxer(napi_env env, napi_callback_info info) {
       }
     }
 
+    c->status = napi_get_named_property(env, args[0], "buffer", &value);
+    REJECT_RETURN;
+    c->status = napi_is_buffer(env, value, &isBuffer);
+    REJECT_RETURN;
+    if (isBuffer) {
+      if (c->adaptor) {
+        REJECT_ERROR_RETURN("Demuxer cannot read from both a governor and a buffer.",
+          BEAMCODER_INVALID_ARGS);
+      }
+      c->status = BufferInput::create(env, value, &c->bufferInput);
+      REJECT_RETURN;
+    } else {
+      c->status = napi_typeof(env, value, &type);
+      REJECT_RETURN;
+      if (type != napi_undefined) {
+        REJECT_ERROR_RETURN("Demuxer buffer must be a Buffer when specified.",
+          BEAMCODER_INVALID_ARGS);
+      }
+    }
+
     c->status = napi_get_named_property(env, args[0], "url", &value);
     REJECT_RETURN;
     c->status = napi_typeof(env, value, &type);
@@ -207,10 +321,28 @@ napi_value demuxer(napi_env env, napi_callback_info info) {
       c->status = makeAVDictionary(env, value, &c->options);
       REJECT_RETURN;
     }
+
+    bool present;
+    c->status = beam_get_bool(env, args[0], "lowLatency", &present, &c->lowLatency);
+    REJECT_RETURN;
+    c->status = beam_get_uint32(env, args[0], "max_pending", &c->maxPending);
+    REJECT_RETURN;
+    if (c->lowLatency) applyLowLatency(&c->options);
+
+    bool aborted;
+    c->status = getInterruptOptions(env, args[0], c->interrupter, &aborted);
+    if (c->status != napi_ok) {
+      REJECT_ERROR_RETURN("Demuxer signal must be an AbortSignal when specified.",
+        BEAMCODER_INVALID_ARGS);
+    }
+    if (aborted) {
+      REJECT_ERROR_RETURN("Problem opening input format: operation cancelled.",
+        BEAMCODER_ERROR_START);
+    }
   }
 
-  if ((c->filename == nullptr) && (c->adaptor == nullptr)) {
-    REJECT_ERROR_RETURN("Neither a filename nor an adaptor have been provided.",
+  if ((c->filename == nullptr) && (c->adaptor == nullptr) && (c->bufferInput == nullptr)) {
+    REJECT_ERROR_RETURN("Neither a filename, an adaptor nor a buffer have been provided.",
       BEAMCODER_INVALID_ARGS);
   }
 
@@ -230,6 +362,59 @@ void demuxerFinalizer(napi_env env, void* data, void* hint) {
   avformat_close_input(&fmtCtx);
 }
 
+int readStreamPacket(fmtCtxRef *formatRef, int streamIndex, AVPacket *packet) {
+  std::lock_guard<std::mutex> lk(formatRef->readLock);
+  if ((formatRef->interrupter != nullptr) && formatRef->interrupter->cancelled())
+    return AVERROR_EXIT;
+  for (auto it = formatRef->pending.begin(); it != formatRef->pending.end(); ++it) {
+    if ((streamIndex < 0) || ((*it)->stream_index == streamIndex)) {
+      av_packet_move_ref(packet, *it);
+      av_packet_free(&(*it));
+      formatRef->pending.erase(it);
+      return 0;
+    }
+  }
+
+  int ret;
+  while (true) {
+    if (formatRef->fmtCtx == nullptr) return AVERROR(EINVAL);
+    // Held packets are kept for whoever reads them, so stop before holding more
+    if ((streamIndex >= 0) && (formatRef->pendingLimit > 0) &&
+        (formatRef->pending.size() >= formatRef->pendingLimit))
+      return AVERROR(ENOBUFS);
+    {
+      interruptScope scope(formatRef->interrupter);
+      ret = av_read_frame(formatRef->fmtCtx, packet);
+    }
+    // A cancelled stream input reports the end of its data
+    if ((ret < 0) && (formatRef->interrupter != nullptr) && formatRef->interrupter->cancelled())
+      return AVERROR_EXIT;
+    if (ret < 0) return ret;
+    if ((ret = setPacketArrival(packet, av_gettime_relative())) < 0) {
+      av_packet_unref(packet);
+      return ret;
+    }
+    if ((streamIndex < 0) || (packet->stream_index == streamIndex)) return 0;
+    // Streams set to discard all are never read, so are not held
+    if ((packet->stream_index < (int) formatRef->fmtCtx->nb_streams) &&
+        (formatRef->fmtCtx->streams[packet->stream_index]->discard >= AVDISCARD_ALL)) {
+      av_packet_unref(packet);
+      continue;
+    }
+    AVPacket *other = av_packet_alloc();
+    if (other == nullptr) return AVERROR(ENOMEM);
+    av_packet_move_ref(other, packet);
+    formatRef->pending.push_back(other);
+  }
+}
+
+void clearPending(fmtCtxRef *formatRef) {
+  std::lock_guard<std::mutex> lk(formatRef->readLock);
+  for (auto it = formatRef->pending.begin(); it != formatRef->pending.end(); ++it)
+    av_packet_free(&(*it));
+  formatRef->pending.clear();
+}
+
 void readFrameExecute(napi_env env, void* data) {
   readFrameCarrier* c = (readFrameCarrier*) data;
   int ret;
@@ -241,12 +426,13 @@ void readFrameExecute(napi_env env, void* data) {
     return;
   }
 
-  ret = av_read_frame(fmtCtx, c->packet);
+  // Packets held back by pulling decoders are returned first
+  ret = readStreamPacket(c->formatRef, -1, c->packet);
   if (ret == AVERROR_EOF) {
     av_packet_free(&c->packet);
   } else if (ret < 0) {
     c->status = BEAMCODER_ERROR_READ_FRAME;
-    c->errorMsg = avErrorMsg("Problem reading frame: ", ret);
+    c->errorMsg = interruptErrorMsg(c->formatRef->interrupter, "Problem reading frame: ", ret);
     return;
   }
 }
@@ -342,12 +528,23 @@ void seekFrameExecute(napi_env env, void *data) {
     return;
   }
 
-  ret = av_seek_frame(fmtCtx, c->streamIndex, c->timestamp, c->flags);
+  {
+    std::lock_guard<std::mutex> lk(c->formatRef->readLock);
+    interruptScope scope(c->formatRef->interrupter);
+    ret = scope.cancelled() ? AVERROR_EXIT :
+      av_seek_frame(fmtCtx, c->streamIndex, c->timestamp, c->flags);
+    // Packets from before the seek no longer follow on
+    if (ret >= 0) {
+      for (auto it = c->formatRef->pending.begin(); it != c->formatRef->pending.end(); ++it)
+        av_packet_free(&(*it));
+      c->formatRef->pending.clear();
+    }
+  }
   // printf("Seek and ye shall %i, streamIndex = %i, timestamp = %i, flags = %i\n",
   //   ret, c->streamIndex, c->timestamp, c->flags );
   if (ret < 0) {
     c->status = BEAMCODER_ERROR_SEEK_FRAME;
-    c->errorMsg = avErrorMsg("Problem seeking frame: ", ret);
+    c->errorMsg = interruptErrorMsg(c->formatRef->interrupter, "Problem seeking frame: ", ret);
     return;
   }
 };
@@ -561,22 +758,32 @@ napi_value forceCloseInput(napi_env env, napi_callback_info info) {
   status = napi_get_value_external(env, adaptorExt, (void**) &adaptor);
   CHECK_STATUS;
 
-  if (fmtRef->fmtCtx != nullptr) {
-    fc = fmtRef->fmtCtx;
-    if (fc->pb != nullptr) {
-      if (adaptor)
-        avio_context_free(&fc->pb);
-      else {
-        ret = avio_closep(&fc->pb);
-        if (ret < 0) {
-          printf("DEBUG: For url '%s', %s", (fc->url != nullptr) ? fc->url : "unknown",
-            avErrorMsg("error closing IO: ", ret));
+  // Wake any read blocked on the input so its worker thread is released
+  if (fmtRef->interrupter != nullptr) fmtRef->interrupter->cancel();
+  if (adaptor) adaptor->finish();
+
+  {
+    std::lock_guard<std::mutex> lk(fmtRef->readLock);
+    if (fmtRef->fmtCtx != nullptr) {
+      fc = fmtRef->fmtCtx;
+      if (fc->pb != nullptr) {
+        if (BufferInput::owns(fc->pb))
+          BufferInput::freeContext(&fc->pb);
+        else if (adaptor)
+          avio_context_free(&fc->pb);
+        else {
+          ret = avio_closep(&fc->pb);
+          if (ret < 0) {
+            printf("DEBUG: For url '%s', %s", (fc->url != nullptr) ? fc->url : "unknown",
+              avErrorMsg("error closing IO: ", ret));
+          }
         }
       }
-    }
 
-    avformat_close_input(&fmtRef->fmtCtx);
+      avformat_close_input(&fmtRef->fmtCtx);
+    }
   }
+  clearPending(fmtRef);
 
   status = napi_get_undefined(env, &result);
   CHECK_STATUS;
@@ -36,6 +36,9 @@ extern "C" {
 #include "format.h"
 #include "node_api.h"
 #include "adaptor.h"
+#include "bufferinput.h"
+#include "scan.h"
+#include "analysis.h"
 
 void demuxerExecute(napi_env env, void* data);
 void demuxerComplete(napi_env env, napi_status asyncStatus, void* data);
@@ -49,6 +52,13 @@ void seekFrameExecute(napi_env env, void *data);
 void seekFrameComplete(napi_env env, napi_status asyncStatus, void *data);
 napi_value seekFrame(napi_env env, napi_callback_info info);
 
+// Read the next packet for a stream, holding packets for other streams in
+// the pending queue. A negative stream index takes the next packet of any
+// stream. Called on a worker thread. Fails with AVERROR(ENOBUFS) when the
+// pending queue is full, leaving the held packets in place.
+int readStreamPacket(fmtCtxRef *formatRef, int streamIndex, AVPacket *packet);
+void clearPending(fmtCtxRef *formatRef);
+
 void demuxerFinalizer(napi_env env, void* data, void* hint);
 void readBufferFinalizer(napi_env env, void* data, void* hint);
 
@@ -57,12 +67,21 @@ napi_value forceCloseInput(napi_env env, napi_callback_info info);
 struct demuxerCarrier : carrier {
   const char* filename = nullptr;
   Adaptor *adaptor = nullptr;
+  BufferInput *bufferInput = nullptr;
   AVFormatContext* format = nullptr;
   AVInputFormat* iformat = nullptr;
   AVDictionary* options = nullptr;
+  bool lowLatency = false;
+  uint32_t maxPending = 4096;
+  Interrupter* interrupter = new Interrupter;
   ~demuxerCarrier() {
+    if ((format != nullptr) && BufferInput::owns(format->pb)) {
+      BufferInput::freeContext(&format->pb);
+    }
     if (format != nullptr) { avformat_close_input(&format); }
+    if (bufferInput != nullptr) { delete bufferInput; }
     if (options != nullptr) { av_dict_free(&options); }
+    interrupter->release();
   }
 };
 
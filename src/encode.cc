@@ -25,7 +25,7 @@ napi_value encoder(napi_env env, napi_callback_info info) {
   napi_status status;
   napi_value value, result, global, jsObject, assign, jsParams;
   napi_valuetype type;
-  bool isArray, hasName, hasID, hasParams;
+  bool isArray, hasName, hasID, hasParams, hasThreads;
   char* codecName = nullptr;
   size_t codecNameLen = 0;
   int32_t codecID = -1;
@@ -134,6 +134,15 @@ create:
   status = napi_call_function(env, result, assign, 2, fargs, &result);
   CHECK_BAIL;
 
+  status = napi_has_named_property(env, args[0], "thread_count", &hasThreads);
+  CHECK_BAIL;
+  ThreadBudget::instance().allocate(encoder, true, hasThreads);
+
+  status = napi_create_function(env, "attach", NAPI_AUTO_LENGTH, attach, nullptr, &value);
+  CHECK_BAIL;
+  status = napi_set_named_property(env, result, "attach", value);
+  CHECK_BAIL;
+
   if ((encoder->sample_fmt != AV_SAMPLE_FMT_NONE) && 
       (encoder->sample_rate > 0) && (encoder->channel_layout != 0)) {
     // For audio encodes open the encoder if sufficient parameters have been provided
@@ -148,6 +157,7 @@ create:
 
 bail:
   if (encoder != nullptr) {
+    ThreadBudget::instance().release(encoder);
     avcodec_close(encoder);
     avcodec_free_context(&encoder);
   }
@@ -213,6 +223,26 @@ void encodeExecute(napi_env env, void* data) {
   } while (ret == 0);
   av_packet_free(&packet);
 
+  if (c->interleaver != nullptr) {
+    AVRational streamTimeBase = c->format->streams[c->streamIndex]->time_base;
+    bool flushing = !c->frames.empty() && (c->frames.front() == nullptr);
+    for ( auto it = c->packets.begin() ; it != c->packets.end() ; it++ ) {
+      (*it)->stream_index = c->streamIndex;
+      av_packet_rescale_ts(*it, c->encoder->time_base, streamTimeBase);
+      c->bytes += (*it)->size;
+    }
+    c->produced = c->packets.size();
+    // The end of the encoded stream also ends the stream in the interleaver
+    ret = c->interleaver->push(c->format, c->packets,
+      flushing ? c->streamIndex : -1, c->done);
+    c->queued = c->interleaver->queued();
+    if (ret < 0) {
+      c->status = BEAMCODER_ERROR_WRITE_FRAME;
+      c->errorMsg = avErrorMsg("Error writing encoded packet: ", ret);
+      return;
+    }
+  }
+
   c->totalTime = microTime(encodeStart);
   /* if (!c->frames.empty()) {
     printf("Finished encoding frame. First pts = %i\n", c->frames.front()->pts);
@@ -239,6 +269,34 @@ void encodeComplete(napi_env env, napi_status asyncStatus, void* data) {
 
   c->status = napi_create_object(env, &result);
   REJECT_STATUS;
+
+  if (c->interleaver != nullptr) {
+    // tidy up adaptor chunks if required
+    if (c->adaptor) {
+      c->status = c->adaptor->finaliseBufs(env);
+      REJECT_STATUS;
+    }
+    c->status = beam_set_string_utf8(env, result, "type", "encoded");
+    REJECT_STATUS;
+    c->status = beam_set_uint32(env, result, "packets", (uint32_t) c->produced);
+    REJECT_STATUS;
+    c->status = beam_set_int64(env, result, "bytes", c->bytes);
+    REJECT_STATUS;
+    c->status = beam_set_uint32(env, result, "written", (uint32_t) c->done.size());
+    REJECT_STATUS;
+    c->status = beam_set_uint32(env, result, "queued", (uint32_t) c->queued);
+    REJECT_STATUS;
+    c->status = beam_set_int64(env, result, "total_time", c->totalTime);
+    REJECT_STATUS;
+
+    napi_status status;
+    status = napi_resolve_deferred(env, c->_deferred, result);
+    FLOATING_STATUS;
+
+    tidyCarrier(env, c);
+    return;
+  }
+
   c->status = beam_set_string_utf8(env, result, "type", "packets");
   REJECT_STATUS;
 
@@ -271,6 +329,38 @@ void encodeComplete(napi_env env, napi_status asyncStatus, void* data) {
   tidyCarrier(env, c);
 };
 
+// Pick up the muxer stream an encoder is attached to, if any
+static napi_status getAttachment(napi_env env, napi_value encoderJS, encodeCarrier* c) {
+  napi_status status;
+  napi_value muxerJS, value;
+  napi_valuetype type;
+
+  status = napi_get_named_property(env, encoderJS, "_muxer", &muxerJS);
+  PASS_STATUS;
+  status = napi_typeof(env, muxerJS, &type);
+  PASS_STATUS;
+  if (type != napi_object) return napi_ok;
+
+  status = napi_get_named_property(env, muxerJS, "_formatContext", &value);
+  PASS_STATUS;
+  status = napi_get_value_external(env, value, (void**) &c->format);
+  PASS_STATUS;
+  status = napi_get_named_property(env, muxerJS, "_adaptor", &value);
+  PASS_STATUS;
+  status = napi_get_value_external(env, value, (void**) &c->adaptor);
+  PASS_STATUS;
+  status = napi_get_named_property(env, muxerJS, "_interleaver", &value);
+  PASS_STATUS;
+  status = napi_get_value_external(env, value, (void**) &c->interleaver);
+  PASS_STATUS;
+  status = napi_get_named_property(env, encoderJS, "_streamIndex", &value);
+  PASS_STATUS;
+  status = napi_get_value_int32(env, value, &c->streamIndex);
+  PASS_STATUS;
+  // Keep the encoder, and through it the muxer, alive while encoding
+  return napi_create_reference(env, encoderJS, 1, &c->passthru);
+}
+
 napi_value encode(napi_env env, napi_callback_info info) {
   napi_value resourceName, promise, encoderJS, encoderExt, value;
   encodeCarrier* c = new encodeCarrier;
@@ -290,6 +380,8 @@ napi_value encode(napi_env env, napi_callback_info info) {
   REJECT_RETURN;
   c->status = napi_get_value_external(env, encoderExt, (void**) &c->encoder);
   REJECT_RETURN;
+  c->status = getAttachment(env, encoderJS, c);
+  REJECT_RETURN;
 
   if (argc == 0) {
     REJECT_ERROR_RETURN("Encode call requires one or more frames.",
@@ -481,6 +573,8 @@ napi_value flushEnc(napi_env env, napi_callback_info info) {
     REJECT_ERROR_RETURN("Encode flush takes no arguments.",
       BEAMCODER_INVALID_ARGS);
   }
+  c->status = getAttachment(env, encoderJS, c);
+  REJECT_RETURN;
 
   c->frames.push_back(nullptr);
 
@@ -494,3 +588,94 @@ napi_value flushEnc(napi_env env, napi_callback_info info) {
 
   return promise;
 }
+
+/*
+  encoder.attach(muxer, stream); // stream is a muxer stream or its index
+  encoder.attach(null); // detach
+*/
+napi_value attach(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result, encoderJS, encoderExt, value, muxerValue, indexValue, undef;
+  napi_valuetype type;
+  AVCodecContext* encoder;
+  AVFormatContext* format;
+  int32_t streamIndex = -1;
+
+  size_t argc = 2;
+  napi_value args[2];
+
+  status = napi_get_cb_info(env, info, &argc, args, &encoderJS, nullptr);
+  CHECK_STATUS;
+  status = napi_get_named_property(env, encoderJS, "_CodecContext", &encoderExt);
+  CHECK_STATUS;
+  status = napi_get_value_external(env, encoderExt, (void**) &encoder);
+  CHECK_STATUS;
+  status = napi_get_undefined(env, &undef);
+  CHECK_STATUS;
+
+  if (argc < 1) {
+    NAPI_THROW_ERROR("Attach requires a muxer and a stream, or null to detach.");
+  }
+  status = napi_typeof(env, args[0], &type);
+  CHECK_STATUS;
+  if ((type == napi_null) || (type == napi_undefined)) {
+    muxerValue = undef;
+    indexValue = undef;
+  } else {
+    if (type != napi_object) {
+      NAPI_THROW_ERROR("Attach requires a muxer as its first argument.");
+    }
+    status = napi_get_named_property(env, args[0], "_interleaver", &value);
+    CHECK_STATUS;
+    status = napi_typeof(env, value, &type);
+    CHECK_STATUS;
+    if (type != napi_external) {
+      NAPI_THROW_ERROR("Encoders can only be attached to a muxer.");
+    }
+    status = napi_get_named_property(env, args[0], "_formatContext", &value);
+    CHECK_STATUS;
+    status = napi_get_value_external(env, value, (void**) &format);
+    CHECK_STATUS;
+
+    if (argc < 2) {
+      NAPI_THROW_ERROR("Attach requires a muxer stream or stream index.");
+    }
+    status = napi_typeof(env, args[1], &type);
+    CHECK_STATUS;
+    if (type == napi_number) {
+      status = napi_get_value_int32(env, args[1], &streamIndex);
+      CHECK_STATUS;
+    } else if (type == napi_object) {
+      status = beam_get_int32(env, args[1], "index", &streamIndex);
+      CHECK_STATUS;
+    }
+    if ((streamIndex < 0) || (streamIndex >= (int) format->nb_streams)) {
+      NAPI_THROW_ERROR("Attach stream is not a stream of the given muxer.");
+    }
+    if (format->streams[streamIndex]->codecpar->codec_type != encoder->codec_type) {
+      NAPI_THROW_ERROR("Attach stream media type does not match the encoder.");
+    }
+    if (encoder->time_base.num <= 0) {
+      NAPI_THROW_ERROR("Attached encoders require a time_base to rescale packet timestamps.");
+    }
+    if (format->max_interleave_delta <= 0) {
+      NAPI_THROW_ERROR("Attached encoders require a muxer max_interleave_delta greater than zero.");
+    }
+    muxerValue = args[0];
+    status = napi_create_int32(env, streamIndex, &indexValue);
+    CHECK_STATUS;
+  }
+
+  napi_property_descriptor desc[] = {
+    { "_muxer", nullptr, nullptr, nullptr, nullptr, muxerValue,
+      (napi_property_attributes) (napi_writable | napi_configurable), nullptr },
+    { "_streamIndex", nullptr, nullptr, nullptr, nullptr, indexValue,
+      (napi_property_attributes) (napi_writable | napi_configurable), nullptr }
+  };
+  status = napi_define_properties(env, encoderJS, 2, desc);
+  CHECK_STATUS;
+
+  status = napi_get_undefined(env, &result);
+  CHECK_STATUS;
+  return result;
+}
@@ -26,6 +26,8 @@
 #include "frame.h"
 #include "packet.h"
 #include "codec.h"
+#include "mux.h"
+#include "threadbudget.h"
 #include <vector>
 
 extern "C" {
@@ -40,6 +42,9 @@ void encodeExecute(napi_env env, void* data);
 void encodeComplete(napi_env env, napi_status asyncStatus, void* data);
 napi_value encode(napi_env env, napi_callback_info info);
 napi_value flushEnc(napi_env env, napi_callback_info info);
+// Attach the encoder to a muxer stream so that encoded packets are written
+// through the muxer's interleaver on the worker thread
+napi_value attach(napi_env env, napi_callback_info info);
 
 void encoderFinalizer(napi_env env, void* data, void* hint);
 
@@ -63,7 +68,18 @@ struct encodeCarrier : carrier {
   std::vector<AVFrame*> frames;
   std::vector<AVPacket*> packets;
   std::vector<napi_ref> frameRefs;
-  ~encodeCarrier() { }
+  // Set when the encoder is attached to a muxer stream
+  AVFormatContext* format = nullptr;
+  Adaptor *adaptor = nullptr;
+  Interleaver *interleaver = nullptr;
+  int streamIndex = -1;
+  std::vector<AVPacket*> done;
+  size_t produced = 0;
+  int64_t bytes = 0;
+  size_t queued = 0;
+  ~encodeCarrier() {
+    for (auto it = done.begin(); it != done.end(); ++it) av_packet_free(&(*it));
+  }
 };
 
 napi_status isFrame(napi_env env, napi_value packet);
@@ -22,8 +22,10 @@
 #include "filter.h"
 #include "beamcoder_util.h"
 #include "frame.h"
+#include "slicepool.h"
 #include <map>
-#include <deque>
+#include <vector>
+#include <mutex>
 
 extern "C" {
   #include <libavfilter/avfilter.h>
@@ -895,23 +897,41 @@ public:
   ~filtContexts() {}
 
   bool add(const std::string &name, AVFilterContext *context) {
-    mContextNames.push_back(name);
-    auto result = mFiltContexts.emplace(name, context);
+    auto result = mIndices.emplace(name, mContexts.size());
+    if (result.second) {
+      mContextNames.push_back(name);
+      mContexts.push_back(context);
+    }
     return result.second;
   }
 
+  AVFilterContext *getContext(size_t index) const {
+    return (index < mContexts.size()) ? mContexts[index] : nullptr;
+  }
+
   AVFilterContext *getContext(const std::string &name) const {
-    AVFilterContext *result = nullptr;
-    auto c = mFiltContexts.find(name);
-    if (c != mFiltContexts.end())
-      result = c->second;
-    return result;
+    int index = getIndex(name);
+    return (index >= 0) ? mContexts[index] : nullptr;
+  }
+
+  // Resolve a pad name to the handle used for index-based filtering, -1 if not found
+  int getIndex(const std::string &name) const {
+    auto c = mIndices.find(name);
+    return (c != mIndices.end()) ? (int)c->second : -1;
   }
 
+  size_t size() const  { return mContexts.size(); }
   const std::vector<std::string>& getNames() const  { return mContextNames; }
 
+  // Parameters last set on each buffer source by reinit, by source name
+  std::map<std::string, AVBufferSrcParameters> srcParams;
+  // Held by the source contexts of a filterer while its graph is filtering,
+  // reconfiguring or running commands, and while srcParams is used
+  std::mutex graphLock;
+
 private:
-  std::map<std::string, AVFilterContext *> mFiltContexts;
+  std::map<std::string, size_t> mIndices;
+  std::vector<AVFilterContext *> mContexts;
   std::vector<std::string> mContextNames;
 };
 
@@ -929,6 +949,9 @@ struct filtererCarrier : carrier {
   std::vector<std::string> outNames;
   std::vector<std::map<std::string, std::string> > outParams;
   std::string filterSpec;
+  int32_t threads = -1;
+  int32_t threadType = -1;
+  bool sharedThreads = false;
 
   filtContexts *srcCtxs = nullptr;
   filtContexts *sinkCtxs = nullptr;
@@ -968,6 +991,16 @@ void filtererExecute(napi_env env, void* data) {
     goto end;
   }
 
+  // Threading must be set up before any filters are added to the graph
+  if (c->threadType >= 0)
+    c->filterGraph->thread_type = c->threadType;
+  if (c->sharedThreads) {
+    c->filterGraph->execute = SlicePool::execute;
+    c->filterGraph->nb_threads = (c->threads > 0) ? c->threads :
+      (int)SlicePool::instance().threads() + 1;
+  } else if (c->threads >= 0)
+    c->filterGraph->nb_threads = c->threads;
+
   c->srcCtxs = new filtContexts;
   for (size_t i = 0; i < c->inParams.size(); ++i) {
     const AVFilter *buffersrc  = avfilter_get_by_name(0 == c->filterType.compare("audio")?"abuffer":"buffer");
@@ -1102,9 +1135,23 @@ end:
   delete[] outputs;
 }
 
+napi_status makeHandles(napi_env env, const filtContexts *ctxs, napi_value* result) {
+  napi_status status;
+  const std::vector<std::string>& names = ctxs->getNames();
+
+  status = napi_create_object(env, result);
+  PASS_STATUS;
+  for (size_t i = 0; i < names.size(); ++i) {
+    status = beam_set_int32(env, *result, names[i].c_str(), (int32_t)i);
+    PASS_STATUS;
+  }
+  return napi_ok;
+}
+
 void filtererComplete(napi_env env, napi_status asyncStatus, void* data) {
   filtererCarrier* c = (filtererCarrier*) data;
   napi_value result, typeName, filterGraphValue, srcContextsValue, sinkContextsValue;
+  napi_value inHandlesValue, outHandlesValue;
 
   if (asyncStatus != napi_ok) {
     c->status = asyncStatus;
@@ -1123,16 +1170,25 @@ void filtererComplete(napi_env env, napi_status asyncStatus, void* data) {
   REJECT_STATUS;
   c->status = napi_create_external(env, c->sinkCtxs, ctxsFinalizer, nullptr, &sinkContextsValue);
   REJECT_STATUS;
+  c->status = makeHandles(env, c->srcCtxs, &inHandlesValue);
+  REJECT_STATUS;
+  c->status = makeHandles(env, c->sinkCtxs, &outHandlesValue);
+  REJECT_STATUS;
 
   napi_property_descriptor desc[] = {
     { "type", nullptr, nullptr, nullptr, nullptr, typeName, napi_enumerable, nullptr },
     { "graph", nullptr, nullptr, getFilterGraph, nullptr, nullptr, napi_enumerable, c->filterGraph },
+    { "inputHandles", nullptr, nullptr, nullptr, nullptr, inHandlesValue, napi_enumerable, nullptr },
+    { "outputHandles", nullptr, nullptr, nullptr, nullptr, outHandlesValue, napi_enumerable, nullptr },
     { "filter", nullptr, filter, nullptr, nullptr, nullptr, napi_enumerable, nullptr },
+    { "sendCommand", nullptr, sendCommand, nullptr, nullptr, nullptr, napi_enumerable, c->filterGraph },
+    { "queueCommand", nullptr, queueCommand, nullptr, nullptr, nullptr, napi_enumerable, c->filterGraph },
+    { "reinit", nullptr, reinit, nullptr, nullptr, nullptr, napi_enumerable, nullptr },
     { "_filterGraph", nullptr, nullptr, nullptr, nullptr, filterGraphValue, napi_default, nullptr },
     { "_sourceContexts", nullptr, nullptr, nullptr, nullptr, srcContextsValue, napi_default, nullptr },
     { "_sinkContexts", nullptr, nullptr, nullptr, nullptr, sinkContextsValue, napi_default, nullptr }
   };
-  c->status = napi_define_properties(env, result, 6, desc);
+  c->status = napi_define_properties(env, result, 11, desc);
   REJECT_STATUS;
 
   napi_status status;
@@ -1537,6 +1593,40 @@ napi_value filterer(napi_env env, napi_callback_info info) {
   c->status = napi_get_value_string_utf8(env, filterSpecJS, (char *)c->filterSpec.data(), specLen+1, nullptr);
   REJECT_RETURN;
 
+  bool hasThreads, hasThreadType, present;
+  c->status = napi_has_named_property(env, args[0], "threads", &hasThreads);
+  REJECT_RETURN;
+  if (hasThreads) {
+    c->status = beam_get_int32(env, args[0], "threads", &c->threads);
+    REJECT_RETURN;
+    if (c->threads < 0) {
+      REJECT_ERROR_RETURN("Filterer threads must be zero or a positive number.",
+        BEAMCODER_INVALID_ARGS);
+    }
+  }
+  c->status = napi_has_named_property(env, args[0], "threadType", &hasThreadType);
+  REJECT_RETURN;
+  if (hasThreadType) {
+    char* threadTypeStr;
+    c->status = beam_get_string_utf8(env, args[0], "threadType", &threadTypeStr);
+    REJECT_RETURN;
+    if (threadTypeStr != nullptr) {
+      if (0 == strcmp(threadTypeStr, "slice")) c->threadType = AVFILTER_THREAD_SLICE;
+      else if (0 == strcmp(threadTypeStr, "none")) c->threadType = 0;
+      free(threadTypeStr);
+      if (c->threadType < 0) {
+        REJECT_ERROR_RETURN("Filterer threadType must be 'slice', 'none' or a number.",
+          BEAMCODER_INVALID_ARGS);
+      }
+    } else {
+      c->status = beam_get_int32(env, args[0], "threadType", &c->threadType);
+      REJECT_RETURN;
+    }
+  }
+  c->status = beam_get_bool(env, args[0], "sharedThreads", &present, &c->sharedThreads);
+  REJECT_RETURN;
+  if (!present) c->sharedThreads = false;
+
   c->status = napi_create_string_utf8(env, "Filterer", NAPI_AUTO_LENGTH, &resourceName);
   REJECT_RETURN;
   c->status = napi_create_async_work(env, nullptr, resourceName, filtererExecute,
@@ -1552,9 +1642,11 @@ napi_value filterer(napi_env env, napi_callback_info info) {
 struct filterCarrier : carrier {
   filtContexts *srcCtxs = nullptr;
   filtContexts *sinkCtxs = nullptr;
-  std::unordered_map<std::string, std::deque<AVFrame *> > srcFrames;
-  std::unordered_map<std::string, std::vector<AVFrame *> > dstFrames;
+  // Frame lists indexed by source and sink handle - no name lookups when filtering
+  std::vector<std::vector<AVFrame *> > srcFrames;
+  std::vector<std::vector<AVFrame *> > dstFrames;
   std::vector<napi_ref> frameRefs;
+  bool byHandle = false;
   ~filterCarrier() {}
 };
 
@@ -1606,55 +1698,86 @@ namespace {
 
     return result->frame;
   }
+
+  // Validate an array or array-like of frames, referencing each one and
+  // collecting its AVFrame for the source at the given handle
+  napi_status collectFrames(napi_env env, napi_value framesArr,
+      filterCarrier* c, uint32_t handle) {
+    napi_status status;
+    napi_value value, propNames;
+    napi_ref frameRef;
+    bool isArray;
+    uint32_t framesLen;
+
+    status = napi_is_array(env, framesArr, &isArray);
+    PASS_STATUS;
+    if (isArray) {
+      status = napi_get_array_length(env, framesArr, &framesLen);
+      PASS_STATUS;
+    } else {
+      status = napi_get_property_names(env, framesArr, &propNames);
+      PASS_STATUS;
+      status = napi_get_array_length(env, propNames, &framesLen);
+      PASS_STATUS;
+    }
+    for (uint32_t f = 0; f < framesLen; ++f) {
+      status = napi_get_element(env, framesArr, f, &value);
+      PASS_STATUS; // Blow up here if not array or array-like
+      status = isFrame(env, value);
+      PASS_STATUS;
+    }
+
+    std::vector<AVFrame *> &frames = c->srcFrames[handle];
+    frames.reserve(frames.size() + framesLen);
+    for (uint32_t f = 0; f < framesLen; ++f) {
+      status = napi_get_element(env, framesArr, f, &value);
+      PASS_STATUS;
+      status = napi_create_reference(env, value, 1, &frameRef);
+      PASS_STATUS;
+      c->frameRefs.push_back(frameRef);
+      frames.push_back(getFrame(env, value));
+    }
+    return napi_ok;
+  }
 }
 
 void filterExecute(napi_env env, void* data) {
   filterCarrier* c = (filterCarrier*) data;
   int ret = 0;
   HR_TIME_POINT filterStart = NOW;
+  std::lock_guard<std::mutex> lk(c->srcCtxs->graphLock);
 
-  for (auto it = c->srcFrames.begin(); it != c->srcFrames.end(); ++it) {
-    AVFilterContext *srcCtx = c->srcCtxs->getContext(it->first);
-    if (!srcCtx) {
-      c->status = BEAMCODER_INVALID_ARGS;
-      c->errorMsg = "Frame name not found in source contexts.";
-      return;
-    }
-
-    std::deque<AVFrame *> frames = it->second;
-    while (frames.size() > 0) {
-      ret = av_buffersrc_add_frame_flags(srcCtx, frames.front(), AV_BUFFERSRC_FLAG_KEEP_REF);
+  for (size_t h = 0; h < c->srcFrames.size(); ++h) {
+    AVFilterContext *srcCtx = c->srcCtxs->getContext(h);
+    for (AVFrame *frame : c->srcFrames[h]) {
+      ret = av_buffersrc_add_frame_flags(srcCtx, frame, AV_BUFFERSRC_FLAG_KEEP_REF);
       if (ret < 0) {
         c->status = BEAMCODER_ERROR_FILTER_ADD_FRAME;
         c->errorMsg = "Error while feeding the filtergraph.";
         return;
       }
-      frames.pop_front();
     }
   }
 
-  std::vector<std::string> sinkNames = c->sinkCtxs->getNames();
-  for (auto it = sinkNames.begin(); it != sinkNames.end(); ++it) {
-    std::vector<AVFrame *> frames;
+  c->dstFrames.resize(c->sinkCtxs->size());
+  for (size_t h = 0; h < c->sinkCtxs->size(); ++h) {
+    AVFilterContext *sinkCtx = c->sinkCtxs->getContext(h);
+    std::vector<AVFrame *> &frames = c->dstFrames[h];
     while (1) {
       AVFrame *filtFrame = av_frame_alloc();
-      AVFilterContext *sinkCtx = c->sinkCtxs->getContext(*it);
-      if (!sinkCtx) {
-        c->status = BEAMCODER_INVALID_ARGS;
-        c->errorMsg = "Sink name not found in sink contexts.";
-        return;
-      }
       ret = av_buffersink_get_frame(sinkCtx, filtFrame);
-      if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+      if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+        av_frame_free(&filtFrame);
         break;
+      }
       if (ret < 0) {
+        av_frame_free(&filtFrame);
         c->status = BEAMCODER_ERROR_FILTER_GET_FRAME;
         c->errorMsg = "Error while filtering.";
         return;
       }
       frames.push_back(filtFrame);
     }
-    c->dstFrames.emplace(*it, frames);
   }
   c->totalTime = microTime(filterStart);
 };
@@ -1677,21 +1800,13 @@ void filterComplete(napi_env env, napi_status asyncStatus, void* data) {
   c->status = napi_create_array(env, &result);
   REJECT_STATUS;
 
-  uint32_t outCount = 0;
-  for (auto it = c->dstFrames.begin(); it != c->dstFrames.end(); it++) {
-    c->status = napi_create_object(env, &dstFrame);
-    REJECT_STATUS;
-
+  const std::vector<std::string>& sinkNames = c->sinkCtxs->getNames();
+  for (size_t h = 0; h < c->dstFrames.size(); ++h) {
     c->status = napi_create_array(env, &frames);
     REJECT_STATUS;
 
-    c->status = napi_create_string_utf8(env, it->first.c_str(), NAPI_AUTO_LENGTH, &nameVal);
-    REJECT_STATUS;
-    c->status = napi_set_named_property(env, dstFrame, "name", nameVal);
-    REJECT_STATUS;
-
     uint32_t frameCount = 0;
-    for (auto fit = it->second.begin(); fit != it->second.end(); ++fit) {
+    for (auto fit = c->dstFrames[h].begin(); fit != c->dstFrames[h].end(); ++fit) {
       frameData* f = new frameData;
       f->frame = *fit;
 
@@ -1701,10 +1816,23 @@ void filterComplete(napi_env env, napi_status asyncStatus, void* data) {
       c->status = napi_set_element(env, frames, frameCount++, frame);
       REJECT_STATUS;
     }
+
+    if (c->byHandle) {
+      c->status = napi_set_element(env, result, (uint32_t)h, frames);
+      REJECT_STATUS;
+      continue;
+    }
+
+    c->status = napi_create_object(env, &dstFrame);
+    REJECT_STATUS;
+    c->status = napi_create_string_utf8(env, sinkNames[h].c_str(), NAPI_AUTO_LENGTH, &nameVal);
+    REJECT_STATUS;
+    c->status = napi_set_named_property(env, dstFrame, "name", nameVal);
+    REJECT_STATUS;
     c->status = napi_set_named_property(env, dstFrame, "frames", frames);
     REJECT_STATUS;
 
-    c->status = napi_set_element(env, result, outCount++, dstFrame);
+    c->status = napi_set_element(env, result, (uint32_t)h, dstFrame);
     REJECT_STATUS;
   }
 
@@ -1721,9 +1849,9 @@ void filterComplete(napi_env env, napi_status asyncStatus, void* data) {
 };
 
 napi_value filter(napi_env env, napi_callback_info info) {
-  napi_value resourceName, promise, filtererJS, value;
+  napi_value resourceName, promise, filtererJS, item;
+  napi_valuetype type;
   filterCarrier* c = new filterCarrier;
-  napi_ref frameRef;
 
   c->status = napi_create_promise(env, &c->_deferred, &promise);
   REJECT_RETURN;
@@ -1750,63 +1878,67 @@ napi_value filter(napi_env env, napi_callback_info info) {
       BEAMCODER_INVALID_ARGS);
   }
 
-  bool isArray;
+  c->srcFrames.resize(c->srcCtxs->size());
+  std::vector<bool> srcSeen(c->srcCtxs->size(), false);
+
+  bool isArray, itemIsArray;
   c->status = napi_is_array(env, args[0], &isArray);
   // REJECT_RETURN;
   // if (!isArray) // Allow array-like objects
   //   REJECT_ERROR_RETURN("Expected an array of source frame objects.",
   //     BEAMCODER_INVALID_ARGS);
 
-  napi_value item;
   c->status = napi_get_element(env, args[0], 0, &item);
   if (c->status != napi_ok) {
     REJECT_ERROR_RETURN("Expected an array or array-like object of source frame objects.",
       BEAMCODER_INVALID_ARGS);
   }
+  c->status = napi_is_array(env, item, &itemIsArray);
+  REJECT_RETURN;
+  c->status = napi_typeof(env, item, &type);
+  REJECT_RETURN;
+
   if (napi_ok == isFrame(env, item)) {
-    // Simplest case of an array of frame objects
-    uint32_t framesLen;
-    if (isArray) {
-      c->status = napi_get_array_length(env, args[0], &framesLen);
-      REJECT_RETURN;
-    } else {
-      napi_value propNames;
-      c->status = napi_get_property_names(env, args[0], &propNames);
-      REJECT_RETURN;
-      c->status = napi_get_array_length(env, propNames, &framesLen);
-      REJECT_RETURN;
+    // Simplest case of an array of frame objects, for the input named "in"
+    int handle = c->srcCtxs->getIndex("in");
+    if ((handle < 0) && (c->srcCtxs->size() == 1)) handle = 0;
+    if (handle < 0) {
+      REJECT_ERROR_RETURN("Frame name not found in source contexts.",
+        BEAMCODER_INVALID_ARGS);
     }
-    for (uint32_t f = 0; f < framesLen; ++f) {
-      c->status = napi_get_element(env, args[0], f, &value);
+    c->status = collectFrames(env, args[0], c, handle);
+    if (c->status != napi_ok) {
+      REJECT_ERROR_RETURN("Expected an array whose elements must be of type frame.",
+        BEAMCODER_INVALID_ARGS);
+    }
+  } else if (itemIsArray || (type == napi_null) || (type == napi_undefined)) {
+    // Array of frame arrays indexed by the filterer's inputHandles
+    uint32_t srcsLen;
+    c->status = napi_get_array_length(env, args[0], &srcsLen);
+    REJECT_RETURN;
+    if (srcsLen > c->srcCtxs->size()) {
+      REJECT_ERROR_RETURN("More frame arrays provided than the filterer has input handles.",
+        BEAMCODER_INVALID_ARGS);
+    }
+    c->byHandle = true;
+    for (uint32_t h = 0; h < srcsLen; ++h) {
+      c->status = napi_get_element(env, args[0], h, &item);
       REJECT_RETURN;
-      c->status = isFrame(env, value);
+      c->status = napi_typeof(env, item, &type);
+      REJECT_RETURN;
+      if ((type == napi_null) || (type == napi_undefined)) continue;
+      c->status = collectFrames(env, item, c, h);
       if (c->status != napi_ok) {
-        REJECT_ERROR_RETURN("Expected an array whose elements must be of type frame.",
+        REJECT_ERROR_RETURN("Values in array must by of type frame.",
           BEAMCODER_INVALID_ARGS);
       }
     }
-    std::deque<AVFrame *> frames;
-    for (uint32_t f = 0; f < framesLen; ++f) {
-      c->status = napi_get_element(env, args[0], f, &value);
-      REJECT_RETURN;
-      c->status = napi_create_reference(env, value, 1, &frameRef);
-      REJECT_RETURN;
-
-      c->frameRefs.push_back(frameRef);
-      frames.push_back(getFrame(env, value));
-    }
-    auto result = c->srcFrames.emplace("in", frames);
-    if (!result.second) {
-      REJECT_ERROR_RETURN("Frame names must be unique.",
-        BEAMCODER_INVALID_ARGS);
-    }
   } else {
     // Argument is an array of filter objects with name and frames members
     uint32_t srcsLen;
     c->status = napi_get_array_length(env, args[0], &srcsLen);
     REJECT_RETURN;
     for (uint32_t i = 0; i < srcsLen; ++i) {
-      napi_value item;
       c->status = napi_get_element(env, args[0], i, &item);
       REJECT_RETURN;
       std::string name;
@@ -1830,59 +1962,431 @@ napi_value filter(napi_env env, napi_callback_info info) {
           BEAMCODER_INVALID_ARGS);
       }
 
+      int handle = c->srcCtxs->getIndex(name);
+      if (handle < 0) {
+        REJECT_ERROR_RETURN("Frame name not found in source contexts.",
+          BEAMCODER_INVALID_ARGS);
+      }
+      if (srcSeen[handle]) {
+        REJECT_ERROR_RETURN("Frame names must be unique.",
+          BEAMCODER_INVALID_ARGS);
+      }
+      srcSeen[handle] = true;
+
       napi_value framesArrVal;
       c->status = napi_get_named_property(env, item, "frames", &framesArrVal);
       REJECT_RETURN;
+      c->status = collectFrames(env, framesArrVal, c, handle);
+      if (c->status != napi_ok) {
+        REJECT_ERROR_RETURN("Values in array must by of type frame.",
+          BEAMCODER_INVALID_ARGS);
+      }
+    }
+  }
+
+  c->status = napi_create_string_utf8(env, "Filter", NAPI_AUTO_LENGTH, &resourceName);
+  REJECT_RETURN;
+  c->status = napi_create_async_work(env, nullptr, resourceName, filterExecute,
+    filterComplete, c, &c->_request);
+  REJECT_RETURN;
+  c->status = napi_queue_async_work(env, c->_request);
+  REJECT_RETURN;
+
+  return promise;
+};
+
+napi_status parseCommandArgs(napi_env env, napi_value* args,
+    char** target, char** cmd, char** arg) {
+  napi_status status;
+  napi_value names[3] = { args[0], args[1], args[2] };
+  char** values[3] = { target, cmd, arg };
+  size_t len;
+  for (int x = 0; x < 3; ++x) {
+    status = napi_get_value_string_utf8(env, names[x], nullptr, 0, &len);
+    PASS_STATUS;
+    *values[x] = (char*) malloc(sizeof(char) * (len + 1));
+    status = napi_get_value_string_utf8(env, names[x], *values[x], len + 1, &len);
+    PASS_STATUS;
+  }
+  return napi_ok;
+}
+
+// Map an optional { one, fast } options object onto AVFILTER_CMD_FLAG_* values
+napi_status parseCommandFlags(napi_env env, napi_value options, int* flags) {
+  napi_status status;
+  napi_valuetype type;
+  bool present, flag;
+  *flags = 0;
+  status = napi_typeof(env, options, &type);
+  PASS_STATUS;
+  if (type != napi_object) return napi_ok;
+  status = beam_get_bool(env, options, "one", &present, &flag);
+  PASS_STATUS;
+  if (present && flag) *flags |= AVFILTER_CMD_FLAG_ONE;
+  status = beam_get_bool(env, options, "fast", &present, &flag);
+  PASS_STATUS;
+  if (present && flag) *flags |= AVFILTER_CMD_FLAG_FAST;
+  return napi_ok;
+}
+
+napi_value sendCommand(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result, filtererJS, srcCtxsExt;
+  AVFilterGraph* filterGraph;
+  filtContexts* srcCtxs;
+  char* target = nullptr;
+  char* cmd = nullptr;
+  char* arg = nullptr;
+  char response[1024];
+  int flags = 0;
+  int ret;
+
+  size_t argc = 4;
+  napi_value args[4];
 
-      bool isArray;
-      uint32_t framesLen;
-      c->status = napi_is_array(env, framesArrVal, &isArray);
+  status = napi_get_cb_info(env, info, &argc, args, &filtererJS, (void**) &filterGraph);
+  CHECK_STATUS;
+  status = napi_get_named_property(env, filtererJS, "_sourceContexts", &srcCtxsExt);
+  CHECK_STATUS;
+  status = napi_get_value_external(env, srcCtxsExt, (void**) &srcCtxs);
+  CHECK_STATUS;
+  if (argc < 3) {
+    NAPI_THROW_ERROR("Filter graph send command requires target, command and argument strings.");
+  }
+  status = parseCommandArgs(env, args, &target, &cmd, &arg);
+  if (status != napi_ok) {
+    free(target); free(cmd); free(arg);
+    NAPI_THROW_ERROR("Filter graph command target, command and argument must be strings.");
+  }
+  if (argc > 3) {
+    status = parseCommandFlags(env, args[3], &flags);
+    if (status != napi_ok) {
+      free(target); free(cmd); free(arg);
+      NAPI_THROW_ERROR("Filter graph command options could not be read.");
+    }
+  }
+
+  response[0] = '\0';
+  { // Waits for any filter or reinit in progress on a worker thread
+    std::lock_guard<std::mutex> lk(srcCtxs->graphLock);
+    ret = avfilter_graph_send_command(filterGraph, target, cmd, arg,
+      response, sizeof(response), flags);
+  }
+  free(target); free(cmd); free(arg);
+  if (ret < 0) {
+    char* errMsg = avErrorMsg("Filter graph failed to process command: ", ret);
+    napi_throw_error(env, nullptr, errMsg);
+    free(errMsg);
+    return nullptr;
+  }
+
+  status = napi_create_string_utf8(env, response, NAPI_AUTO_LENGTH, &result);
+  CHECK_STATUS;
+  return result;
+}
+
+napi_value queueCommand(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result, filtererJS, srcCtxsExt;
+  AVFilterGraph* filterGraph;
+  filtContexts* srcCtxs;
+  char* target = nullptr;
+  char* cmd = nullptr;
+  char* arg = nullptr;
+  double ts;
+  int flags = 0;
+  int ret;
+
+  size_t argc = 5;
+  napi_value args[5];
+
+  status = napi_get_cb_info(env, info, &argc, args, &filtererJS, (void**) &filterGraph);
+  CHECK_STATUS;
+  status = napi_get_named_property(env, filtererJS, "_sourceContexts", &srcCtxsExt);
+  CHECK_STATUS;
+  status = napi_get_value_external(env, srcCtxsExt, (void**) &srcCtxs);
+  CHECK_STATUS;
+  if (argc < 4) {
+    NAPI_THROW_ERROR("Filter graph queue command requires target, command, argument and time values.");
+  }
+  status = napi_get_value_double(env, args[3], &ts);
+  if (status != napi_ok) {
+    NAPI_THROW_ERROR("Filter graph queue command time must be a number of seconds.");
+  }
+  status = parseCommandArgs(env, args, &target, &cmd, &arg);
+  if (status != napi_ok) {
+    free(target); free(cmd); free(arg);
+    NAPI_THROW_ERROR("Filter graph command target, command and argument must be strings.");
+  }
+  if (argc > 4) {
+    status = parseCommandFlags(env, args[4], &flags);
+    if (status != napi_ok) {
+      free(target); free(cmd); free(arg);
+      NAPI_THROW_ERROR("Filter graph command options could not be read.");
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lk(srcCtxs->graphLock);
+    ret = avfilter_graph_queue_command(filterGraph, target, cmd, arg, flags, ts);
+  }
+  free(target); free(cmd); free(arg);
+  if (ret < 0) {
+    char* errMsg = avErrorMsg("Filter graph failed to queue command: ", ret);
+    napi_throw_error(env, nullptr, errMsg);
+    free(errMsg);
+    return nullptr;
+  }
+
+  status = napi_get_undefined(env, &result);
+  CHECK_STATUS;
+  return result;
+}
+
+struct reinitParams {
+  std::string name;
+  AVFilterContext *srcCtx = nullptr;
+  AVBufferSrcParameters *par = nullptr;
+};
+
+struct reinitCarrier : carrier {
+  filtContexts *srcCtxs = nullptr;
+  std::vector<reinitParams> sources;
+  std::vector<std::string> reconfigured;
+  ~reinitCarrier() {
+    for (auto &s : sources) av_freep(&s.par);
+  }
+};
+
+void reinitExecute(napi_env env, void* data) {
+  reinitCarrier* c = (reinitCarrier*) data;
+  int ret = 0;
+  HR_TIME_POINT reinitStart = NOW;
+  std::lock_guard<std::mutex> lk(c->srcCtxs->graphLock);
+
+  // Only the buffer source is updated. Its output link keeps the negotiated
+  // values, so a filter such as scale sees each frame differ from its input
+  // link and reconfigures itself.
+  for (auto &s : c->sources) {
+    ret = av_buffersrc_parameters_set(s.srcCtx, s.par);
+    if (ret < 0) {
+      c->status = BEAMCODER_ERROR_EINVAL;
+      c->errorMsg = avErrorMsg("Failed to reconfigure filter source: ", ret);
+      return;
+    }
+    c->srcCtxs->srcParams[s.name] = *s.par;
+    c->reconfigured.push_back(s.name);
+  }
+  c->totalTime = microTime(reinitStart);
+}
+
+void reinitComplete(napi_env env, napi_status asyncStatus, void* data) {
+  reinitCarrier* c = (reinitCarrier*) data;
+  napi_value result, names, prop;
+
+  if (asyncStatus != napi_ok) {
+    c->status = asyncStatus;
+    c->errorMsg = "Filter reinit failed to complete.";
+  }
+  REJECT_STATUS;
+
+  c->status = napi_create_object(env, &result);
+  REJECT_STATUS;
+  c->status = napi_create_array(env, &names);
+  REJECT_STATUS;
+  for (size_t i = 0; i < c->reconfigured.size(); ++i) {
+    c->status = napi_create_string_utf8(env, c->reconfigured[i].c_str(), NAPI_AUTO_LENGTH, &prop);
+    REJECT_STATUS;
+    c->status = napi_set_element(env, names, (uint32_t)i, prop);
+    REJECT_STATUS;
+  }
+  c->status = napi_set_named_property(env, result, "reconfigured", names);
+  REJECT_STATUS;
+  c->status = beam_set_int64(env, result, "total_time", c->totalTime);
+  REJECT_STATUS;
+
+  napi_status status;
+  status = napi_resolve_deferred(env, c->_deferred, result);
+  FLOATING_STATUS;
+
+  tidyCarrier(env, c);
+}
+
+napi_value reinit(napi_env env, napi_callback_info info) {
+  napi_value resourceName, promise, filtererJS, srcCtxsExt, paramsVal;
+  filtContexts *srcCtxs;
+  bool isArray, hasProp;
+  uint32_t paramsLen;
+  reinitCarrier* c = new reinitCarrier;
+
+  c->status = napi_create_promise(env, &c->_deferred, &promise);
+  REJECT_RETURN;
+
+  size_t argc = 1;
+  napi_value args[1];
+
+  c->status = napi_get_cb_info(env, info, &argc, args, &filtererJS, nullptr);
+  REJECT_RETURN;
+  if (argc != 1) {
+    REJECT_ERROR_RETURN("Filter reinit requires an array of input parameters.",
+      BEAMCODER_INVALID_ARGS);
+  }
+  c->status = napi_get_named_property(env, filtererJS, "_sourceContexts", &srcCtxsExt);
+  REJECT_RETURN;
+  c->status = napi_get_value_external(env, srcCtxsExt, (void**)&srcCtxs);
+  REJECT_RETURN;
+  c->srcCtxs = srcCtxs;
+
+  c->status = napi_is_array(env, args[0], &isArray);
+  REJECT_RETURN;
+  if (!isArray) {
+    REJECT_ERROR_RETURN("Filter reinit requires an array of input parameters.",
+      BEAMCODER_INVALID_ARGS);
+  }
+  c->status = napi_get_array_length(env, args[0], &paramsLen);
+  REJECT_RETURN;
+
+  for (uint32_t i = 0; i < paramsLen; ++i) {
+    reinitParams s;
+    char* str = nullptr;
+    c->status = napi_get_element(env, args[0], i, &paramsVal);
+    REJECT_RETURN;
+
+    c->status = napi_has_named_property(env, paramsVal, "name", &hasProp);
+    REJECT_RETURN;
+    if (hasProp) {
+      c->status = beam_get_string_utf8(env, paramsVal, "name", &str);
       REJECT_RETURN;
-      if (isArray) {
-        c->status = napi_get_array_length(env, framesArrVal, &framesLen);
-        REJECT_RETURN;
+      if (str == nullptr) {
+        REJECT_ERROR_RETURN("Filter reinit input parameter name must be a string.",
+          BEAMCODER_INVALID_ARGS);
+      }
+      s.name = str;
+      free(str);
+    } else if (0 == i) {
+      s.name = "in";
+    } else {
+      REJECT_ERROR_RETURN("Filter reinit input parameters must include a name value if there is more than one input.",
+        BEAMCODER_INVALID_ARGS);
+    }
+    s.srcCtx = srcCtxs->getContext(s.name);
+    if (s.srcCtx == nullptr) {
+      REJECT_ERROR_RETURN("Filter reinit input name not found in source contexts.",
+        BEAMCODER_INVALID_ARGS);
+    }
+
+    // Start from the source's current parameters so only given values change
+    AVFilterLink *link = s.srcCtx->outputs[0];
+    AVBufferSrcParameters current = {};
+    {
+      std::lock_guard<std::mutex> lk(srcCtxs->graphLock);
+      auto applied = srcCtxs->srcParams.find(s.name);
+      if (applied != srcCtxs->srcParams.end()) {
+        current = applied->second;
       } else {
-        napi_value propNames;
-        c->status = napi_get_property_names(env, framesArrVal, &propNames);
-        REJECT_RETURN;
-        c->status = napi_get_array_length(env, propNames, &framesLen);
-        REJECT_RETURN;
+        current.format = link->format;
+        current.time_base = link->time_base;
+        current.width = link->w;
+        current.height = link->h;
+        current.sample_aspect_ratio = link->sample_aspect_ratio;
+        current.sample_rate = link->sample_rate;
+        current.channel_layout = link->channel_layout;
       }
+    }
+    AVBufferSrcParameters next = current;
+    AVBufferSrcParameters *par = &next;
 
-      std::deque<AVFrame *> frames;
-      for (uint32_t f = 0; f < framesLen; ++f) {
-        c->status = napi_get_element(env, framesArrVal, f, &value);
-        REJECT_RETURN; // Blow up here if not array or array-like
-        c->status = isFrame(env, value);
-        if (c->status != napi_ok) {
-          REJECT_ERROR_RETURN("Values in array must by of type frame.",
+    c->status = napi_has_named_property(env, paramsVal, "timeBase", &hasProp);
+    REJECT_RETURN;
+    if (hasProp) {
+      c->status = beam_get_rational(env, paramsVal, "timeBase", &par->time_base);
+      REJECT_RETURN;
+    }
+    if (link->type == AVMEDIA_TYPE_AUDIO) {
+      int32_t sampleRate = par->sample_rate;
+      c->status = beam_get_int32(env, paramsVal, "sampleRate", &sampleRate);
+      REJECT_RETURN;
+      par->sample_rate = sampleRate;
+      c->status = beam_get_string_utf8(env, paramsVal, "sampleFormat", &str);
+      REJECT_RETURN;
+      if (str != nullptr) {
+        par->format = av_get_sample_fmt(str);
+        free(str);
+        if (par->format == AV_SAMPLE_FMT_NONE) {
+          REJECT_ERROR_RETURN("Filter reinit sample format not recognised.",
             BEAMCODER_INVALID_ARGS);
         }
       }
-      for (uint32_t f = 0; f < framesLen; ++f) {
-        c->status = napi_get_element(env, framesArrVal, f, &value);
-        REJECT_RETURN;
-        c->status = napi_create_reference(env, value, 1, &frameRef);
-        REJECT_RETURN;
-
-        c->frameRefs.push_back(frameRef);
-        frames.push_back(getFrame(env, value));
+      c->status = beam_get_string_utf8(env, paramsVal, "channelLayout", &str);
+      REJECT_RETURN;
+      if (str != nullptr) {
+        par->channel_layout = av_get_channel_layout(str);
+        free(str);
+        if (par->channel_layout == 0) {
+          REJECT_ERROR_RETURN("Filter reinit channel layout not recognised.",
+            BEAMCODER_INVALID_ARGS);
+        }
       }
-      auto result = c->srcFrames.emplace(name, frames);
-      if (!result.second) {
-        REJECT_ERROR_RETURN("Frame names must be unique.",
-          BEAMCODER_INVALID_ARGS);
+    } else {
+      c->status = beam_get_int32(env, paramsVal, "width", &par->width);
+      REJECT_RETURN;
+      c->status = beam_get_int32(env, paramsVal, "height", &par->height);
+      REJECT_RETURN;
+      c->status = beam_get_string_utf8(env, paramsVal, "pixelFormat", &str);
+      REJECT_RETURN;
+      if (str != nullptr) {
+        par->format = av_get_pix_fmt(str);
+        free(str);
+        if (par->format == AV_PIX_FMT_NONE) {
+          REJECT_ERROR_RETURN("Filter reinit pixel format not recognised.",
+            BEAMCODER_INVALID_ARGS);
+        }
       }
+      c->status = napi_has_named_property(env, paramsVal, "pixelAspect", &hasProp);
+      REJECT_RETURN;
+      if (hasProp) {
+        c->status = beam_get_rational(env, paramsVal, "pixelAspect", &par->sample_aspect_ratio);
+        REJECT_RETURN;
+      }
+    }
+
+    bool changed = (next.format != current.format) ||
+      (av_cmp_q(next.time_base, current.time_base) != 0);
+    if (link->type == AVMEDIA_TYPE_AUDIO) {
+      changed = changed || (next.sample_rate != current.sample_rate) ||
+        (next.channel_layout != current.channel_layout);
+    } else {
+      changed = changed || (next.width != current.width) || (next.height != current.height) ||
+        (av_cmp_q(next.sample_aspect_ratio, current.sample_aspect_ratio) != 0);
+    }
+    if (!changed) continue;
+
+    // Timestamps and audio filters are set up once, when the graph is configured
+    if (av_cmp_q(next.time_base, current.time_base) != 0) {
+      REJECT_ERROR_RETURN("Filter reinit cannot change the time base of an input - create a new filterer.",
+        BEAMCODER_INVALID_ARGS);
     }
+    if (link->type == AVMEDIA_TYPE_AUDIO) {
+      REJECT_ERROR_RETURN("Filter reinit cannot change the parameters of an audio input - create a new filterer.",
+        BEAMCODER_INVALID_ARGS);
+    }
+
+    s.par = av_buffersrc_parameters_alloc();
+    if (s.par == nullptr) {
+      REJECT_ERROR_RETURN("Failed to allocate filter source parameters.",
+        BEAMCODER_ERROR_ENOMEM);
+    }
+    *s.par = next;
+    c->sources.push_back(s);
   }
 
-  c->status = napi_create_string_utf8(env, "Filter", NAPI_AUTO_LENGTH, &resourceName);
+  c->status = napi_create_string_utf8(env, "Reinit", NAPI_AUTO_LENGTH, &resourceName);
   REJECT_RETURN;
-  c->status = napi_create_async_work(env, nullptr, resourceName, filterExecute,
-    filterComplete, c, &c->_request);
+  c->status = napi_create_async_work(env, nullptr, resourceName, reinitExecute,
+    reinitComplete, c, &c->_request);
   REJECT_RETURN;
   c->status = napi_queue_async_work(env, c->_request);
   REJECT_RETURN;
 
   return promise;
-};
+}
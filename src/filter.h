@@ -26,5 +26,8 @@
 
 napi_value filterer(napi_env env, napi_callback_info info);
 napi_value filter(napi_env env, napi_callback_info info);
+napi_value sendCommand(napi_env env, napi_callback_info info);
+napi_value queueCommand(napi_env env, napi_callback_info info);
+napi_value reinit(napi_env env, napi_callback_info info);
 
 #endif // FILTER_H
@@ -3497,6 +3497,7 @@ napi_status fromAVFormatContext(napi_env env, AVFormatContext* fmtCtx,
   napi_value jsFmtCtx, extFmtCtxRef, extFmtCtx, extAdaptor, truth, undef;
   fmtCtxRef* fmtRef = new fmtCtxRef;
   fmtRef->fmtCtx = fmtCtx;
+  fmtRef->interrupter = Interrupter::attach(fmtCtx);
 
   bool isMuxer = fmtCtx->oformat != nullptr;
   bool isFormat = !((fmtCtx->oformat == nullptr) ^ (fmtCtx->iformat == nullptr));
@@ -3837,7 +3838,9 @@ void formatContextFinalizer(napi_env env, void* data, void* hint) {
   if (fmtRef->fmtCtx != nullptr) {
     fc = fmtRef->fmtCtx;
     if (fc->pb != nullptr) {
-      if (adaptor)
+      if (BufferInput::owns(fc->pb))
+        BufferInput::freeContext(&fc->pb);
+      else if (adaptor || ((fc->oformat != nullptr) && (fc->flags & AVFMT_FLAG_CUSTOM_IO)))
         avio_context_free(&fc->pb);
       else {
         ret = avio_closep(&fc->pb);
@@ -27,6 +27,10 @@
 #include "codec_par.h"
 #include "packet.h"
 #include "adaptor.h"
+#include "bufferinput.h"
+#include "interrupt.h"
+#include <deque>
+#include <mutex>
 
 extern "C" {
   #include <libavformat/avformat.h>
@@ -36,6 +40,18 @@ extern "C" {
 // Indirection required to avoid double delete after demuxer forceClose 
 struct fmtCtxRef {
   AVFormatContext* fmtCtx = nullptr;
+  // Serialises reads by the demuxer and by decoders pulling from it
+  std::mutex readLock;
+  // Packets read by a pulling decoder for other streams, in read order
+  std::deque<AVPacket*> pending;
+  // Most packets held in pending before a pulling read fails, zero for no limit
+  size_t pendingLimit = 4096;
+  // Installed as the context's interrupt callback, so outlives the context
+  Interrupter* interrupter = nullptr;
+  ~fmtCtxRef() {
+    for (auto it = pending.begin(); it != pending.end(); ++it) av_packet_free(&(*it));
+    if (interrupter != nullptr) interrupter->release();
+  }
 };
 
 napi_value muxers(napi_env env, napi_callback_info info);
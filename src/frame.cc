@@ -1047,6 +1047,51 @@ done:
   return result;
 }
 
+// Drop cached plane Buffers and row views when the frame's buffers change
+static napi_status clearFrameCache(napi_env env, frameData* f) {
+  napi_status status;
+  if (f->dataCache != nullptr) {
+    status = napi_delete_reference(env, f->dataCache);
+    PASS_STATUS;
+    f->dataCache = nullptr;
+  }
+  if (f->rowsCache != nullptr) {
+    status = napi_delete_reference(env, f->rowsCache);
+    PASS_STATUS;
+    f->rowsCache = nullptr;
+  }
+  return napi_ok;
+}
+
+napi_status detachFrameData(napi_env env, frameData* f, int* bufRefs) {
+  napi_status status;
+  napi_value array, element, arrayBuffer;
+  napi_typedarray_type type;
+  size_t length, offset;
+  void* base;
+  uint32_t count = 0;
+  *bufRefs = 0;
+  if (f->dataCache != nullptr) {
+    status = napi_get_reference_value(env, f->dataCache, &array);
+    PASS_STATUS;
+    if (array != nullptr) {
+      status = napi_get_array_length(env, array, &count);
+      PASS_STATUS;
+    }
+    for ( uint32_t x = 0 ; x < count ; x++ ) {
+      status = napi_get_element(env, array, x, &element);
+      PASS_STATUS;
+      status = napi_get_typedarray_info(env, element, &type, &length, &base, &arrayBuffer, &offset);
+      PASS_STATUS;
+      status = napi_detach_arraybuffer(env, arrayBuffer);
+      PASS_STATUS;
+    }
+    // getFrameData gives the first Buffer its own reference to buf[0]
+    if ((count > 0) && (f->frame->buf[0] != nullptr)) *bufRefs = 1;
+  }
+  return clearFrameCache(env, f);
+}
+
 napi_value getFrameData(napi_env env, napi_callback_info info) {
   napi_status status;
   napi_value array, element;
@@ -1059,6 +1104,12 @@ napi_value getFrameData(napi_env env, napi_callback_info info) {
   status = napi_get_cb_info(env, info, 0, nullptr, nullptr, (void**) &f);
   CHECK_STATUS;
 
+  if (f->dataCache != nullptr) {
+    status = napi_get_reference_value(env, f->dataCache, &array);
+    CHECK_STATUS;
+    if (array != nullptr) return array;
+  }
+
   status = napi_create_array(env, &array);
   CHECK_STATUS;
 
@@ -1094,10 +1145,97 @@ napi_value getFrameData(napi_env env, napi_callback_info info) {
     CHECK_STATUS;
   }
 
+  // Shared by every read, so nobody can swap its planes for anyone else
+  status = napi_object_freeze(env, array);
+  CHECK_STATUS;
+  status = napi_create_reference(env, array, 1, &f->dataCache);
   CHECK_STATUS;
   return array;
 }
 
+// Views of each row of each plane of a video frame, without the padding at the
+// end of each line. Components deeper than 8 bits are viewed as 16-bit values.
+napi_value getFrameRows(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result, data, plane, element, arrayBuffer, row;
+  frameData* f;
+  frameRowsKey key;
+  const AVPixFmtDescriptor* desc;
+  uint32_t dataCount;
+
+  status = napi_get_cb_info(env, info, 0, nullptr, nullptr, (void**) &f);
+  CHECK_STATUS;
+
+  desc = av_pix_fmt_desc_get((AVPixelFormat) f->frame->format);
+  if ((f->frame->width <= 0) || (f->frame->height <= 0) || (desc == nullptr) ||
+      (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM))) {
+    status = napi_get_null(env, &result);
+    CHECK_STATUS;
+    return result;
+  }
+
+  key.format = f->frame->format;
+  key.width = f->frame->width;
+  key.height = f->frame->height;
+  for ( int p = 0 ; p < 4 ; p++ ) key.linesize[p] = f->frame->linesize[p];
+  if ((f->rowsCache != nullptr) && (memcmp(&key, &f->rowsKey, sizeof(key)) == 0)) {
+    status = napi_get_reference_value(env, f->rowsCache, &result);
+    CHECK_STATUS;
+    if (result != nullptr) return result;
+  }
+
+  data = getFrameData(env, info);
+  if (data == nullptr) return nullptr;
+  status = napi_get_array_length(env, data, &dataCount);
+  CHECK_STATUS;
+
+  bool wide = desc->comp[0].depth > 8;
+  int planes = av_pix_fmt_count_planes((AVPixelFormat) f->frame->format);
+  status = napi_create_array(env, &result);
+  CHECK_STATUS;
+  for ( int p = 0 ; (p < planes) && (p < (int) dataCount) ; p++ ) {
+    napi_typedarray_type type;
+    size_t length, offset;
+    void* base;
+    int linesize = f->frame->linesize[p];
+    int rowBytes = av_image_get_linesize((AVPixelFormat) f->frame->format, f->frame->width, p);
+    int height = ((p == 1) || (p == 2)) ?
+      AV_CEIL_RSHIFT(f->frame->height, desc->log2_chroma_h) : f->frame->height;
+
+    status = napi_get_element(env, data, p, &element);
+    CHECK_STATUS;
+    status = napi_get_typedarray_info(env, element, &type, &length, &base, &arrayBuffer, &offset);
+    CHECK_STATUS;
+    status = napi_create_array(env, &plane);
+    CHECK_STATUS;
+    bool asWide = wide && ((offset % 2) == 0) && ((linesize % 2) == 0);
+    for ( int y = 0 ; (linesize > 0) && (rowBytes > 0) && (y < height) ; y++ ) {
+      size_t rowOffset = offset + (size_t) y * linesize;
+      if ((size_t) y * linesize + rowBytes > length) break;
+      status = napi_create_typedarray(env, asWide ? napi_uint16_array : napi_uint8_array,
+        asWide ? rowBytes / 2 : rowBytes, arrayBuffer, rowOffset, &row);
+      CHECK_STATUS;
+      status = napi_set_element(env, plane, y, row);
+      CHECK_STATUS;
+    }
+    status = napi_object_freeze(env, plane);
+    CHECK_STATUS;
+    status = napi_set_element(env, result, p, plane);
+    CHECK_STATUS;
+  }
+  status = napi_object_freeze(env, result);
+  CHECK_STATUS;
+
+  if (f->rowsCache != nullptr) {
+    status = napi_delete_reference(env, f->rowsCache);
+    CHECK_STATUS;
+  }
+  status = napi_create_reference(env, result, 1, &f->rowsCache);
+  CHECK_STATUS;
+  f->rowsKey = key;
+  return result;
+}
+
 napi_value setFrameData(napi_env env, napi_callback_info info) {
   napi_status status;
   napi_value result, element;
@@ -1118,6 +1256,8 @@ napi_value setFrameData(napi_env env, napi_callback_info info) {
   if (argc < 1) {
     NAPI_THROW_ERROR("Set packet data must be provided with an array of buffer values.");
   }
+  status = clearFrameCache(env, f);
+  CHECK_STATUS;
   status = napi_typeof(env, args[0], &type);
   CHECK_STATUS;
   if ((type == napi_null) || (type == napi_undefined)) {
@@ -1185,6 +1325,7 @@ napi_value setFrameData(napi_env env, napi_callback_info info) {
     status = napi_get_buffer_info(env, element, (void**) &data, &length);
     CHECK_STATUS;
 
+    beam_track_js_buffer(avr, true);
     f->frame->buf[x] = av_buffer_create(data, length, frameBufferFree, avr, 0);
     CHECK_STATUS;
     f->frame->data[x] = f->frame->buf[x]->data;
@@ -2352,6 +2493,8 @@ napi_value alloc(napi_env env, napi_callback_info info) {
   CHECK_STATUS;
   status = napi_get_value_external(env, extFrame, (void**) &f);
   CHECK_STATUS;
+  status = clearFrameCache(env, f);
+  CHECK_STATUS;
 
   if (f->frame->format >= 0) {
     if (f->frame->width > 0 && f->frame->height > 0) {
@@ -2623,9 +2766,10 @@ napi_status fromAVFrame(napi_env env, frameData* f, napi_value* result) {
       (napi_property_attributes) (napi_writable | napi_enumerable), f },
     { "alloc", nullptr, alloc, nullptr, nullptr, nullptr, napi_enumerable, nullptr },
     { "toJSON", nullptr, frameToJSON, nullptr, nullptr, nullptr, napi_default, f },
-    { "_frame", nullptr, nullptr, nullptr, nullptr, extFrame, napi_default, nullptr }
+    { "_frame", nullptr, nullptr, nullptr, nullptr, extFrame, napi_default, nullptr },
+    { "rows", nullptr, nullptr, getFrameRows, nullptr, nullptr, napi_default, f }
   };
-  status = napi_define_properties(env, jsFrame, 44, desc);
+  status = napi_define_properties(env, jsFrame, 45, desc);
   PASS_STATUS;
 
   for ( int x = 0 ; x < AV_NUM_DATA_POINTERS ; x++ ) {
@@ -2654,6 +2798,10 @@ void frameDataFinalizer(napi_env env, void* data, void* hint) {
   if (status != napi_ok) {
     printf("DEBUG: Failed to adjust external memory downwards on frame delete.\n");
   }
+  status = clearFrameCache(env, f);
+  if (status != napi_ok) {
+    printf("DEBUG: Failed to delete cached frame data, status %i.\n", status);
+  }
   for ( auto it = f->dataRefs.cbegin() ; it != f->dataRefs.cend() ; it++) {
     // printf("Freeing data reference for frame with pts = %i\n", f->frame->pts);
     status = napi_delete_reference(env, *it);
@@ -2673,6 +2821,7 @@ void frameBufferFinalizer(napi_env env, void* data, void* hint) {
 void frameBufferFree(void* opaque, uint8_t* data) {
   napi_status status;
   avBufRef* avr = (avBufRef*) opaque;
+  beam_track_js_buffer(avr, false);
   // printf("AV freeing a frame buffer. pts = %i\n", avr->pts);
   status = napi_delete_reference(avr->env, (napi_ref) avr->ref);
   if (status != napi_ok)
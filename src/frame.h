@@ -29,6 +29,7 @@
 extern "C" {
   #include <libavcodec/avcodec.h>
   #include <libavutil/imgutils.h>
+  #include <libavutil/pixdesc.h>
 }
 
 void frameFinalizer(napi_env env, void* data, void* hint);
@@ -36,10 +37,22 @@ void frameDataFinalizer(napi_env env, void* data, void* hint);
 void frameBufferFinalizer(napi_env env, void* data, void* hint);
 void frameBufferFree(void* opaque, uint8_t* data);
 
+// Shape of a frame's planes when its row views were made
+struct frameRowsKey {
+  int format = -1;
+  int width = 0;
+  int height = 0;
+  int linesize[4] = { 0, 0, 0, 0 };
+};
+
 struct frameData {
   AVFrame* frame = nullptr;
   std::vector<napi_ref> dataRefs;
   int32_t extSize = 0;
+  // Plane Buffers and row views, kept until the frame's buffers change
+  napi_ref dataCache = nullptr;
+  napi_ref rowsCache = nullptr;
+  frameRowsKey rowsKey;
   ~frameData() {
     // printf("Freeing frame with pts = %i\n", frame->pts);
     av_frame_free(&frame);
@@ -47,6 +60,11 @@ struct frameData {
 };
 
 napi_value makeFrame(napi_env env, napi_callback_info info);
+// Detach the plane Buffers already handed to Javascript, and their row views,
+// so that they cannot see the frame's memory after it has been reused. Sets
+// bufRefs to the references to buf[0] that the detached Buffers still hold
+// until they are garbage collected.
+napi_status detachFrameData(napi_env env, frameData* f, int* bufRefs);
 napi_status fromAVFrame(napi_env env, frameData* frame, napi_value* result);
 
 #endif // FRAME_H
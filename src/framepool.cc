@@ -0,0 +1,128 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#include "framepool.h"
+#include "bufferpool.h"
+
+extern "C" {
+  #include <libavutil/imgutils.h>
+  #include <libavutil/pixdesc.h>
+}
+
+#define PLANE_ALIGN 64
+
+// Block from the BufferPool behind an aligned plane
+struct pooledPlane {
+  uint8_t *block;
+  size_t capacity;
+};
+
+static void planeFree(void *opaque, uint8_t *data) {
+  pooledPlane *p = (pooledPlane *) opaque;
+  BufferPool::instance().release(p->block, p->capacity);
+  delete p;
+}
+
+static AVBufferRef *planeAlloc(void *opaque, size_t size) {
+  pooledPlane *p = new pooledPlane;
+  p->block = BufferPool::instance().acquire(size + PLANE_ALIGN, &p->capacity);
+  if (p->block == nullptr) {
+    delete p;
+    return nullptr;
+  }
+  uint8_t *data = (uint8_t *) (((uintptr_t) p->block + PLANE_ALIGN - 1) & ~(uintptr_t) (PLANE_ALIGN - 1));
+  AVBufferRef *buf = av_buffer_create(data, size, planeFree, p, 0);
+  if (buf == nullptr) planeFree(p, data);
+  return buf;
+}
+
+void FramePool::install(AVCodecContext *ctx) {
+  ctx->opaque = new FramePool;
+  ctx->get_buffer2 = getBuffer2;
+}
+
+FramePool *FramePool::of(AVCodecContext *ctx) {
+  return (ctx->get_buffer2 == getBuffer2) ? (FramePool *) ctx->opaque : nullptr;
+}
+
+FramePool::~FramePool() {
+  // Planes still held by frames keep their pool until they are released
+  for ( auto &p : mPools ) av_buffer_pool_uninit(&p.second);
+}
+
+AVBufferRef *FramePool::get(size_t size) {
+  AVBufferPool *pool;
+  {
+    std::lock_guard<std::mutex> lk(m);
+    auto it = mPools.find(size);
+    if (it == mPools.end()) {
+      pool = av_buffer_pool_init2(size, this, planeAlloc, nullptr);
+      if (pool == nullptr) return nullptr;
+      mPools[size] = pool;
+    } else {
+      pool = it->second;
+    }
+  }
+  return av_buffer_pool_get(pool);
+}
+
+// May be called from decoder threads
+int FramePool::getBuffer2(AVCodecContext *ctx, AVFrame *frame, int flags) {
+  FramePool *pool = (FramePool *) ctx->opaque;
+  const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((AVPixelFormat) frame->format);
+  if ((ctx->codec_type != AVMEDIA_TYPE_VIDEO) || (frame->hw_frames_ctx != nullptr) ||
+      !(ctx->codec->capabilities & AV_CODEC_CAP_DR1) || (desc == nullptr) ||
+      (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL)))
+    return avcodec_default_get_buffer2(ctx, frame, flags);
+
+  int ret, w = frame->width, h = frame->height;
+  int linesizeAlign[AV_NUM_DATA_POINTERS];
+  int linesizes[4];
+  ptrdiff_t strides[4];
+  size_t sizes[4];
+  avcodec_align_dimensions2(ctx, &w, &h, linesizeAlign);
+
+  // As the default allocator, widen until every linesize is aligned
+  bool unaligned;
+  do {
+    if ((ret = av_image_fill_linesizes(linesizes, (AVPixelFormat) frame->format, w)) < 0)
+      return ret;
+    w += w & ~(w - 1);
+    unaligned = false;
+    for ( int i = 0 ; i < 4 ; i++ ) unaligned |= (linesizes[i] % PLANE_ALIGN) != 0;
+  } while (unaligned);
+
+  for ( int i = 0 ; i < 4 ; i++ ) strides[i] = linesizes[i];
+  if ((ret = av_image_fill_plane_sizes(sizes, (AVPixelFormat) frame->format, h, strides)) < 0)
+    return ret;
+
+  for ( int i = 0 ; i < 4 && sizes[i] > 0 ; i++ ) {
+    frame->buf[i] = pool->get(sizes[i] + 16 + PLANE_ALIGN - 1 + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (frame->buf[i] == nullptr) {
+      av_frame_unref(frame);
+      return AVERROR(ENOMEM);
+    }
+    frame->data[i] = frame->buf[i]->data;
+    frame->linesize[i] = linesizes[i];
+  }
+  frame->extended_data = frame->data;
+  return 0;
+}
@@ -0,0 +1,55 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+#include <map>
+#include <mutex>
+
+extern "C" {
+  #include <libavcodec/avcodec.h>
+  #include <libavutil/buffer.h>
+}
+
+// Decoder get_buffer2 that allocates video frame planes from memory in the
+// process-wide BufferPool. Planes have 64-byte aligned data and linesizes,
+// and are padded for SIMD reads past the end. Each plane size has its own
+// AVBufferPool, so planes are recycled as soon as frames are released.
+class FramePool {
+public:
+  // Install on a decoder before it is opened
+  static void install(AVCodecContext *ctx);
+  // The pool installed on a decoder, or nullptr
+  static FramePool *of(AVCodecContext *ctx);
+  static int getBuffer2(AVCodecContext *ctx, AVFrame *frame, int flags);
+
+  ~FramePool();
+
+private:
+  FramePool() {}
+  AVBufferRef *get(size_t size);
+
+  std::mutex m;
+  std::map<size_t, AVBufferPool*> mPools;
+};
+
+#endif // FRAMEPOOL_H
@@ -0,0 +1,684 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#include "framering.h"
+#include "frame.h"
+#include <cstring>
+#include <new>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+extern "C" {
+  #include <libavutil/imgutils.h>
+  #include <libavutil/samplefmt.h>
+  #include <libavutil/pixdesc.h>
+}
+
+// Slot states and sequence numbers are shared between processes
+static_assert((ATOMIC_INT_LOCK_FREE == 2) && (ATOMIC_LONG_LOCK_FREE == 2) &&
+  (ATOMIC_LLONG_LOCK_FREE == 2), "Frame rings need lock-free atomics.");
+
+static uint64_t ringAlign(uint64_t x) {
+  return (x + RING_ALIGN - 1) / RING_ALIGN * RING_ALIGN;
+}
+
+// Reference from a read frame's buffer back to its slot
+struct ringRelease {
+  FrameRing* ring;
+  ringSlot* slot;
+  // Set once the slot has been handed back, so it is only freed once
+  std::atomic<bool> released{false};
+};
+
+FrameRing* FrameRing::open(const char* name, bool create, uint32_t slots,
+    uint64_t slotSize, std::string& error) {
+#ifdef _WIN32
+  error = "Shared memory frame rings are not supported on Windows.";
+  return nullptr;
+#else
+  int fd;
+  size_t size;
+  uint64_t headerBytes = ringAlign(sizeof(ringHeader));
+  uint64_t slotStride = ringAlign(sizeof(ringSlot)) + ringAlign(slotSize);
+
+  if (create) {
+    if ((slots == 0) || (slotSize == 0)) {
+      error = "Frame ring needs at least one slot of a non-zero size.";
+      return nullptr;
+    }
+    size = headerBytes + slots * slotStride;
+    fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+      error = std::string("Failed to create shared memory: ") + strerror(errno);
+      return nullptr;
+    }
+    if (ftruncate(fd, size) < 0) {
+      error = std::string("Failed to size shared memory: ") + strerror(errno);
+      close(fd);
+      shm_unlink(name);
+      return nullptr;
+    }
+  } else {
+    struct stat st;
+    fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+      error = std::string("Failed to open shared memory: ") + strerror(errno);
+      return nullptr;
+    }
+    if ((fstat(fd, &st) < 0) || (st.st_size < (off_t) headerBytes)) {
+      error = "Shared memory is not a beam coder frame ring.";
+      close(fd);
+      return nullptr;
+    }
+    size = st.st_size;
+  }
+
+  void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    error = std::string("Failed to map shared memory: ") + strerror(errno);
+    if (create) shm_unlink(name);
+    return nullptr;
+  }
+
+  ringHeader* header = (ringHeader*) base;
+  if (create) {
+    header->version = RING_VERSION;
+    header->slots = slots;
+    header->reserved = 0;
+    header->slotSize = ringAlign(slotSize);
+    header->slotStride = slotStride;
+    new (&header->writeSeq) std::atomic<uint64_t>(0);
+    new (&header->readSeq) std::atomic<uint64_t>(0);
+    for ( uint32_t x = 0 ; x < slots ; x++ ) {
+      ringSlot* s = (ringSlot*) (((uint8_t*) base) + headerBytes + x * slotStride);
+      new (&s->state) std::atomic<uint32_t>(RING_SLOT_FREE);
+    }
+    // Openers check the magic number, so it is set last
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = RING_MAGIC;
+  } else {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if ((header->magic != RING_MAGIC) || (header->version != RING_VERSION) ||
+        (header->slotStride < ringAlign(sizeof(ringSlot)) + header->slotSize) ||
+        (headerBytes + header->slots * header->slotStride > size)) {
+      error = "Shared memory is not a beam coder frame ring.";
+      munmap(base, size);
+      return nullptr;
+    }
+  }
+  return new FrameRing(name, base, size);
+#endif
+}
+
+bool FrameRing::unlink(const char* name) {
+#ifdef _WIN32
+  return false;
+#else
+  return shm_unlink(name) == 0;
+#endif
+}
+
+FrameRing::~FrameRing() {
+#ifndef _WIN32
+  munmap(mBase, mSize);
+#endif
+}
+
+ringSlot* FrameRing::slot(uint64_t seq) {
+  return (ringSlot*) (((uint8_t*) mBase) + ringAlign(sizeof(ringHeader)) +
+    (seq % mHeader->slots) * mHeader->slotStride);
+}
+
+uint64_t FrameRing::readable() {
+  return mHeader->writeSeq.load(std::memory_order_acquire) -
+    mHeader->readSeq.load(std::memory_order_acquire);
+}
+
+int FrameRing::write(AVFrame* frame, std::string& error) {
+  uint64_t seq = mHeader->writeSeq.load(std::memory_order_relaxed);
+  if (seq - mHeader->readSeq.load(std::memory_order_acquire) >= mHeader->slots) return 0;
+  ringSlot* s = slot(seq);
+  uint32_t expected = RING_SLOT_FREE;
+  // Slots are only free once the reader has released their frames
+  if (!s->state.compare_exchange_strong(expected, RING_SLOT_WRITING, std::memory_order_acquire))
+    return 0;
+
+  uint8_t* base = slotData(s);
+  uint8_t* planes[RING_MAX_PLANES] = { nullptr };
+  uint64_t dataSize = 0;
+  int ret = 0;
+  memset(s->linesize, 0, sizeof(s->linesize));
+  memset(s->offset, 0, sizeof(s->offset));
+  s->planes = 0;
+
+  if (frame->nb_samples > 0) {
+    AVSampleFormat fmt = (AVSampleFormat) frame->format;
+    int linesize;
+    int size = av_samples_get_buffer_size(&linesize, frame->channels, frame->nb_samples,
+      fmt, RING_ALIGN);
+    int count = av_sample_fmt_is_planar(fmt) ? frame->channels : 1;
+    if ((size < 0) || (count > RING_MAX_PLANES)) {
+      error = "Frame ring cannot hold audio with this format or channel count.";
+      ret = AVERROR(EINVAL);
+      goto fail;
+    }
+    dataSize = size;
+    if (dataSize + AV_INPUT_BUFFER_PADDING_SIZE > mHeader->slotSize) goto tooLarge;
+    for ( int p = 0 ; p < count ; p++ ) {
+      s->offset[p] = (uint64_t) p * linesize;
+      s->linesize[p] = linesize;
+      planes[p] = base + s->offset[p];
+    }
+    s->planes = count;
+    av_samples_copy(planes, frame->extended_data, 0, 0, frame->nb_samples,
+      frame->channels, fmt);
+    s->mediaType = AVMEDIA_TYPE_AUDIO;
+  } else if ((frame->width > 0) && (frame->height > 0)) {
+    AVPixelFormat fmt = (AVPixelFormat) frame->format;
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(fmt);
+    int linesizes[4];
+    ptrdiff_t strides[4];
+    size_t sizes[4];
+    if ((desc == nullptr) || (desc->flags & AV_PIX_FMT_FLAG_HWACCEL)) {
+      error = "Frame ring can only hold software video frames.";
+      ret = AVERROR(EINVAL);
+      goto fail;
+    }
+    if ((ret = av_image_fill_linesizes(linesizes, fmt, frame->width)) < 0) goto avFail;
+    for ( int p = 0 ; p < 4 ; p++ ) strides[p] = ringAlign(linesizes[p]);
+    if ((ret = av_image_fill_plane_sizes(sizes, fmt, frame->height, strides)) < 0) goto avFail;
+    for ( int p = 0 ; (p < 4) && (sizes[p] > 0) ; p++ ) {
+      s->offset[p] = dataSize;
+      s->linesize[p] = (int) strides[p];
+      dataSize = ringAlign(dataSize + sizes[p]);
+      s->planes++;
+    }
+    if (dataSize + AV_INPUT_BUFFER_PADDING_SIZE > mHeader->slotSize) goto tooLarge;
+    for ( int p = 0 ; p < s->planes ; p++ ) planes[p] = base + s->offset[p];
+    av_image_copy(planes, s->linesize, (const uint8_t**) frame->data, frame->linesize,
+      fmt, frame->width, frame->height);
+    s->mediaType = AVMEDIA_TYPE_VIDEO;
+  } else {
+    error = "Frame ring can only hold frames with data.";
+    ret = AVERROR(EINVAL);
+    goto fail;
+  }
+
+  s->dataSize = dataSize;
+  s->format = frame->format;
+  s->width = frame->width;
+  s->height = frame->height;
+  s->nbSamples = frame->nb_samples;
+  s->sampleRate = frame->sample_rate;
+  s->channels = frame->channels;
+  s->channelLayout = frame->channel_layout;
+  s->pts = frame->pts;
+  s->pktDts = frame->pkt_dts;
+  s->bestEffortTimestamp = frame->best_effort_timestamp;
+  s->pktDuration = frame->pkt_duration;
+  s->keyFrame = frame->key_frame;
+  s->pictType = frame->pict_type;
+  s->sarNum = frame->sample_aspect_ratio.num;
+  s->sarDen = frame->sample_aspect_ratio.den;
+  s->colorRange = frame->color_range;
+  s->colorPrimaries = frame->color_primaries;
+  s->colorTrc = frame->color_trc;
+  s->colorspace = frame->colorspace;
+  s->chromaLocation = frame->chroma_location;
+
+  s->state.store(RING_SLOT_READY, std::memory_order_release);
+  mHeader->writeSeq.store(seq + 1, std::memory_order_release);
+  return 1;
+
+tooLarge:
+  error = "Frame is too large for a frame ring slot.";
+  ret = AVERROR(ENOSPC);
+  goto fail;
+avFail:
+  error = avErrorMsg("Problem laying out frame for a frame ring: ", ret);
+fail:
+  s->state.store(RING_SLOT_FREE, std::memory_order_release);
+  return ret;
+}
+
+// Layout of the planes in a slot, copied out of shared memory once so that
+// the writing process cannot change it after it has been checked
+struct slotLayout {
+  int32_t mediaType;
+  int32_t format;
+  int32_t width;
+  int32_t height;
+  int32_t nbSamples;
+  int32_t channels;
+  int32_t planes;
+  int32_t linesize[RING_MAX_PLANES];
+  uint64_t offset[RING_MAX_PLANES];
+  uint64_t dataSize;
+};
+
+// The slot header comes from another process, so check that every plane it
+// describes lies inside the slot before the frame is wrapped
+static bool slotLayoutValid(const slotLayout& l, uint64_t slotSize) {
+  uint64_t planeSize[RING_MAX_PLANES] = { 0 };
+  if ((l.planes <= 0) || (l.planes > RING_MAX_PLANES) || (l.dataSize > slotSize))
+    return false;
+
+  if (l.mediaType == AVMEDIA_TYPE_AUDIO) {
+    AVSampleFormat fmt = (AVSampleFormat) l.format;
+    int bytes = av_get_bytes_per_sample(fmt);
+    if ((bytes <= 0) || (l.nbSamples <= 0) || (l.channels <= 0) ||
+        (l.planes != (av_sample_fmt_is_planar(fmt) ? l.channels : 1))) return false;
+    int64_t lineBytes = (int64_t) l.nbSamples * bytes *
+      (av_sample_fmt_is_planar(fmt) ? 1 : l.channels);
+    for ( int p = 0 ; p < l.planes ; p++ ) {
+      if (l.linesize[p] < lineBytes) return false;
+      planeSize[p] = (uint64_t) l.linesize[p];
+    }
+  } else if (l.mediaType == AVMEDIA_TYPE_VIDEO) {
+    AVPixelFormat fmt = (AVPixelFormat) l.format;
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(fmt);
+    ptrdiff_t strides[4] = { 0 };
+    size_t sizes[4] = { 0 };
+    if ((desc == nullptr) || (desc->flags & AV_PIX_FMT_FLAG_HWACCEL) ||
+        (av_image_check_size(l.width, l.height, 0, nullptr) < 0) ||
+        (l.planes > 4)) return false;
+    for ( int p = 0 ; p < l.planes ; p++ ) {
+      if (l.linesize[p] < av_image_get_linesize(fmt, l.width, p)) return false;
+      strides[p] = l.linesize[p];
+    }
+    // As laid out by write, with a plane for each non-zero size
+    if (av_image_fill_plane_sizes(sizes, fmt, l.height, strides) < 0) return false;
+    for ( int p = 0 ; p < 4 ; p++ ) {
+      if ((p < l.planes) != (sizes[p] > 0)) return false;
+      if (p < l.planes) planeSize[p] = sizes[p];
+    }
+  } else {
+    return false;
+  }
+
+  for ( int p = 0 ; p < l.planes ; p++ ) {
+    if ((l.offset[p] > l.dataSize) || (planeSize[p] > l.dataSize - l.offset[p]))
+      return false;
+  }
+  return true;
+}
+
+AVFrame* FrameRing::read(std::string& error) {
+  uint64_t seq = mHeader->readSeq.load(std::memory_order_relaxed);
+  if (seq == mHeader->writeSeq.load(std::memory_order_acquire)) return nullptr;
+  ringSlot* s = slot(seq);
+  uint32_t expected = RING_SLOT_READY;
+  if (!s->state.compare_exchange_strong(expected, RING_SLOT_READING, std::memory_order_acquire))
+    return nullptr;
+
+  slotLayout l;
+  l.mediaType = s->mediaType;
+  l.format = s->format;
+  l.width = s->width;
+  l.height = s->height;
+  l.nbSamples = s->nbSamples;
+  l.channels = s->channels;
+  l.planes = s->planes;
+  memcpy(l.linesize, s->linesize, sizeof(l.linesize));
+  memcpy(l.offset, s->offset, sizeof(l.offset));
+  l.dataSize = s->dataSize;
+  if (!slotLayoutValid(l, mHeader->slotSize)) {
+    s->state.store(RING_SLOT_FREE, std::memory_order_release);
+    mHeader->readSeq.store(seq + 1, std::memory_order_release);
+    error = "Frame ring slot does not describe a frame that fits in it, so was dropped.";
+    return nullptr;
+  }
+
+  AVFrame* frame = av_frame_alloc();
+  ringRelease* r = new ringRelease;
+  r->ring = this;
+  r->slot = s;
+  uint8_t* base = slotData(s);
+  if (frame != nullptr) {
+    // Read-only, so that writers make their own copy rather than changing the slot
+    frame->buf[0] = av_buffer_create(base, l.dataSize, slotFree, r, AV_BUFFER_FLAG_READONLY);
+  }
+  if ((frame == nullptr) || (frame->buf[0] == nullptr)) {
+    av_frame_free(&frame);
+    delete r;
+    s->state.store(RING_SLOT_READY, std::memory_order_release);
+    return nullptr;
+  }
+  retain();
+
+  for ( int p = 0 ; p < l.planes ; p++ ) {
+    frame->data[p] = base + l.offset[p];
+    frame->linesize[p] = l.linesize[p];
+  }
+  frame->format = l.format;
+  frame->width = (l.mediaType == AVMEDIA_TYPE_VIDEO) ? l.width : 0;
+  frame->height = (l.mediaType == AVMEDIA_TYPE_VIDEO) ? l.height : 0;
+  frame->nb_samples = (l.mediaType == AVMEDIA_TYPE_AUDIO) ? l.nbSamples : 0;
+  frame->sample_rate = s->sampleRate;
+  frame->channels = l.channels;
+  frame->channel_layout = s->channelLayout;
+  frame->pts = s->pts;
+  frame->pkt_dts = s->pktDts;
+  frame->best_effort_timestamp = s->bestEffortTimestamp;
+  frame->pkt_duration = s->pktDuration;
+  frame->key_frame = s->keyFrame;
+  frame->pict_type = (AVPictureType) s->pictType;
+  frame->sample_aspect_ratio = av_make_q(s->sarNum, s->sarDen);
+  frame->color_range = (AVColorRange) s->colorRange;
+  frame->color_primaries = (AVColorPrimaries) s->colorPrimaries;
+  frame->color_trc = (AVColorTransferCharacteristic) s->colorTrc;
+  frame->colorspace = (AVColorSpace) s->colorspace;
+  frame->chroma_location = (AVChromaLocation) s->chromaLocation;
+
+  mHeader->readSeq.store(seq + 1, std::memory_order_release);
+  return frame;
+}
+
+bool FrameRing::holds(const AVFrame* frame) {
+  uint8_t* base = (uint8_t*) mBase;
+  return (frame->buf[0] != nullptr) && (frame->buf[0]->data >= base) &&
+    (frame->buf[0]->data < base + mSize);
+}
+
+bool FrameRing::release(AVFrame* frame, int unusedRefs) {
+  if (!holds(frame)) return false;
+  ringRelease* r = (ringRelease*) av_buffer_get_opaque(frame->buf[0]);
+  // An encoder, filter or transfer handle may still be reading the slot
+  bool now = av_buffer_get_ref_count(frame->buf[0]) == 1 + unusedRefs;
+  if (now && !r->released.exchange(true))
+    r->slot->state.store(RING_SLOT_FREE, std::memory_order_release);
+  av_frame_unref(frame);
+  return now;
+}
+
+void FrameRing::slotFree(void* opaque, uint8_t* data) {
+  ringRelease* r = (ringRelease*) opaque;
+  if (!r->released.exchange(true))
+    r->slot->state.store(RING_SLOT_FREE, std::memory_order_release);
+  r->ring->release();
+  delete r;
+}
+
+// Javascript side of a ring, cleared by close
+struct frameRingRef {
+  FrameRing* ring = nullptr;
+  std::string name;
+};
+
+static void frameRingFinalizer(napi_env env, void* data, void* hint) {
+  frameRingRef* ref = (frameRingRef*) data;
+  if (ref->ring != nullptr) ref->ring->release();
+  delete ref;
+}
+
+static frameRingRef* getRingRef(napi_env env, napi_callback_info info,
+    size_t* argc, napi_value* args) {
+  frameRingRef* ref = nullptr;
+  if (napi_get_cb_info(env, info, argc, args, nullptr, (void**) &ref) != napi_ok) return nullptr;
+  return ref;
+}
+
+napi_value ringWrite(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result, value;
+  frameData* f;
+  bool hasFrame = false;
+  std::string error;
+
+  size_t argc = 1;
+  napi_value args[1];
+  frameRingRef* ref = getRingRef(env, info, &argc, args);
+  if ((ref == nullptr) || (ref->ring == nullptr)) {
+    NAPI_THROW_ERROR("Frame ring is closed.");
+  }
+  if (argc >= 1) {
+    status = napi_has_named_property(env, args[0], "_frame", &hasFrame);
+    if (status == napi_object_expected) hasFrame = false;
+    else CHECK_STATUS;
+  }
+  if (!hasFrame) {
+    NAPI_THROW_ERROR("Frame ring write requires a frame.");
+  }
+  status = napi_get_named_property(env, args[0], "_frame", &value);
+  CHECK_STATUS;
+  status = napi_get_value_external(env, value, (void**) &f);
+  CHECK_STATUS;
+
+  int ret = ref->ring->write(f->frame, error);
+  if (ret < 0) {
+    NAPI_THROW_ERROR(error.c_str());
+  }
+  status = napi_get_boolean(env, ret > 0, &result);
+  CHECK_STATUS;
+  return result;
+}
+
+napi_value ringRead(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result;
+  size_t argc = 0;
+
+  frameRingRef* ref = getRingRef(env, info, &argc, nullptr);
+  if ((ref == nullptr) || (ref->ring == nullptr)) {
+    NAPI_THROW_ERROR("Frame ring is closed.");
+  }
+  std::string error;
+  AVFrame* frame = ref->ring->read(error);
+  if (!error.empty()) {
+    NAPI_THROW_ERROR(error.c_str());
+  }
+  if (frame == nullptr) {
+    status = napi_get_null(env, &result);
+    CHECK_STATUS;
+    return result;
+  }
+  frameData* f = new frameData;
+  f->frame = frame;
+  status = fromAVFrame(env, f, &result);
+  CHECK_STATUS;
+  return result;
+}
+
+napi_value ringRelease(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result, value;
+  frameData* f;
+  bool hasFrame = false;
+
+  size_t argc = 1;
+  napi_value args[1];
+  frameRingRef* ref = getRingRef(env, info, &argc, args);
+  if ((ref == nullptr) || (ref->ring == nullptr)) {
+    NAPI_THROW_ERROR("Frame ring is closed.");
+  }
+  if (argc >= 1) {
+    status = napi_has_named_property(env, args[0], "_frame", &hasFrame);
+    if (status == napi_object_expected) hasFrame = false;
+    else CHECK_STATUS;
+  }
+  if (!hasFrame) {
+    NAPI_THROW_ERROR("Frame ring release requires a frame.");
+  }
+  status = napi_get_named_property(env, args[0], "_frame", &value);
+  CHECK_STATUS;
+  status = napi_get_value_external(env, value, (void**) &f);
+  CHECK_STATUS;
+
+  if (!ref->ring->holds(f->frame)) {
+    NAPI_THROW_ERROR("Frame was not read from this frame ring, or has already been released.");
+  }
+  // Plane Buffers already handed out would otherwise see the next frame
+  int unusedRefs;
+  status = detachFrameData(env, f, &unusedRefs);
+  CHECK_STATUS;
+  bool now = ref->ring->release(f->frame, unusedRefs);
+  status = napi_get_boolean(env, now, &result);
+  CHECK_STATUS;
+  return result;
+}
+
+napi_value ringReadable(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result;
+  size_t argc = 0;
+
+  frameRingRef* ref = getRingRef(env, info, &argc, nullptr);
+  if ((ref == nullptr) || (ref->ring == nullptr)) {
+    NAPI_THROW_ERROR("Frame ring is closed.");
+  }
+  status = napi_create_int64(env, ref->ring->readable(), &result);
+  CHECK_STATUS;
+  return result;
+}
+
+napi_value ringClose(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result;
+  size_t argc = 0;
+
+  frameRingRef* ref = getRingRef(env, info, &argc, nullptr);
+  // Frames already read keep the mapping until they are released
+  if ((ref != nullptr) && (ref->ring != nullptr)) {
+    ref->ring->release();
+    ref->ring = nullptr;
+  }
+  status = napi_get_undefined(env, &result);
+  CHECK_STATUS;
+  return result;
+}
+
+napi_value ringUnlink(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result;
+  size_t argc = 0;
+
+  frameRingRef* ref = getRingRef(env, info, &argc, nullptr);
+  if (ref == nullptr) {
+    NAPI_THROW_ERROR("Frame ring is not valid.");
+  }
+  status = napi_get_boolean(env, FrameRing::unlink(ref->name.c_str()), &result);
+  CHECK_STATUS;
+  return result;
+}
+
+/*
+  let ring = beamcoder.frameRing({
+    name: '/beamcoder-ring', // POSIX shared memory name
+    create: true, // Create rather than open an existing ring
+    slots: 8, // Number of frame slots, default 8
+    slot_size: 4 << 20 // Bytes per slot, or from width, height and pix_fmt
+  });
+*/
+
+napi_value frameRing(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result, ext;
+  napi_valuetype type;
+  char* name = nullptr;
+  char* pixFmtName = nullptr;
+  bool present, create = false;
+  uint32_t slots = 8, width = 0, height = 0;
+  double slotSize = 0.0;
+  std::string error;
+
+  size_t argc = 1;
+  napi_value args[1];
+  status = napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+  CHECK_STATUS;
+  if (argc >= 1) {
+    status = napi_typeof(env, args[0], &type);
+    CHECK_STATUS;
+  }
+  if ((argc < 1) || (type != napi_object)) {
+    NAPI_THROW_ERROR("Frame ring requires an options object.");
+  }
+  status = beam_get_string_utf8(env, args[0], "name", &name);
+  CHECK_STATUS;
+  if (name == nullptr) {
+    NAPI_THROW_ERROR("Frame ring requires a shared memory name.");
+  }
+  frameRingRef* ref = new frameRingRef;
+  ref->name = name;
+  free(name);
+
+  status = beam_get_bool(env, args[0], "create", &present, &create);
+  CHECK_STATUS;
+  status = beam_get_uint32(env, args[0], "slots", &slots);
+  CHECK_STATUS;
+  status = beam_get_double(env, args[0], "slot_size", &slotSize);
+  CHECK_STATUS;
+  if (create && (slotSize <= 0.0)) {
+    // Sized from a picture, with room for plane alignment and padding
+    status = beam_get_uint32(env, args[0], "width", &width);
+    CHECK_STATUS;
+    status = beam_get_uint32(env, args[0], "height", &height);
+    CHECK_STATUS;
+    status = beam_get_string_utf8(env, args[0], "pix_fmt", &pixFmtName);
+    CHECK_STATUS;
+    AVPixelFormat fmt = (pixFmtName != nullptr) ? av_get_pix_fmt(pixFmtName) : AV_PIX_FMT_NONE;
+    free(pixFmtName);
+    int size = av_image_get_buffer_size(fmt, width, height, RING_ALIGN);
+    if (size > 0) slotSize = size + 4 * RING_ALIGN + AV_INPUT_BUFFER_PADDING_SIZE;
+  }
+  if (create && (slotSize <= 0.0)) {
+    delete ref;
+    NAPI_THROW_ERROR("Frame ring creation requires a slot_size, or width, height and pix_fmt.");
+  }
+
+  ref->ring = FrameRing::open(ref->name.c_str(), create, slots, (uint64_t) slotSize, error);
+  if (ref->ring == nullptr) {
+    delete ref;
+    NAPI_THROW_ERROR(error.c_str());
+  }
+  status = napi_create_external(env, ref, frameRingFinalizer, nullptr, &ext);
+  CHECK_STATUS;
+
+  status = napi_create_object(env, &result);
+  CHECK_STATUS;
+  status = beam_set_string_utf8(env, result, "type", "FrameRing");
+  CHECK_STATUS;
+  status = beam_set_string_utf8(env, result, "name", ref->name.c_str());
+  CHECK_STATUS;
+  status = beam_set_uint32(env, result, "slots", ref->ring->slots());
+  CHECK_STATUS;
+  status = beam_set_double(env, result, "slot_size", (double) ref->ring->slotSize());
+  CHECK_STATUS;
+
+  napi_property_descriptor desc[] = {
+    { "write", nullptr, ringWrite, nullptr, nullptr, nullptr, napi_enumerable, ref },
+    { "read", nullptr, ringRead, nullptr, nullptr, nullptr, napi_enumerable, ref },
+    { "release", nullptr, ringRelease, nullptr, nullptr, nullptr, napi_enumerable, ref },
+    { "readable", nullptr, ringReadable, nullptr, nullptr, nullptr, napi_enumerable, ref },
+    { "close", nullptr, ringClose, nullptr, nullptr, nullptr, napi_enumerable, ref },
+    { "unlink", nullptr, ringUnlink, nullptr, nullptr, nullptr, napi_enumerable, ref },
+    { "_frameRing", nullptr, nullptr, nullptr, nullptr, ext, napi_default, nullptr }
+  };
+  status = napi_define_properties(env, result, 7, desc);
+  CHECK_STATUS;
+  return result;
+}
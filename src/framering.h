@@ -0,0 +1,135 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#ifndef FRAMERING_H
+#define FRAMERING_H
+
+#include "node_api.h"
+#include "beamcoder_util.h"
+#include <atomic>
+#include <string>
+
+extern "C" {
+  #include <libavutil/frame.h>
+}
+
+#define RING_MAGIC 0x474e5242 // "BRNG"
+#define RING_VERSION 1
+#define RING_ALIGN 64
+#define RING_MAX_PLANES 8
+
+enum ringSlotState : uint32_t {
+  RING_SLOT_FREE = 0,
+  RING_SLOT_WRITING,
+  RING_SLOT_READY,
+  RING_SLOT_READING
+};
+
+// Control header at the start of each slot, describing the frame in it.
+// Laid out the same in every process using the same build of beam coder.
+struct ringSlot {
+  std::atomic<uint32_t> state;
+  int32_t mediaType;
+  int32_t format;
+  int32_t width;
+  int32_t height;
+  int32_t nbSamples;
+  int32_t sampleRate;
+  int32_t channels;
+  uint64_t channelLayout;
+  int64_t pts;
+  int64_t pktDts;
+  int64_t bestEffortTimestamp;
+  int64_t pktDuration;
+  int32_t keyFrame;
+  int32_t pictType;
+  int32_t sarNum;
+  int32_t sarDen;
+  int32_t colorRange;
+  int32_t colorPrimaries;
+  int32_t colorTrc;
+  int32_t colorspace;
+  int32_t chromaLocation;
+  int32_t planes;
+  int32_t linesize[RING_MAX_PLANES];
+  uint64_t offset[RING_MAX_PLANES];
+  uint64_t dataSize;
+};
+
+// Header at the start of the shared memory. Slots are used in sequence, with
+// one writing process and one reading process.
+struct ringHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t slots;
+  uint32_t reserved;
+  uint64_t slotSize; // bytes of plane data per slot
+  uint64_t slotStride; // bytes from one slot header to the next
+  std::atomic<uint64_t> writeSeq;
+  std::atomic<uint64_t> readSeq;
+};
+
+// A ring of frame slots in POSIX shared memory. Frames are copied in by the
+// writer and wrapped in place by the reader, with a slot returning to the
+// writer when the reader releases its frame or the last reference to the
+// frame's data goes, whichever is first.
+class FrameRing {
+public:
+  static FrameRing* open(const char* name, bool create, uint32_t slots,
+    uint64_t slotSize, std::string& error);
+  static bool unlink(const char* name);
+  // 1 when written, 0 when the next slot is still in use, negative on error
+  int write(AVFrame* frame, std::string& error);
+  // The next frame, or nullptr when none is ready. A slot that does not
+  // describe a frame fitting inside it is dropped, with error set.
+  AVFrame* read(std::string& error);
+  // Whether the frame's data is in a slot of this ring
+  bool holds(const AVFrame* frame);
+  // Empty a read frame, returning its slot to the writer now rather than
+  // when it is garbage collected. The slot is only returned now when nothing
+  // but the frame and the given number of unused references holds its data,
+  // otherwise it returns when the last reference goes. True if returned now.
+  bool release(AVFrame* frame, int unusedRefs);
+  uint64_t readable();
+  uint32_t slots() { return mHeader->slots; }
+  uint64_t slotSize() { return mHeader->slotSize; }
+  const std::string& name() { return mName; }
+  void retain() { mRefs++; }
+  void release() { if (--mRefs == 0) delete this; }
+
+private:
+  FrameRing(const std::string& name, void* base, size_t size)
+    : mName(name), mBase(base), mSize(size), mHeader((ringHeader*) base) { }
+  ~FrameRing();
+  ringSlot* slot(uint64_t seq);
+  uint8_t* slotData(ringSlot* s) { return ((uint8_t*) s) + RING_ALIGN * ((sizeof(ringSlot) + RING_ALIGN - 1) / RING_ALIGN); }
+  static void slotFree(void* opaque, uint8_t* data);
+
+  std::string mName;
+  void* mBase;
+  size_t mSize;
+  ringHeader* mHeader;
+  std::atomic<int> mRefs{1};
+};
+
+napi_value frameRing(napi_env env, napi_callback_info info);
+
+#endif // FRAMERING_H
@@ -0,0 +1,70 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#include "instance.h"
+#include "log.h"
+
+extern "C" {
+  #include <libavformat/avformat.h>
+}
+
+static thread_local beamInstance* threadInstance = nullptr;
+
+// Runs as the environment is torn down, before its instance data is finalized
+static void instanceCleanup(void* arg) {
+  beamInstance* instance = (beamInstance*) arg;
+  logDetach(instance);
+  avformat_network_deinit();
+  if (threadInstance == instance) threadInstance = nullptr;
+}
+
+static void instanceFinalizer(napi_env env, void* data, void* hint) {
+  delete (beamInstance*) data;
+}
+
+napi_status initInstance(napi_env env) {
+  napi_status status;
+  beamInstance* instance = new beamInstance;
+  instance->env = env;
+  instance->logLevel = av_log_get_level();
+  status = napi_set_instance_data(env, instance, instanceFinalizer, nullptr);
+  if (status != napi_ok) {
+    delete instance;
+    return status;
+  }
+  status = napi_add_env_cleanup_hook(env, instanceCleanup, instance);
+  PASS_STATUS;
+
+  threadInstance = instance;
+  logAttach(instance);
+  avformat_network_init();
+  return napi_ok;
+}
+
+beamInstance* getInstance(napi_env env) {
+  void* data = nullptr;
+  if (napi_get_instance_data(env, &data) != napi_ok) return nullptr;
+  return (beamInstance*) data;
+}
+
+beamInstance* currentInstance() {
+  return threadInstance;
+}
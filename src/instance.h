@@ -0,0 +1,42 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include "node_api.h"
+
+// State for each environment that loads the addon, being the main thread or
+// one of its worker threads. Held as the environment's instance data.
+struct beamInstance {
+  napi_env env = nullptr;
+  // Delivers FFmpeg log messages to this environment's callback, when set
+  napi_threadsafe_function logFunction = nullptr;
+  // Most verbose FFmpeg log level wanted by this environment
+  int logLevel = 0;
+};
+
+napi_status initInstance(napi_env env);
+beamInstance* getInstance(napi_env env);
+// Instance of the environment whose Javascript runs on this thread, if any
+beamInstance* currentInstance();
+
+#endif // INSTANCE_H
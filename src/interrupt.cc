@@ -0,0 +1,253 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#include "interrupt.h"
+#include "format.h"
+#include "adaptor.h"
+#include <cstring>
+
+Interrupter* Interrupter::of(const AVFormatContext* fmtCtx) {
+  if ((fmtCtx == nullptr) || (fmtCtx->interrupt_callback.callback != &Interrupter::callback))
+    return nullptr;
+  return (Interrupter*) fmtCtx->interrupt_callback.opaque;
+}
+
+Interrupter* Interrupter::attach(AVFormatContext* fmtCtx) {
+  Interrupter* interrupter = of(fmtCtx);
+  if (interrupter != nullptr) {
+    interrupter->retain();
+    return interrupter;
+  }
+  interrupter = new Interrupter;
+  interrupter->install(fmtCtx);
+  return interrupter;
+}
+
+int Interrupter::callback(void* opaque) {
+  Interrupter* interrupter = (Interrupter*) opaque;
+  if (interrupter->mCancelled) return 1;
+  int64_t deadline = interrupter->mDeadline;
+  if ((deadline > 0) && (av_gettime_relative() > deadline)) {
+    interrupter->mTimedOut = true;
+    return 1;
+  }
+  return 0;
+}
+
+void Interrupter::install(AVFormatContext* fmtCtx) {
+  fmtCtx->interrupt_callback.callback = &Interrupter::callback;
+  fmtCtx->interrupt_callback.opaque = this;
+}
+
+void Interrupter::begin() {
+  int64_t timeout = mTimeout;
+  mTimedOut = false;
+  mDeadline = (timeout > 0) ? av_gettime_relative() + timeout : 0;
+}
+
+char* interruptErrorMsg(const Interrupter* interrupter, const char* base, int avError) {
+  const char* cause = nullptr;
+  if (interrupter != nullptr) {
+    if (interrupter->cancelled())
+      cause = "operation cancelled.";
+    else if (interrupter->timedOut())
+      cause = "operation timed out.";
+  }
+  if (cause == nullptr) return avErrorMsg(base, avError);
+
+  char* both = (char*) malloc(sizeof(char) * (strlen(base) + strlen(cause) + 1));
+  strcpy(both, base);
+  strcat(both, cause);
+  return both;
+}
+
+void abortListenerFinalizer(napi_env env, void* data, void* hint) {
+  ((Interrupter*) data)->release();
+}
+
+napi_value abortListener(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result;
+  Interrupter* interrupter;
+
+  size_t argc = 0;
+  status = napi_get_cb_info(env, info, &argc, nullptr, nullptr, (void**) &interrupter);
+  CHECK_STATUS;
+  interrupter->cancel();
+
+  status = napi_get_undefined(env, &result);
+  CHECK_STATUS;
+  return result;
+}
+
+napi_status getInterruptOptions(napi_env env, napi_value options,
+    Interrupter* interrupter, bool* aborted) {
+  napi_status status;
+  napi_value signal, addListener, listener, args[2];
+  napi_valuetype type;
+  double timeout = 0.0;
+  bool present, isAborted = false;
+
+  *aborted = false;
+  status = beam_get_double(env, options, "timeout", &timeout);
+  PASS_STATUS;
+  interrupter->setTimeout((int64_t) (timeout * 1000.0));
+
+  status = napi_get_named_property(env, options, "signal", &signal);
+  PASS_STATUS;
+  status = napi_typeof(env, signal, &type);
+  PASS_STATUS;
+  if ((type == napi_undefined) || (type == napi_null)) return napi_ok;
+  if (type != napi_object) return napi_object_expected;
+
+  status = beam_get_bool(env, signal, "aborted", &present, &isAborted);
+  PASS_STATUS;
+  if (isAborted) {
+    interrupter->cancel();
+    *aborted = true;
+    return napi_ok;
+  }
+
+  status = napi_get_named_property(env, signal, "addEventListener", &addListener);
+  PASS_STATUS;
+  status = napi_typeof(env, addListener, &type);
+  PASS_STATUS;
+  if (type != napi_function) return napi_function_expected;
+
+  // The listener holds a reference as the signal may outlive the format
+  status = napi_create_function(env, "abort", NAPI_AUTO_LENGTH, abortListener,
+    interrupter, &listener);
+  PASS_STATUS;
+  status = napi_wrap(env, listener, interrupter, abortListenerFinalizer, nullptr, nullptr);
+  PASS_STATUS;
+  interrupter->retain();
+
+  status = napi_create_string_utf8(env, "abort", NAPI_AUTO_LENGTH, &args[0]);
+  PASS_STATUS;
+  args[1] = listener;
+  return napi_call_function(env, signal, addListener, 2, args, nullptr);
+}
+
+napi_value cancelFormat(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result, formatJS, formatRefExt, adaptorExt;
+  fmtCtxRef* fmtRef;
+  Adaptor* adaptor;
+
+  size_t argc = 0;
+  status = napi_get_cb_info(env, info, &argc, nullptr, &formatJS, nullptr);
+  CHECK_STATUS;
+  status = napi_get_named_property(env, formatJS, "_formatContextRef", &formatRefExt);
+  CHECK_STATUS;
+  status = napi_get_value_external(env, formatRefExt, (void**) &fmtRef);
+  CHECK_STATUS;
+  status = napi_get_named_property(env, formatJS, "_adaptor", &adaptorExt);
+  CHECK_STATUS;
+  status = napi_get_value_external(env, adaptorExt, (void**) &adaptor);
+  CHECK_STATUS;
+
+  if (fmtRef->interrupter != nullptr) fmtRef->interrupter->cancel();
+  // A governed demuxer waits on its adaptor rather than in FFmpeg IO
+  if ((adaptor != nullptr) && (fmtRef->fmtCtx != nullptr) &&
+      (fmtRef->fmtCtx->iformat != nullptr))
+    adaptor->finish();
+
+  status = napi_get_undefined(env, &result);
+  CHECK_STATUS;
+  return result;
+}
+
+napi_value getFormatCancelled(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result;
+  Interrupter* interrupter;
+
+  status = napi_get_cb_info(env, info, 0, nullptr, nullptr, (void**) &interrupter);
+  CHECK_STATUS;
+  status = napi_get_boolean(env, interrupter->cancelled(), &result);
+  CHECK_STATUS;
+  return result;
+}
+
+napi_value getFormatTimeout(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result;
+  Interrupter* interrupter;
+
+  status = napi_get_cb_info(env, info, 0, nullptr, nullptr, (void**) &interrupter);
+  CHECK_STATUS;
+  status = napi_create_double(env, interrupter->timeout() / 1000.0, &result);
+  CHECK_STATUS;
+  return result;
+}
+
+napi_value setFormatTimeout(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result;
+  napi_valuetype type;
+  Interrupter* interrupter;
+  double timeout = 0.0;
+
+  size_t argc = 1;
+  napi_value args[1];
+
+  status = napi_get_cb_info(env, info, &argc, args, nullptr, (void**) &interrupter);
+  CHECK_STATUS;
+  if (argc != 1) {
+    NAPI_THROW_ERROR("Format timeout must be set with a value.");
+  }
+  status = napi_typeof(env, args[0], &type);
+  CHECK_STATUS;
+  if (type == napi_number) {
+    status = napi_get_value_double(env, args[0], &timeout);
+    CHECK_STATUS;
+  } else if ((type != napi_null) && (type != napi_undefined)) {
+    NAPI_THROW_ERROR("Format timeout must be set with a number of milliseconds or null.");
+  }
+  if (timeout < 0.0) {
+    NAPI_THROW_ERROR("Format timeout cannot be negative.");
+  }
+  interrupter->setTimeout((int64_t) (timeout * 1000.0));
+
+  status = napi_get_undefined(env, &result);
+  CHECK_STATUS;
+  return result;
+}
+
+napi_status defineInterruptControls(napi_env env, napi_value jsFmtCtx) {
+  napi_status status;
+  napi_value formatRefExt;
+  fmtCtxRef* fmtRef;
+
+  status = napi_get_named_property(env, jsFmtCtx, "_formatContextRef", &formatRefExt);
+  PASS_STATUS;
+  status = napi_get_value_external(env, formatRefExt, (void**) &fmtRef);
+  PASS_STATUS;
+
+  napi_property_descriptor desc[] = {
+    { "cancel", nullptr, cancelFormat, nullptr, nullptr, nullptr, napi_writable, nullptr },
+    { "cancelled", nullptr, nullptr, getFormatCancelled, nop, nullptr,
+       napi_default, fmtRef->interrupter },
+    { "timeout", nullptr, nullptr, getFormatTimeout, setFormatTimeout, nullptr,
+       napi_default, fmtRef->interrupter }
+  };
+  return napi_define_properties(env, jsFmtCtx, 3, desc);
+}
@@ -0,0 +1,98 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#ifndef INTERRUPT_H
+#define INTERRUPT_H
+
+#include "node_api.h"
+#include "beamcoder_util.h"
+#include <atomic>
+
+extern "C" {
+  #include <libavformat/avformat.h>
+  #include <libavutil/time.h>
+}
+
+// Interrupt callback installed on every format context beam coder creates.
+// Blocking IO returns AVERROR_EXIT once the interrupter is cancelled or when
+// the operation in progress runs past its deadline. Reference counted as it
+// may be held by a format context, a carrier and an abort signal listener.
+class Interrupter {
+public:
+  Interrupter() : mRefs(1), mCancelled(false), mTimedOut(false),
+    mTimeout(0), mDeadline(0) { }
+
+  // The interrupter installed on a format context, if any. No reference taken.
+  static Interrupter* of(const AVFormatContext* fmtCtx);
+  // The interrupter installed on a format context, installing a new one when
+  // there is none. The caller owns one reference.
+  static Interrupter* attach(AVFormatContext* fmtCtx);
+  static int callback(void* opaque);
+
+  void install(AVFormatContext* fmtCtx);
+  void retain() { mRefs++; }
+  void release() { if (--mRefs == 0) delete this; }
+
+  // Cancelling is permanent - later operations fail straight away
+  void cancel() { mCancelled = true; }
+  bool cancelled() const { return mCancelled; }
+  bool timedOut() const { return mTimedOut; }
+  // Limit for each blocking operation in microseconds, zero for none
+  void setTimeout(int64_t timeout) { mTimeout = (timeout > 0) ? timeout : 0; }
+  int64_t timeout() const { return mTimeout; }
+  void begin();
+  void end() { mDeadline = 0; }
+
+private:
+  ~Interrupter() { }
+  std::atomic<int> mRefs;
+  std::atomic<bool> mCancelled;
+  std::atomic<bool> mTimedOut;
+  std::atomic<int64_t> mTimeout;
+  std::atomic<int64_t> mDeadline;
+};
+
+// Applies the interrupter timeout to the blocking calls made in a scope
+class interruptScope {
+public:
+  interruptScope(Interrupter* interrupter) : mInterrupter(interrupter) {
+    if (mInterrupter != nullptr) mInterrupter->begin();
+  }
+  ~interruptScope() { if (mInterrupter != nullptr) mInterrupter->end(); }
+  // Custom IO does not poll the callback, so callers check before starting
+  bool cancelled() const { return (mInterrupter != nullptr) && mInterrupter->cancelled(); }
+private:
+  Interrupter* mInterrupter;
+};
+
+// As avErrorMsg, naming cancellation or a timeout as the cause when it was
+char* interruptErrorMsg(const Interrupter* interrupter, const char* base, int avError);
+
+// Reads the timeout (milliseconds) and signal (an AbortSignal) options
+napi_status getInterruptOptions(napi_env env, napi_value options,
+  Interrupter* interrupter, bool* aborted);
+
+// Adds cancel(), cancelled and timeout to a demuxer or muxer object
+napi_status defineInterruptControls(napi_env env, napi_value jsFmtCtx);
+
+napi_value cancelFormat(napi_env env, napi_callback_info info);
+
+#endif // INTERRUPT_H
@@ -1,6 +1,10 @@
 #include "node_api.h"
 #include <stdio.h>
 #include "log.h"
+#include "instance.h"
+#include <mutex>
+#include <vector>
+#include <algorithm>
 
 
 extern "C" {
@@ -22,6 +26,42 @@ std::unordered_map<int, std::string> beam_logging_level_fmap = {
 
 const beamEnum* beam_logging_level = new beamEnum(beam_logging_level_fmap);
 
+void av_log_custom_callback(void* ptr, int level, const char* fmt, va_list vl);
+
+// Instances of every environment that has loaded the addon. FFmpeg's log
+// level and callback are process-wide, so are shared between them.
+static std::mutex logLock;
+static std::vector<beamInstance*> logInstances;
+
+// Call with logLock held
+static void applyLogSettings() {
+  int level = AV_LOG_QUIET;
+  bool routed = false;
+  for ( auto i : logInstances ) {
+    level = std::max(level, i->logLevel);
+    routed = routed || (i->logFunction != nullptr);
+  }
+  if (!logInstances.empty()) av_log_set_level(level);
+  av_log_set_callback(routed ? av_log_custom_callback : av_log_default_callback);
+}
+
+void logAttach(beamInstance* instance) {
+  std::lock_guard<std::mutex> lk(logLock);
+  logInstances.push_back(instance);
+  applyLogSettings();
+}
+
+void logDetach(beamInstance* instance) {
+  std::lock_guard<std::mutex> lk(logLock);
+  logInstances.erase(std::remove(logInstances.begin(), logInstances.end(), instance),
+    logInstances.end());
+  if (instance->logFunction != nullptr) {
+    napi_release_threadsafe_function(instance->logFunction, napi_tsfn_abort);
+    instance->logFunction = nullptr;
+  }
+  applyLogSettings();
+}
+
 napi_value logging(napi_env env, napi_callback_info info) {
   napi_status status;
   napi_value result;
@@ -34,8 +74,9 @@ napi_value logging(napi_env env, napi_callback_info info) {
   status = napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
   CHECK_STATUS;
 
+  beamInstance* instance = getInstance(env);
   if (argc == 0) {
-    logLevel = av_log_get_level();
+    logLevel = (instance != nullptr) ? instance->logLevel : av_log_get_level();
     status = napi_create_string_utf8(env,
       (char*) beam_lookup_name(beam_logging_level->forward, logLevel),
       NAPI_AUTO_LENGTH, &result);
@@ -66,7 +107,15 @@ napi_value logging(napi_env env, napi_callback_info info) {
     if (logLevel == BEAM_ENUM_UNKNOWN) {
       NAPI_THROW_ERROR("Logging level string unrecognised");
     }
-    av_log_set_level(logLevel);
+    free(logLevelStr);
+    if (instance != nullptr) {
+      // Each environment has its own level, with FFmpeg at the most verbose
+      std::lock_guard<std::mutex> lk(logLock);
+      instance->logLevel = logLevel;
+      applyLogSettings();
+    } else {
+      av_log_set_level(logLevel);
+    }
 
     status = napi_get_undefined(env, &result);
     CHECK_STATUS;
@@ -75,38 +124,35 @@ napi_value logging(napi_env env, napi_callback_info info) {
   return result;
 }
 
-napi_threadsafe_function threadSafeFunction;
-
 // Inspired from https://github.com/FFmpeg/FFmpeg/blob/321a3c244d0a89b2826c38611284cc403a9808fa/libavutil/log.c#L346
 #define LINE_SZ 1024
 void av_log_custom_callback(void* ptr, int level, const char* fmt, va_list vl)
 {
-		int av_log_level = av_log_get_level();
-    static int print_prefix = 1;
-    static int count;
-    static char prev[LINE_SZ];
-    AVBPrint part[4];
+    static thread_local int print_prefix = 1;
     char line[LINE_SZ];
-    static int is_atty;
-    int type[2];
-    unsigned tint = 0;
 
     if (level >= 0) {
-        tint = level & 0xff00;
         level &= 0xff;
     }
 
-    if (level > av_log_level)
+    if (level > av_log_get_level())
         return;
-		av_log_format_line(ptr, level, fmt, vl, line, sizeof(line), &print_prefix);
-		
-		logCarrier* c = new logCarrier;
-		c->msg = line;
-		c->level = level;
-    napi_status status;
-    
-		status = napi_call_threadsafe_function(threadSafeFunction, c, napi_tsfn_nonblocking);	
-
+    av_log_format_line(ptr, level, fmt, vl, line, sizeof(line), &print_prefix);
+
+    // Messages from an environment's own thread go only to that environment.
+    // Messages from shared worker threads cannot be attributed, so go to all.
+    std::lock_guard<std::mutex> lk(logLock);
+    beamInstance* own = currentInstance();
+    bool attributed = (own != nullptr) && (own->logFunction != nullptr);
+    for ( auto i : logInstances ) {
+      if ((i->logFunction == nullptr) || (level > i->logLevel)) continue;
+      if (attributed && (i != own)) continue;
+      logCarrier* c = new logCarrier;
+      c->msg = line;
+      c->level = level;
+      if (napi_call_threadsafe_function(i->logFunction, c, napi_tsfn_nonblocking) != napi_ok)
+        delete c;
+    }
     return;
 }
 
@@ -118,15 +164,22 @@ static void callJsCb(
 	){
 		
   logCarrier* c = (logCarrier*) data;
+  // Pending messages are dropped as the environment closes
+  if ((env == nullptr) || (jsCallback == nullptr)) {
+    delete c;
+    return;
+  }
 	
 	napi_value jsThis;
 	napi_status status;
 
 	status = napi_create_object(env, &jsThis);
+	if (status != napi_ok) delete c;
 	CHECK_STATUS_VOID;
   	
 	napi_value jsStr;
 	status = napi_create_string_utf8(env, c->msg.c_str(), NAPI_AUTO_LENGTH, &jsStr);
+	delete c;
 	CHECK_STATUS_VOID;
 
 	napi_value return_val;
@@ -139,6 +192,7 @@ static void callJsCb(
 napi_value setLoggingCallback(napi_env env, napi_callback_info info){
 
 	napi_status status;
+	napi_threadsafe_function logFunction = nullptr;
 
   napi_value args[1];
   size_t argc = 1;
@@ -154,33 +208,46 @@ napi_value setLoggingCallback(napi_env env, napi_callback_info info){
   status = napi_typeof(env, callback, &t);
   CHECK_STATUS;
 
-  if (t != napi_function) {
+  if ((t != napi_function) && (t != napi_null) && (t != napi_undefined)) {
     status = napi_throw_type_error(env, nullptr, "Callback argument should be a function.");
     return nullptr;
   }
-	
-	napi_value work_name;
-	status = napi_create_string_utf8(env, "Thread-safe Function For Libav Custom Logging", NAPI_AUTO_LENGTH, &work_name);
-	CHECK_STATUS;
-    
-	status = napi_create_threadsafe_function(
-		env,
-    callback,
-    NULL,
-    work_name,
-    0,
-    1,
-    nullptr,
-    nullptr,
-    nullptr,
-    callJsCb,
-    &threadSafeFunction
-	);
-	CHECK_STATUS;
-  
-  status = napi_unref_threadsafe_function(env, threadSafeFunction);
-	CHECK_STATUS;
-  
-	av_log_set_callback(av_log_custom_callback);
+
+  beamInstance* instance = getInstance(env);
+  if (instance == nullptr) {
+    NAPI_THROW_ERROR("Logging is not available in this environment.");
+  }
+
+  if (t == napi_function) {
+    napi_value work_name;
+    status = napi_create_string_utf8(env, "Thread-safe Function For Libav Custom Logging", NAPI_AUTO_LENGTH, &work_name);
+    CHECK_STATUS;
+
+    status = napi_create_threadsafe_function(
+      env,
+      callback,
+      NULL,
+      work_name,
+      0,
+      1,
+      nullptr,
+      nullptr,
+      nullptr,
+      callJsCb,
+      &logFunction
+    );
+    CHECK_STATUS;
+
+    status = napi_unref_threadsafe_function(env, logFunction);
+    CHECK_STATUS;
+  }
+
+  // Replaces any previous callback for this environment, null removes it
+  std::lock_guard<std::mutex> lk(logLock);
+  if (instance->logFunction != nullptr) {
+    napi_release_threadsafe_function(instance->logFunction, napi_tsfn_release);
+  }
+  instance->logFunction = logFunction;
+  applyLogSettings();
 	return nullptr;
-}
\ No newline at end of file
+}
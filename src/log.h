@@ -12,6 +12,11 @@ extern const beamEnum* beam_logging_level;
 napi_value logging(napi_env env, napi_callback_info info);
 napi_value setLoggingCallback(napi_env env, napi_callback_info info);
 
+struct beamInstance;
+// Register and remove environments for log level and callback routing
+void logAttach(beamInstance* instance);
+void logDetach(beamInstance* instance);
+
 struct logCarrier : carrier {
   std::string msg;
 	int level;
@@ -0,0 +1,241 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#include "memoryoutput.h"
+#include <algorithm>
+#include <cstring>
+
+// Read cursor for the second pass of muxers that reopen their own output
+struct memoryReader {
+  MemoryOutput *output;
+  int64_t pos = 0;
+};
+
+MemoryOutput::~MemoryOutput() {
+  for (auto &c : mData) BufferPool::instance().release(c.data, c.capacity);
+}
+
+int MemoryOutput::write(const uint8_t *buf, size_t len, size_t pos) {
+  size_t end = pos + len;
+  while (mData.size() * mChunkSize < end) {
+    chunk c;
+    c.data = BufferPool::instance().acquire(mChunkSize, &c.capacity);
+    if (nullptr == c.data) return AVERROR(ENOMEM);
+    c.size = 0;
+    mData.push_back(c);
+  }
+  // Zero any gap left by seeking beyond the end
+  for (size_t p = mSize; p < pos; ) {
+    chunk &c = mData[p / mChunkSize];
+    size_t off = p % mChunkSize;
+    size_t n = std::min(mChunkSize - off, pos - p);
+    memset(c.data + off, 0, n);
+    p += n;
+  }
+  for (size_t p = pos; p < end; ) {
+    chunk &c = mData[p / mChunkSize];
+    size_t off = p % mChunkSize;
+    size_t n = std::min(mChunkSize - off, end - p);
+    memcpy(c.data + off, buf + (p - pos), n);
+    p += n;
+  }
+  mSize = std::max(mSize, end);
+  return (int)len;
+}
+
+size_t MemoryOutput::read(uint8_t *buf, size_t len, size_t pos) const {
+  if (pos >= mSize) return 0;
+  size_t end = std::min(mSize, pos + len);
+  for (size_t p = pos; p < end; ) {
+    const chunk &c = mData[p / mChunkSize];
+    size_t off = p % mChunkSize;
+    size_t n = std::min(mChunkSize - off, end - p);
+    memcpy(buf + (p - pos), c.data + off, n);
+    p += n;
+  }
+  return end - pos;
+}
+
+int MemoryOutput::writePacket(void *opaque, uint8_t *buf, int bufSize) {
+  MemoryOutput *output = (MemoryOutput *)opaque;
+  if (output->mFinished) return AVERROR(EINVAL);
+  int ret = output->write(buf, (size_t)bufSize, output->mPos);
+  if (ret > 0) output->mPos += ret;
+  return ret;
+}
+
+int64_t MemoryOutput::seek(void *opaque, int64_t offset, int whence) {
+  MemoryOutput *output = (MemoryOutput *)opaque;
+  int64_t pos;
+  switch (whence & ~AVSEEK_FORCE) {
+    case AVSEEK_SIZE:
+      return (int64_t)output->mSize;
+    case SEEK_SET:
+      pos = offset;
+      break;
+    case SEEK_CUR:
+      pos = (int64_t)output->mPos + offset;
+      break;
+    case SEEK_END:
+      pos = (int64_t)output->mSize + offset;
+      break;
+    default:
+      return AVERROR(EINVAL);
+  }
+  if (pos < 0) return AVERROR(EINVAL);
+  output->mPos = (size_t)pos;
+  return pos;
+}
+
+void MemoryOutput::install(AVFormatContext *fmtCtx) {
+  fmtCtx->opaque = this;
+  fmtCtx->io_open = &MemoryOutput::ioOpen;
+  // io_close2 arrived in FFmpeg 5.1, and io_close is deprecated from then on
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(59, 17, 100)
+  fmtCtx->io_close2 = &MemoryOutput::ioClose;
+#else
+  fmtCtx->io_close = &MemoryOutput::ioCloseLegacy;
+#endif
+}
+
+int MemoryOutput::ioOpen(AVFormatContext *s, AVIOContext **pb, const char *url,
+    int flags, AVDictionary **options) {
+  MemoryOutput *output = (MemoryOutput *)s->opaque;
+  // Only reading back the output itself is supported
+  if ((flags & AVIO_FLAG_WRITE) || (nullptr == output)) return AVERROR(ENOSYS);
+
+  memoryReader *reader = new memoryReader;
+  reader->output = output;
+  uint8_t *ioBuf = (uint8_t *)av_malloc(32768);
+  if (nullptr == ioBuf) {
+    delete reader;
+    return AVERROR(ENOMEM);
+  }
+  *pb = avio_alloc_context(ioBuf, 32768, 0, reader,
+    &MemoryOutput::readPacket, nullptr, &MemoryOutput::readSeek);
+  if (nullptr == *pb) {
+    av_free(ioBuf);
+    delete reader;
+    return AVERROR(ENOMEM);
+  }
+  return 0;
+}
+
+// Contexts not opened by ioOpen are closed as FFmpeg's default would
+int MemoryOutput::ioClose(AVFormatContext *s, AVIOContext *pb) {
+  if (pb == nullptr) return 0;
+  if (pb->read_packet != &MemoryOutput::readPacket) return avio_close(pb);
+  delete (memoryReader *)pb->opaque;
+  av_freep(&pb->buffer);
+  avio_context_free(&pb);
+  return 0;
+}
+
+#if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(59, 17, 100)
+void MemoryOutput::ioCloseLegacy(AVFormatContext *s, AVIOContext *pb) {
+  ioClose(s, pb);
+}
+#endif
+
+int MemoryOutput::readPacket(void *opaque, uint8_t *buf, int bufSize) {
+  memoryReader *reader = (memoryReader *)opaque;
+  size_t numBytes = reader->output->read(buf, (size_t)bufSize, (size_t)reader->pos);
+  if (0 == numBytes) return AVERROR_EOF;
+  reader->pos += numBytes;
+  return (int)numBytes;
+}
+
+int64_t MemoryOutput::readSeek(void *opaque, int64_t offset, int whence) {
+  memoryReader *reader = (memoryReader *)opaque;
+  int64_t pos;
+  // Use the live size - the muxer keeps writing while it reads ahead
+  int64_t size = (int64_t)reader->output->mSize;
+  switch (whence & ~AVSEEK_FORCE) {
+    case AVSEEK_SIZE:
+      return size;
+    case SEEK_SET:
+      pos = offset;
+      break;
+    case SEEK_CUR:
+      pos = reader->pos + offset;
+      break;
+    case SEEK_END:
+      pos = size + offset;
+      break;
+    default:
+      return AVERROR(EINVAL);
+  }
+  if ((pos < 0) || (pos > size)) return AVERROR(EINVAL);
+  reader->pos = pos;
+  return pos;
+}
+
+int MemoryOutput::finish() {
+  mFinished = true;
+  for (size_t x = 0; x < mData.size(); ++x) {
+    size_t start = x * mChunkSize;
+    mData[x].size = (mSize > start) ? std::min(mChunkSize, mSize - start) : 0;
+  }
+  while (!mData.empty() && (0 == mData.back().size)) {
+    BufferPool::instance().release(mData.back().data, mData.back().capacity);
+    mData.pop_back();
+  }
+  if (mChunks || (mData.size() <= 1)) return 0;
+
+  // A single Buffer was asked for, so consolidate once
+  chunk whole;
+  whole.data = BufferPool::instance().acquire(mSize, &whole.capacity);
+  if (nullptr == whole.data) return AVERROR(ENOMEM);
+  whole.size = read(whole.data, mSize, 0);
+  for (auto &c : mData) BufferPool::instance().release(c.data, c.capacity);
+  mData.clear();
+  mData.push_back(whole);
+  return 0;
+}
+
+napi_status MemoryOutput::toJS(napi_env env, napi_value *result) {
+  napi_status status;
+  napi_value element;
+  if (mChunks) {
+    status = napi_create_array(env, result);
+    if (status != napi_ok) return status;
+  }
+  for (size_t x = 0; x < mData.size(); ++x) {
+    status = makePooledBuffer(env, mData[x].data, mData[x].size, mData[x].capacity, &element);
+    if (status != napi_ok) return status;
+    mData[x].data = nullptr; // now owned by the Buffer
+    if (!mChunks) {
+      *result = element;
+    } else {
+      status = napi_set_element(env, *result, (uint32_t)x, element);
+      if (status != napi_ok) return status;
+    }
+  }
+  if (!mChunks && mData.empty())
+    status = napi_create_buffer(env, 0, nullptr, result);
+  mData.clear();
+  return status;
+}
+
+void memoryOutputFinalizer(napi_env env, void* data, void* hint) {
+  MemoryOutput *output = (MemoryOutput *)data;
+  delete output;
+}
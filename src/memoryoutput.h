@@ -0,0 +1,87 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#ifndef MEMORYOUTPUT_H
+#define MEMORYOUTPUT_H
+
+#include "node_api.h"
+#include "bufferpool.h"
+#include <vector>
+
+extern "C" {
+  #include <libavformat/avformat.h>
+}
+
+// Seekable muxer output held in memory as a list of fixed-size chunks from
+// the BufferPool. Formats that rewrite earlier data, such as MOV and MP4
+// with faststart, seek back into the chunks. The second pass of faststart
+// reads the output back through io_open.
+class MemoryOutput {
+public:
+  MemoryOutput(size_t chunkSize, bool chunks)
+    : mChunkSize(chunkSize), mChunks(chunks), mIOBuf(32768) {}
+  ~MemoryOutput();
+
+  static int writePacket(void *opaque, uint8_t *buf, int bufSize);
+  static int64_t seek(void *opaque, int64_t offset, int whence);
+  unsigned char *ioBuf()  { return &mIOBuf[0]; }
+  int ioBufLen() const  { return (int)mIOBuf.size(); }
+
+  // Route the muxer's own reopen requests back to this output
+  void install(AVFormatContext *fmtCtx);
+
+  // Take the output as pooled blocks, consolidated into one unless chunks were
+  // requested. Returns a negative AVERROR on failure.
+  int finish();
+  // Wrap the finished output as a Buffer or an array of Buffers - main thread
+  napi_status toJS(napi_env env, napi_value *result);
+
+private:
+  struct chunk {
+    uint8_t *data;
+    size_t capacity;
+    size_t size;
+  };
+
+  int write(const uint8_t *buf, size_t len, size_t pos);
+  size_t read(uint8_t *buf, size_t len, size_t pos) const;
+
+  static int ioOpen(AVFormatContext *s, AVIOContext **pb, const char *url,
+    int flags, AVDictionary **options);
+  static int ioClose(AVFormatContext *s, AVIOContext *pb);
+#if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(59, 17, 100)
+  static void ioCloseLegacy(AVFormatContext *s, AVIOContext *pb);
+#endif
+  static int readPacket(void *opaque, uint8_t *buf, int bufSize);
+  static int64_t readSeek(void *opaque, int64_t offset, int whence);
+
+  const size_t mChunkSize;
+  const bool mChunks;
+  std::vector<unsigned char> mIOBuf;
+  std::vector<chunk> mData;
+  size_t mSize = 0;
+  size_t mPos = 0;
+  bool mFinished = false;
+};
+
+void memoryOutputFinalizer(napi_env env, void* data, void* hint);
+
+#endif // MEMORYOUTPUT_H
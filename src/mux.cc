@@ -119,12 +119,154 @@ napi_value muxer(napi_env env, napi_callback_info info) {
     }
   }
 
+  Segmenter *segmenter = nullptr;
+  status = napi_get_named_property(env, args[0], "segmenter", &prop);
+  CHECK_STATUS;
+  status = napi_typeof(env, prop, &type);
+  CHECK_STATUS;
+  if (type == napi_object) {
+    double duration = 0.0;
+    bool keyframes = true, present;
+    int32_t streamIndex = -1;
+    if (adaptor) {
+      NAPI_THROW_ERROR("Muxer cannot be created with both a governor and a segmenter.");
+    }
+    status = beam_get_double(env, prop, "duration", &duration);
+    CHECK_STATUS;
+    status = beam_get_bool(env, prop, "keyframes", &present, &keyframes);
+    CHECK_STATUS;
+    if (!present) keyframes = true;
+    status = beam_get_int32(env, prop, "stream_index", &streamIndex);
+    CHECK_STATUS;
+    if ((duration <= 0.0) && !keyframes) {
+      NAPI_THROW_ERROR("Segmenter requires a fragment duration, keyframe boundaries or both.");
+    }
+    segmenter = new Segmenter(duration, keyframes, streamIndex);
+  } else if (type != napi_undefined) {
+    NAPI_THROW_ERROR("Muxer segmenter must be an options object when specified.");
+  }
+
+  Packager *packager = nullptr;
+  status = napi_get_named_property(env, args[0], "packager", &prop);
+  CHECK_STATUS;
+  status = napi_typeof(env, prop, &type);
+  CHECK_STATUS;
+  if (type == napi_object) {
+    double duration = 0.0;
+    bool keyframes = true, present;
+    int32_t streamIndex = -1;
+    uint32_t window = 0;
+    if (adaptor || segmenter) {
+      delete segmenter;
+      NAPI_THROW_ERROR("Muxer packager cannot be combined with a governor or a segmenter.");
+    }
+    status = beam_get_uint32(env, prop, "window", &window);
+    CHECK_STATUS;
+    status = beam_get_double(env, prop, "duration", &duration);
+    CHECK_STATUS;
+    status = beam_get_bool(env, prop, "keyframes", &present, &keyframes);
+    CHECK_STATUS;
+    if (!present) keyframes = true;
+    status = beam_get_int32(env, prop, "stream_index", &streamIndex);
+    CHECK_STATUS;
+
+    // Strings are copied as soon as they are read so no error path leaks them
+    char* str = nullptr;
+    std::string directoryStr, playlistStr, prefixStr;
+    bool dash = false;
+    status = beam_get_string_utf8(env, prop, "directory", &str);
+    CHECK_STATUS;
+    if (nullptr == str) {
+      NAPI_THROW_ERROR("Muxer packager requires an output directory.");
+    }
+    directoryStr = str;
+    free(str);
+    status = beam_get_string_utf8(env, prop, "type", &str);
+    CHECK_STATUS;
+    if (str != nullptr) {
+      dash = 0 == strcmp(str, "dash");
+      bool hls = 0 == strcmp(str, "hls");
+      free(str);
+      if (!dash && !hls) {
+        NAPI_THROW_ERROR("Muxer packager type must be either 'hls' or 'dash'.");
+      }
+    }
+    status = beam_get_string_utf8(env, prop, "playlist", &str);
+    CHECK_STATUS;
+    playlistStr = str ? str : (dash ? "manifest.mpd" : "index.m3u8");
+    free(str);
+    status = beam_get_string_utf8(env, prop, "prefix", &str);
+    CHECK_STATUS;
+    prefixStr = str ? str : "segment";
+    free(str);
+
+    if ((duration <= 0.0) && !keyframes) {
+      NAPI_THROW_ERROR("Packager requires a segment duration, keyframe boundaries or both.");
+    }
+    if (!Packager::ensureDirectory(directoryStr)) {
+      NAPI_THROW_ERROR("Muxer packager could not create its output directory.");
+    }
+    segmenter = new Segmenter(duration, keyframes, streamIndex);
+    packager = new Packager(directoryStr, dash, playlistStr, prefixStr, window);
+    segmenter->setSink(packager);
+  } else if (type != napi_undefined) {
+    NAPI_THROW_ERROR("Muxer packager must be an options object when specified.");
+  }
+
+  MemoryOutput *memoryOutput = nullptr;
+  status = napi_get_named_property(env, args[0], "memory", &prop);
+  CHECK_STATUS;
+  status = napi_typeof(env, prop, &type);
+  CHECK_STATUS;
+  if ((type == napi_object) || (type == napi_boolean)) {
+    bool useMemory = true, chunks = false, present;
+    uint32_t chunkSize = 1024 * 1024;
+    if (type == napi_boolean) {
+      status = napi_get_value_bool(env, prop, &useMemory);
+      CHECK_STATUS;
+    } else {
+      status = beam_get_uint32(env, prop, "chunk_size", &chunkSize);
+      CHECK_STATUS;
+      status = beam_get_bool(env, prop, "chunks", &present, &chunks);
+      CHECK_STATUS;
+      if (!present) chunks = false;
+    }
+    if (useMemory) {
+      if (adaptor || segmenter) {
+        delete segmenter;
+        delete packager;
+        NAPI_THROW_ERROR("Muxer memory output cannot be combined with a governor, segmenter or packager.");
+      }
+      if (chunkSize < 4096) {
+        NAPI_THROW_ERROR("Muxer memory output chunk_size must be at least 4096 bytes.");
+      }
+      memoryOutput = new MemoryOutput(chunkSize, chunks);
+    }
+  } else if (type != napi_undefined) {
+    NAPI_THROW_ERROR("Muxer memory must be a Boolean or an options object when specified.");
+  }
+
   AVIOContext* avio_ctx = nullptr;
   if (adaptor) {
     avio_ctx = avio_alloc_context(adaptor->buf(), adaptor->bufLen(), 1, adaptor, nullptr, &write_packet, nullptr);
     if (!avio_ctx) {
       NAPI_THROW_ERROR("Problem allocating muxer stream output context.");
     }
+  } else if (segmenter) {
+    avio_ctx = avio_alloc_context(segmenter->ioBuf(), segmenter->ioBufLen(), 1, segmenter,
+      nullptr, &Segmenter::writePacket, nullptr);
+    if (!avio_ctx) {
+      delete segmenter;
+      delete packager;
+      NAPI_THROW_ERROR("Problem allocating muxer segmenter output context.");
+    }
+  } else if (memoryOutput) {
+    avio_ctx = avio_alloc_context(memoryOutput->ioBuf(), memoryOutput->ioBufLen(), 1, memoryOutput,
+      nullptr, &MemoryOutput::writePacket, &MemoryOutput::seek);
+    if (!avio_ctx) {
+      delete memoryOutput;
+      NAPI_THROW_ERROR("Problem allocating muxer memory output context.");
+    }
   }
   ret = avformat_alloc_output_context2(&fmtCtx, oformat, formatName, filename);
 
@@ -132,10 +274,36 @@ napi_value muxer(napi_env env, napi_callback_info info) {
   free(filename);
 
   if (ret < 0) {
+    if (segmenter) {
+      avio_context_free(&avio_ctx);
+      delete segmenter;
+      delete packager;
+    }
+    if (memoryOutput) {
+      avio_context_free(&avio_ctx);
+      delete memoryOutput;
+    }
     NAPI_THROW_ERROR(avErrorMsg("Error allocating muxer context: ", ret));
   }
 
   fmtCtx->pb = avio_ctx;
+  if (memoryOutput) {
+    fmtCtx->flags |= AVFMT_FLAG_CUSTOM_IO;
+    memoryOutput->install(fmtCtx);
+  }
+  if (segmenter) {
+    // Fragments are only cut when the segmenter flushes the muxer
+    fmtCtx->flags |= AVFMT_FLAG_CUSTOM_IO;
+    ret = av_opt_set(fmtCtx->priv_data, "movflags",
+      "+frag_custom+empty_moov+default_base_moof", 0);
+    if (ret < 0) {
+      avio_context_free(&fmtCtx->pb);
+      avformat_free_context(fmtCtx);
+      delete segmenter;
+      delete packager;
+      NAPI_THROW_ERROR("Segmenter requires a fragmented MP4 capable output format such as mp4.");
+    }
+  }
 
   status = fromAVFormatContext(env, fmtCtx, adaptor, &result);
   CHECK_STATUS;
@@ -164,6 +332,42 @@ napi_value muxer(napi_env env, napi_callback_info info) {
   status = napi_set_named_property(env, result, "writeFrame", prop);
   CHECK_STATUS;
 
+  status = napi_create_function(env, "interleave", NAPI_AUTO_LENGTH,
+    interleave, nullptr, &prop);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, result, "interleave", prop);
+  CHECK_STATUS;
+
+  status = napi_create_function(env, "segments", NAPI_AUTO_LENGTH,
+    segments, nullptr, &prop);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, result, "segments", prop);
+  CHECK_STATUS;
+
+  {
+    Interleaver *interleaver = new Interleaver(segmenter);
+    napi_value interleaverExt, segmenterExt, packagerExt, memoryOutputExt;
+    status = napi_create_external(env, interleaver, interleaverFinalizer, nullptr, &interleaverExt);
+    CHECK_STATUS;
+    status = napi_create_external(env, segmenter,
+      segmenter ? segmenterFinalizer : nullptr, nullptr, &segmenterExt);
+    CHECK_STATUS;
+    status = napi_create_external(env, packager,
+      packager ? packagerFinalizer : nullptr, nullptr, &packagerExt);
+    CHECK_STATUS;
+    status = napi_create_external(env, memoryOutput,
+      memoryOutput ? memoryOutputFinalizer : nullptr, nullptr, &memoryOutputExt);
+    CHECK_STATUS;
+    napi_property_descriptor desc[] = {
+      { "_interleaver", nullptr, nullptr, nullptr, nullptr, interleaverExt, napi_default, nullptr },
+      { "_segmenter", nullptr, nullptr, nullptr, nullptr, segmenterExt, napi_default, nullptr },
+      { "_packager", nullptr, nullptr, nullptr, nullptr, packagerExt, napi_default, nullptr },
+      { "_memoryOutput", nullptr, nullptr, nullptr, nullptr, memoryOutputExt, napi_default, nullptr }
+    };
+    status = napi_define_properties(env, result, 4, desc);
+    CHECK_STATUS;
+  }
+
   status = napi_create_function(env, "writeTrailer", NAPI_AUTO_LENGTH,
     writeTrailer, nullptr, &prop);
   CHECK_STATUS;
@@ -176,17 +380,38 @@ napi_value muxer(napi_env env, napi_callback_info info) {
   status = napi_set_named_property(env, result, "forceClose", prop);
   CHECK_STATUS;
 
+  status = defineInterruptControls(env, result);
+  CHECK_STATUS;
+  {
+    // An aborted signal leaves the muxer cancelled, so each write fails
+    bool aborted;
+    status = getInterruptOptions(env, args[0], Interrupter::of(fmtCtx), &aborted);
+    if (status != napi_ok) {
+      NAPI_THROW_ERROR("Muxer signal must be an AbortSignal when specified.");
+    }
+  }
+
   return result;
 }
 
 void openIOExecute(napi_env env, void* data) {
   openIOCarrier* c = (openIOCarrier*) data;
   int ret;
+  // Checked with the lock held, as forceClose cancels before freeing the IO context
+  std::lock_guard<std::mutex> lk(c->interleaver->writeLock());
+  interruptScope scope(Interrupter::of(c->format));
+  if (scope.cancelled()) {
+    c->status = BEAMCODER_ERROR_OPENIO;
+    c->errorMsg = "Problem opening IO context: operation cancelled.";
+    return;
+  }
   if (c->format->pb == nullptr) {
-    ret = avio_open2(&c->format->pb, c->format->url, c->flags, nullptr, &c->options);
+    ret = avio_open2(&c->format->pb, c->format->url, c->flags,
+      &c->format->interrupt_callback, &c->options);
     if (ret < 0) {
       c->status = BEAMCODER_ERROR_OPENIO;
-      c->errorMsg = avErrorMsg("Problem opening IO context: ", ret);
+      c->errorMsg = interruptErrorMsg(Interrupter::of(c->format),
+        "Problem opening IO context: ", ret);
     }
   }
 }
@@ -226,7 +451,7 @@ void openIOComplete(napi_env env, napi_status asyncStatus, void* data) {
 }
 
 napi_value openIO(napi_env env, napi_callback_info info) {
-  napi_value promise, formatJS, formatExt, resourceName, prop;
+  napi_value promise, formatJS, formatExt, interleaverExt, resourceName, prop;
   napi_valuetype type;
   bool isArray, present, flag;
   size_t strLen;
@@ -242,6 +467,10 @@ napi_value openIO(napi_env env, napi_callback_info info) {
   REJECT_RETURN;
   c->status = napi_get_value_external(env, formatExt, (void**) &c->format);
   REJECT_RETURN;
+  c->status = napi_get_named_property(env, formatJS, "_interleaver", &interleaverExt);
+  REJECT_RETURN;
+  c->status = napi_get_value_external(env, interleaverExt, (void**) &c->interleaver);
+  REJECT_RETURN;
 
   if (argc > 0) { // Possible options, url and flags
     napi_value args[1];
@@ -340,13 +569,23 @@ napi_value openIO(napi_env env, napi_callback_info info) {
 
 void writeHeaderExecute(napi_env env, void* data) {
   writeHeaderCarrier* c = (writeHeaderCarrier*) data;
+  // Checked with the lock held, as forceClose cancels before freeing the IO context
+  std::lock_guard<std::mutex> lk(c->interleaver->writeLock());
+  interruptScope scope(Interrupter::of(c->format));
+  if (scope.cancelled()) {
+    c->status = BEAMCODER_ERROR_WRITE_HEADER;
+    c->errorMsg = "Failed to write header: operation cancelled.";
+    return;
+  }
 
   c->result = avformat_write_header(c->format, &c->options);
   if (c->result < 0) {
     c->status = BEAMCODER_ERROR_WRITE_HEADER;
-    c->errorMsg = avErrorMsg("Failed to write header: ", c->result);
+    c->errorMsg = interruptErrorMsg(Interrupter::of(c->format),
+      "Failed to write header: ", c->result);
     return;
   }
+  if (c->segmenter) c->segmenter->cutInit(c->format);
 }
 
 void writeHeaderComplete(napi_env env, napi_status asyncStatus, void* data) {
@@ -389,7 +628,7 @@ void writeHeaderComplete(napi_env env, napi_status asyncStatus, void* data) {
 }
 
 napi_value writeHeader(napi_env env, napi_callback_info info) {
-  napi_value promise, formatJS, formatExt, resourceName, prop;
+  napi_value promise, formatJS, formatExt, interleaverExt, segmenterExt, resourceName, prop;
   napi_valuetype type;
   bool isArray;
   writeHeaderCarrier* c = new writeHeaderCarrier;
@@ -404,6 +643,14 @@ napi_value writeHeader(napi_env env, napi_callback_info info) {
   REJECT_RETURN;
   c->status = napi_get_value_external(env, formatExt, (void**) &c->format);
   REJECT_RETURN;
+  c->status = napi_get_named_property(env, formatJS, "_interleaver", &interleaverExt);
+  REJECT_RETURN;
+  c->status = napi_get_value_external(env, interleaverExt, (void**) &c->interleaver);
+  REJECT_RETURN;
+  c->status = napi_get_named_property(env, formatJS, "_segmenter", &segmenterExt);
+  REJECT_RETURN;
+  c->status = napi_get_value_external(env, segmenterExt, (void**) &c->segmenter);
+  REJECT_RETURN;
 
   if (argc > 0) { // Possible options
     napi_value args[1];
@@ -445,11 +692,20 @@ napi_value writeHeader(napi_env env, napi_callback_info info) {
 
 void initOutputExecute(napi_env env, void* data) {
   initOutputCarrier* c = (initOutputCarrier*) data;
+  // Checked with the lock held, as forceClose cancels before freeing the IO context
+  std::lock_guard<std::mutex> lk(c->interleaver->writeLock());
+  interruptScope scope(Interrupter::of(c->format));
+  if (scope.cancelled()) {
+    c->status = BEAMCODER_ERROR_INIT_OUTPUT;
+    c->errorMsg = "Failed to initialize output: operation cancelled.";
+    return;
+  }
 
   c->result = avformat_init_output(c->format, &c->options);
   if (c->result < 0) {
     c->status = BEAMCODER_ERROR_INIT_OUTPUT;
-    c->errorMsg = avErrorMsg("Failed to initialize output: ", c->result);
+    c->errorMsg = interruptErrorMsg(Interrupter::of(c->format),
+      "Failed to initialize output: ", c->result);
     return;
   }
 }
@@ -494,7 +750,7 @@ void initOutputComplete(napi_env env, napi_status asyncStatus, void* data) {
 }
 
 napi_value initOutput(napi_env env, napi_callback_info info) {
-  napi_value promise, formatJS, formatExt, resourceName, prop;
+  napi_value promise, formatJS, formatExt, interleaverExt, resourceName, prop;
   napi_valuetype type;
   bool isArray;
   initOutputCarrier* c = new initOutputCarrier;
@@ -509,6 +765,10 @@ napi_value initOutput(napi_env env, napi_callback_info info) {
   REJECT_RETURN;
   c->status = napi_get_value_external(env, formatExt, (void**) &c->format);
   REJECT_RETURN;
+  c->status = napi_get_named_property(env, formatJS, "_interleaver", &interleaverExt);
+  REJECT_RETURN;
+  c->status = napi_get_value_external(env, interleaverExt, (void**) &c->interleaver);
+  REJECT_RETURN;
 
   if (argc > 0) { // Possible options
     napi_value args[1];
@@ -551,6 +811,42 @@ napi_value initOutput(napi_env env, napi_callback_info info) {
 void writeFrameExecute(napi_env env, void* data) {
   writeFrameCarrier* c = (writeFrameCarrier*) data;
   int ret;
+  // Checked with the lock held, as forceClose cancels before freeing the IO context
+  std::lock_guard<std::mutex> lk(c->interleaver->writeLock());
+  interruptScope scope(Interrupter::of(c->format));
+  if (scope.cancelled()) {
+    c->status = BEAMCODER_ERROR_WRITE_FRAME;
+    c->errorMsg = "Error writing frame: operation cancelled.";
+    return;
+  }
+
+  if (c->batch) { // Batch of packets in one async hop
+    for (auto it = c->packets.begin(); it != c->packets.end(); ++it) {
+      if (c->segmenter &&
+          ((ret = c->segmenter->beforePacket(c->format, *it, c->interleaved)) < 0)) {
+        c->status = BEAMCODER_ERROR_WRITE_FRAME;
+        c->errorMsg = avErrorMsg("Error cutting fragment: ", ret);
+        return;
+      }
+      ret = c->interleaved ?
+        av_interleaved_write_frame(c->format, *it) :
+        av_write_frame(c->format, *it);
+      if (ret < 0) {
+        c->status = BEAMCODER_ERROR_WRITE_FRAME;
+        c->errorMsg = interruptErrorMsg(Interrupter::of(c->format),
+          "Error writing frame: ", ret);
+        return;
+      }
+    }
+    return;
+  }
+
+  if (c->segmenter && (c->packet != nullptr) &&
+      ((ret = c->segmenter->beforePacket(c->format, c->packet, c->interleaved)) < 0)) {
+    c->status = BEAMCODER_ERROR_WRITE_FRAME;
+    c->errorMsg = avErrorMsg("Error cutting fragment: ", ret);
+    return;
+  }
 
   if (c->interleaved) {
     if (c->packet != nullptr) {
@@ -572,7 +868,8 @@ void writeFrameExecute(napi_env env, void* data) {
 
   if (ret < 0) {
     c->status = BEAMCODER_ERROR_WRITE_FRAME;
-    c->errorMsg = avErrorMsg("Error writing frame: ", ret);
+    c->errorMsg = interruptErrorMsg(Interrupter::of(c->format),
+      "Error writing frame: ", ret);
     return;
   }
 }
@@ -604,9 +901,9 @@ void writeFrameComplete(napi_env env, napi_status asyncStatus, void* data) {
 }
 
 napi_value writeFrame(napi_env env, napi_callback_info info) {
-  napi_value promise, formatJS, formatExt, adaptorExt, interleavedJS, resourceName, options, prop;
+  napi_value promise, formatJS, formatExt, interleaverExt, adaptorExt, segmenterExt, interleavedJS, resourceName, options, prop;
   napi_valuetype type;
-  bool isArray;
+  bool isArray, hasPackets;
   bool hasOptions = false;
   writeFrameCarrier* c = new writeFrameCarrier;
   packetData* packetData;
@@ -624,12 +921,21 @@ napi_value writeFrame(napi_env env, napi_callback_info info) {
   REJECT_RETURN;
   c->status = napi_get_value_external(env, formatExt, (void**) &c->format);
   REJECT_RETURN;
+  c->status = napi_get_named_property(env, formatJS, "_interleaver", &interleaverExt);
+  REJECT_RETURN;
+  c->status = napi_get_value_external(env, interleaverExt, (void**) &c->interleaver);
+  REJECT_RETURN;
 
   c->status = napi_get_named_property(env, formatJS, "_adaptor", &adaptorExt);
   REJECT_RETURN;
   c->status = napi_get_value_external(env, adaptorExt, (void**)&c->adaptor);
   REJECT_RETURN;
 
+  c->status = napi_get_named_property(env, formatJS, "_segmenter", &segmenterExt);
+  REJECT_RETURN;
+  c->status = napi_get_value_external(env, segmenterExt, (void**)&c->segmenter);
+  REJECT_RETURN;
+
   c->status = napi_get_named_property(env, formatJS, "interleaved", &interleavedJS);
   REJECT_RETURN;
   c->status = napi_get_value_bool(env, interleavedJS, &c->interleaved);
@@ -642,11 +948,26 @@ napi_value writeFrame(napi_env env, napi_callback_info info) {
     REJECT_RETURN;
     c->status = napi_is_array(env, args[0], &isArray);
     REJECT_RETURN;
-    if (isArray || (type != napi_object)) {
-      REJECT_ERROR_RETURN("Write frame requires a frame, a packet or an options object.",
+    if (type != napi_object) {
+      REJECT_ERROR_RETURN("Write frame requires a frame, a packet, an array of packets or an options object.",
         BEAMCODER_INVALID_ARGS);
     }
 
+    // An array of packets or an encode result with a packets array
+    c->status = napi_get_named_property(env, args[0], "packets", &prop);
+    REJECT_RETURN;
+    c->status = napi_is_array(env, prop, &hasPackets);
+    REJECT_RETURN;
+    if (isArray || hasPackets) {
+      c->batch = true;
+      c->status = getPacketRefs(env, args[0], c->packets);
+      if (c->status != napi_ok) {
+        REJECT_ERROR_RETURN("Write frame requires every element of a packet array to be a packet.",
+          BEAMCODER_INVALID_ARGS);
+      }
+      goto work;
+    }
+
     c->status = napi_get_named_property(env, args[0], "packet", &options);
     REJECT_RETURN;
     c->status = napi_typeof(env, options, &type);
@@ -707,7 +1028,7 @@ napi_value writeFrame(napi_env env, napi_callback_info info) {
   }
 
 work:
-  if ((c->packet != nullptr) || (c->frame != nullptr)) {
+  if ((c->packet != nullptr) || (c->frame != nullptr) || c->batch) {
     c->status = napi_create_reference(env, hasOptions ? options : args[0], 1,
       &c->passthru);
     REJECT_RETURN;
@@ -724,15 +1045,337 @@ work:
   return promise;
 }
 
+Interleaver::~Interleaver() {
+  for (auto &q : mQueues)
+    for (auto it = q.begin(); it != q.end(); ++it) av_packet_free(&(*it));
+}
+
+size_t Interleaver::queued() {
+  std::lock_guard<std::mutex> lk(m);
+  return mQueued;
+}
+
+int Interleaver::push(AVFormatContext *fmtCtx, std::vector<AVPacket*> &packets,
+    int endStream, std::vector<AVPacket*> &done) {
+  std::lock_guard<std::mutex> lk(m);
+  // Without a maximum delay a stalled stream would hold every other stream's
+  // packets in the queue, without limit
+  if (fmtCtx->max_interleave_delta <= 0) return AVERROR(EINVAL);
+  if (mQueues.size() < fmtCtx->nb_streams) {
+    mQueues.resize(fmtCtx->nb_streams);
+    mEnded.resize(fmtCtx->nb_streams, false);
+  }
+  for (auto it = packets.begin(); it != packets.end(); ++it) {
+    mQueues[(*it)->stream_index].push_back(*it);
+    mQueued++;
+  }
+  packets.clear();
+  if (endStream >= 0) mEnded[endStream] = true;
+
+  bool allEnded = std::all_of(mEnded.begin(), mEnded.end(), [](bool e) { return e; });
+  return release(fmtCtx, allEnded, done);
+}
+
+int Interleaver::drain(AVFormatContext *fmtCtx, std::vector<AVPacket*> &done) {
+  std::lock_guard<std::mutex> lk(m);
+  return release(fmtCtx, true, done);
+}
+
+static inline int64_t interleaveTS(const AVPacket *pkt) {
+  return (pkt->dts != AV_NOPTS_VALUE) ? pkt->dts : pkt->pts;
+}
+
+// Called with the lock held. Writes the packet with the lowest dts for as long
+// as the queue holds enough information to be sure nothing earlier can arrive.
+// Ties go to the lowest stream index so output order is deterministic.
+int Interleaver::release(AVFormatContext *fmtCtx, bool flushAll, std::vector<AVPacket*> &done) {
+  int ret;
+  // A force closed muxer has no IO context left to write to
+  Interrupter* interrupter = Interrupter::of(fmtCtx);
+  if ((mQueued > 0) && (interrupter != nullptr) && interrupter->cancelled()) return AVERROR_EXIT;
+  while (mQueued > 0) {
+    int next = -1;
+    int64_t nextTS = AV_NOPTS_VALUE;
+    bool ready = true;
+    int64_t newestTS = INT64_MIN; // in AV_TIME_BASE units
+    for (size_t s = 0; s < mQueues.size(); ++s) {
+      if (mQueues[s].empty()) {
+        if (!mEnded[s]) ready = false;
+        continue;
+      }
+      AVRational tb = fmtCtx->streams[s]->time_base;
+      int64_t headTS = interleaveTS(mQueues[s].front());
+      int64_t tailTS = interleaveTS(mQueues[s].back());
+      if (tailTS != AV_NOPTS_VALUE)
+        newestTS = std::max(newestTS, av_rescale_q(tailTS, tb, AV_TIME_BASE_Q));
+      if (next < 0) {
+        next = (int)s;
+        nextTS = headTS;
+        continue;
+      }
+      if (nextTS == AV_NOPTS_VALUE) continue; // untimed packets go first
+      if ((headTS == AV_NOPTS_VALUE) ||
+          (av_compare_ts(headTS, tb, nextTS, fmtCtx->streams[next]->time_base) < 0)) {
+        next = (int)s;
+        nextTS = headTS;
+      }
+    }
+    if (next < 0) break;
+
+    if (!(flushAll || ready || (nextTS == AV_NOPTS_VALUE))) {
+      // A stream has stalled - only release once the queue spans the max delay
+      int64_t nextUS = av_rescale_q(nextTS, fmtCtx->streams[next]->time_base, AV_TIME_BASE_Q);
+      if (newestTS - nextUS <= fmtCtx->max_interleave_delta) break;
+    }
+
+    AVPacket *pkt = mQueues[next].front();
+    mQueues[next].pop_front();
+    mQueued--;
+    done.push_back(pkt);
+    if (mSegmenter && ((ret = mSegmenter->beforePacket(fmtCtx, pkt, false)) < 0)) return ret;
+    if ((ret = av_write_frame(fmtCtx, pkt)) < 0) return ret;
+  }
+  return 0;
+}
+
+void interleaverFinalizer(napi_env env, void* data, void* hint) {
+  Interleaver *interleaver = (Interleaver*) data;
+  delete interleaver;
+}
+
+// Collect new references to the packets of an array, or of the packets
+// property of an encode result, leaving them owned by the caller
+napi_status getPacketRefs(napi_env env, napi_value value, std::vector<AVPacket*> &packets) {
+  napi_status status;
+  napi_value element, prop;
+  napi_valuetype type;
+  packetData* p;
+  bool isArray;
+  uint32_t count;
+
+  status = napi_is_array(env, value, &isArray);
+  PASS_STATUS;
+  if (!isArray) {
+    status = napi_get_named_property(env, value, "packets", &value);
+    PASS_STATUS;
+    status = napi_is_array(env, value, &isArray);
+    PASS_STATUS;
+    if (!isArray) return napi_array_expected;
+  }
+  status = napi_get_array_length(env, value, &count);
+  PASS_STATUS;
+  packets.reserve(packets.size() + count);
+  for (uint32_t i = 0; i < count; ++i) {
+    status = napi_get_element(env, value, i, &element);
+    PASS_STATUS;
+    status = napi_typeof(env, element, &type);
+    PASS_STATUS;
+    if (type != napi_object) return napi_object_expected;
+    status = napi_get_named_property(env, element, "_packet", &prop);
+    PASS_STATUS;
+    status = napi_get_value_external(env, prop, (void**) &p);
+    PASS_STATUS;
+    AVPacket *pkt = av_packet_alloc();
+    if (av_packet_ref(pkt, p->packet) < 0) {
+      av_packet_free(&pkt);
+      return napi_generic_failure;
+    }
+    packets.push_back(pkt);
+  }
+  return napi_ok;
+}
+
+void interleaveExecute(napi_env env, void* data) {
+  interleaveCarrier* c = (interleaveCarrier*) data;
+  int ret;
+  interruptScope scope(Interrupter::of(c->format));
+  if (scope.cancelled()) {
+    c->status = BEAMCODER_ERROR_WRITE_FRAME;
+    c->errorMsg = "Error writing interleaved packet: operation cancelled.";
+    return;
+  }
+
+  for (auto it = c->packets.begin(); it != c->packets.end(); ++it) {
+    AVPacket *pkt = *it;
+    if (c->streamIndex >= 0) pkt->stream_index = c->streamIndex;
+    if ((pkt->stream_index < 0) || (pkt->stream_index >= (int) c->format->nb_streams)) {
+      c->status = BEAMCODER_INVALID_ARGS;
+      c->errorMsg = "Interleaved packet has a stream index that is out of range.";
+      return;
+    }
+    if (c->timeBase.num > 0)
+      av_packet_rescale_ts(pkt, c->timeBase, c->format->streams[pkt->stream_index]->time_base);
+  }
+
+  ret = c->interleaver->push(c->format, c->packets,
+    c->final ? c->streamIndex : -1, c->done);
+  c->queued = c->interleaver->queued();
+  if (ret < 0) {
+    c->status = BEAMCODER_ERROR_WRITE_FRAME;
+    c->errorMsg = interruptErrorMsg(Interrupter::of(c->format),
+      "Error writing interleaved packet: ", ret);
+    return;
+  }
+}
+
+void interleaveComplete(napi_env env, napi_status asyncStatus, void* data) {
+  napi_value result;
+  interleaveCarrier* c = (interleaveCarrier*) data;
+
+  if (asyncStatus != napi_ok) {
+    c->status = asyncStatus;
+    c->errorMsg = "Interleave failed to complete.";
+  }
+  REJECT_STATUS;
+
+  // tidy up adaptor chunks if required
+  if (c->adaptor) {
+    c->status = c->adaptor->finaliseBufs(env);
+    REJECT_STATUS;
+  }
+
+  c->status = napi_create_object(env, &result);
+  REJECT_STATUS;
+  c->status = beam_set_uint32(env, result, "written", (uint32_t) c->done.size());
+  REJECT_STATUS;
+  c->status = beam_set_uint32(env, result, "queued", (uint32_t) c->queued);
+  REJECT_STATUS;
+
+  napi_status status;
+  status = napi_resolve_deferred(env, c->_deferred, result);
+  FLOATING_STATUS;
+
+  tidyCarrier(env, c);
+}
+
+napi_value interleave(napi_env env, napi_callback_info info) {
+  napi_value promise, formatJS, formatExt, adaptorExt, interleaverExt, resourceName, prop;
+  napi_valuetype type;
+  bool isArray, hasProp, present;
+  interleaveCarrier* c = new interleaveCarrier;
+
+  c->status = napi_create_promise(env, &c->_deferred, &promise);
+  REJECT_RETURN;
+
+  size_t argc = 1;
+  napi_value args[1];
+  c->status = napi_get_cb_info(env, info, &argc, args, &formatJS, nullptr);
+  REJECT_RETURN;
+  c->status = napi_get_named_property(env, formatJS, "_formatContext", &formatExt);
+  REJECT_RETURN;
+  c->status = napi_get_value_external(env, formatExt, (void**) &c->format);
+  REJECT_RETURN;
+  c->status = napi_get_named_property(env, formatJS, "_adaptor", &adaptorExt);
+  REJECT_RETURN;
+  c->status = napi_get_value_external(env, adaptorExt, (void**)&c->adaptor);
+  REJECT_RETURN;
+  c->status = napi_get_named_property(env, formatJS, "_interleaver", &interleaverExt);
+  REJECT_RETURN;
+  c->status = napi_get_value_external(env, interleaverExt, (void**)&c->interleaver);
+  REJECT_RETURN;
+
+  if (c->format->max_interleave_delta <= 0) {
+    REJECT_ERROR_RETURN("Interleave requires a max_interleave_delta greater than zero, "
+      "so that packets queued behind a stalled stream are released.", BEAMCODER_INVALID_ARGS);
+  }
+  if (argc != 1) {
+    REJECT_ERROR_RETURN("Interleave requires an array of packets or an options object.",
+      BEAMCODER_INVALID_ARGS);
+  }
+  c->status = napi_typeof(env, args[0], &type);
+  REJECT_RETURN;
+  c->status = napi_is_array(env, args[0], &isArray);
+  REJECT_RETURN;
+  if (type != napi_object) {
+    REJECT_ERROR_RETURN("Interleave requires an array of packets or an options object.",
+      BEAMCODER_INVALID_ARGS);
+  }
+
+  if (!isArray) {
+    c->status = napi_has_named_property(env, args[0], "stream_index", &hasProp);
+    REJECT_RETURN;
+    if (hasProp) {
+      c->status = beam_get_int32(env, args[0], "stream_index", &c->streamIndex);
+      REJECT_RETURN;
+      if ((c->streamIndex < 0) || (c->streamIndex >= (int) c->format->nb_streams)) {
+        REJECT_ERROR_RETURN("Interleave stream_index is out of range.",
+          BEAMCODER_INVALID_ARGS);
+      }
+    }
+    c->status = napi_has_named_property(env, args[0], "time_base", &hasProp);
+    REJECT_RETURN;
+    if (hasProp) {
+      c->status = beam_get_rational(env, args[0], "time_base", &c->timeBase);
+      REJECT_RETURN;
+    }
+    c->status = beam_get_bool(env, args[0], "final", &present, &c->final);
+    REJECT_RETURN;
+    if (!present) c->final = false;
+    if (c->final && (c->streamIndex < 0)) {
+      REJECT_ERROR_RETURN("Interleave requires a stream_index to mark a stream as final.",
+        BEAMCODER_INVALID_ARGS);
+    }
+    c->status = napi_get_named_property(env, args[0], "packets", &prop);
+    REJECT_RETURN;
+    c->status = napi_typeof(env, prop, &type);
+    REJECT_RETURN;
+  } else {
+    prop = args[0];
+  }
+
+  if (type != napi_undefined) {
+    c->status = getPacketRefs(env, prop, c->packets);
+    if (c->status != napi_ok) {
+      REJECT_ERROR_RETURN("Interleave packets must be an array of packets or an encode result.",
+        BEAMCODER_INVALID_ARGS);
+    }
+  }
+
+  c->status = napi_create_string_utf8(env, "Interleave", NAPI_AUTO_LENGTH, &resourceName);
+  REJECT_RETURN;
+  c->status = napi_create_async_work(env, nullptr, resourceName, interleaveExecute,
+    interleaveComplete, c, &c->_request);
+  REJECT_RETURN;
+  c->status = napi_queue_async_work(env, c->_request);
+  REJECT_RETURN;
+
+  return promise;
+}
+
 void writeTrailerExecute(napi_env env, void* data) {
   writeTrailerCarrier* c = (writeTrailerCarrier*) data;
   int retWrite = 0, retClose = 0;
+  interruptScope scope(Interrupter::of(c->format));
+  if (scope.cancelled()) {
+    c->status = BEAMCODER_ERROR_WRITE_TRAILER;
+    c->errorMsg = "Error writing trailer: operation cancelled.";
+    return;
+  }
 
-  retWrite = av_write_trailer(c->format);
+  retWrite = c->interleaver->drain(c->format, c->done);
+  std::lock_guard<std::mutex> lk(c->interleaver->writeLock());
+  if (scope.cancelled()) {
+    c->status = BEAMCODER_ERROR_WRITE_TRAILER;
+    c->errorMsg = "Error writing trailer: operation cancelled.";
+    return;
+  }
+  if (retWrite >= 0)
+    retWrite = av_write_trailer(c->format);
   if (c->format->pb != nullptr) {
     if (c->adaptor) {
       c->adaptor->finish();
       avio_context_free(&c->format->pb);
+    } else if (c->segmenter) {
+      c->segmenter->cutFinal(c->format);
+      avio_context_free(&c->format->pb);
+      if (c->packager && (c->packager->finish() < 0)) {
+        c->status = BEAMCODER_ERROR_WRITE_TRAILER;
+        c->errorMsg = "Error writing packaged output: " + c->packager->error();
+        return;
+      }
+    } else if (c->memoryOutput) {
+      avio_context_free(&c->format->pb);
+      retClose = c->memoryOutput->finish();
     }
     else
       retClose = avio_closep(&c->format->pb);
@@ -744,7 +1387,8 @@ void writeTrailerExecute(napi_env env, void* data) {
   }
   if (retWrite < 0) {
     c->status = BEAMCODER_ERROR_WRITE_TRAILER;
-    c->errorMsg = avErrorMsg("Error writing trailer: ", retWrite);
+    c->errorMsg = interruptErrorMsg(Interrupter::of(c->format),
+      "Error writing trailer: ", retWrite);
     return;
   }
   if (retClose < 0) {
@@ -764,7 +1408,11 @@ void writeTrailerComplete(napi_env env, napi_status asyncStatus, void* data) {
   }
   REJECT_STATUS;
 
-  c->status = napi_get_undefined(env, &result);
+  if (c->memoryOutput) {
+    c->status = c->memoryOutput->toJS(env, &result);
+  } else {
+    c->status = napi_get_undefined(env, &result);
+  }
   REJECT_STATUS;
 
   napi_status status;
@@ -775,7 +1423,8 @@ void writeTrailerComplete(napi_env env, napi_status asyncStatus, void* data) {
 }
 
 napi_value writeTrailer(napi_env env, napi_callback_info info) {
-  napi_value promise, formatJS, formatExt, adaptorExt, resourceName;
+  napi_value promise, formatJS, formatExt, adaptorExt, interleaverExt, segmenterExt, packagerExt,
+    memoryOutputExt, resourceName;
   writeTrailerCarrier* c = new writeTrailerCarrier;
 
   c->status = napi_create_promise(env, &c->_deferred, &promise);
@@ -792,6 +1441,22 @@ napi_value writeTrailer(napi_env env, napi_callback_info info) {
   REJECT_RETURN;
   c->status = napi_get_value_external(env, adaptorExt, (void**) &c->adaptor);
   REJECT_RETURN;
+  c->status = napi_get_named_property(env, formatJS, "_interleaver", &interleaverExt);
+  REJECT_RETURN;
+  c->status = napi_get_value_external(env, interleaverExt, (void**) &c->interleaver);
+  REJECT_RETURN;
+  c->status = napi_get_named_property(env, formatJS, "_segmenter", &segmenterExt);
+  REJECT_RETURN;
+  c->status = napi_get_value_external(env, segmenterExt, (void**) &c->segmenter);
+  REJECT_RETURN;
+  c->status = napi_get_named_property(env, formatJS, "_packager", &packagerExt);
+  REJECT_RETURN;
+  c->status = napi_get_value_external(env, packagerExt, (void**) &c->packager);
+  REJECT_RETURN;
+  c->status = napi_get_named_property(env, formatJS, "_memoryOutput", &memoryOutputExt);
+  REJECT_RETURN;
+  c->status = napi_get_value_external(env, memoryOutputExt, (void**) &c->memoryOutput);
+  REJECT_RETURN;
 
   c->status = napi_create_string_utf8(env, "WriteTrailer", NAPI_AUTO_LENGTH, &resourceName);
   REJECT_RETURN;
@@ -806,8 +1471,10 @@ napi_value writeTrailer(napi_env env, napi_callback_info info) {
 
 napi_value forceClose(napi_env env, napi_callback_info info) {
   napi_status status;
-  napi_value result, formatJS, formatExt;
+  napi_value result, formatJS, formatExt, interleaverExt, adaptorExt;
   AVFormatContext* format;
+  Interleaver* interleaver;
+  Adaptor* adaptor;
   int ret;
 
   size_t argc = 0;
@@ -818,7 +1485,25 @@ napi_value forceClose(napi_env env, napi_callback_info info) {
   status = napi_get_value_external(env, formatExt, (void**) &format);
   CHECK_STATUS;
 
-  if (format->pb != nullptr) {
+  status = napi_get_named_property(env, formatJS, "_interleaver", &interleaverExt);
+  CHECK_STATUS;
+  status = napi_get_value_external(env, interleaverExt, (void**) &interleaver);
+  CHECK_STATUS;
+  status = napi_get_named_property(env, formatJS, "_adaptor", &adaptorExt);
+  CHECK_STATUS;
+  status = napi_get_value_external(env, adaptorExt, (void**) &adaptor);
+  CHECK_STATUS;
+
+  Interrupter* interrupter = Interrupter::of(format);
+  if (interrupter != nullptr) interrupter->cancel();
+  // A write to a full stream adaptor waits for a reader on this thread
+  if (adaptor != nullptr) adaptor->finish();
+  // Cancelled writes return promptly, and later writes see the cancel
+  std::lock_guard<std::mutex> lk(interleaver->writeLock());
+
+  if ((format->pb != nullptr) && (format->flags & AVFMT_FLAG_CUSTOM_IO)) {
+    avio_context_free(&format->pb);
+  } else if (format->pb != nullptr) {
     ret = avio_closep(&format->pb);
     if (ret < 0) {
       NAPI_THROW_ERROR(avErrorMsg("Failed to force close muxer resource: ", ret));
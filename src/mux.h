@@ -27,11 +27,50 @@
 #include "format.h"
 #include "frame.h"
 #include "adaptor.h"
+#include "segmenter.h"
+#include "packager.h"
+#include "memoryoutput.h"
+#include <vector>
+#include <deque>
 
 extern "C" {
   #include <libavformat/avformat.h>
 }
 
+// Native multi-stream interleaving queue attached to a muxer. Packets are held
+// per stream and written in dts order once every active stream has a packet
+// queued, or once the queue spans more than the muxer's max_interleave_delta.
+class Interleaver {
+public:
+  Interleaver(Segmenter *segmenter) : mSegmenter(segmenter) {}
+  ~Interleaver();
+
+  // Queue packets that are already in their stream's time base, taking
+  // ownership, then write all that can be released. Written packets are handed
+  // back through done so that they are freed on the main thread.
+  int push(AVFormatContext *fmtCtx, std::vector<AVPacket*> &packets,
+    int endStream, std::vector<AVPacket*> &done);
+  // Write everything that is queued, ahead of the trailer
+  int drain(AVFormatContext *fmtCtx, std::vector<AVPacket*> &done);
+  size_t queued();
+  // Held while writing to the muxer by push and drain, and by every other
+  // write, so that forceClose can wait for the write in progress before
+  // freeing the muxer's IO context
+  std::mutex& writeLock() { return m; }
+
+private:
+  int release(AVFormatContext *fmtCtx, bool flushAll, std::vector<AVPacket*> &done);
+
+  Segmenter *mSegmenter;
+  std::mutex m;
+  std::vector<std::deque<AVPacket*> > mQueues;
+  std::vector<bool> mEnded;
+  size_t mQueued = 0;
+};
+
+void interleaverFinalizer(napi_env env, void* data, void* hint);
+napi_status getPacketRefs(napi_env env, napi_value value, std::vector<AVPacket*> &packets);
+
 napi_value muxer(napi_env env, napi_callback_info info); // Set to interleaving once
 
 void openIOExecute(napi_env env, void* data);
@@ -50,6 +89,10 @@ void writeFrameExecute(napi_env env, void* data);
 void writeFrameComplete(napi_env env, napi_status asyncStatus, void* data);
 napi_value writeFrame(napi_env env, napi_callback_info info); // IF AVFrame, must include stream_index
 
+void interleaveExecute(napi_env env, void* data);
+void interleaveComplete(napi_env env, napi_status asyncStatus, void* data);
+napi_value interleave(napi_env env, napi_callback_info info);
+
 void writeTrailerExecute(napi_env env, void* data);
 void writeTrailerComplete(napi_env env, napi_status asyncStatus, void* data);
 napi_value writeTrailer(napi_env env, napi_callback_info info);
@@ -58,6 +101,7 @@ napi_value forceClose(napi_env env, napi_callback_info info);
 
 struct openIOCarrier : carrier {
   AVFormatContext* format;
+  Interleaver *interleaver = nullptr;
   int flags = AVIO_FLAG_WRITE;
   AVDictionary* options = nullptr;
   ~openIOCarrier() {
@@ -67,6 +111,8 @@ struct openIOCarrier : carrier {
 
 struct writeHeaderCarrier : carrier {
   AVFormatContext* format;
+  Interleaver *interleaver = nullptr;
+  Segmenter *segmenter = nullptr;
   AVDictionary* options = nullptr;
   int result = -1;
   ~writeHeaderCarrier() {
@@ -76,6 +122,7 @@ struct writeHeaderCarrier : carrier {
 
 struct initOutputCarrier : carrier {
   AVFormatContext* format;
+  Interleaver *interleaver = nullptr;
   AVDictionary* options = nullptr;
   int result = -1;
   ~initOutputCarrier() {
@@ -85,21 +132,48 @@ struct initOutputCarrier : carrier {
 
 struct writeFrameCarrier : carrier {
   AVFormatContext* format;
+  Interleaver *interleaver = nullptr;
   Adaptor *adaptor = nullptr;
+  Segmenter *segmenter = nullptr;
   AVPacket* packet = nullptr;
+  std::vector<AVPacket*> packets;
+  bool batch = false;
   AVFrame* frame = nullptr;
   int streamIndex = 0;
   bool interleaved = true;
   ~writeFrameCarrier() {
     if (packet != nullptr) { av_packet_free(&packet); }
+    for (auto it = packets.begin(); it != packets.end(); ++it) av_packet_free(&(*it));
     if (frame != nullptr) { av_frame_free(&frame); }
   }
 };
 
+struct interleaveCarrier : carrier {
+  AVFormatContext* format;
+  Adaptor *adaptor = nullptr;
+  Interleaver *interleaver = nullptr;
+  std::vector<AVPacket*> packets;
+  std::vector<AVPacket*> done;
+  int streamIndex = -1;
+  AVRational timeBase = { 0, 1 };
+  bool final = false;
+  size_t queued = 0;
+  ~interleaveCarrier() {
+    for (auto it = packets.begin(); it != packets.end(); ++it) av_packet_free(&(*it));
+    for (auto it = done.begin(); it != done.end(); ++it) av_packet_free(&(*it));
+  }
+};
+
 struct writeTrailerCarrier : carrier {
   AVFormatContext* format;
   Adaptor *adaptor = nullptr;
+  Segmenter *segmenter = nullptr;
+  Packager *packager = nullptr;
+  MemoryOutput *memoryOutput = nullptr;
+  Interleaver *interleaver = nullptr;
+  std::vector<AVPacket*> done;
   ~writeTrailerCarrier() {
+    for (auto it = done.begin(); it != done.end(); ++it) av_packet_free(&(*it));
   }
 };
 
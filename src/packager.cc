@@ -0,0 +1,302 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#include "packager.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <cerrno>
+#include <sstream>
+
+#ifdef _WIN32
+  #include <io.h>
+  #include <direct.h>
+  #include <windows.h>
+#else
+  #include <unistd.h>
+  #include <sys/stat.h>
+#endif
+
+Packager::Packager(const std::string &directory, bool dash, const std::string &playlist,
+    const std::string &prefix, uint32_t window)
+  : mDirectory(directory), mDash(dash), mPlaylist(playlist), mPrefix(prefix), mWindow(window) {
+  char timeStr[32];
+  time_t now = time(nullptr);
+  strftime(timeStr, sizeof(timeStr), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+  mStartTime = timeStr;
+  mThread = std::thread(&Packager::run, this);
+}
+
+Packager::~Packager() {
+  {
+    std::lock_guard<std::mutex> lk(m);
+    mStop = true;
+    cv.notify_all();
+  }
+  if (mThread.joinable()) mThread.join();
+  for (auto &j : mJobs) BufferPool::instance().release(j.segment.data, j.segment.capacity);
+}
+
+void Packager::submit(const segmentInfo &segment) {
+  job j;
+  j.segment = segment;
+  if (!segment.init)
+    j.seconds = segment.duration * av_q2d(segment.timeBase);
+  j.video = segment.mediaType != AVMEDIA_TYPE_AUDIO;
+  std::lock_guard<std::mutex> lk(m);
+  mJobs.push_back(j);
+  cv.notify_all();
+}
+
+bool Packager::ensureDirectory(const std::string &directory) {
+#ifdef _WIN32
+  const char *separators = "/\\";
+#else
+  const char *separators = "/";
+#endif
+  if (directory.empty()) return false;
+  // Each missing parent in turn, then the directory itself
+  size_t pos = directory.find_first_not_of(separators);
+  while (pos != std::string::npos) {
+    pos = directory.find_first_of(separators, pos);
+    std::string path = directory.substr(0, pos);
+#ifdef _WIN32
+    if ((path.back() != ':') && // not a drive letter
+        (_mkdir(path.c_str()) != 0) && (errno != EEXIST)) return false;
+#else
+    if ((mkdir(path.c_str(), 0755) != 0) && (errno != EEXIST)) return false;
+#endif
+    pos = directory.find_first_not_of(separators, pos);
+  }
+  return true;
+}
+
+bool Packager::failed() {
+  std::lock_guard<std::mutex> lk(m);
+  return mFailed;
+}
+
+std::string Packager::error() {
+  std::lock_guard<std::mutex> lk(m);
+  return mError;
+}
+
+void Packager::fail(const std::string &msg) {
+  std::lock_guard<std::mutex> lk(m);
+  if (!mFailed) {
+    mFailed = true;
+    mError = msg;
+  }
+}
+
+int Packager::finish() {
+  {
+    std::lock_guard<std::mutex> lk(m);
+    job j;
+    j.end = true;
+    mJobs.push_back(j);
+    mStop = true;
+    cv.notify_all();
+  }
+  if (mThread.joinable()) mThread.join();
+  return failed() ? AVERROR(EIO) : 0;
+}
+
+void Packager::run() {
+  std::unique_lock<std::mutex> lk(m);
+  while (true) {
+    cv.wait(lk, [&]{ return mStop || !mJobs.empty(); });
+    if (mJobs.empty()) return; // stopped with nothing left to write
+    job j = mJobs.front();
+    mJobs.pop_front();
+    lk.unlock();
+    write(j);
+    BufferPool::instance().release(j.segment.data, j.segment.capacity);
+    lk.lock();
+  }
+}
+
+std::string Packager::segmentName(const segmentInfo &segment) const {
+  std::ostringstream name;
+  name << mPrefix;
+  if (segment.init) name << "init.mp4";
+  else name << segment.sequence << ".m4s";
+  return name.str();
+}
+
+bool Packager::writeFile(const std::string &name, const uint8_t *data, size_t size) {
+  std::string path = mDirectory + "/" + name;
+  std::string tmpPath = mDirectory + "/." + name + ".tmp";
+  FILE *f = fopen(tmpPath.c_str(), "wb");
+  if (nullptr == f) {
+    fail("Packager failed to create file " + tmpPath);
+    return false;
+  }
+  bool ok = (fwrite(data, 1, size, f) == size) && (0 == fflush(f));
+#ifdef _WIN32
+  ok = ok && (0 == _commit(_fileno(f)));
+#else
+  ok = ok && (0 == fsync(fileno(f)));
+#endif
+  ok = (0 == fclose(f)) && ok;
+  if (ok) {
+#ifdef _WIN32
+    ok = MoveFileExA(tmpPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    ok = 0 == rename(tmpPath.c_str(), path.c_str());
+#endif
+  }
+  if (!ok) {
+    remove(tmpPath.c_str());
+    fail("Packager failed to write file " + path);
+  }
+  return ok;
+}
+
+void Packager::write(job &j) {
+  if (!j.end) {
+    if (!writeFile(segmentName(j.segment), j.segment.data, j.segment.size)) return;
+    if (j.segment.init) { // Playlists only change with media segments
+      mStreams = j.segment.streams;
+      return;
+    }
+
+    mTimeBase = j.segment.timeBase;
+    mVideo = j.video;
+    mTargetDuration = std::max(mTargetDuration, j.seconds);
+    entry e = { j.segment.sequence, j.seconds, j.segment.pts, j.segment.duration, j.segment.size };
+    mEntries.push_back(e);
+    while ((mWindow > 0) && (mEntries.size() > mWindow)) {
+      segmentInfo expired;
+      expired.sequence = mEntries.front().sequence;
+      mExpired.push_back(segmentName(expired));
+      mEntries.pop_front();
+    }
+  }
+
+  std::string playlist = mDash ? playlistDASH(j.end) : playlistHLS(j.end);
+  if (!writeFile(mPlaylist, (const uint8_t *)playlist.data(), playlist.size())) return;
+
+  // Segments stay on disk for a further window after leaving the playlist,
+  // for clients that fetched the previous playlist
+  while (mExpired.size() > mWindow) {
+    remove((mDirectory + "/" + mExpired.front()).c_str());
+    mExpired.pop_front();
+  }
+}
+
+std::string Packager::playlistHLS(bool ended) {
+  std::ostringstream pl;
+  segmentInfo init;
+  init.init = true;
+  pl << "#EXTM3U\n";
+  pl << "#EXT-X-VERSION:7\n";
+  pl << "#EXT-X-TARGETDURATION:" << (int)ceil(mTargetDuration) << "\n";
+  pl << "#EXT-X-MEDIA-SEQUENCE:" << (mEntries.empty() ? 1 : mEntries.front().sequence) << "\n";
+  if ((0 == mWindow) && ended) pl << "#EXT-X-PLAYLIST-TYPE:VOD\n";
+  pl << "#EXT-X-MAP:URI=\"" << segmentName(init) << "\"\n";
+  char dur[32];
+  for (auto &e : mEntries) {
+    segmentInfo seg;
+    seg.sequence = e.sequence;
+    snprintf(dur, sizeof(dur), "%.6f", e.seconds);
+    pl << "#EXTINF:" << dur << ",\n" << segmentName(seg) << "\n";
+  }
+  if (ended) pl << "#EXT-X-ENDLIST\n";
+  return pl.str();
+}
+
+std::string Packager::playlistDASH(bool ended) {
+  std::ostringstream pl;
+  segmentInfo init;
+  init.init = true;
+  double total = 0.0;
+  size_t bytes = 0;
+  for (auto &e : mEntries) {
+    total += e.seconds;
+    bytes += e.bytes;
+  }
+  int64_t bandwidth = (total > 0.0) ? (int64_t)(bytes * 8 / total) : 0;
+  int64_t timescale = (mTimeBase.num > 0) ? mTimeBase.den : 1;
+  int64_t scale = (mTimeBase.num > 0) ? mTimeBase.num : 1;
+  char dur[32];
+
+  pl << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n";
+  pl << "<MPD xmlns=\"urn:mpeg:dash:schema:mpd:2011\" profiles=\"urn:mpeg:dash:profile:isoff-live:2011\"";
+  if (ended) {
+    snprintf(dur, sizeof(dur), "PT%.3fS", total);
+    pl << " type=\"static\" mediaPresentationDuration=\"" << dur << "\"";
+  } else {
+    pl << " type=\"dynamic\" availabilityStartTime=\"" << mStartTime << "\"";
+    if (mWindow > 0) {
+      snprintf(dur, sizeof(dur), "PT%.3fS", total);
+      pl << " timeShiftBufferDepth=\"" << dur << "\"";
+    }
+  }
+  snprintf(dur, sizeof(dur), "PT%.3fS", mTargetDuration);
+  pl << " minBufferTime=\"" << dur << "\">\n";
+  // Every segment holds all the muxer's streams, so the one Representation is
+  // labelled with a content component per stream when they are of mixed types
+  bool video = mStreams.empty() && mVideo, mixed = false;
+  std::string codecs;
+  for (auto &st : mStreams) {
+    if (st.mediaType == AVMEDIA_TYPE_VIDEO) video = true;
+    if (st.mediaType != mStreams.front().mediaType) mixed = true;
+    if (st.codecs.empty()) continue;
+    if (!codecs.empty()) codecs += ",";
+    codecs += st.codecs;
+  }
+  pl << "  <Period id=\"0\" start=\"PT0S\">\n";
+  pl << "    <AdaptationSet id=\"0\"";
+  if (!mixed)
+    pl << " contentType=\"" << (video ? "video" : "audio") << "\"";
+  pl << " segmentAlignment=\"true\">\n";
+  if (mixed) {
+    for (size_t i = 0; i < mStreams.size(); ++i) {
+      AVMediaType type = mStreams[i].mediaType;
+      pl << "      <ContentComponent id=\"" << i << "\" contentType=\""
+         << ((type == AVMEDIA_TYPE_VIDEO) ? "video" : (type == AVMEDIA_TYPE_AUDIO) ? "audio" :
+           (type == AVMEDIA_TYPE_SUBTITLE) ? "text" : "application") << "\"/>\n";
+    }
+  }
+  pl << "      <Representation id=\"0\" mimeType=\"" << (video ? "video/mp4" : "audio/mp4") << "\"";
+  if (!codecs.empty()) pl << " codecs=\"" << codecs << "\"";
+  pl << " bandwidth=\"" << bandwidth << "\">\n";
+  pl << "        <SegmentTemplate timescale=\"" << timescale << "\" initialization=\""
+     << segmentName(init) << "\" media=\"" << mPrefix << "$Number$.m4s\" startNumber=\""
+     << (mEntries.empty() ? 1 : mEntries.front().sequence) << "\">\n";
+  pl << "          <SegmentTimeline>\n";
+  for (auto &e : mEntries)
+    pl << "            <S t=\"" << e.pts * scale << "\" d=\"" << e.duration * scale << "\"/>\n";
+  pl << "          </SegmentTimeline>\n";
+  pl << "        </SegmentTemplate>\n";
+  pl << "      </Representation>\n";
+  pl << "    </AdaptationSet>\n";
+  pl << "  </Period>\n";
+  pl << "</MPD>\n";
+  return pl.str();
+}
+
+void packagerFinalizer(napi_env env, void* data, void* hint) {
+  Packager *packager = (Packager *)data;
+  delete packager;
+}
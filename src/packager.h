@@ -0,0 +1,101 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#ifndef PACKAGER_H
+#define PACKAGER_H
+
+#include "node_api.h"
+#include "segmenter.h"
+#include <string>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Writes segments from a Segmenter and an HLS or DASH playlist to a local
+// directory on a background I/O thread, so that file creation, fsync and
+// playlist rewrites never block the muxing worker. Every file is written to
+// a temporary name and renamed into place.
+class Packager : public SegmentSink {
+public:
+  Packager(const std::string &directory, bool dash, const std::string &playlist,
+    const std::string &prefix, uint32_t window);
+  ~Packager();
+
+  void submit(const segmentInfo &segment);
+  bool failed();
+  std::string error();
+  // Create the output directory and any missing parent directories
+  static bool ensureDirectory(const std::string &directory);
+  // Write the final playlist and wait for all outstanding writes
+  int finish();
+
+private:
+  struct job {
+    segmentInfo segment;
+    double seconds = 0.0;
+    bool video = true;
+    bool end = false;
+  };
+  struct entry {
+    uint32_t sequence;
+    double seconds;
+    int64_t pts;
+    int64_t duration;
+    size_t bytes;
+  };
+
+  void run();
+  void write(job &j);
+  bool writeFile(const std::string &name, const uint8_t *data, size_t size);
+  std::string playlistHLS(bool ended);
+  std::string playlistDASH(bool ended);
+  std::string segmentName(const segmentInfo &segment) const;
+  void fail(const std::string &msg);
+
+  const std::string mDirectory;
+  const bool mDash;
+  const std::string mPlaylist;
+  const std::string mPrefix;
+  const uint32_t mWindow;
+
+  std::mutex m;
+  std::condition_variable cv;
+  std::deque<job> mJobs;
+  bool mStop = false;
+  bool mFailed = false;
+  std::string mError;
+  std::thread mThread;
+
+  // Only touched by the I/O thread
+  std::deque<entry> mEntries;
+  std::deque<std::string> mExpired;
+  double mTargetDuration = 0.0;
+  AVRational mTimeBase = { 0, 1 };
+  bool mVideo = true;
+  std::vector<segmentStream> mStreams;
+  std::string mStartTime;
+};
+
+void packagerFinalizer(napi_env env, void* data, void* hint);
+
+#endif // PACKAGER_H
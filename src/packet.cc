@@ -197,6 +197,7 @@ napi_value setPacketData(napi_env env, napi_callback_info info) {
   if (p->packet->buf != nullptr) {
     av_buffer_unref(&p->packet->buf);
   }
+  beam_track_js_buffer(avr, true);
   p->packet->buf = av_buffer_create(data, length, packetBufferFree, avr, 0);
   CHECK_STATUS;
   p->packet->data = data;
@@ -211,6 +212,7 @@ done:
 void packetBufferFree(void* opaque, uint8_t* data) {
   napi_status status;
   avBufRef* avr = (avBufRef*) opaque;
+  beam_track_js_buffer(avr, false);
   status = napi_delete_reference(avr->env, (napi_ref) avr->ref);
   if (status != napi_ok)
     printf("DEBUG: Failed to delete buffer reference associated with an AVBufferRef.");
@@ -581,6 +583,88 @@ napi_value setPacketPos(napi_env env, napi_callback_info info) {
   return result;
 }
 
+int setPacketArrival(AVPacket* packet, int64_t arrival) {
+  // A new buffer each time, as the old one may be shared with other references
+  AVBufferRef* ref = av_buffer_alloc(sizeof(int64_t));
+  if (ref == nullptr) return AVERROR(ENOMEM);
+  memcpy(ref->data, &arrival, sizeof(int64_t));
+  av_buffer_unref(&packet->opaque_ref);
+  packet->opaque_ref = ref;
+  return 0;
+}
+
+void clearPacketArrival(AVPacket* packet) {
+  av_buffer_unref(&packet->opaque_ref);
+}
+
+bool getPacketArrival(const AVPacket* packet, int64_t* arrival) {
+  if ((packet->opaque_ref == nullptr) ||
+      (packet->opaque_ref->size != sizeof(int64_t))) return false;
+  memcpy(arrival, packet->opaque_ref->data, sizeof(int64_t));
+  return true;
+}
+
+napi_value getPacketArrivalTime(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result;
+  packetData* p;
+
+  status = napi_get_cb_info(env, info, 0, nullptr, nullptr, (void**) &p);
+  CHECK_STATUS;
+
+  int64_t arrival;
+  if (getPacketArrival(p->packet, &arrival)) {
+    status = napi_create_int64(env, arrival, &result);
+  } else {
+    status = napi_get_null(env, &result);
+  }
+  CHECK_STATUS;
+  return result;
+}
+
+napi_value setPacketArrivalTime(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result;
+  napi_valuetype type;
+  packetData* p;
+  int64_t arrival;
+
+  size_t argc = 1;
+  napi_value args[1];
+
+  status = napi_get_cb_info(env, info, &argc, args, nullptr, (void**) &p);
+  CHECK_STATUS;
+  if (argc < 1) {
+    NAPI_THROW_ERROR("Set packet arrival_time must be provided with a value.");
+  }
+  status = napi_typeof(env, args[0], &type);
+  CHECK_STATUS;
+  if (type == napi_number) {
+    status = napi_get_value_int64(env, args[0], &arrival);
+    CHECK_STATUS;
+    if (setPacketArrival(p->packet, arrival) < 0) {
+      NAPI_THROW_ERROR("Failed to allocate memory for packet arrival_time.");
+    }
+  } else if ((type == napi_null) || (type == napi_undefined)) {
+    clearPacketArrival(p->packet);
+  } else {
+    NAPI_THROW_ERROR("Packet arrival_time property must be set with a number or null.");
+  }
+
+  status = napi_get_undefined(env, &result);
+  CHECK_STATUS;
+  return result;
+}
+
+napi_value monotonicTime(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result;
+
+  status = napi_create_int64(env, av_gettime_relative(), &result);
+  CHECK_STATUS;
+  return result;
+}
+
 napi_value makePacket(napi_env env, napi_callback_info info) {
   napi_status status;
   napi_value result, global, jsObject, assign, jsJSON, jsParse;
@@ -664,7 +748,7 @@ napi_value packetToJSON(napi_env env, napi_callback_info info) {
   status = napi_create_object(env, &result);
   CHECK_STATUS;
 
-  napi_property_descriptor desc[10];
+  napi_property_descriptor desc[11];
   DECLARE_GETTER3("type", true, getPacketTypeName, p);
   DECLARE_GETTER3("pts", p->packet->pts != AV_NOPTS_VALUE, getPacketPts, p);
   DECLARE_GETTER3("dts", p->packet->dts != AV_NOPTS_VALUE, getPacketDts, p);
@@ -674,6 +758,7 @@ napi_value packetToJSON(napi_env env, napi_callback_info info) {
   DECLARE_GETTER3("side_data", p->packet->side_data != nullptr, getPacketSideData, p);
   DECLARE_GETTER3("duration", p->packet->duration > 0, getPacketDuration, p);
   DECLARE_GETTER3("pos", p->packet->pos > 0, getPacketPos, p);
+  DECLARE_GETTER3("arrival_time", p->packet->opaque_ref != nullptr, getPacketArrivalTime, p);
 
   status = napi_define_properties(env, result, count, desc);
   CHECK_STATUS;
@@ -715,10 +800,12 @@ napi_status fromAVPacket(napi_env env, packetData* p, napi_value* result) {
     // 10
     { "pos", nullptr, nullptr, getPacketPos, setPacketPos, nullptr,
       (napi_property_attributes) (napi_writable | napi_enumerable), p },
+    { "arrival_time", nullptr, nullptr, getPacketArrivalTime, setPacketArrivalTime, nullptr,
+      napi_writable, p },
     { "toJSON", nullptr, packetToJSON, nullptr, nullptr, nullptr, napi_default, p },
     { "_packet", nullptr, nullptr, nullptr, nullptr, extPacket, napi_default, nullptr }
   };
-  status = napi_define_properties(env, jsPacket, 12, desc);
+  status = napi_define_properties(env, jsPacket, 13, desc);
   PASS_STATUS;
 
   if (p->packet->buf != nullptr) {
@@ -27,6 +27,7 @@
 
 extern "C" {
   #include <libavcodec/avcodec.h>
+  #include <libavutil/time.h>
 }
 
 void packetFinalizer(napi_env env, void* data, void* hint);
@@ -43,7 +44,15 @@ struct packetData {
   }
 };
 
+// Monotonic time in microseconds (av_gettime_relative) when a demuxer read the
+// packet, held as an int64_t in the packet's opaque_ref buffer so that it
+// survives the pending queue and packet references. No buffer when not stamped.
+int setPacketArrival(AVPacket* packet, int64_t arrival);
+void clearPacketArrival(AVPacket* packet);
+bool getPacketArrival(const AVPacket* packet, int64_t* arrival);
+
 napi_value makePacket(napi_env env, napi_callback_info info);
+napi_value monotonicTime(napi_env env, napi_callback_info info);
 napi_status fromAVPacket(napi_env env, packetData* packet, napi_value* result);
 
 #endif // PACKET_H
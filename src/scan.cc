@@ -0,0 +1,290 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#include "scan.h"
+#include <cstring>
+#include <cmath>
+
+void packetColumns::push(const AVPacket* packet) {
+  streamIndex.push_back(packet->stream_index);
+  pts.push_back(packet->pts);
+  dts.push_back(packet->dts);
+  duration.push_back(packet->duration);
+  pos.push_back(packet->pos);
+  size.push_back(packet->size);
+  flags.push_back((uint8_t) packet->flags);
+}
+
+bool scanRange::wants(int streamIndex) const {
+  if (streams.empty()) return true;
+  for ( auto s : streams ) {
+    if (s == streamIndex) return true;
+  }
+  return false;
+}
+
+int scanPackets(fmtCtxRef* formatRef, const scanRange& range, packetColumns& columns) {
+  std::lock_guard<std::mutex> lk(formatRef->readLock);
+  AVFormatContext* fmtCtx = formatRef->fmtCtx;
+  if (fmtCtx == nullptr) return AVERROR(EINVAL);
+
+  // Times are from the start of the media, as for thumbnails: the start of
+  // the stream when scanning one stream, otherwise of the earliest stream
+  int64_t offset = 0;
+  if ((range.streams.size() == 1) && (range.streams[0] >= 0) &&
+      (range.streams[0] < (int) fmtCtx->nb_streams) &&
+      (fmtCtx->streams[range.streams[0]]->start_time != AV_NOPTS_VALUE)) {
+    AVStream *st = fmtCtx->streams[range.streams[0]];
+    offset = av_rescale_q(st->start_time, st->time_base, AV_TIME_BASE_Q);
+  } else if (fmtCtx->start_time != AV_NOPTS_VALUE) {
+    offset = fmtCtx->start_time;
+  }
+
+  int ret = 0;
+  if (range.start != AV_NOPTS_VALUE) {
+    interruptScope scope(formatRef->interrupter);
+    ret = scope.cancelled() ? AVERROR_EXIT :
+      av_seek_frame(fmtCtx, -1, range.start + offset, AVSEEK_FLAG_BACKWARD);
+    if (ret < 0) return ret;
+  } else {
+    // Packets held back for pulling decoders come first
+    for ( auto it = formatRef->pending.begin() ; it != formatRef->pending.end() ; it++ ) {
+      if (range.wants((*it)->stream_index)) columns.push(*it);
+    }
+  }
+  for ( auto it = formatRef->pending.begin() ; it != formatRef->pending.end() ; it++ )
+    av_packet_free(&(*it));
+  formatRef->pending.clear();
+
+  AVPacket* packet = av_packet_alloc();
+  if (packet == nullptr) return AVERROR(ENOMEM);
+
+  // Streams that are not scanned are skipped by the demuxer where it can
+  std::vector<AVDiscard> discard;
+  for ( uint32_t s = 0 ; s < fmtCtx->nb_streams ; s++ ) {
+    discard.push_back(fmtCtx->streams[s]->discard);
+    if (!range.wants(s)) fmtCtx->streams[s]->discard = AVDISCARD_ALL;
+  }
+
+  // Timeouts apply to each read, not to the scan as a whole
+  while (true) {
+    {
+      interruptScope scope(formatRef->interrupter);
+      ret = scope.cancelled() ? AVERROR_EXIT : av_read_frame(fmtCtx, packet);
+    }
+    if (ret < 0) break;
+    if (range.wants(packet->stream_index)) {
+      int64_t ts = (packet->dts != AV_NOPTS_VALUE) ? packet->dts : packet->pts;
+      if ((range.end != AV_NOPTS_VALUE) && (ts != AV_NOPTS_VALUE) &&
+          (av_compare_ts(ts, fmtCtx->streams[packet->stream_index]->time_base,
+            range.end + offset, AV_TIME_BASE_Q) >= 0)) {
+        av_packet_unref(packet);
+        break;
+      }
+      columns.push(packet);
+    }
+    av_packet_unref(packet);
+  }
+  if (ret == AVERROR_EOF) ret = 0;
+
+  // Streams added while reading keep their default
+  for ( uint32_t s = 0 ; s < discard.size() ; s++ )
+    fmtCtx->streams[s]->discard = discard[s];
+  av_packet_free(&packet);
+  return (ret < 0) ? ret : 0;
+}
+
+napi_status fromPacketColumns(napi_env env, packetColumns& columns, napi_value result) {
+  napi_status status;
+  status = beam_set_int64(env, result, "count", columns.count());
+  PASS_STATUS;
+  status = setColumn(env, result, "stream_index", napi_int32_array, columns.streamIndex);
+  PASS_STATUS;
+  status = setColumn(env, result, "pts", napi_bigint64_array, columns.pts);
+  PASS_STATUS;
+  status = setColumn(env, result, "dts", napi_bigint64_array, columns.dts);
+  PASS_STATUS;
+  status = setColumn(env, result, "duration", napi_bigint64_array, columns.duration);
+  PASS_STATUS;
+  status = setColumn(env, result, "pos", napi_bigint64_array, columns.pos);
+  PASS_STATUS;
+  status = setColumn(env, result, "size", napi_int32_array, columns.size);
+  PASS_STATUS;
+  status = setColumn(env, result, "flags", napi_uint8_array, columns.flags);
+  PASS_STATUS;
+  return napi_ok;
+}
+
+napi_status getScanRange(napi_env env, napi_value options, AVFormatContext* fmtCtx,
+    scanRange& range, const char** error) {
+  napi_status status;
+  napi_value value, element;
+  napi_valuetype type;
+  bool isArray;
+  double start = NAN, end = NAN;
+  int32_t index;
+
+  status = napi_typeof(env, options, &type);
+  PASS_STATUS;
+  if ((type == napi_undefined) || (type == napi_null)) return napi_ok;
+  if (type != napi_object) {
+    *error = "Scan options must be an object.";
+    return napi_ok;
+  }
+
+  status = napi_get_named_property(env, options, "streams", &value);
+  PASS_STATUS;
+  status = napi_is_array(env, value, &isArray);
+  PASS_STATUS;
+  if (isArray) {
+    uint32_t length;
+    status = napi_get_array_length(env, value, &length);
+    PASS_STATUS;
+    for ( uint32_t x = 0 ; x < length ; x++ ) {
+      status = napi_get_element(env, value, x, &element);
+      PASS_STATUS;
+      status = napi_get_value_int32(env, element, &index);
+      if ((status == napi_number_expected) || (index < 0) ||
+          (index >= (int32_t) fmtCtx->nb_streams)) {
+        *error = "Scan streams must be an array of stream indexes.";
+        return napi_ok;
+      }
+      PASS_STATUS;
+      range.streams.push_back(index);
+    }
+  }
+
+  status = beam_get_double(env, options, "start", &start);
+  PASS_STATUS;
+  status = beam_get_double(env, options, "end", &end);
+  PASS_STATUS;
+  if (!std::isnan(start)) range.start = (int64_t) (start * AV_TIME_BASE);
+  if (!std::isnan(end)) range.end = (int64_t) (end * AV_TIME_BASE);
+  if ((range.start != AV_NOPTS_VALUE) && (range.end != AV_NOPTS_VALUE) &&
+      (range.end <= range.start)) {
+    *error = "Scan end time must be after its start time.";
+  }
+  return napi_ok;
+}
+
+void scanExecute(napi_env env, void* data) {
+  scanCarrier* c = (scanCarrier*) data;
+  HR_TIME_POINT scanStart = NOW;
+
+  int ret = scanPackets(c->formatRef, c->range, c->columns);
+  if (ret < 0) {
+    c->status = BEAMCODER_ERROR_READ_FRAME;
+    c->errorMsg = interruptErrorMsg(c->formatRef->interrupter, "Problem scanning packets: ", ret);
+    return;
+  }
+  c->totalTime = microTime(scanStart);
+}
+
+void scanComplete(napi_env env, napi_status asyncStatus, void* data) {
+  scanCarrier* c = (scanCarrier*) data;
+  napi_value result;
+
+  if (asyncStatus != napi_ok) {
+    c->status = asyncStatus;
+    c->errorMsg = "Packet scan failed to complete.";
+  }
+  REJECT_STATUS;
+
+  // tidy up adaptor chunks if required
+  if (c->adaptor) {
+    c->status = c->adaptor->finaliseBufs(env);
+    REJECT_STATUS;
+  }
+
+  c->status = napi_create_object(env, &result);
+  REJECT_STATUS;
+  c->status = beam_set_string_utf8(env, result, "type", "packet_scan");
+  REJECT_STATUS;
+  c->status = fromPacketColumns(env, c->columns, result);
+  REJECT_STATUS;
+  c->status = beam_set_int64(env, result, "total_time", c->totalTime);
+  REJECT_STATUS;
+
+  napi_status status;
+  status = napi_resolve_deferred(env, c->_deferred, result);
+  FLOATING_STATUS;
+
+  tidyCarrier(env, c);
+}
+
+/*
+  let scan = await demuxer.scan({
+    streams: [ 0 ], // Default is all streams
+    start: 10.0, // Seconds, scan from the key frame before. Default is current position
+    end: 20.0 // Seconds, stop at the first packet with a later timestamp
+  });
+*/
+
+napi_value scan(napi_env env, napi_callback_info info) {
+  napi_value resourceName, promise, formatJS, formatRefExt, adaptorExt, options;
+  const char* error = nullptr;
+  scanCarrier* c = new scanCarrier;
+
+  c->status = napi_create_promise(env, &c->_deferred, &promise);
+  REJECT_RETURN;
+
+  size_t argc = 1;
+  napi_value args[1];
+  c->status = napi_get_cb_info(env, info, &argc, args, &formatJS, nullptr);
+  REJECT_RETURN;
+  c->status = napi_get_named_property(env, formatJS, "_formatContextRef", &formatRefExt);
+  REJECT_RETURN;
+  c->status = napi_get_value_external(env, formatRefExt, (void**) &c->formatRef);
+  REJECT_RETURN;
+  if (c->formatRef->fmtCtx == nullptr) {
+    REJECT_ERROR_RETURN("Cannot scan a closed demuxer.", BEAMCODER_INVALID_ARGS);
+  }
+
+  c->status = napi_get_named_property(env, formatJS, "_adaptor", &adaptorExt);
+  REJECT_RETURN;
+  c->status = napi_get_value_external(env, adaptorExt, (void**)&c->adaptor);
+  REJECT_RETURN;
+
+  if (argc >= 1) {
+    options = args[0];
+  } else {
+    c->status = napi_get_undefined(env, &options);
+    REJECT_RETURN;
+  }
+  c->status = getScanRange(env, options, c->formatRef->fmtCtx, c->range, &error);
+  REJECT_RETURN;
+  if (error != nullptr) {
+    REJECT_ERROR_RETURN(error, BEAMCODER_INVALID_ARGS);
+  }
+
+  c->status = napi_create_reference(env, formatJS, 1, &c->passthru);
+  REJECT_RETURN;
+
+  c->status = napi_create_string_utf8(env, "Scan", NAPI_AUTO_LENGTH, &resourceName);
+  REJECT_RETURN;
+  c->status = napi_create_async_work(env, nullptr, resourceName, scanExecute,
+    scanComplete, c, &c->_request);
+  REJECT_RETURN;
+  c->status = napi_queue_async_work(env, c->_request);
+  REJECT_RETURN;
+
+  return promise;
+}
@@ -0,0 +1,111 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#ifndef SCAN_H
+#define SCAN_H
+
+#include "node_api.h"
+#include "beamcoder_util.h"
+#include "format.h"
+#include "adaptor.h"
+#include <vector>
+#include <utility>
+
+extern "C" {
+  #include <libavformat/avformat.h>
+}
+
+// Packet metadata held column by column, one entry per packet in read order
+struct packetColumns {
+  std::vector<int32_t> streamIndex;
+  std::vector<int64_t> pts;
+  std::vector<int64_t> dts;
+  std::vector<int64_t> duration;
+  std::vector<int64_t> pos;
+  std::vector<int32_t> size;
+  std::vector<uint8_t> flags;
+  size_t count() const { return streamIndex.size(); }
+  void push(const AVPacket* packet);
+};
+
+// Streams and time range to scan. Times are in AV_TIME_BASE units from the
+// start of the media, with AV_NOPTS_VALUE for an open end. An empty stream list selects all streams.
+struct scanRange {
+  std::vector<int> streams;
+  int64_t start = AV_NOPTS_VALUE;
+  int64_t end = AV_NOPTS_VALUE;
+  bool wants(int streamIndex) const;
+};
+
+// Read packets from a demuxer, recording their metadata and discarding their
+// payloads. Called on a worker thread.
+int scanPackets(fmtCtxRef* formatRef, const scanRange& range, packetColumns& columns);
+template <typename T>
+void columnFinalizer(napi_env env, void* data, void* hint) {
+  delete (std::vector<T>*) hint;
+}
+
+// Set a named property to a typed array over the storage of values, which is
+// moved out of the vector rather than copied and freed with the array buffer
+template <typename T>
+napi_status setColumn(napi_env env, napi_value result, const char* name,
+    napi_typedarray_type type, std::vector<T>& values) {
+  napi_status status;
+  napi_value arrayBuffer, column;
+  size_t count = values.size();
+  if (0 == count) {
+    void* data;
+    status = napi_create_arraybuffer(env, 0, &data, &arrayBuffer);
+    PASS_STATUS;
+  } else {
+    std::vector<T>* storage = new std::vector<T>(std::move(values));
+    status = napi_create_external_arraybuffer(env, storage->data(), count * sizeof(T),
+      columnFinalizer<T>, storage, &arrayBuffer);
+    if (status != napi_ok) {
+      delete storage;
+      return status;
+    }
+  }
+  values.clear();
+  status = napi_create_typedarray(env, type, count, arrayBuffer, 0, &column);
+  PASS_STATUS;
+  return napi_set_named_property(env, result, name, column);
+}
+
+// Hands the storage of each column over to Javascript, leaving columns empty
+napi_status fromPacketColumns(napi_env env, packetColumns& columns, napi_value result);
+// Parse the streams, start and end options of a scan
+napi_status getScanRange(napi_env env, napi_value options, AVFormatContext* fmtCtx,
+  scanRange& range, const char** error);
+
+struct scanCarrier : carrier {
+  fmtCtxRef* formatRef = nullptr;
+  Adaptor *adaptor = nullptr;
+  scanRange range;
+  packetColumns columns;
+  ~scanCarrier() { }
+};
+
+void scanExecute(napi_env env, void* data);
+void scanComplete(napi_env env, napi_status asyncStatus, void* data);
+napi_value scan(napi_env env, napi_callback_info info);
+
+#endif // SCAN_H
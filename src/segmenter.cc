@@ -0,0 +1,308 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#include "segmenter.h"
+#include <cstdio>
+#include <cstring>
+
+Segmenter::~Segmenter() {
+  BufferPool::instance().release(mData, mCapacity);
+  for (auto &s : mDone) BufferPool::instance().release(s.data, s.capacity);
+}
+
+namespace {
+  // Profile, constraint flags and level bytes of an H.264 sequence parameter
+  // set, from avcC extradata or the first SPS of Annex B extradata
+  const uint8_t *avcProfileBytes(const AVCodecParameters *codecpar) {
+    const uint8_t *data = codecpar->extradata;
+    int size = codecpar->extradata_size;
+    if ((nullptr == data) || (size < 4)) return nullptr;
+    if (1 == data[0]) return data + 1;
+    for (int i = 0; i + 6 < size; ++i)
+      if ((0 == data[i]) && (0 == data[i + 1]) && (1 == data[i + 2]) &&
+          (7 == (data[i + 3] & 0x1f)))
+        return data + i + 4;
+    return nullptr;
+  }
+
+  std::string hevcCodecs(const AVCodecParameters *codecpar) {
+    const char *tag = (codecpar->codec_tag == MKTAG('h', 'e', 'v', '1')) ? "hev1" : "hvc1";
+    const uint8_t *data = codecpar->extradata;
+    char str[64];
+    if ((nullptr == data) || (codecpar->extradata_size < 13) || (data[0] != 1)) {
+      int profile = (codecpar->profile > 0) ? codecpar->profile : 1;
+      snprintf(str, sizeof(str), "%s.%d.%X.L%d.B0", tag, profile, 1u << profile,
+        (codecpar->level > 0) ? codecpar->level : 93);
+      return str;
+    }
+    // hvcC: profile space, tier and profile, 32 compatibility flags, 6 bytes of
+    // constraint flags, then the level
+    uint32_t compat = ((uint32_t)data[2] << 24) | (data[3] << 16) | (data[4] << 8) | data[5];
+    uint32_t reversed = 0;
+    for (int b = 0; b < 32; ++b)
+      if (compat & (1u << b)) reversed |= 1u << (31 - b);
+    int space = data[1] >> 6;
+    std::string codecs = tag;
+    codecs += ".";
+    if (space > 0) codecs += (char)('A' + space - 1);
+    snprintf(str, sizeof(str), "%d.%X.%c%d", data[1] & 0x1f, reversed,
+      (data[1] & 0x20) ? 'H' : 'L', data[12]);
+    codecs += str;
+    int last = 11;
+    while ((last >= 6) && (0 == data[last])) --last;
+    for (int b = 6; b <= last; ++b) {
+      snprintf(str, sizeof(str), ".%X", data[b]);
+      codecs += str;
+    }
+    return codecs;
+  }
+
+  int bitDepth(const AVCodecParameters *codecpar) {
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((AVPixelFormat)codecpar->format);
+    return (desc != nullptr) ? desc->comp[0].depth : 8;
+  }
+}
+
+std::string codecsString(const AVCodecParameters *codecpar) {
+  char str[64];
+  const uint8_t *data = codecpar->extradata;
+  int size = codecpar->extradata_size;
+  switch (codecpar->codec_id) {
+  case AV_CODEC_ID_H264: {
+    const uint8_t *sps = avcProfileBytes(codecpar);
+    if (sps != nullptr)
+      snprintf(str, sizeof(str), "avc1.%02X%02X%02X", sps[0], sps[1], sps[2]);
+    else
+      snprintf(str, sizeof(str), "avc1.%02X00%02X", (codecpar->profile > 0) ?
+        codecpar->profile & 0xff : 66, (codecpar->level > 0) ? codecpar->level : 30);
+    return str;
+  }
+  case AV_CODEC_ID_HEVC:
+    return hevcCodecs(codecpar);
+  case AV_CODEC_ID_AV1:
+    if ((data != nullptr) && (size >= 4) && (0x81 == data[0])) { // av1C
+      int depth = (data[2] & 0x40) ? ((data[2] & 0x20) ? 12 : 10) : 8;
+      snprintf(str, sizeof(str), "av01.%d.%02d%c.%02d", data[1] >> 5, data[1] & 0x1f,
+        (data[2] & 0x80) ? 'H' : 'M', depth);
+    } else {
+      snprintf(str, sizeof(str), "av01.%d.%02dM.%02d", (codecpar->profile > 0) ?
+        codecpar->profile : 0, (codecpar->level > 0) ? codecpar->level : 0, bitDepth(codecpar));
+    }
+    return str;
+  case AV_CODEC_ID_VP9:
+    snprintf(str, sizeof(str), "vp09.%02d.%02d.%02d", (codecpar->profile > 0) ?
+      codecpar->profile : 0, (codecpar->level > 0) ? codecpar->level : 10, bitDepth(codecpar));
+    return str;
+  case AV_CODEC_ID_MPEG4: return "mp4v.20";
+  case AV_CODEC_ID_MJPEG: return "mp4v.6C";
+  case AV_CODEC_ID_AAC: {
+    // Audio object type from the AudioSpecificConfig, else from the profile
+    int objectType = ((data != nullptr) && (size >= 1)) ? data[0] >> 3 :
+      ((codecpar->profile >= 0) ? codecpar->profile + 1 : 2);
+    snprintf(str, sizeof(str), "mp4a.40.%d", (objectType > 0) ? objectType : 2);
+    return str;
+  }
+  case AV_CODEC_ID_MP3: return "mp4a.6B";
+  case AV_CODEC_ID_AC3: return "ac-3";
+  case AV_CODEC_ID_EAC3: return "ec-3";
+  case AV_CODEC_ID_OPUS: return "opus";
+  case AV_CODEC_ID_FLAC: return "fLaC";
+  default: return "";
+  }
+}
+
+int Segmenter::writePacket(void *opaque, uint8_t *buf, int bufSize) {
+  Segmenter *segmenter = (Segmenter *)opaque;
+  return segmenter->append(buf, bufSize);
+}
+
+int Segmenter::append(const uint8_t *buf, int bufSize) {
+  uint8_t *data = growPooled(mData, mSize, mSize + bufSize, &mCapacity);
+  if (nullptr == data) return AVERROR(ENOMEM);
+  mData = data;
+  memcpy(mData + mSize, buf, bufSize);
+  mSize += bufSize;
+  return bufSize;
+}
+
+void Segmenter::cut(bool init, AVFormatContext *fmtCtx) {
+  if (0 == mSize) return;
+  segmentInfo s;
+  s.init = init;
+  s.sequence = init ? 0 : ++mSequence;
+  if (!init && (mStreamIndex >= 0)) {
+    s.pts = mStartPTS;
+    s.duration = ((mStartPTS != AV_NOPTS_VALUE) && (mEndPTS != AV_NOPTS_VALUE)) ?
+      mEndPTS - mStartPTS : 0;
+    s.timeBase = fmtCtx->streams[mStreamIndex]->time_base;
+    s.streamIndex = mStreamIndex;
+    s.mediaType = fmtCtx->streams[mStreamIndex]->codecpar->codec_type;
+    s.keyframe = mStartKey;
+  }
+  if (init) {
+    for (uint32_t i = 0; i < fmtCtx->nb_streams; ++i) {
+      segmentStream stream;
+      stream.mediaType = fmtCtx->streams[i]->codecpar->codec_type;
+      stream.codecs = codecsString(fmtCtx->streams[i]->codecpar);
+      s.streams.push_back(stream);
+    }
+  }
+  s.data = mData;
+  s.size = mSize;
+  s.capacity = mCapacity;
+  mData = nullptr;
+  mSize = 0;
+  mCapacity = 0;
+  mHasMedia = false;
+  mStartKey = false;
+  mStartPTS = AV_NOPTS_VALUE;
+  mEndPTS = AV_NOPTS_VALUE;
+
+  if (mSink) {
+    mSink->submit(s);
+    return;
+  }
+  std::lock_guard<std::mutex> lk(m);
+  mDone.push_back(s);
+}
+
+int Segmenter::cutInit(AVFormatContext *fmtCtx) {
+  avio_flush(fmtCtx->pb);
+  cut(true, fmtCtx);
+  return 0;
+}
+
+int Segmenter::beforePacket(AVFormatContext *fmtCtx, const AVPacket *pkt, bool interleaved) {
+  int ret;
+  if (mStreamIndex < 0) { // Default to the first video stream
+    mStreamIndex = 0;
+    for (uint32_t s = 0; s < fmtCtx->nb_streams; ++s)
+      if (fmtCtx->streams[s]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+        mStreamIndex = (int)s;
+        break;
+      }
+  }
+  if (mSink && mSink->failed()) return AVERROR(EIO);
+  if (pkt->stream_index != mStreamIndex) return 0;
+
+  bool key = (pkt->flags & AV_PKT_FLAG_KEY) != 0;
+  AVRational tb = fmtCtx->streams[mStreamIndex]->time_base;
+  if (mHasMedia && (mStartPTS != AV_NOPTS_VALUE) && (pkt->pts != AV_NOPTS_VALUE)) {
+    bool boundary = (mDuration > 0.0) ?
+      ((pkt->pts - mStartPTS) * av_q2d(tb) >= mDuration) && (!mKeyframes || key) :
+      mKeyframes && key;
+    if (boundary) {
+      // Push out anything held for interleaving, then close the fragment
+      if (interleaved && ((ret = av_interleaved_write_frame(fmtCtx, nullptr)) < 0)) return ret;
+      if ((ret = av_write_frame(fmtCtx, nullptr)) < 0) return ret;
+      avio_flush(fmtCtx->pb);
+      cut(false, fmtCtx);
+    }
+  }
+
+  if (!mHasMedia) {
+    mHasMedia = true;
+    mStartKey = key;
+    mStartPTS = pkt->pts;
+  } else if ((pkt->pts != AV_NOPTS_VALUE) &&
+      ((mStartPTS == AV_NOPTS_VALUE) || (pkt->pts < mStartPTS))) {
+    mStartPTS = pkt->pts;
+  }
+  if (pkt->pts != AV_NOPTS_VALUE) {
+    int64_t end = pkt->pts + pkt->duration;
+    if ((mEndPTS == AV_NOPTS_VALUE) || (end > mEndPTS)) mEndPTS = end;
+  }
+  return 0;
+}
+
+int Segmenter::cutFinal(AVFormatContext *fmtCtx) {
+  avio_flush(fmtCtx->pb);
+  cut(false, fmtCtx);
+  return 0;
+}
+
+std::vector<segmentInfo> Segmenter::take() {
+  std::lock_guard<std::mutex> lk(m);
+  std::vector<segmentInfo> result(mDone.begin(), mDone.end());
+  mDone.clear();
+  return result;
+}
+
+void segmenterFinalizer(napi_env env, void* data, void* hint) {
+  Segmenter *segmenter = (Segmenter *)data;
+  delete segmenter;
+}
+
+napi_value segments(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result, formatJS, segmenterExt, segment, buffer;
+  Segmenter *segmenter;
+
+  size_t argc = 0;
+  status = napi_get_cb_info(env, info, &argc, nullptr, &formatJS, nullptr);
+  CHECK_STATUS;
+  status = napi_get_named_property(env, formatJS, "_segmenter", &segmenterExt);
+  CHECK_STATUS;
+  status = napi_get_value_external(env, segmenterExt, (void**) &segmenter);
+  CHECK_STATUS;
+
+  status = napi_create_array(env, &result);
+  CHECK_STATUS;
+  if (nullptr == segmenter) return result;
+
+  std::vector<segmentInfo> done = segmenter->take();
+  for (size_t i = 0; i < done.size(); ++i) {
+    segmentInfo &s = done[i];
+    status = napi_create_object(env, &segment);
+    CHECK_STATUS;
+    status = beam_set_string_utf8(env, segment, "type", s.init ? "init" : "media");
+    CHECK_STATUS;
+    status = beam_set_uint32(env, segment, "sequence", s.sequence);
+    CHECK_STATUS;
+    if (!s.init) {
+      if (s.pts != AV_NOPTS_VALUE) {
+        status = beam_set_int64(env, segment, "pts", s.pts);
+      } else {
+        status = beam_set_null(env, segment, "pts");
+      }
+      CHECK_STATUS;
+      status = beam_set_int64(env, segment, "duration", s.duration);
+      CHECK_STATUS;
+      status = beam_set_rational(env, segment, "time_base", s.timeBase);
+      CHECK_STATUS;
+      status = beam_set_bool(env, segment, "keyframe", s.keyframe);
+      CHECK_STATUS;
+    }
+    status = makePooledBuffer(env, s.data, s.size, s.capacity, &buffer);
+    s.data = nullptr;
+    if (status != napi_ok) { // release what has not been handed over
+      for (size_t j = i + 1; j < done.size(); ++j)
+        BufferPool::instance().release(done[j].data, done[j].capacity);
+    }
+    CHECK_STATUS;
+    status = napi_set_named_property(env, segment, "data", buffer);
+    CHECK_STATUS;
+    status = napi_set_element(env, result, (uint32_t)i, segment);
+    CHECK_STATUS;
+  }
+
+  return result;
+}
@@ -0,0 +1,119 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#ifndef SEGMENTER_H
+#define SEGMENTER_H
+
+#include "node_api.h"
+#include "beamcoder_util.h"
+#include "bufferpool.h"
+#include <deque>
+#include <string>
+#include <vector>
+#include <mutex>
+
+extern "C" {
+  #include <libavformat/avformat.h>
+}
+
+// Media type and RFC 6381 codecs string of a muxer stream, for playlists
+struct segmentStream {
+  AVMediaType mediaType = AVMEDIA_TYPE_UNKNOWN;
+  std::string codecs;
+};
+
+// RFC 6381 codecs string for a stream in fragmented MP4, such as avc1.64001F or
+// mp4a.40.2, or empty when the codec has no known form
+std::string codecsString(const AVCodecParameters *codecpar);
+
+struct segmentInfo {
+  bool init = false;
+  uint32_t sequence = 0;
+  int64_t pts = AV_NOPTS_VALUE;
+  int64_t duration = 0;
+  AVRational timeBase = { 0, 1 };
+  // Reference stream that timed the segment, -1 for none
+  int streamIndex = -1;
+  AVMediaType mediaType = AVMEDIA_TYPE_UNKNOWN;
+  bool keyframe = false;
+  uint8_t *data = nullptr;
+  size_t size = 0;
+  size_t capacity = 0;
+  // Init segments only, one per muxer stream
+  std::vector<segmentStream> streams;
+};
+
+// Receives segments as they are cut, in place of queueing them for segments()
+class SegmentSink {
+public:
+  virtual ~SegmentSink() {}
+  virtual void submit(const segmentInfo &segment) = 0;
+  virtual bool failed() = 0;
+};
+
+// Collects fragmented MP4 output written through a custom AVIOContext and
+// cuts it into the init segment and one moof+mdat per fragment. Fragment
+// boundaries are decided before each packet on the reference stream.
+class Segmenter {
+public:
+  Segmenter(double duration, bool keyframes, int streamIndex)
+    : mDuration(duration), mKeyframes(keyframes), mStreamIndex(streamIndex), mIOBuf(32768) {}
+  ~Segmenter();
+
+  static int writePacket(void *opaque, uint8_t *buf, int bufSize);
+  unsigned char *ioBuf()  { return &mIOBuf[0]; }
+  int ioBufLen() const  { return (int)mIOBuf.size(); }
+
+  int cutInit(AVFormatContext *fmtCtx);
+  int beforePacket(AVFormatContext *fmtCtx, const AVPacket *pkt, bool interleaved);
+  int cutFinal(AVFormatContext *fmtCtx);
+
+  // Hand over completed segments - called on the main thread
+  std::vector<segmentInfo> take();
+  void setSink(SegmentSink *sink)  { mSink = sink; }
+
+private:
+  int append(const uint8_t *buf, int bufSize);
+  void cut(bool init, AVFormatContext *fmtCtx);
+
+  const double mDuration;
+  const bool mKeyframes;
+  int mStreamIndex;
+  std::vector<unsigned char> mIOBuf;
+  SegmentSink *mSink = nullptr;
+
+  std::mutex m;
+  std::deque<segmentInfo> mDone;
+
+  uint8_t *mData = nullptr;
+  size_t mSize = 0;
+  size_t mCapacity = 0;
+  uint32_t mSequence = 0;
+  bool mHasMedia = false;
+  bool mStartKey = false;
+  int64_t mStartPTS = AV_NOPTS_VALUE;
+  int64_t mEndPTS = AV_NOPTS_VALUE;
+};
+
+void segmenterFinalizer(napi_env env, void* data, void* hint);
+napi_value segments(napi_env env, napi_callback_info info);
+
+#endif // SEGMENTER_H
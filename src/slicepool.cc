@@ -0,0 +1,189 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#include "slicepool.h"
+
+SlicePool& SlicePool::instance() {
+  static SlicePool pool;
+  return pool;
+}
+
+SlicePool::~SlicePool() {
+  std::vector<std::thread> stopping;
+  {
+    std::lock_guard<std::mutex> lk(m);
+    mTarget = 0;
+    stopping.swap(mWorkers);
+    cv.notify_all();
+  }
+  for (auto &t : stopping) t.join();
+}
+
+static uint32_t defaultThreads() {
+  uint32_t cores = std::thread::hardware_concurrency();
+  return (cores > 1) ? cores - 1 : 1;
+}
+
+void SlicePool::setThreads(uint32_t threads) {
+  std::vector<std::thread> stopping;
+  {
+    std::lock_guard<std::mutex> lk(m);
+    mTarget = (threads > 0) ? threads : defaultThreads();
+    if (mStarted) {
+      while (mWorkers.size() > mTarget) {
+        stopping.push_back(std::move(mWorkers.back()));
+        mWorkers.pop_back();
+      }
+      resize(mTarget);
+    }
+    cv.notify_all();
+  }
+  // Surplus workers exit after their current job
+  for (auto &t : stopping) t.join();
+}
+
+uint32_t SlicePool::threads() const {
+  std::lock_guard<std::mutex> lk(m);
+  return (mTarget > 0) ? mTarget : defaultThreads();
+}
+
+uint64_t SlicePool::batches() const {
+  std::lock_guard<std::mutex> lk(m);
+  return mBatchCount;
+}
+
+// Called with the lock held
+void SlicePool::resize(uint32_t threads) {
+  mStarted = true;
+  for (uint32_t id = (uint32_t)mWorkers.size(); id < threads; ++id)
+    mWorkers.push_back(std::thread(&SlicePool::worker, this, id));
+}
+
+// Called with the lock held, which is released while the job runs
+bool SlicePool::runOne(std::unique_lock<std::mutex> &lk, sliceBatch *only) {
+  sliceBatch *b = only;
+  if (nullptr == b) {
+    if (mBatches.empty()) return false;
+    b = mBatches.front();
+  }
+  if (b->nextJob >= b->nbJobs) return false;
+
+  int jobnr = b->nextJob++;
+  if (b->nextJob == b->nbJobs) {
+    for (auto it = mBatches.begin(); it != mBatches.end(); ++it)
+      if (*it == b) { mBatches.erase(it); break; }
+  }
+
+  lk.unlock();
+  int r = b->func(b->ctx, b->arg, jobnr, b->nbJobs);
+  if (b->ret) b->ret[jobnr] = r;
+  lk.lock();
+
+  if (++b->doneJobs == b->nbJobs) doneCv.notify_all();
+  return true;
+}
+
+void SlicePool::worker(uint32_t id) {
+  std::unique_lock<std::mutex> lk(m);
+  while (true) {
+    cv.wait(lk, [&]{ return (id >= mTarget) || !mBatches.empty(); });
+    if (id >= mTarget) return;
+    runOne(lk, nullptr);
+  }
+}
+
+int SlicePool::execute(AVFilterContext *ctx, avfilter_action_func *func,
+    void *arg, int *ret, int nbJobs) {
+  if (nbJobs <= 1) {
+    for (int i = 0; i < nbJobs; ++i) {
+      int r = func(ctx, arg, i, nbJobs);
+      if (ret) ret[i] = r;
+    }
+    return 0;
+  }
+
+  SlicePool &pool = instance();
+  sliceBatch batch;
+  batch.ctx = ctx;
+  batch.func = func;
+  batch.arg = arg;
+  batch.ret = ret;
+  batch.nbJobs = nbJobs;
+
+  std::unique_lock<std::mutex> lk(pool.m);
+  if (!pool.mStarted) {
+    if (0 == pool.mTarget) pool.mTarget = defaultThreads();
+    pool.resize(pool.mTarget);
+  }
+  pool.mBatches.push_back(&batch);
+  pool.mBatchCount++;
+  pool.cv.notify_all();
+
+  // The caller works through its own batch so progress never depends on
+  // a free worker, then waits for any jobs still running elsewhere
+  while (pool.runOne(lk, &batch)) {}
+  pool.doneCv.wait(lk, [&]{ return batch.doneJobs == batch.nbJobs; });
+  return 0;
+}
+
+napi_value filterThreads(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result;
+  napi_valuetype type;
+  bool hasThreads;
+  uint32_t threads;
+  SlicePool &pool = SlicePool::instance();
+
+  size_t argc = 1;
+  napi_value args[1];
+
+  status = napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+  CHECK_STATUS;
+
+  if (argc == 1) {
+    status = napi_typeof(env, args[0], &type);
+    CHECK_STATUS;
+    if (type != napi_object) {
+      NAPI_THROW_ERROR("Filter threads can only be configured with an options object.");
+    }
+    status = napi_has_named_property(env, args[0], "threads", &hasThreads);
+    CHECK_STATUS;
+    if (hasThreads) {
+      napi_value threadsVal;
+      status = napi_get_named_property(env, args[0], "threads", &threadsVal);
+      CHECK_STATUS;
+      status = napi_get_value_uint32(env, threadsVal, &threads);
+      if (status != napi_ok) {
+        NAPI_THROW_ERROR("Filter threads value must be a non-negative number.");
+      }
+      pool.setThreads(threads);
+    }
+  }
+
+  status = napi_create_object(env, &result);
+  CHECK_STATUS;
+  status = beam_set_uint32(env, result, "threads", pool.threads());
+  CHECK_STATUS;
+  status = beam_set_int64(env, result, "batches", (int64_t)pool.batches());
+  CHECK_STATUS;
+
+  return result;
+}
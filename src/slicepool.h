@@ -0,0 +1,82 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#ifndef SLICEPOOL_H
+#define SLICEPOOL_H
+
+#include "node_api.h"
+#include "beamcoder_util.h"
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+extern "C" {
+  #include <libavfilter/avfilter.h>
+}
+
+// A batch of slice jobs from one call to a filter graph's execute callback
+struct sliceBatch {
+  AVFilterContext *ctx;
+  avfilter_action_func *func;
+  void *arg;
+  int *ret;
+  int nbJobs;
+  int nextJob = 0;
+  int doneJobs = 0;
+};
+
+// Process-wide bounded pool that runs slice jobs for every filter graph
+// created with shared threads, rather than each graph spawning its own
+class SlicePool {
+public:
+  static SlicePool& instance();
+
+  // Change the number of worker threads, 0 for one per core less the caller
+  void setThreads(uint32_t threads);
+  uint32_t threads() const;
+  uint64_t batches() const;
+
+  // Matches avfilter_execute_func - the calling thread also runs jobs
+  static int execute(AVFilterContext *ctx, avfilter_action_func *func,
+    void *arg, int *ret, int nbJobs);
+
+private:
+  SlicePool() {}
+  ~SlicePool();
+  void worker(uint32_t id);
+  bool runOne(std::unique_lock<std::mutex> &lk, sliceBatch *only);
+  void resize(uint32_t threads);
+
+  mutable std::mutex m;
+  std::condition_variable cv;
+  std::condition_variable doneCv;
+  std::deque<sliceBatch*> mBatches;
+  std::vector<std::thread> mWorkers;
+  uint32_t mTarget = 0;
+  bool mStarted = false;
+  uint64_t mBatchCount = 0;
+};
+
+napi_value filterThreads(napi_env env, napi_callback_info info);
+
+#endif // SLICEPOOL_H
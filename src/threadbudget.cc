@@ -0,0 +1,189 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#include "threadbudget.h"
+#include <thread>
+#include <algorithm>
+
+// Pixels per thread wanted by a video codec, half of 720p
+#define PIXELS_PER_THREAD (1280 * 720 / 2)
+
+ThreadBudget& ThreadBudget::instance() {
+  static ThreadBudget budget;
+  return budget;
+}
+
+ThreadBudget::ThreadBudget() {
+  mCores = std::max(1u, std::thread::hardware_concurrency());
+}
+
+uint32_t ThreadBudget::budget() const {
+  return (mBudget > 0) ? mBudget : mCores;
+}
+
+void ThreadBudget::allocate(AVCodecContext *ctx, bool encoder, bool isExplicit) {
+  std::lock_guard<std::mutex> lk(m);
+  threadGrant g;
+  g.id = ++mNextId;
+  g.encoder = encoder;
+  g.codec = ctx->codec ? ctx->codec->name : "";
+  g.width = ctx->width;
+  g.height = ctx->height;
+
+  if (isExplicit) {
+    g.threads = (ctx->thread_count > 0) ? ctx->thread_count : (int) mCores;
+    g.reason = "explicit";
+  } else if (!mEnabled) {
+    return; // FFmpeg chooses, as without a budget
+  } else if ((ctx->codec_type != AVMEDIA_TYPE_VIDEO) || (ctx->codec == nullptr) ||
+      !(ctx->codec->capabilities & (AV_CODEC_CAP_FRAME_THREADS |
+        AV_CODEC_CAP_SLICE_THREADS | AV_CODEC_CAP_OTHER_THREADS))) {
+    g.threads = 1;
+    g.reason = "single";
+  } else {
+    uint32_t total = budget();
+    uint32_t available = (total > mAllocated) ? total - mAllocated : 0;
+    uint32_t fairShare = std::max(1u, total / (uint32_t) (mGrants.size() + 1));
+    int64_t pixels = (int64_t) ctx->width * ctx->height;
+    uint32_t want = (pixels > 0) ?
+      (uint32_t) ((pixels + PIXELS_PER_THREAD - 1) / PIXELS_PER_THREAD) : fairShare;
+    want = std::max(1u, std::min(want, mMaxPerSession));
+    // Take what is wanted if it is free, otherwise what is left. Every codec
+    // needs a thread, so a spent budget still grants one and is overrun.
+    uint32_t grant = std::max(1u, std::min(want, available));
+    g.threads = (int) grant;
+    g.reason = (grant < want) ? "budget" : ((pixels > 0) ? "resolution" : "fair_share");
+  }
+
+  if (!isExplicit) ctx->thread_count = g.threads;
+  mAllocated += g.threads;
+  mGrants[ctx] = g;
+}
+
+void ThreadBudget::release(AVCodecContext *ctx) {
+  std::lock_guard<std::mutex> lk(m);
+  auto it = mGrants.find(ctx);
+  if (it == mGrants.end()) return;
+  mAllocated -= std::min(mAllocated, (uint32_t) it->second.threads);
+  mGrants.erase(it);
+}
+
+void ThreadBudget::configure(bool enabled, uint32_t budget, uint32_t maxPerSession) {
+  std::lock_guard<std::mutex> lk(m);
+  mEnabled = enabled;
+  mBudget = budget;
+  mMaxPerSession = std::max(1u, maxPerSession);
+}
+
+napi_status ThreadBudget::toJS(napi_env env, napi_value *result) {
+  napi_status status;
+  napi_value sessions, session;
+  uint32_t index = 0;
+  std::lock_guard<std::mutex> lk(m);
+
+  status = napi_create_object(env, result);
+  PASS_STATUS;
+  status = beam_set_bool(env, *result, "enabled", mEnabled);
+  PASS_STATUS;
+  status = beam_set_uint32(env, *result, "budget", budget());
+  PASS_STATUS;
+  status = beam_set_uint32(env, *result, "cores", mCores);
+  PASS_STATUS;
+  status = beam_set_uint32(env, *result, "max_per_session", mMaxPerSession);
+  PASS_STATUS;
+  status = beam_set_uint32(env, *result, "allocated", mAllocated);
+  PASS_STATUS;
+  status = beam_set_uint32(env, *result, "overrun",
+    (mAllocated > budget()) ? mAllocated - budget() : 0);
+  PASS_STATUS;
+
+  status = napi_create_array(env, &sessions);
+  PASS_STATUS;
+  for ( auto &it : mGrants ) {
+    const threadGrant &g = it.second;
+    status = napi_create_object(env, &session);
+    PASS_STATUS;
+    status = beam_set_int64(env, session, "id", (int64_t) g.id);
+    PASS_STATUS;
+    status = beam_set_string_utf8(env, session, "type", g.encoder ? "encoder" : "decoder");
+    PASS_STATUS;
+    status = beam_set_string_utf8(env, session, "codec", g.codec.c_str());
+    PASS_STATUS;
+    status = beam_set_int32(env, session, "width", g.width);
+    PASS_STATUS;
+    status = beam_set_int32(env, session, "height", g.height);
+    PASS_STATUS;
+    status = beam_set_int32(env, session, "threads", g.threads);
+    PASS_STATUS;
+    status = beam_set_string_utf8(env, session, "reason", g.reason);
+    PASS_STATUS;
+    status = napi_set_element(env, sessions, index++, session);
+    PASS_STATUS;
+  }
+  return napi_set_named_property(env, *result, "sessions", sessions);
+}
+
+napi_value codecThreads(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result;
+  napi_valuetype type;
+  ThreadBudget &budget = ThreadBudget::instance();
+
+  size_t argc = 1;
+  napi_value args[1];
+
+  status = napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+  CHECK_STATUS;
+
+  if (argc == 1) {
+    status = napi_typeof(env, args[0], &type);
+    CHECK_STATUS;
+    if (type != napi_object) {
+      NAPI_THROW_ERROR("Codec threads can only be configured with an options object.");
+    }
+    napi_value current;
+    bool enabled, present;
+    uint32_t total, maxPerSession;
+    status = budget.toJS(env, &current);
+    CHECK_STATUS;
+    status = beam_get_bool(env, current, "enabled", &present, &enabled);
+    CHECK_STATUS;
+    status = beam_get_uint32(env, current, "budget", &total);
+    CHECK_STATUS;
+    status = beam_get_uint32(env, args[0], "budget", &total);
+    if (status != napi_ok) {
+      NAPI_THROW_ERROR("Codec threads budget must be a non-negative number.");
+    }
+    status = beam_get_uint32(env, current, "max_per_session", &maxPerSession);
+    CHECK_STATUS;
+    status = beam_get_uint32(env, args[0], "max_per_session", &maxPerSession);
+    if (status != napi_ok) {
+      NAPI_THROW_ERROR("Codec threads max_per_session must be a non-negative number.");
+    }
+    status = beam_get_bool(env, args[0], "enabled", &present, &enabled);
+    CHECK_STATUS;
+    budget.configure(enabled, total, maxPerSession);
+  }
+
+  status = budget.toJS(env, &result);
+  CHECK_STATUS;
+  return result;
+}
@@ -0,0 +1,78 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#ifndef THREADBUDGET_H
+#define THREADBUDGET_H
+
+#include "node_api.h"
+#include "beamcoder_util.h"
+#include <map>
+#include <string>
+#include <mutex>
+
+extern "C" {
+  #include <libavcodec/avcodec.h>
+}
+
+// A thread_count decision for one decoder or encoder
+struct threadGrant {
+  uint64_t id;
+  bool encoder;
+  std::string codec;
+  int width;
+  int height;
+  int threads;
+  const char *reason;
+};
+
+// Process-wide budget of codec threads. Decoders and encoders that do not set
+// thread_count explicitly are given a share of the budget when created, based
+// on their resolution and on how much of the budget is already in use, rather
+// than each starting one thread per core. Grants never take the total past the
+// budget, except for the single thread every codec needs and explicit counts.
+class ThreadBudget {
+public:
+  static ThreadBudget& instance();
+
+  // Set ctx->thread_count unless it was given explicitly, and record the grant
+  void allocate(AVCodecContext *ctx, bool encoder, bool isExplicit);
+  void release(AVCodecContext *ctx);
+
+  void configure(bool enabled, uint32_t budget, uint32_t maxPerSession);
+  napi_status toJS(napi_env env, napi_value *result);
+
+private:
+  ThreadBudget();
+  uint32_t budget() const; // called with the lock held
+
+  std::mutex m;
+  uint32_t mCores;
+  bool mEnabled = true;
+  uint32_t mBudget = 0; // 0 for one per core
+  uint32_t mMaxPerSession = 16;
+  uint32_t mAllocated = 0;
+  uint64_t mNextId = 0;
+  std::map<AVCodecContext*, threadGrant> mGrants;
+};
+
+napi_value codecThreads(napi_env env, napi_callback_info info);
+
+#endif // THREADBUDGET_H
@@ -0,0 +1,506 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#include "thumbnail.h"
+#include "bufferpool.h"
+#include "frame.h"
+#include <thread>
+#include <mutex>
+#include <algorithm>
+#include <cstring>
+
+// First error reported by any of the samplers
+struct sampleError {
+  std::mutex m;
+  int32_t status = BEAMCODER_SUCCESS;
+  std::string msg;
+  void set(int32_t s, const std::string &message) {
+    std::lock_guard<std::mutex> lk(m);
+    if (status != BEAMCODER_SUCCESS) return;
+    status = s;
+    msg = message;
+  }
+  bool failed() {
+    std::lock_guard<std::mutex> lk(m);
+    return status != BEAMCODER_SUCCESS;
+  }
+};
+
+// Seek to before time and decode the first keyframe of the stream after it.
+// Sets frame to nullptr if no keyframe is found before the end of the stream.
+static int sampleOne(AVFormatContext *fmt, int streamIndex, AVCodecContext *dec,
+    double time, AVFrame **frame) {
+  int ret;
+  AVStream *st = fmt->streams[streamIndex];
+  int64_t ts = av_rescale_q((int64_t) (time * AV_TIME_BASE), AV_TIME_BASE_Q, st->time_base);
+  if (st->start_time != AV_NOPTS_VALUE) ts += st->start_time;
+
+  *frame = nullptr;
+  if ((ret = av_seek_frame(fmt, streamIndex, ts, AVSEEK_FLAG_BACKWARD)) < 0) return ret;
+  avcodec_flush_buffers(dec);
+
+  AVPacket *packet = av_packet_alloc();
+  AVFrame *f = av_frame_alloc();
+  while (true) {
+    ret = avcodec_receive_frame(dec, f);
+    if (ret == 0) {
+      *frame = f;
+      f = nullptr;
+      break;
+    }
+    if (ret == AVERROR_EOF) { // nothing after the target
+      ret = 0;
+      break;
+    }
+    if (ret != AVERROR(EAGAIN)) break;
+
+    ret = av_read_frame(fmt, packet);
+    if (ret == AVERROR_EOF) {
+      if ((ret = avcodec_send_packet(dec, nullptr)) < 0) break;
+      continue;
+    }
+    if (ret < 0) break;
+    if ((packet->stream_index == streamIndex) && (packet->flags & AV_PKT_FLAG_KEY))
+      ret = avcodec_send_packet(dec, packet);
+    av_packet_unref(packet);
+    if (ret < 0) break;
+  }
+  av_frame_free(&f);
+  av_packet_free(&packet);
+  return ret;
+}
+
+static int encodeJpeg(AVCodecContext **enc, AVFrame *frame, uint32_t quality, AVPacket **out) {
+  int ret;
+  if ((*enc != nullptr) &&
+      (((*enc)->width != frame->width) || ((*enc)->height != frame->height)))
+    avcodec_free_context(enc);
+  if (*enc == nullptr) {
+    const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
+    if (codec == nullptr) return AVERROR_ENCODER_NOT_FOUND;
+    *enc = avcodec_alloc_context3(codec);
+    if (*enc == nullptr) return AVERROR(ENOMEM);
+    (*enc)->width = frame->width;
+    (*enc)->height = frame->height;
+    (*enc)->pix_fmt = (AVPixelFormat) frame->format;
+    (*enc)->color_range = AVCOL_RANGE_JPEG;
+    (*enc)->time_base = { 1, 25 };
+    (*enc)->flags |= AV_CODEC_FLAG_QSCALE;
+    (*enc)->global_quality = FF_QP2LAMBDA * quality;
+    if ((ret = avcodec_open2(*enc, codec, nullptr)) < 0) {
+      avcodec_free_context(enc);
+      return ret;
+    }
+  }
+  frame->quality = (*enc)->global_quality;
+  frame->pict_type = AV_PICTURE_TYPE_NONE;
+  if ((ret = avcodec_send_frame(*enc, frame)) < 0) return ret;
+  AVPacket *packet = av_packet_alloc();
+  if ((ret = avcodec_receive_packet(*enc, packet)) < 0) {
+    av_packet_free(&packet);
+    return ret;
+  }
+  *out = packet;
+  return 0;
+}
+
+// Custom IO does not poll the interrupt callback, so samplers check between targets
+static bool samplingCancelled(thumbnailCarrier *c) {
+  return (c->formatRef->interrupter != nullptr) && c->formatRef->interrupter->cancelled();
+}
+
+// Sample targets [first, last) with a decoder of its own
+static void sampleRange(thumbnailCarrier *c, size_t first, size_t last,
+    uint32_t workers, sampleError *error) {
+  int ret;
+  AVFormatContext *fmt = nullptr;
+  AVCodecContext *dec = nullptr;
+  AVCodecContext *enc = nullptr;
+  Converter *converter = nullptr;
+  const AVCodec *codec;
+  const AVCodecParameters *params = c->params;
+
+  if (c->shared) {
+    fmt = c->formatRef->fmtCtx;
+  } else {
+    if ((fmt = avformat_alloc_context()) == nullptr) {
+      error->set(BEAMCODER_ERROR_OPENIO, "Problem allocating sampler input.");
+      return;
+    }
+    // Cancelling the demuxer also stops its samplers
+    fmt->interrupt_callback = c->interruptCallback;
+    if ((ret = avformat_open_input(&fmt, c->url.c_str(), c->iformat, nullptr)) < 0) {
+      error->set(BEAMCODER_ERROR_OPENIO, interruptErrorMsg(c->formatRef->interrupter,
+        "Problem opening sampler input: ", ret));
+      return;
+    }
+    if ((c->streamIndex >= (int) fmt->nb_streams) &&
+        ((ret = avformat_find_stream_info(fmt, nullptr)) < 0)) {
+      error->set(BEAMCODER_ERROR_OPENIO, avErrorMsg("Problem probing sampler input: ", ret));
+      goto done;
+    }
+    if (c->streamIndex >= (int) fmt->nb_streams) {
+      error->set(BEAMCODER_ERROR_OUT_OF_BOUNDS, "Sampler input does not have the requested stream.");
+      goto done;
+    }
+  }
+
+  codec = avcodec_find_decoder(params->codec_id);
+  if (codec == nullptr) {
+    error->set(BEAMCODER_ERROR_ALLOC_DECODER, "Failed to find a decoder for the stream.");
+    goto done;
+  }
+  dec = avcodec_alloc_context3(codec);
+  avcodec_parameters_to_context(dec, params);
+  dec->skip_frame = AVDISCARD_NONKEY;
+  dec->lowres = std::max(0, std::min(c->lowres, (int) codec->max_lowres));
+  // One keyframe at a time gains nothing from frame threads
+  dec->thread_type = FF_THREAD_SLICE;
+  dec->thread_count = (workers > 1) ? 1 : 0;
+  if ((ret = avcodec_open2(dec, codec, nullptr)) < 0) {
+    error->set(BEAMCODER_ERROR_ALLOC_DECODER, avErrorMsg("Problem opening decoder: ", ret));
+    goto done;
+  }
+  converter = Converter::video(c->jpeg ? AV_PIX_FMT_YUVJ420P : c->pixFmt,
+    c->width, c->height, c->flags);
+
+  for ( size_t x = first ; x < last ; x++ ) {
+    if (error->failed()) break;
+    thumbnailTarget &t = c->targets[x];
+    AVFrame *frame = nullptr;
+    std::vector<AVFrame*> converted;
+    ret = samplingCancelled(c) ? AVERROR_EXIT : sampleOne(fmt, c->streamIndex, dec, t.time, &frame);
+    // A cancelled stream input ends early rather than failing
+    if ((ret >= 0) && samplingCancelled(c)) {
+      av_frame_free(&frame);
+      ret = AVERROR_EXIT;
+    }
+    if (ret < 0) {
+      error->set(BEAMCODER_ERROR_SEEK_FRAME, interruptErrorMsg(c->formatRef->interrupter,
+        "Problem sampling frame: ", ret));
+      break;
+    }
+    if (frame == nullptr) continue;
+    t.pts = frame->best_effort_timestamp;
+    if ((ret = converter->convert(frame, converted)) < 0) {
+      error->set(BEAMCODER_ERROR_DECODE, avErrorMsg("Error converting frame: ", ret));
+      break;
+    }
+    if (!c->jpeg) {
+      t.frame = converted[0];
+      continue;
+    }
+    ret = encodeJpeg(&enc, converted[0], c->quality, &t.jpeg);
+    av_frame_free(&converted[0]);
+    if (ret < 0) {
+      error->set(BEAMCODER_ERROR_ENCODE, avErrorMsg("Error encoding JPEG: ", ret));
+      break;
+    }
+  }
+
+done:
+  delete converter;
+  avcodec_free_context(&enc);
+  avcodec_free_context(&dec);
+  if (!c->shared) avformat_close_input(&fmt);
+}
+
+void thumbnailsExecute(napi_env env, void* data) {
+  thumbnailCarrier* c = (thumbnailCarrier*) data;
+  sampleError error;
+  HR_TIME_POINT sampleStart = NOW;
+  size_t count = c->targets.size();
+  uint32_t workers = c->shared ? 1 : std::min((size_t) c->parallel, count);
+  c->samplers = std::max(1u, workers);
+
+  if (workers <= 1) {
+    if (c->shared) {
+      // The demuxer's own position is lost, as with seek()
+      std::lock_guard<std::mutex> lk(c->formatRef->readLock);
+      if (c->formatRef->fmtCtx == nullptr) {
+        c->status = BEAMCODER_INVALID_ARGS;
+        c->errorMsg = "Demuxer was closed before thumbnails were sampled.";
+        return;
+      }
+      for (auto it = c->formatRef->pending.begin(); it != c->formatRef->pending.end(); ++it)
+        av_packet_free(&(*it));
+      c->formatRef->pending.clear();
+      sampleRange(c, 0, count, 1, &error);
+    } else {
+      sampleRange(c, 0, count, 1, &error);
+    }
+  } else {
+    // Contiguous runs of targets keep each sampler's seeks short
+    std::vector<std::thread> threads;
+    size_t first = 0;
+    for ( uint32_t w = 0 ; w < workers ; w++ ) {
+      size_t last = first + (count - first) / (workers - w);
+      threads.push_back(std::thread(sampleRange, c, first, last, workers, &error));
+      first = last;
+    }
+    for ( auto &t : threads ) t.join();
+  }
+
+  c->status = error.status;
+  c->errorMsg = error.msg;
+  c->totalTime = microTime(sampleStart);
+}
+
+void thumbnailsComplete(napi_env env, napi_status asyncStatus, void* data) {
+  thumbnailCarrier* c = (thumbnailCarrier*) data;
+  napi_value result, thumbs, thumb, value;
+  uint32_t index = 0;
+
+  if (asyncStatus != napi_ok) {
+    c->status = asyncStatus;
+    c->errorMsg = "Thumbnail sampler failed to complete.";
+  }
+  REJECT_STATUS;
+
+  c->status = napi_create_object(env, &result);
+  REJECT_STATUS;
+  c->status = beam_set_string_utf8(env, result, "type", "thumbnails");
+  REJECT_STATUS;
+  c->status = napi_create_array(env, &thumbs);
+  REJECT_STATUS;
+  c->status = napi_set_named_property(env, result, "thumbnails", thumbs);
+  REJECT_STATUS;
+
+  for ( auto &t : c->targets ) {
+    c->status = napi_create_object(env, &thumb);
+    REJECT_STATUS;
+    c->status = beam_set_double(env, thumb, "time", t.time);
+    REJECT_STATUS;
+    if (t.pts == AV_NOPTS_VALUE) {
+      c->status = beam_set_null(env, thumb, "pts");
+    } else {
+      c->status = beam_set_int64(env, thumb, "pts", t.pts);
+    }
+    REJECT_STATUS;
+    if (c->jpeg) {
+      if (t.jpeg != nullptr) {
+        size_t capacity;
+        uint8_t *block = BufferPool::instance().acquire(t.jpeg->size, &capacity);
+        memcpy(block, t.jpeg->data, t.jpeg->size);
+        c->status = makePooledBuffer(env, block, t.jpeg->size, capacity, &value);
+        REJECT_STATUS;
+        c->status = napi_set_named_property(env, thumb, "data", value);
+      } else {
+        c->status = beam_set_null(env, thumb, "data");
+      }
+    } else {
+      if (t.frame != nullptr) {
+        frameData* f = new frameData;
+        f->frame = t.frame;
+        t.frame = nullptr;
+        c->status = fromAVFrame(env, f, &value);
+        REJECT_STATUS;
+        c->status = napi_set_named_property(env, thumb, "frame", value);
+      } else {
+        c->status = beam_set_null(env, thumb, "frame");
+      }
+    }
+    REJECT_STATUS;
+    c->status = napi_set_element(env, thumbs, index++, thumb);
+    REJECT_STATUS;
+  }
+
+  c->status = beam_set_uint32(env, result, "samplers", c->samplers);
+  REJECT_STATUS;
+  c->status = beam_set_int64(env, result, "total_time", c->totalTime);
+  REJECT_STATUS;
+
+  napi_status status;
+  status = napi_resolve_deferred(env, c->_deferred, result);
+  FLOATING_STATUS;
+
+  tidyCarrier(env, c);
+}
+
+napi_value thumbnails(napi_env env, napi_callback_info info) {
+  napi_value resourceName, promise, demuxerJS, formatRefExt, value;
+  napi_valuetype type;
+  bool isArray, hasProp;
+  char* name = nullptr;
+  uint32_t count = 0;
+  AVFormatContext* fmtCtx;
+  thumbnailCarrier* c = new thumbnailCarrier;
+
+  c->status = napi_create_promise(env, &c->_deferred, &promise);
+  REJECT_RETURN;
+
+  size_t argc = 1;
+  napi_value args[1];
+  c->status = napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+  REJECT_RETURN;
+  if (argc < 1) {
+    REJECT_ERROR_RETURN("Thumbnails requires an options object.", BEAMCODER_INVALID_ARGS);
+  }
+  c->status = napi_typeof(env, args[0], &type);
+  REJECT_RETURN;
+  if (type != napi_object) {
+    REJECT_ERROR_RETURN("Thumbnails requires an options object.", BEAMCODER_INVALID_ARGS);
+  }
+
+  c->status = napi_get_named_property(env, args[0], "demuxer", &demuxerJS);
+  REJECT_RETURN;
+  c->status = napi_typeof(env, demuxerJS, &type);
+  REJECT_RETURN;
+  if (type == napi_object) {
+    c->status = napi_has_named_property(env, demuxerJS, "_formatContextRef", &hasProp);
+    REJECT_RETURN;
+  }
+  if ((type != napi_object) || !hasProp) {
+    REJECT_ERROR_RETURN("Thumbnails requires a demuxer.", BEAMCODER_INVALID_ARGS);
+  }
+  c->status = napi_get_named_property(env, demuxerJS, "_formatContextRef", &formatRefExt);
+  REJECT_RETURN;
+  c->status = napi_get_value_external(env, formatRefExt, (void**) &c->formatRef);
+  REJECT_RETURN;
+  fmtCtx = c->formatRef->fmtCtx;
+  if (fmtCtx == nullptr) {
+    REJECT_ERROR_RETURN("Cannot sample thumbnails from a closed demuxer.", BEAMCODER_INVALID_ARGS);
+  }
+
+  c->status = beam_get_int32(env, args[0], "stream_index", &c->streamIndex);
+  REJECT_RETURN;
+  if (c->streamIndex < 0) {
+    c->streamIndex = av_find_best_stream(fmtCtx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+  }
+  if ((c->streamIndex < 0) || (c->streamIndex >= (int) fmtCtx->nb_streams) ||
+      (fmtCtx->streams[c->streamIndex]->codecpar->codec_type != AVMEDIA_TYPE_VIDEO)) {
+    REJECT_ERROR_RETURN("Thumbnails requires a video stream.", BEAMCODER_INVALID_ARGS);
+  }
+
+  c->status = napi_get_named_property(env, args[0], "times", &value);
+  REJECT_RETURN;
+  c->status = napi_is_array(env, value, &isArray);
+  REJECT_RETURN;
+  if (isArray) {
+    uint32_t length;
+    napi_value element;
+    c->status = napi_get_array_length(env, value, &length);
+    REJECT_RETURN;
+    for ( uint32_t x = 0 ; x < length ; x++ ) {
+      thumbnailTarget t;
+      c->status = napi_get_element(env, value, x, &element);
+      REJECT_RETURN;
+      c->status = napi_get_value_double(env, element, &t.time);
+      if (c->status != napi_ok) {
+        REJECT_ERROR_RETURN("Thumbnail times must be numbers of seconds.", BEAMCODER_INVALID_ARGS);
+      }
+      c->targets.push_back(t);
+    }
+  } else {
+    c->status = beam_get_uint32(env, args[0], "count", &count);
+    REJECT_RETURN;
+    if (count == 0) {
+      REJECT_ERROR_RETURN("Thumbnails requires an array of times or a count.", BEAMCODER_INVALID_ARGS);
+    }
+    AVStream* st = fmtCtx->streams[c->streamIndex];
+    double duration = (fmtCtx->duration > 0) ? (double) fmtCtx->duration / AV_TIME_BASE :
+      (st->duration > 0) ? st->duration * av_q2d(st->time_base) : 0.0;
+    if (duration <= 0.0) {
+      REJECT_ERROR_RETURN("Duration is not known, so thumbnail times must be given.",
+        BEAMCODER_INVALID_ARGS);
+    }
+    // Centre of each of count equal parts
+    for ( uint32_t x = 0 ; x < count ; x++ ) {
+      thumbnailTarget t;
+      t.time = (x + 0.5) * duration / count;
+      c->targets.push_back(t);
+    }
+  }
+
+  c->status = beam_get_string_utf8(env, args[0], "format", &name);
+  REJECT_RETURN;
+  if (name != nullptr) {
+    c->jpeg = strcmp(name, "jpeg") == 0;
+    bool valid = c->jpeg || (strcmp(name, "frame") == 0);
+    free(name);
+    if (!valid) {
+      REJECT_ERROR_RETURN("Thumbnail format must be 'frame' or 'jpeg'.", BEAMCODER_INVALID_ARGS);
+    }
+  }
+  c->status = beam_get_string_utf8(env, args[0], "pix_fmt", &name);
+  REJECT_RETURN;
+  if (name != nullptr) {
+    c->pixFmt = av_get_pix_fmt(name);
+    free(name);
+    if ((c->pixFmt == AV_PIX_FMT_NONE) || !sws_isSupportedOutput(c->pixFmt)) {
+      REJECT_ERROR_RETURN("Thumbnail pix_fmt is not a supported pixel format.", BEAMCODER_INVALID_ARGS);
+    }
+  }
+  c->status = beam_get_string_utf8(env, args[0], "algorithm", &name);
+  REJECT_RETURN;
+  if (name != nullptr) {
+    c->flags = scaleAlgorithm(name);
+    free(name);
+    if (c->flags < 0) {
+      REJECT_ERROR_RETURN("Thumbnail algorithm is not a known scaling algorithm.", BEAMCODER_INVALID_ARGS);
+    }
+  }
+  uint32_t dimension = 0;
+  c->status = beam_get_uint32(env, args[0], "width", &dimension);
+  REJECT_RETURN;
+  c->width = (int) dimension;
+  dimension = 0;
+  c->status = beam_get_uint32(env, args[0], "height", &dimension);
+  REJECT_RETURN;
+  c->height = (int) dimension;
+  c->status = beam_get_int32(env, args[0], "lowres", &c->lowres);
+  REJECT_RETURN;
+  c->status = beam_get_uint32(env, args[0], "quality", &c->quality);
+  REJECT_RETURN;
+  c->quality = std::max(2u, std::min(31u, c->quality));
+  c->parallel = std::max(1u, std::min(4u, std::thread::hardware_concurrency()));
+  c->status = beam_get_uint32(env, args[0], "parallel", &c->parallel);
+  REJECT_RETURN;
+
+  // Custom I/O cannot be reopened, so sample with the demuxer itself
+  c->shared = (fmtCtx->flags & AVFMT_FLAG_CUSTOM_IO) || (fmtCtx->url == nullptr) ||
+    (fmtCtx->url[0] == '\0');
+  if (!c->shared) {
+    c->url = fmtCtx->url;
+    c->iformat = fmtCtx->iformat;
+    c->interruptCallback = fmtCtx->interrupt_callback;
+  }
+  // Probed parameters, copied so that samplers do not read the demuxer's stream
+  c->params = avcodec_parameters_alloc();
+  if ((c->params == nullptr) ||
+      (avcodec_parameters_copy(c->params, fmtCtx->streams[c->streamIndex]->codecpar) < 0)) {
+    REJECT_ERROR_RETURN("Problem copying thumbnail stream parameters.", BEAMCODER_ERROR_ENOMEM);
+  }
+
+  // Keeps the demuxer alive while sampling
+  c->status = napi_create_reference(env, demuxerJS, 1, &c->passthru);
+  REJECT_RETURN;
+
+  c->status = napi_create_string_utf8(env, "Thumbnails", NAPI_AUTO_LENGTH, &resourceName);
+  REJECT_RETURN;
+  c->status = napi_create_async_work(env, nullptr, resourceName, thumbnailsExecute,
+    thumbnailsComplete, c, &c->_request);
+  REJECT_RETURN;
+  c->status = napi_queue_async_work(env, c->_request);
+  REJECT_RETURN;
+
+  return promise;
+}
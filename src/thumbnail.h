@@ -0,0 +1,77 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#ifndef THUMBNAIL_H
+#define THUMBNAIL_H
+
+#include "node_api.h"
+#include "beamcoder_util.h"
+#include "format.h"
+#include "converter.h"
+#include <string>
+#include <vector>
+
+extern "C" {
+  #include <libavcodec/avcodec.h>
+  #include <libavformat/avformat.h>
+}
+
+struct thumbnailTarget {
+  double time = 0.0;
+  int64_t pts = AV_NOPTS_VALUE;
+  AVFrame *frame = nullptr;
+  AVPacket *jpeg = nullptr;
+};
+
+struct thumbnailCarrier : carrier {
+  fmtCtxRef* formatRef = nullptr;
+  // Parallel samplers open their own demuxers from the same url
+  std::string url;
+  const AVInputFormat* iformat = nullptr;
+  bool shared = false;
+  // Copied when sampling starts, as the demuxer may be closed meanwhile
+  AVCodecParameters* params = nullptr;
+  AVIOInterruptCB interruptCallback = { nullptr, nullptr };
+  int streamIndex = -1;
+  std::vector<thumbnailTarget> targets;
+  AVPixelFormat pixFmt = AV_PIX_FMT_RGB24;
+  int width = 0;
+  int height = 0;
+  int flags = SWS_BICUBIC;
+  int lowres = 0;
+  bool jpeg = false;
+  uint32_t quality = 5;
+  uint32_t parallel = 0;
+  uint32_t samplers = 0;
+  ~thumbnailCarrier() {
+    avcodec_parameters_free(&params);
+    for ( auto &t : targets ) {
+      av_frame_free(&t.frame);
+      av_packet_free(&t.jpeg);
+    }
+  }
+};
+
+void thumbnailsExecute(napi_env env, void* data);
+void thumbnailsComplete(napi_env env, napi_status asyncStatus, void* data);
+napi_value thumbnails(napi_env env, napi_callback_info info);
+
+#endif // THUMBNAIL_H
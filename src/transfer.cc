@@ -0,0 +1,253 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#include "transfer.h"
+#include "frame.h"
+#include "packet.h"
+#include <cstring>
+
+TransferRegistry& TransferRegistry::instance() {
+  static TransferRegistry registry;
+  return registry;
+}
+
+TransferRegistry::~TransferRegistry() {
+  for ( auto &e : mEntries ) {
+    av_frame_free(&e.second.frame);
+    av_packet_free(&e.second.packet);
+  }
+}
+
+uint64_t TransferRegistry::put(AVFrame* frame, AVPacket* packet) {
+  std::lock_guard<std::mutex> lk(m);
+  uint64_t id = mNextId++;
+  transferEntry e;
+  e.frame = frame;
+  e.packet = packet;
+  mEntries[id] = e;
+  return id;
+}
+
+bool TransferRegistry::take(uint64_t id, AVFrame** frame, AVPacket** packet) {
+  std::lock_guard<std::mutex> lk(m);
+  auto it = mEntries.find(id);
+  if (it == mEntries.end()) return false;
+  *frame = it->second.frame;
+  *packet = it->second.packet;
+  mEntries.erase(it);
+  return true;
+}
+
+size_t TransferRegistry::pending() {
+  std::lock_guard<std::mutex> lk(m);
+  return mEntries.size();
+}
+
+// New reference to a frame's buffers. Planes wrapping Javascript Buffers
+// belong to this environment, so are copied into FFmpeg buffers.
+static int detachFrame(AVFrame* src, AVFrame** result) {
+  int ret;
+  bool jsBacked = false;
+  AVFrame* frame = av_frame_alloc();
+  if (frame == nullptr) return AVERROR(ENOMEM);
+  if ((ret = av_frame_ref(frame, src)) < 0) goto fail;
+  for ( int x = 0 ; x < AV_NUM_DATA_POINTERS ; x++ )
+    jsBacked = jsBacked || beam_is_js_buffer(frame->buf[x]);
+  if (jsBacked && ((ret = av_frame_make_writable(frame)) < 0)) goto fail;
+  *result = frame;
+  return 0;
+
+fail:
+  av_frame_free(&frame);
+  return ret;
+}
+
+static int detachPacket(AVPacket* src, AVPacket** result) {
+  int ret;
+  AVPacket* packet = av_packet_alloc();
+  if (packet == nullptr) return AVERROR(ENOMEM);
+  if ((ret = av_packet_ref(packet, src)) < 0) goto fail;
+  if (beam_is_js_buffer(packet->buf) && ((ret = av_packet_make_writable(packet)) < 0))
+    goto fail;
+  *result = packet;
+  return 0;
+
+fail:
+  av_packet_free(&packet);
+  return ret;
+}
+
+// Reads the id of a handle made by transfer, or returns 0
+static uint64_t handleId(napi_env env, napi_value handle) {
+  napi_status status;
+  napi_value value;
+  napi_valuetype type;
+  char typeName[16];
+  size_t typeLen;
+  uint64_t id = 0;
+  bool lossless;
+
+  status = napi_typeof(env, handle, &type);
+  if ((status != napi_ok) || (type != napi_object)) return 0;
+  status = napi_get_named_property(env, handle, "type", &value);
+  if (status != napi_ok) return 0;
+  status = napi_get_value_string_utf8(env, value, typeName, 16, &typeLen);
+  if ((status != napi_ok) || (strcmp(typeName, "TransferHandle") != 0)) return 0;
+  status = napi_get_named_property(env, handle, "id", &value);
+  if (status != napi_ok) return 0;
+  status = napi_get_value_bigint_uint64(env, value, &id, &lossless);
+  if ((status != napi_ok) || !lossless) return 0;
+  return id;
+}
+
+napi_value transfer(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result, value, typeVal;
+  char objType[10];
+  size_t typeLen;
+  bool hasProp;
+  AVFrame* frame = nullptr;
+  AVPacket* packet = nullptr;
+  int ret;
+
+  size_t argc = 1;
+  napi_value args[1];
+  status = napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+  CHECK_STATUS;
+  if (argc < 1) {
+    NAPI_THROW_ERROR("Transfer requires a frame or a packet.");
+  }
+
+  napi_valuetype type;
+  status = napi_typeof(env, args[0], &type);
+  CHECK_STATUS;
+  if (type != napi_object) {
+    NAPI_THROW_ERROR("Transfer requires a frame or a packet.");
+  }
+  status = napi_get_named_property(env, args[0], "type", &typeVal);
+  CHECK_STATUS;
+  status = napi_get_value_string_utf8(env, typeVal, objType, 10, &typeLen);
+  if (status == napi_string_expected) {
+    NAPI_THROW_ERROR("Transfer requires a frame or a packet.");
+  }
+  CHECK_STATUS;
+
+  if (strcmp(objType, "Frame") == 0) {
+    frameData* f;
+    status = napi_has_named_property(env, args[0], "_frame", &hasProp);
+    CHECK_STATUS;
+    if (!hasProp) {
+      NAPI_THROW_ERROR("Transfer requires a frame or a packet.");
+    }
+    status = napi_get_named_property(env, args[0], "_frame", &value);
+    CHECK_STATUS;
+    status = napi_get_value_external(env, value, (void**) &f);
+    CHECK_STATUS;
+    if ((f->frame->buf[0] == nullptr) && (f->frame->data[0] == nullptr)) {
+      NAPI_THROW_ERROR("Cannot transfer a frame without data.");
+    }
+    ret = detachFrame(f->frame, &frame);
+  } else if (strcmp(objType, "Packet") == 0) {
+    packetData* p;
+    status = napi_has_named_property(env, args[0], "_packet", &hasProp);
+    CHECK_STATUS;
+    if (!hasProp) {
+      NAPI_THROW_ERROR("Transfer requires a frame or a packet.");
+    }
+    status = napi_get_named_property(env, args[0], "_packet", &value);
+    CHECK_STATUS;
+    status = napi_get_value_external(env, value, (void**) &p);
+    CHECK_STATUS;
+    ret = detachPacket(p->packet, &packet);
+  } else {
+    NAPI_THROW_ERROR("Transfer requires a frame or a packet.");
+  }
+  if (ret < 0) {
+    NAPI_THROW_ERROR(avErrorMsg("Problem referencing data for transfer: ", ret));
+  }
+
+  uint64_t id = TransferRegistry::instance().put(frame, packet);
+  status = napi_create_object(env, &result);
+  CHECK_STATUS;
+  status = beam_set_string_utf8(env, result, "type", "TransferHandle");
+  CHECK_STATUS;
+  status = beam_set_string_utf8(env, result, "kind", (frame != nullptr) ? "frame" : "packet");
+  CHECK_STATUS;
+  status = napi_create_bigint_uint64(env, id, &value);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, result, "id", value);
+  CHECK_STATUS;
+  return result;
+}
+
+napi_value receive(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result;
+  AVFrame* frame = nullptr;
+  AVPacket* packet = nullptr;
+
+  size_t argc = 1;
+  napi_value args[1];
+  status = napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+  CHECK_STATUS;
+  uint64_t id = (argc < 1) ? 0 : handleId(env, args[0]);
+  if (id == 0) {
+    NAPI_THROW_ERROR("Receive requires a handle made by transfer.");
+  }
+  if (!TransferRegistry::instance().take(id, &frame, &packet)) {
+    NAPI_THROW_ERROR("Transfer handle has already been received or released.");
+  }
+
+  if (frame != nullptr) {
+    frameData* f = new frameData;
+    f->frame = frame;
+    status = fromAVFrame(env, f, &result);
+  } else {
+    packetData* p = new packetData;
+    p->packet = packet;
+    status = fromAVPacket(env, p, &result);
+  }
+  CHECK_STATUS;
+  return result;
+}
+
+napi_value releaseTransfer(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result;
+  AVFrame* frame = nullptr;
+  AVPacket* packet = nullptr;
+
+  size_t argc = 1;
+  napi_value args[1];
+  status = napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+  CHECK_STATUS;
+  uint64_t id = (argc < 1) ? 0 : handleId(env, args[0]);
+  if (id == 0) {
+    NAPI_THROW_ERROR("Release transfer requires a handle made by transfer.");
+  }
+  bool found = TransferRegistry::instance().take(id, &frame, &packet);
+  av_frame_free(&frame);
+  av_packet_free(&packet);
+
+  status = napi_get_boolean(env, found, &result);
+  CHECK_STATUS;
+  return result;
+}
@@ -0,0 +1,64 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+#ifndef TRANSFER_H
+#define TRANSFER_H
+
+#include "node_api.h"
+#include "beamcoder_util.h"
+#include <mutex>
+#include <unordered_map>
+
+extern "C" {
+  #include <libavcodec/avcodec.h>
+  #include <libavutil/frame.h>
+}
+
+// Frames and packets detached from one environment, waiting to be received
+// by another, for example in a different worker thread. Each entry holds its
+// own references to the underlying buffers, so planes are shared, not copied.
+class TransferRegistry {
+public:
+  static TransferRegistry& instance();
+  // Takes ownership of either the frame or the packet, returning its id
+  uint64_t put(AVFrame* frame, AVPacket* packet);
+  // Removes an entry, passing ownership to the caller. False if not found.
+  bool take(uint64_t id, AVFrame** frame, AVPacket** packet);
+  size_t pending();
+
+private:
+  TransferRegistry() { }
+  ~TransferRegistry();
+
+  struct transferEntry {
+    AVFrame* frame = nullptr;
+    AVPacket* packet = nullptr;
+  };
+  std::mutex m;
+  uint64_t mNextId = 1;
+  std::unordered_map<uint64_t, transferEntry> mEntries;
+};
+
+napi_value transfer(napi_env env, napi_callback_info info);
+napi_value receive(napi_env env, napi_callback_info info);
+napi_value releaseTransfer(napi_env env, napi_callback_info info);
+
+#endif // TRANSFER_H
@@ -21,6 +21,7 @@
 
 const test = require('tape');
 const beamcoder = require('../index.js');
+const media = require('./fixtures/media.js');
 
 test('Creating a decoder', t => {
   let dec = beamcoder.decoder({ name: 'h264' });
@@ -54,3 +55,185 @@ test('Checking the A properties:', t => {
 });
 
 // TODO properties B to Z
+
+test('Pulling frames from a demuxer', async t => {
+  let samples = 48000;
+  let wav = media.wav(samples);
+  let dm = await beamcoder.demuxer({ buffer: wav });
+  let dec = beamcoder.decoder({ demuxer: dm, stream_index: 0 });
+  let result = await dec.pull({ maxFrames: 2 });
+  t.equal(result.frames.length, 2, 'resolves with the requested number of frames.');
+  t.ok(result.packets >= 2, 'reads packets from the demuxer.');
+  let decoded = result.frames.reduce((n, f) => n + f.nb_samples, 0);
+  while (!result.eof) {
+    result = await dec.pull({ maxFrames: 16 });
+    decoded += result.frames.reduce((n, f) => n + f.nb_samples, 0);
+  }
+  t.equal(decoded, samples, 'decodes every sample before eof.');
+  try {
+    await beamcoder.decoder({ name: 'h264' }).pull();
+    t.fail('Did not reject pull on an unbound decoder.');
+  } catch (e) {
+    t.ok(e.message.match(/demuxer and stream_index/), 'rejects pull on an unbound decoder.');
+  }
+  t.end();
+});
+
+test('Streaming decoded frames', async t => {
+  let samples = 48000;
+  let wav = media.wav(samples);
+  let dm = await beamcoder.demuxer({ buffer: wav });
+  let packets = [];
+  for ( let p = await dm.read() ; p !== null ; p = await dm.read() ) packets.push(p);
+  let dec = beamcoder.decoder({ demuxer: dm, stream_index: 0 });
+  let decoded = 0;
+  for await (const frame of dec.decodeStream(packets, { highWaterMark: 2 })) {
+    decoded += frame.nb_samples;
+  }
+  t.equal(decoded, samples, 'async iterator yields every frame.');
+  dec = beamcoder.decoder({ demuxer: dm, stream_index: 0 });
+  let seen = 0;
+  let result = await dec.decodeStream(packets, () => ++seen < 2);
+  t.equal(seen, 2, 'callback returning false stops the stream.');
+  t.ok(result.cancelled, 'result reports cancellation.');
+  t.throws(() => dec.decodeStream('wibble'), /array of packets/,
+    'throws without an array of packets.');
+  t.end();
+});
+
+test('Streams waiting on a consumer do not hold threads', async t => {
+  let wav = media.wav(48000);
+  let dm = await beamcoder.demuxer({ buffer: wav });
+  let packets = [];
+  for ( let p = await dm.read() ; p !== null ; p = await dm.read() ) packets.push(p);
+  // More unread streams than the default thread pool size of 4
+  let streams = [];
+  for ( let x = 0 ; x < 6 ; x++ ) {
+    let dec = beamcoder.decoder({ demuxer: dm, stream_index: 0 });
+    streams.push(dec.decodeStream(packets, { highWaterMark: 1 }));
+  }
+  await new Promise(resolve => setTimeout(resolve, 100));
+  let dec = beamcoder.decoder({ demuxer: dm, stream_index: 0 });
+  let result = await Promise.race([
+    dec.decode(packets.slice(0, 4)),
+    new Promise(resolve => setTimeout(resolve, 2000, null)) ]);
+  t.ok(result && result.frames.length > 0, 'other work still runs.');
+  let decoded = 0;
+  for await (const frame of streams[0]) decoded += frame.nb_samples;
+  t.equal(decoded, 48000, 'a parked stream resumes when read.');
+  for ( let s of streams.slice(1) ) await s.return();
+  t.end();
+});
+
+test('Decoding to an output format', async t => {
+  let samples = 48000;
+  let wav = media.wav(samples);
+  let dm = await beamcoder.demuxer({ buffer: wav });
+  let dec = beamcoder.decoder({ demuxer: dm, stream_index: 0,
+    output_format: { sample_fmt: 'flt', sample_rate: 24000 } });
+  let frames = [];
+  for ( let p = await dm.read() ; p !== null ; p = await dm.read() )
+    frames = frames.concat((await dec.decode(p)).frames);
+  frames = frames.concat((await dec.flush()).frames);
+  t.ok(frames.every(f => f.format === 'flt' && f.sample_rate === 24000),
+    'frames are converted to the output format.');
+  let total = frames.reduce((n, f) => n + f.nb_samples, 0);
+  t.ok(Math.abs(total - samples / 2) < 64, 'audio is resampled.');
+  t.throws(() => beamcoder.decoder({ name: 'h264', output_format: { pix_fmt: 'wibble' } }),
+    /pixel format/, 'throws for an unknown pixel format.');
+  t.end();
+});
+
+test('Decoder speed profiles', t => {
+  let dec = beamcoder.decoder({ name: 'h264', speed_profile: 'fast' });
+  t.ok(dec.flags2.FAST, 'fast profile sets the FAST flag.');
+  t.equal(dec.skip_loop_filter, 'nonref', 'fast profile skips the loop filter on non-reference frames.');
+  dec = beamcoder.decoder({ name: 'h264', speed_profile: 'fastest', skip_idct: 'default' });
+  t.equal(dec.skip_frame, 'nonref', 'fastest profile skips non-reference frames.');
+  t.equal(dec.skip_idct, 'default', 'explicit options override the profile.');
+  dec = beamcoder.decoder({ name: 'h264', speed_profile: 'quality' });
+  t.notOk(dec.flags2.FAST, 'quality profile does not set the FAST flag.');
+  t.equal(beamcoder.decoder({ name: 'h264', speed_profile: 'fastest' }).lowres, 0,
+    'lowres is not used by a codec without it.');
+  t.equal(beamcoder.decoder({ name: 'mjpeg', speed_profile: 'fastest' }).lowres, 2,
+    'but is by a codec that supports it.');
+  dec = beamcoder.decoder({ name: 'aac', speed_profile: 'fastest' });
+  t.ok(!dec.flags2.FAST && dec.skip_frame === 'default', 'audio decoders are not changed.');
+  t.throws(() => beamcoder.decoder({ name: 'h264', speed_profile: 'wibble' }),
+    /speed_profile/, 'throws for an unknown profile.');
+  t.end();
+});
+
+test('Codec thread budget', t => {
+  let before = beamcoder.codecThreads({ budget: 8, max_per_session: 4 });
+  t.equal(before.budget, 8, 'budget can be set.');
+  let dec = beamcoder.decoder({ name: 'h264', width: 1920, height: 1080 });
+  let grant = beamcoder.codecThreads().sessions.find(s => s.codec === 'h264' && s.width === 1920);
+  t.ok(grant, 'records a decision for the decoder.');
+  t.equal(dec.thread_count, grant.threads, 'decoder thread_count comes from the budget.');
+  t.ok(grant.threads >= 1 && grant.threads <= 4, 'grant is within max_per_session.');
+  beamcoder.decoder({ name: 'h264', thread_count: 2 });
+  t.ok(beamcoder.codecThreads().sessions.some(s => s.reason === 'explicit'),
+    'explicit thread counts are recorded.');
+  beamcoder.codecThreads({ budget: 0, max_per_session: 16 });
+  t.end();
+});
+
+test('Codec thread budget is capped', t => {
+  let current = beamcoder.codecThreads();
+  let budget = current.allocated + 3;
+  beamcoder.codecThreads({ budget, max_per_session: 4 });
+  let decs = [ 0, 1, 2 ].map(() => beamcoder.decoder({ name: 'h264', width: 1920, height: 1080 }));
+  t.deepEqual(decs.map(d => d.thread_count), [ 3, 1, 1 ],
+    'grants what is left, then a single thread.');
+  let after = beamcoder.codecThreads();
+  t.equal(after.allocated, budget + 2, 'spent budget is overrun by one thread per codec.');
+  t.equal(after.overrun, 2, 'reports the overrun.');
+  beamcoder.codecThreads({ budget: 0, max_per_session: 16 });
+  t.end();
+});
+
+test('Decoding into the frame pool', async t => {
+  let enc = beamcoder.encoder({ name: 'mjpeg', width: 100, height: 76,
+    pix_fmt: 'yuvj420p', time_base: [1, 25] });
+  let packets = [];
+  for ( let x = 0 ; x < 3 ; x++ ) {
+    let frame = beamcoder.frame({ pts: x, width: 100, height: 76, format: 'yuvj420p' }).alloc();
+    packets = packets.concat((await enc.encode(frame)).packets);
+  }
+  packets = packets.concat((await enc.flush()).packets);
+  let dec = beamcoder.decoder({ name: 'mjpeg', frame_pool: true });
+  let frames = (await dec.decode(packets)).frames;
+  frames = frames.concat((await dec.flush()).frames);
+  t.equal(frames.length, 3, 'decodes every frame.');
+  t.ok(frames.every(f => f.linesize.every(l => l % 64 === 0)), 'linesizes are 64-byte aligned.');
+  t.ok(frames.every(f => f.data[0].length >= f.linesize[0] * f.height),
+    'planes cover the picture.');
+  t.end();
+});
+
+test('Limiting packets held for other streams', async t => {
+  let nut = await media.pcmPair(50);
+  let dm = await beamcoder.demuxer({ buffer: nut, max_pending: 8 });
+  let dec = beamcoder.decoder({ demuxer: dm, stream_index: 0 });
+  try {
+    while (!(await dec.pull({ maxFrames: 16 })).eof);
+    t.fail('Did not reject when too many packets were held.');
+  } catch (e) {
+    t.ok(e.message.match(/Too many packets held/), 'rejects when the limit is reached.');
+  }
+  let held = await dm.read();
+  t.equal(held.stream_index, 1, 'held packets are still read in order.');
+
+  dm = await beamcoder.demuxer({ buffer: nut, max_pending: 8 });
+  dm.streams[1].discard = 'all';
+  dec = beamcoder.decoder({ demuxer: dm, stream_index: 0 });
+  let result = { eof: false };
+  let packets = 0;
+  while (!result.eof) {
+    result = await dec.pull({ maxFrames: 16 });
+    packets += result.packets;
+  }
+  t.equal(packets, 50, 'discarded streams are not held.');
+  t.end();
+});
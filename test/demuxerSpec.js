@@ -21,6 +21,7 @@
 
 const test = require('tape');
 const beamcoder = require('../index.js');
+const media = require('./fixtures/media.js');
 
 test('Creating a demuxer', async t => {
   let dm = await beamcoder.demuxer('https://www.elecard.com/storage/video/bbb_1080p_c.ts');
@@ -39,3 +40,235 @@ test('Creating a demuxer', async t => {
   }
   t.end();
 });
+
+test('Demuxing from a buffer', async t => {
+  let samples = 48000;
+  let wav = media.wav(samples);
+  let dm = await beamcoder.demuxer({ buffer: wav });
+  t.equal(dm.iformat.name, 'wav', 'probes the buffer as wav.');
+  t.equal(dm.streams.length, 1, 'has 1 stream.');
+  let bytes = 0;
+  let packet = await dm.read();
+  while (packet) {
+    bytes += packet.size;
+    packet = await dm.read();
+  }
+  t.equal(bytes, samples * 2, 'reads all of the samples.');
+  await dm.seek({ pos: 44 });
+  packet = await dm.read();
+  t.ok(packet && packet.size > 0, 'reads again after seeking.');
+  try {
+    await beamcoder.demuxer({ buffer: 'not a buffer' });
+    t.fail('Did not reject a buffer that is not a Buffer.');
+  } catch (e) {
+    t.ok(e.message.match(/must be a Buffer/), 'rejects a buffer that is not a Buffer.');
+  }
+  t.end();
+});
+
+test('Sampling thumbnails', async t => {
+  let avi = await media.mjpegAvi(25);
+  let dm = await beamcoder.demuxer({ buffer: avi });
+  let result = await beamcoder.thumbnails({ demuxer: dm, count: 4, width: 32 });
+  t.equal(result.type, 'thumbnails', 'resolves with thumbnails.');
+  t.equal(result.thumbnails.length, 4, 'samples the requested count.');
+  t.ok(result.thumbnails.every(s => s.frame && s.frame.width === 32 && s.frame.format === 'rgb24'),
+    'frames are scaled and converted.');
+  result = await beamcoder.thumbnails({ demuxer: dm, times: [ 0.5 ], format: 'jpeg' });
+  let jpeg = result.thumbnails[0].data;
+  t.ok(jpeg[0] === 0xff && jpeg[1] === 0xd8, 'encodes a JPEG.');
+  try {
+    await beamcoder.thumbnails({ demuxer: dm });
+    t.fail('Did not reject without times or a count.');
+  } catch (e) {
+    t.ok(e.message.match(/times or a count/), 'rejects without times or a count.');
+  }
+  t.end();
+});
+
+test('Sampling thumbnails from a file in parallel', async t => {
+  const fs = require('fs');
+  let file = require('path').join(require('os').tmpdir(), `beamcoder_thumbs_${process.pid}.avi`);
+  fs.writeFileSync(file, await media.mjpegAvi(50));
+
+  let dm = await beamcoder.demuxer(file);
+  let first = await dm.read();
+  let times = [ 0.2, 0.6, 1.0, 1.4, 1.8, 0.4 ];
+  let result = await beamcoder.thumbnails({ demuxer: dm, times, parallel: 3,
+    width: 16, pix_fmt: 'gray' });
+  t.equal(result.samplers, 3, 'runs the requested number of samplers.');
+  t.deepEqual(result.thumbnails.map(s => s.pts), times.map(x => Math.round(x * 25)),
+    'samples the frame at each target, in target order.');
+  // Each frame has its own brightness, so compare the order of brightness
+  let rank = values => values.map(v => values.filter(w => w < v).length);
+  t.deepEqual(rank(result.thumbnails.map(s => s.frame.data[0][0])),
+    rank(times.map(x => (Math.round(x * 25) * 7) % 220)),
+    'with the picture of that frame.');
+  let next = await dm.read();
+  t.equal(next.pts, first.pts + 1, 'leaves the position of the demuxer unchanged.');
+  result = await beamcoder.thumbnails({ demuxer: dm, times, parallel: 1 });
+  t.equal(result.samplers, 1, 'can sample with one sampler.');
+  // Samplers use their own copy of the stream parameters
+  let sampling = beamcoder.thumbnails({ demuxer: dm, times, parallel: 3 });
+  dm.forceClose();
+  try {
+    result = await sampling;
+    t.equal(result.thumbnails.length, times.length, 'sampling can finish after the demuxer closes.');
+  } catch (e) {
+    t.ok(e.message.match(/cancelled/), 'or stops when the demuxer is closed.');
+  }
+  fs.unlinkSync(file);
+  t.end();
+});
+
+test('Scanning packet metadata', async t => {
+  let samples = 48000;
+  let wav = media.wav(samples);
+  let dm = await beamcoder.demuxer({ buffer: wav });
+  let scan = await dm.scan();
+  t.equal(scan.type, 'packet_scan', 'resolves with a packet scan.');
+  t.ok(scan.count > 0, 'finds packets.');
+  t.ok(scan.pts instanceof BigInt64Array && scan.size instanceof Int32Array &&
+    scan.flags instanceof Uint8Array, 'returns typed arrays.');
+  t.equal(scan.size.length, scan.count, 'with one entry per packet.');
+  t.equal(scan.size.reduce((x, y) => x + y, 0), samples * 2, 'covers all of the data.');
+  t.ok(scan.flags.every(f => f & 1), 'audio packets are key frames.');
+  let half = await dm.scan({ start: 0, end: 0.5 });
+  t.ok(half.count < scan.count, 'stops at the end time.');
+  t.ok(half.pts.every(p => p < 24000n), 'with earlier timestamps.');
+  try {
+    await dm.scan({ streams: [ 3 ] });
+    t.fail('Did not reject an unknown stream.');
+  } catch (e) {
+    t.ok(e.message.match(/stream indexes/), 'rejects an unknown stream.');
+  }
+  t.end();
+});
+
+test('Scan and thumbnail times are from the start of the media', async t => {
+  // Timestamps start at 2s
+  let nut = await media.muxVideo('nut', 'mjpeg', 'yuvj420p', media.frameTimes(50).map(x => x + 50));
+  let dm = await beamcoder.demuxer({ buffer: nut });
+  t.equal(dm.streams[0].start_time, 50, 'media starts after zero.');
+  let scan = await dm.scan({ streams: [ 0 ], start: 0.4, end: 1.0 });
+  t.deepEqual(Array.from(scan.pts, Number), media.frameTimes(15).map(x => x + 60),
+    'scans from start_time plus the start to start_time plus the end.');
+  let all = await dm.scan({ start: 0.4, end: 1.0 });
+  t.equal(all.pts[0], 60n, 'and from the start of the format for all streams.');
+  let result = await beamcoder.thumbnails({ demuxer: dm, times: [ 0.4 ], parallel: 1 });
+  t.equal(result.thumbnails[0].pts, Number(scan.pts[0]), 'thumbnails sample the same frame.');
+  t.end();
+});
+
+test('Analysing GOP structure and bitrate', async t => {
+  let avi = await media.mjpegAvi(50);
+  let dm = await beamcoder.demuxer({ buffer: avi });
+  let report = await dm.analyse({ window: 0.5, vbv: { max_rate: 1000, buffer_size: 1000 } });
+  t.equal(report.type, 'analysis', 'resolves with an analysis.');
+  let video = report.streams[0];
+  t.equal(video.packets, 50, 'counts the packets.');
+  t.equal(video.gop.count, 50, 'intra-only video has a GOP per frame.');
+  t.ok(video.gop.lengths.every(l => l === 1), 'of length one.');
+  t.equal(video.gop.open, 0, 'with closed GOPs.');
+  t.ok(Math.abs(video.gop.keyframe_interval - 0.04) < 1e-6, 'key frames every frame.');
+  t.equal(video.reorder_depth, 0, 'without reordering.');
+  t.equal(video.window_bitrate.length, 4, 'windows the bitrate.');
+  t.ok(video.peak_bitrate >= video.average_bitrate, 'peak is above average.');
+  t.equal(video.discontinuities.length, 0, 'timestamps are continuous.');
+  t.ok(video.vbv.underflows > 0, 'a small VBV buffer underflows.');
+  t.end();
+});
+
+test('Analysing open GOPs and timestamp jumps', async t => {
+  // Two runs of 30 frames, 2.8s apart, with two B-frames between references.
+  // Without a closed GOP flag, the B-frames before each key frame after the
+  // first are coded after it and reference the previous GOP.
+  let times = media.frameTimes(30).concat(media.frameTimes(30).map(x => x + 100));
+  let nut = await media.muxVideo('nut', 'mpeg4', 'yuv420p', times,
+    { gop_size: 10, max_b_frames: 2 });
+  let dm = await beamcoder.demuxer({ buffer: nut });
+  let video = (await dm.analyse({ gap: 1.0 })).streams[0];
+  t.equal(video.packets, 60, 'counts the packets.');
+  t.ok(video.gop.count >= 6, 'finds a GOP for each key frame.');
+  t.equal(video.gop.open + video.gop.closed, video.gop.count, 'each GOP is open or closed.');
+  t.equal(video.gop.open_flags[0], 0, 'the first GOP is closed.');
+  t.ok(video.gop.open > 0, 'later GOPs are open.');
+  t.ok(video.reorder_depth >= 1, 'B-frames are reordered.');
+  t.equal(video.discontinuities.length, 1, 'reports the timestamp jump.');
+  let jump = video.discontinuities[0];
+  t.ok(jump >= 28 && jump <= 32, 'at the packet after the jump.');
+  t.end();
+});
+
+test('Cancelling a demuxer', async t => {
+  let samples = 4800;
+  let wav = media.wav(samples);
+  let controller = new AbortController();
+  controller.abort();
+  try {
+    await beamcoder.demuxer({ buffer: wav, signal: controller.signal });
+    t.fail('Did not reject an aborted signal.');
+  } catch (e) {
+    t.ok(e.message.match(/operation cancelled/), 'rejects an aborted signal.');
+  }
+  controller = new AbortController();
+  let dm = await beamcoder.demuxer({ buffer: wav, timeout: 2000, signal: controller.signal });
+  t.equal(dm.timeout, 2000, 'has the requested timeout.');
+  t.notOk(dm.cancelled, 'is not cancelled when opened.');
+  t.ok(await dm.read(), 'reads a packet.');
+  controller.abort();
+  t.ok(dm.cancelled, 'is cancelled by its signal.');
+  try {
+    await dm.read();
+    t.fail('Did not reject a read after cancelling.');
+  } catch (e) {
+    t.ok(e.message.match(/operation cancelled/), 'rejects reads after cancelling.');
+  }
+  let mx = beamcoder.muxer({ format_name: 'wav', memory: true });
+  mx.cancel();
+  t.ok(mx.cancelled, 'muxers can be cancelled.');
+  t.end();
+});
+
+test('Cancelling a read from a stalled stream', async t => {
+  let wav = media.wav(48000);
+  let stream = beamcoder.demuxerStream({ highwaterMark: 1024 });
+  // Part of the file, and the stream is never ended
+  stream.write(wav.slice(0, 16384));
+  let dm = await stream.demuxer({ iformat: beamcoder.demuxers().wav, lowLatency: true });
+  let stall = new Promise(resolve => setTimeout(resolve, 500, 'stalled'));
+  let read = dm.read();
+  while (await Promise.race([ read, stall ]) !== 'stalled')
+    read = dm.read();
+  t.pass('a read waits for more data.');
+  dm.cancel();
+  try {
+    await read;
+    t.fail('Did not reject the stalled read.');
+  } catch (e) {
+    t.ok(e.message.match(/operation cancelled/), 'cancelling rejects the stalled read.');
+  }
+  t.doesNotThrow(() => dm.forceClose(), 'closes once cancelled.');
+  t.end();
+});
+
+test('Low latency demuxing', async t => {
+  let samples = 4800;
+  let wav = media.wav(samples);
+  let dm = await beamcoder.demuxer({ buffer: wav, lowLatency: true });
+  t.equal(dm.streams[0].codecpar.sample_rate, 48000, 'has parameters from the header.');
+  let before = beamcoder.monotonicTime();
+  let packet = await dm.read();
+  t.equal(typeof packet.arrival_time, 'number', 'stamps packets with an arrival time.');
+  t.ok(packet.arrival_time >= before && packet.arrival_time <= beamcoder.monotonicTime(),
+    'on the monotonic clock.');
+  t.equal(beamcoder.packet().arrival_time, null, 'other packets have no arrival time.');
+  let stamped = beamcoder.packet();
+  stamped.arrival_time = 0;
+  t.equal(stamped.arrival_time, 0, 'keeps an arrival time of zero.');
+  stamped.arrival_time = 2 ** 40 + 1;
+  t.equal(stamped.arrival_time, 2 ** 40 + 1, 'keeps an arrival time beyond 32 bits.');
+  stamped.arrival_time = null;
+  t.equal(stamped.arrival_time, null, 'clears the arrival time with null.');
+  t.end();
+});
@@ -67,3 +67,27 @@ test('Checking the A properties:', t => {
 });
 
 // TODO properties B to Z
+
+test('Encoding to an attached muxer stream', async t => {
+  let mx = beamcoder.muxer({ format_name: 'wav', memory: true });
+  let stream = mx.newStream({ name: 'pcm_s16le', time_base: [1, 48000], interleaved: false });
+  Object.assign(stream.codecpar, {
+    channels: 1, sample_rate: 48000, format: 's16',
+    channel_layout: 'mono', block_align: 2, bits_per_coded_sample: 16, bit_rate: 48000 * 16
+  });
+  let enc = beamcoder.encoder({ name: 'pcm_s16le', sample_rate: 48000, sample_fmt: 's16',
+    channel_layout: 'mono', channels: 1, time_base: [1, 48000] });
+  t.throws(() => enc.attach(mx, 3), /not a stream/, 'throws for a stream that is not in the muxer.');
+  enc.attach(mx, stream);
+  await mx.writeHeader();
+  let frame = beamcoder.frame({ pts: 0, nb_samples: 1024, sample_rate: 48000,
+    format: 's16', channel_layout: 'mono', channels: 1 }).alloc();
+  let stats = await enc.encode(frame);
+  t.equal(stats.type, 'encoded', 'resolves with stats.');
+  t.equal(stats.packets, 1, 'produces one packet.');
+  t.equal(stats.bytes, 2048, 'counts the encoded bytes.');
+  await enc.flush();
+  let out = await mx.writeTrailer();
+  t.ok(out.length > 2048, 'writes the encoded packet to the muxer.');
+  t.end();
+});
@@ -43,5 +43,193 @@ test('Create a filterer', async t => {
     filterSpec: 'aresample=8000, aformat=sample_fmts=s16:channel_layouts=mono'
   });
   t.ok(flt, 'is truthy.');
+  t.deepEqual(flt.inputHandles, { in: 0 }, 'has input handles.');
+  t.deepEqual(flt.outputHandles, { out: 0 }, 'has output handles.');
+  let re = await flt.reinit([{ sampleRate: 48000 }]);
+  t.deepEqual(re.reconfigured, [], 'reinit skips unchanged sources.');
+  t.end();
+});
+
+test('Create a filterer with shared threads', async t => {
+  let flt = await beamcoder.filterer({
+    filterType: 'video',
+    inputParams: [
+      {
+        width: 1920,
+        height: 1080,
+        pixelFormat: 'yuv420p',
+        timeBase: [1, 25],
+        pixelAspect: [1, 1]
+      }
+    ],
+    outputParams: [
+      {
+        pixelFormat: 'yuv420p'
+      }
+    ],
+    filterSpec: 'scale=1280:720',
+    threads: 4,
+    threadType: 1,
+    sharedThreads: true
+  });
+  t.equal(flt.graph.nb_threads, 4, 'has requested thread count.');
+  t.equal(flt.graph.thread_type, 1, 'has slice thread type.');
+  t.ok(beamcoder.filterThreads().threads > 0, 'shared pool has threads.');
+  t.end();
+});
+
+test('Filter frames on shared threads', async t => {
+  let flt = await beamcoder.filterer({
+    filterType: 'video',
+    inputParams: [{ width: 64, height: 64, pixelFormat: 'yuv420p',
+      timeBase: [1, 25], pixelAspect: [1, 1] }],
+    outputParams: [{ pixelFormat: 'yuv420p' }],
+    filterSpec: 'hflip', // flips slices of the picture as separate jobs
+    threads: 4,
+    threadType: 'slice',
+    sharedThreads: true
+  });
+  t.equal(flt.graph.thread_type, 1, 'accepts a named slice thread type.');
+  let before = beamcoder.filterThreads().batches;
+  let out = await flt.filter([ halvesFrame(64, 64, 0), halvesFrame(64, 64, 1) ]);
+  let frames = out[0].frames;
+  t.equal(frames.length, 2, 'filters every frame.');
+  let luma = (f, x) => f.data[0][f.linesize[0] * 32 + x];
+  t.ok(frames.every(f => (luma(f, 8) === 200) && (luma(f, 56) === 40)),
+    'with the picture flipped.');
+  t.ok(beamcoder.filterThreads().batches > before, 'runs batches of slice jobs on the pool.');
+  try {
+    await beamcoder.filterer({ filterType: 'video', inputParams: [{ width: 64, height: 64,
+      pixelFormat: 'yuv420p', timeBase: [1, 25], pixelAspect: [1, 1] }],
+      outputParams: [{ pixelFormat: 'yuv420p' }], filterSpec: 'hflip', threadType: 'frame' });
+    t.fail('Did not reject an unknown thread type.');
+  } catch (e) {
+    t.ok(e.message.match(/threadType/), 'rejects an unknown thread type.');
+  }
+  t.end();
+});
+
+// Picture with a dark left half and a light right half
+function halvesFrame(width, height, pts) {
+  let frame = beamcoder.frame({ width, height, format: 'yuv420p', pts }).alloc();
+  let [ y, u, v ] = frame.data;
+  for ( let row = 0 ; row < height ; row++ )
+    for ( let col = 0 ; col < frame.linesize[0] ; col++ )
+      y[row * frame.linesize[0] + col] = (col < width / 2) ? 40 : 200;
+  u.fill(128);
+  v.fill(128);
+  return frame;
+}
+
+test('Reinit a video filterer to a new size', async t => {
+  let flt = await beamcoder.filterer({
+    filterType: 'video',
+    inputParams: [{ width: 32, height: 32, pixelFormat: 'yuv420p',
+      timeBase: [1, 25], pixelAspect: [1, 1] }],
+    outputParams: [{ pixelFormat: 'yuv420p' }],
+    filterSpec: 'scale=64:64'
+  });
+  let out = await flt.filter([ halvesFrame(32, 32, 0) ]);
+  t.equal(out[0].frames[0].width, 64, 'scales the first size.');
+
+  let re = await flt.reinit([{ width: 48, height: 48 }]);
+  t.deepEqual(re.reconfigured, [ 'in' ], 'reconfigures the changed source.');
+  out = await flt.filter([ halvesFrame(48, 48, 1) ]);
+  let frame = out[0].frames[0];
+  t.equal(frame.width, 64, 'output keeps the scaled width.');
+  t.equal(frame.height, 64, 'output keeps the scaled height.');
+  let y = frame.data[0];
+  let mid = 32 * frame.linesize[0];
+  t.ok(Math.abs(y[mid + 8] - 40) < 8, 'left of the new frame is scaled from the left.');
+  t.ok(Math.abs(y[mid + 56] - 200) < 8, 'right of the new frame is scaled from the right.');
+  re = await flt.reinit([{ width: 48, height: 48 }]);
+  t.deepEqual(re.reconfigured, [], 'a repeated reinit changes nothing.');
+
+  try {
+    await flt.reinit([{ timeBase: [1, 50] }]);
+    t.fail('Did not reject a time base change.');
+  } catch (e) {
+    t.ok(e.message.match(/time base/), 'rejects a time base change.');
+  }
+  t.end();
+});
+
+test('Filter a multi-input graph by handle', async t => {
+  let flt = await beamcoder.filterer({
+    filterType: 'video',
+    inputParams: [ 'in0:v', 'in1:v' ].map(name => ({ name, width: 32, height: 32,
+      pixelFormat: 'yuv420p', timeBase: [1, 25], pixelAspect: [1, 1] })),
+    outputParams: [ 'out0:v', 'out1:v' ].map(name => ({ name, pixelFormat: 'yuv420p' })),
+    filterSpec: '[in0:v][in1:v] hstack [st]; [st] split [out0:v][sp]; [sp] scale=32:16 [out1:v]'
+  });
+  const { inputHandles: ih, outputHandles: oh } = flt;
+  t.deepEqual(Object.keys(ih).sort(), [ 'in0:v', 'in1:v' ], 'has a handle for each input.');
+  t.deepEqual(Object.keys(oh).sort(), [ 'out0:v', 'out1:v' ], 'has a handle for each output.');
+  let flat = (luma, pts) => {
+    let frame = beamcoder.frame({ width: 32, height: 32, format: 'yuv420p', pts }).alloc();
+    frame.data[0].fill(luma);
+    frame.data.slice(1).forEach(d => d.fill(128));
+    return frame;
+  };
+
+  // Handles in reverse order of their names, to show the handle picks the input
+  let srcs = [];
+  srcs[ih['in1:v']] = [ flat(200, 0) ];
+  srcs[ih['in0:v']] = [ flat(40, 0) ];
+  let out = await flt.filter(srcs);
+  t.ok(Array.isArray(out) && out.total_time >= 0, 'resolves with an array of frame arrays.');
+  let stacked = out[oh['out0:v']][0];
+  t.equal(stacked.width, 64, 'stacks the two inputs.');
+  t.ok(Math.abs(stacked.data[0][8] - 40) < 8, 'with the first input on the left.');
+  t.ok(Math.abs(stacked.data[0][56] - 200) < 8, 'and the second on the right.');
+  let scaled = out[oh['out1:v']][0];
+  t.ok(scaled.width === 32 && scaled.height === 16, 'each output has its own frames.');
+
+  srcs = [];
+  srcs[ih['in0:v']] = [ flat(40, 1) ];
+  srcs[ih['in1:v']] = null;
+  let waiting = await flt.filter(srcs);
+  t.ok(waiting.every(frames => Array.isArray(frames)), 'accepts inputs with no frames.');
+  srcs = [];
+  srcs[ih['in1:v']] = [ flat(200, 1) ];
+  out = await flt.filter(srcs);
+  t.equal(waiting[oh['out0:v']].length + out[oh['out0:v']].length, 1,
+    'outputs once both inputs have a frame.');
+  try {
+    await flt.filter([ flat(40, 2) ]);
+    t.fail('Did not reject a plain frame array for a graph without an input named in.');
+  } catch (e) {
+    t.ok(e.message.match(/not found/), 'rejects a plain frame array without an input named in.');
+  }
+  t.end();
+});
+
+test('Changing a filter with commands', async t => {
+  let flt = await beamcoder.filterer({
+    filterType: 'audio',
+    inputParams: [{ sampleRate: 48000, sampleFormat: 's16', channelLayout: 'mono',
+      timeBase: [1, 48000] }],
+    outputParams: [{ sampleRate: 48000, sampleFormat: 's16', channelLayout: 'mono' }],
+    filterSpec: 'volume=1.0'
+  });
+  let level = async pts => {
+    let frame = beamcoder.frame({ format: 's16', sample_rate: 48000, channels: 1,
+      channel_layout: 'mono', nb_samples: 1024, pts }).alloc();
+    let data = frame.data[0];
+    new Int16Array(data.buffer, data.byteOffset, 1024).fill(1000);
+    let out = (await flt.filter([ frame ]))[0].frames[0];
+    return new Int16Array(out.data[0].buffer, out.data[0].byteOffset, 1)[0];
+  };
+  t.ok(Math.abs(await level(0) - 1000) <= 2, 'starts at the given volume.');
+  t.equal(typeof flt.sendCommand('volume', 'volume', '0.5'), 'string',
+    'sending a command returns the response.');
+  t.ok(Math.abs(await level(1024) - 500) <= 2, 'sent commands apply to the next frame.');
+  flt.queueCommand('volume', 'volume', '0.25', 1.0, { one: true });
+  t.ok(Math.abs(await level(2048) - 500) <= 2, 'queued commands wait for their time.');
+  t.ok(Math.abs(await level(48000) - 250) <= 2, 'and then apply.');
+  t.throws(() => flt.sendCommand('volume', 'wibble', '1'), /failed to process command/,
+    'throws for an unknown command.');
+  t.throws(() => flt.sendCommand('volume', 'volume'), /requires target, command and argument/,
+    'throws without an argument.');
   t.end();
 });
@@ -0,0 +1,106 @@
+/*
+  Aerostat Beam Coder - Node.js native bindings for FFmpeg.
+  Copyright (C) 2019  Streampunk Media Ltd.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  https://www.streampunk.media/ mailto:furnace@streampunk.media
+  14 Ormiscaig, Aultbea, Achnasheen, IV22 2JJ  U.K.
+*/
+
+// Media built in memory for tests, so no sample files are needed
+
+const beamcoder = require('../../index.js');
+
+// Mono 16-bit PCM WAV at 48kHz, silent, with the given number of samples
+function wav(samples) {
+  let buf = Buffer.alloc(44 + samples * 2);
+  buf.write('RIFF', 0); buf.writeUInt32LE(36 + samples * 2, 4); buf.write('WAVE', 8);
+  buf.write('fmt ', 12); buf.writeUInt32LE(16, 16); buf.writeUInt16LE(1, 20);
+  buf.writeUInt16LE(1, 22); buf.writeUInt32LE(48000, 24); buf.writeUInt32LE(96000, 28);
+  buf.writeUInt16LE(2, 32); buf.writeUInt16LE(16, 34);
+  buf.write('data', 36); buf.writeUInt32LE(samples * 2, 40);
+  return buf;
+}
+
+// NUT file in memory with two interleaved mono PCM streams, each with the
+// given number of 1024 sample packets
+async function pcmPair(count) {
+  let mx = beamcoder.muxer({ format_name: 'nut', memory: true });
+  for ( let s = 0 ; s < 2 ; s++ ) {
+    let stream = mx.newStream({ name: 'pcm_s16le', time_base: [1, 48000] });
+    Object.assign(stream.codecpar, { sample_rate: 48000, channels: 1,
+      channel_layout: 'mono', format: 's16' });
+  }
+  await mx.writeHeader();
+  for ( let x = 0 ; x < count ; x++ ) {
+    for ( let s = 0 ; s < 2 ; s++ ) {
+      await mx.writeFrame(beamcoder.packet({ pts: x * 1024, dts: x * 1024, duration: 1024,
+        stream_index: s, data: Buffer.alloc(2048), flags: { KEY: true } }));
+    }
+  }
+  return mx.writeTrailer();
+}
+
+// Encodes one frame for each of the given timestamps, with a brightness that
+// changes every frame, then flushes. Resolves with any packets the encoder
+// returns - none when it is attached to a muxer.
+async function encodeVideo(enc, timestamps) {
+  let packets = [];
+  for ( let x = 0 ; x < timestamps.length ; x++ ) {
+    let frame = beamcoder.frame({ pts: timestamps[x], width: enc.width, height: enc.height,
+      format: enc.pix_fmt }).alloc();
+    frame.data[0].fill(16 + (x * 7) % 220);
+    frame.data.slice(1).forEach(d => d.fill(128));
+    let result = await enc.encode(frame);
+    if (result.packets) packets = packets.concat(result.packets);
+  }
+  let result = await enc.flush();
+  if (result.packets) packets = packets.concat(result.packets);
+  return packets;
+}
+
+// Muxes 64x64 video encoded at 25fps into a file of the given format in
+// memory, one frame for each of the given timestamps. Options are set on the
+// encoder, e.g. { gop_size: 10, max_b_frames: 2 } for open GOPs.
+async function muxVideo(formatName, codecName, pixFmt, timestamps, options = {}) {
+  let mx = beamcoder.muxer({ format_name: formatName, memory: true });
+  let stream = mx.newStream({ name: codecName, time_base: [1, 25] });
+  Object.assign(stream.codecpar, { width: 64, height: 64, format: pixFmt });
+  let enc = beamcoder.encoder(Object.assign({ name: codecName, width: 64, height: 64,
+    pix_fmt: pixFmt, time_base: [1, 25] }, options));
+  enc.attach(mx, stream);
+  await mx.writeHeader();
+  await encodeVideo(enc, timestamps);
+  return mx.writeTrailer();
+}
+
+// Intra-only MJPEG in AVI with the given number of frames
+function mjpegAvi(count) {
+  return muxVideo('avi', 'mjpeg', 'yuvj420p', frameTimes(count));
+}
+
+// Timestamps 0 to count - 1
+function frameTimes(count) {
+  return Array.from({ length: count }, (_, x) => x);
+}
+
+module.exports = {
+  wav,
+  pcmPair,
+  encodeVideo,
+  muxVideo,
+  mjpegAvi,
+  frameTimes
+};
@@ -143,3 +143,150 @@ test('Can delete data', t => {
   t.equal(f.data.length, 0, 'of length zero.');
   t.end();
 });
+
+test('Data buffers are cached until reallocated', t => {
+  let f = beamcoder.frame({ width: 64, height: 48, format: 'yuv420p' }).alloc();
+  let data = f.data;
+  t.equal(f.data, data, 'repeated reads return the same array.');
+  t.equal(f.data[0], data[0], 'and the same buffers.');
+  t.ok(Object.isFrozen(data), 'the shared array is frozen.');
+  t.throws(() => { 'use strict'; data[0] = Buffer.alloc(1); }, TypeError,
+    'so its planes cannot be replaced in place.');
+  t.equal(f.data[0], data[0], 'leaving the planes unchanged.');
+  f.alloc();
+  t.notEqual(f.data, data, 'alloc creates new data.');
+  data = f.data;
+  f.data = [ Buffer.alloc(f.linesize[0] * 48), data[1], data[2] ];
+  t.notEqual(f.data, data, 'setting data creates new data.');
+  t.end();
+});
+
+test('Row views respect linesize', t => {
+  let f = beamcoder.frame({ width: 50, height: 20, format: 'yuv420p' }).alloc();
+  let rows = f.rows;
+  t.equal(rows.length, 3, 'has rows for three planes.');
+  t.deepEqual(rows.map(p => p.length), [ 20, 10, 10 ], 'with one view per line.');
+  t.equal(rows[0][0].length, 50, 'luma rows exclude padding.');
+  t.equal(rows[1][0].length, 25, 'chroma rows are subsampled.');
+  rows[0][1].fill(42);
+  t.equal(f.data[0][f.linesize[0]], 42, 'second row starts at linesize.');
+  t.equal(f.rows, rows, 'row views are cached.');
+  t.ok(Object.isFrozen(rows) && rows.every(p => Object.isFrozen(p)), 'and frozen.');
+  t.equal(beamcoder.frame({ sample_rate: 48000, format: 's16',
+    channel_layout: 'stereo', nb_samples: 1024 }).alloc().rows, null,
+  'audio frames have no rows.');
+  t.end();
+});
+
+test('Transferring frames between threads', async t => {
+  const { Worker } = require('worker_threads');
+  let f = beamcoder.frame({ width: 64, height: 48, format: 'yuv420p', pts: 42 }).alloc();
+  f.data[0].fill(77);
+  let handle = beamcoder.transfer(f);
+  t.equal(handle.type, 'TransferHandle', 'makes a transfer handle.');
+  t.equal(handle.kind, 'frame', 'for a frame.');
+  let result = await new Promise((resolve, reject) => {
+    let worker = new Worker(`
+      const { parentPort, workerData } = require('worker_threads');
+      const beamcoder = require(workerData.path);
+      let f = beamcoder.receive(workerData.handle);
+      parentPort.postMessage({ pts: f.pts, width: f.width, luma: f.data[0][0] });
+    `, { eval: true, workerData: { path: require.resolve('../index.js'), handle } });
+    worker.once('message', resolve);
+    worker.once('error', reject);
+  });
+  t.deepEqual(result, { pts: 42, width: 64, luma: 77 }, 'receives the frame in a worker.');
+  t.throws(() => beamcoder.receive(handle), /already been received/, 'handles are received once.');
+  let spare = beamcoder.transfer(beamcoder.packet({ pts: 1, data: Buffer.alloc(16) }));
+  t.equal(spare.kind, 'packet', 'packets can be transferred.');
+  t.ok(beamcoder.releaseTransfer(spare), 'unwanted handles can be released.');
+  t.notOk(beamcoder.releaseTransfer(spare), 'only once.');
+  t.end();
+});
+
+test('Passing frames through a shared memory ring', t => {
+  if (process.platform === 'win32') {
+    t.comment('Frame rings are not available on Windows.');
+    return t.end();
+  }
+  let name = `/beamcoder-test-${process.pid}`;
+  let writer = beamcoder.frameRing({ name, create: true, slots: 2,
+    width: 64, height: 48, pix_fmt: 'yuv420p' });
+  let reader = beamcoder.frameRing({ name });
+  t.equal(reader.slots, 2, 'opens the ring by name.');
+  let f = beamcoder.frame({ width: 64, height: 48, format: 'yuv420p', pts: 7 }).alloc();
+  f.data[0].fill(99);
+  t.equal(reader.read(), null, 'an empty ring reads null.');
+  t.ok(writer.write(f), 'writes a frame.');
+  t.ok(writer.write(f), 'writes a second frame.');
+  t.notOk(writer.write(f), 'reports a full ring.');
+  t.equal(reader.readable(), 2, 'has two frames to read.');
+  let r = reader.read();
+  t.equal(r.pts, 7, 'reads the frame properties.');
+  t.deepEqual([ r.width, r.height, r.format ], [ 64, 48, 'yuv420p' ], 'with the same picture.');
+  t.equal(r.data[0][0], 99, 'and the same data.');
+  let data = r.data[0];
+  let second = reader.read();
+  t.ok(second, 'reads the second frame.');
+  t.notOk(writer.write(f), 'slots stay in use while frames are held.');
+  t.ok(reader.release(r), 'release returns the slot now.');
+  t.equal(data.length, 0, 'release detaches the plane Buffers.');
+  t.equal(r.data.length, 0, 'and empties the frame.');
+  f.pts = 8;
+  t.ok(writer.write(f), 'a released slot is written again.');
+  let held = reader.read();
+  t.equal(held.pts, 8, 'and read again.');
+  t.ok(reader.release(second), 'releases the second frame.');
+  let handle = beamcoder.transfer(held);
+  t.notOk(reader.release(held), 'release waits while a transfer handle holds the data.');
+  t.ok(writer.write(f), 'the other slot is written.');
+  t.notOk(writer.write(f), 'but the held slot stays in use.');
+  beamcoder.releaseTransfer(handle);
+  t.ok(writer.write(f), 'until the handle lets go.');
+  t.throws(() => reader.release(r), /already been released/, 'throws when released twice.');
+  t.throws(() => reader.release(f), /not read from this frame ring/,
+    'throws for frames from elsewhere.');
+  reader.close();
+  writer.close();
+  t.ok(writer.unlink(), 'removes the shared memory.');
+  t.throws(() => beamcoder.frameRing({ name }), /Failed to open/, 'which then cannot be opened.');
+  t.end();
+});
+
+test('Dropping frame ring slots that do not fit', t => {
+  if (process.platform !== 'linux') {
+    t.comment('Shared memory is only visible as a file on Linux.');
+    return t.end();
+  }
+  const fs = require('fs');
+  let name = `/beamcoder-test-bad-${process.pid}`;
+  let writer = beamcoder.frameRing({ name, create: true, slots: 2,
+    width: 64, height: 48, pix_fmt: 'yuv420p' });
+  let reader = beamcoder.frameRing({ name });
+  let f = beamcoder.frame({ width: 64, height: 48, format: 'yuv420p', pts: 7 }).alloc();
+  // Slot headers follow the 64 byte ring header, with planes at byte 108
+  // and plane offsets at byte 144 of each
+  let shm = fs.openSync(`/dev/shm${name}`, 'r+');
+  let header = Buffer.alloc(32);
+  fs.readSync(shm, header, 0, 32, 0);
+  let stride = Number(header.readBigUInt64LE(24));
+  let patch = (pos, buf) => fs.writeSync(shm, buf, 0, buf.length, pos);
+
+  t.ok(writer.write(f) && writer.write(f), 'writes two frames.');
+  let planes = Buffer.alloc(4);
+  planes.writeInt32LE(20);
+  patch(64 + 108, planes);
+  t.throws(() => reader.read(), /does not describe a frame/, 'rejects too many planes.');
+  let offset = Buffer.alloc(8);
+  offset.writeBigUInt64LE(1n << 40n);
+  patch(64 + stride + 144 + 8, offset);
+  t.throws(() => reader.read(), /does not describe a frame/, 'rejects a plane outside the slot.');
+  t.equal(reader.readable(), 0, 'drops the bad slots.');
+  t.ok(writer.write(f), 'which return to the writer.');
+  t.equal(reader.read().pts, 7, 'and are read again once valid.');
+  fs.closeSync(shm);
+  reader.close();
+  writer.close();
+  writer.unlink();
+  t.end();
+});
@@ -71,3 +71,26 @@ test('Custom Logging', async t => {
   // [mpegts @ 0x7f1978000900] Packet corrupt (stream = 1, dts = 53647096)
   t.ok(n > 5);
 });
+
+test('Loading in worker threads', async t => {
+  const { Worker } = require('worker_threads');
+  beamcoder.logging('info');
+  let run = level => new Promise((resolve, reject) => {
+    let worker = new Worker(`
+      const { parentPort, workerData } = require('worker_threads');
+      const beamcoder = require(workerData.path);
+      beamcoder.logging(workerData.level);
+      beamcoder.setLoggingCallback(() => {});
+      parentPort.postMessage({ level: beamcoder.logging(),
+        frame: beamcoder.frame({ width: 16, height: 16, format: 'yuv420p' }).alloc().data.length });
+    `, { eval: true, workerData: { path: require.resolve('../index.js'), level } });
+    worker.once('message', resolve);
+    worker.once('error', reject);
+  });
+  let results = await Promise.all([ run('quiet'), run('debug') ]);
+  t.deepEqual(results.map(r => r.level), [ 'quiet', 'debug' ], 'each worker has its own log level.');
+  t.ok(results.every(r => r.frame === 3), 'workers can make frames.');
+  t.equal(beamcoder.logging(), 'info', 'main thread log level is unchanged.');
+  beamcoder.setLoggingCallback(null);
+  t.end();
+});
@@ -21,6 +21,7 @@
 
 const test = require('tape');
 const beamcoder = require('../index.js');
+const media = require('./fixtures/media.js');
 
 test('Creating a muxer', t => {
   let mx = beamcoder.muxer({ name: 'mpegts' });
@@ -29,6 +30,275 @@ test('Creating a muxer', t => {
   t.ok(mx.oformat, 'has output format.');
   t.equal(mx.oformat.name, 'mpegts', 'output format is mpegts.');
   t.equal(mx.type, 'muxer', 'type name is set to muxer.');
+  t.equal(typeof mx.interleave, 'function', 'has an interleave method.');
   t.throws(() => beamcoder.muxer({ name: 'wibble' }), 'throws when unknown name.');
   t.end();
 });
+
+test('Creating a packaging muxer', t => {
+  let dir = require('path').join(require('os').tmpdir(), `beamcoder_pkg_${process.pid}`);
+  let mx = beamcoder.muxer({ format_name: 'mp4', packager: { directory: dir, type: 'dash' } });
+  t.ok(mx, 'is truthy.');
+  t.ok(require('fs').existsSync(dir), 'creates the output directory.');
+  t.deepEqual(mx.segments(), [], 'hands no segments to segments().');
+  t.throws(() => beamcoder.muxer({ format_name: 'mp4', packager: { directory: dir, type: 'smooth' } }),
+    'throws for an unknown playlist type.');
+  t.throws(() => beamcoder.muxer({ format_name: 'mp4', packager: { type: 'hls' } }),
+    'throws without a directory.');
+  require('fs').rmdirSync(dir);
+  t.end();
+});
+
+test('Packaging segments and a playlist', async t => {
+  const fs = require('fs');
+  const path = require('path');
+  let dir = path.join(require('os').tmpdir(), `beamcoder_hls_${process.pid}`);
+  let mx = beamcoder.muxer({ format_name: 'mp4',
+    packager: { directory: dir, type: 'hls', duration: 1 } });
+  let stream = mx.newStream({ name: 'mjpeg', time_base: [1, 25] });
+  Object.assign(stream.codecpar, { width: 64, height: 64, format: 'yuvj420p' });
+  await mx.writeHeader();
+  let enc = beamcoder.encoder({ name: 'mjpeg', width: 64, height: 64,
+    pix_fmt: 'yuvj420p', time_base: [1, 25] });
+  enc.attach(mx, stream);
+  await media.encodeVideo(enc, media.frameTimes(75));
+  await mx.writeTrailer();
+
+  let files = fs.readdirSync(dir);
+  t.ok(files.includes('segmentinit.mp4'), 'writes the init segment.');
+  let init = fs.readFileSync(path.join(dir, 'segmentinit.mp4'));
+  t.ok(init.includes('ftyp') && init.includes('moov'), 'init segment holds the movie header.');
+  let segments = files.filter(f => f.endsWith('.m4s'));
+  t.equal(segments.length, 3, 'writes a segment per second of video.');
+  t.ok(segments.every(f => fs.readFileSync(path.join(dir, f)).includes('mdat')),
+    'media segments hold media data.');
+  t.notOk(files.some(f => f.endsWith('.tmp')), 'leaves no temporary files.');
+  let playlist = fs.readFileSync(path.join(dir, 'index.m3u8'), 'utf8');
+  t.ok(playlist.startsWith('#EXTM3U'), 'writes an HLS playlist.');
+  t.ok(playlist.includes('#EXT-X-MAP:URI="segmentinit.mp4"'), 'that maps the init segment.');
+  t.deepEqual(playlist.split('\n').filter(l => l.endsWith('.m4s')), segments.sort(),
+    'that lists every segment.');
+  t.equal(playlist.match(/#EXTINF:1\.0/g).length, 3, 'each of a second.');
+  t.ok(playlist.includes('#EXT-X-ENDLIST'), 'that is closed by the trailer.');
+  fs.rmSync(dir, { recursive: true });
+  t.end();
+});
+
+test('Packaging a DASH manifest for muxed streams', async t => {
+  const fs = require('fs');
+  const path = require('path');
+  let top = path.join(require('os').tmpdir(), `beamcoder_dash_${process.pid}`);
+  let dir = path.join(top, 'live', 'stream');
+  let mx = beamcoder.muxer({ format_name: 'mp4',
+    packager: { directory: dir, type: 'dash', duration: 1, stream_index: 0 } });
+  t.ok(fs.existsSync(dir), 'creates missing parent directories.');
+  let video = mx.newStream({ name: 'mjpeg', time_base: [1, 25] });
+  Object.assign(video.codecpar, { width: 64, height: 64, format: 'yuvj420p' });
+  let audio = mx.newStream({ name: 'aac', time_base: [1, 48000] });
+  Object.assign(audio.codecpar, { sample_rate: 48000, channels: 1, channel_layout: 'mono',
+    format: 'fltp', extradata: Buffer.from([ 0x11, 0x88 ]) }); // AAC-LC, 48kHz, mono
+  await mx.writeHeader();
+  let enc = beamcoder.encoder({ name: 'mjpeg', width: 64, height: 64,
+    pix_fmt: 'yuvj420p', time_base: [1, 25] });
+  enc.attach(mx, video);
+  await media.encodeVideo(enc, media.frameTimes(50));
+  await mx.writeTrailer();
+
+  let manifest = fs.readFileSync(path.join(dir, 'manifest.mpd'), 'utf8');
+  t.equal(manifest.match(/<AdaptationSet/g).length, 1,
+    'writes one adaptation set for the muxed segments.');
+  t.notOk(manifest.match(/<AdaptationSet[^>]*contentType/), 'without a single content type.');
+  t.ok(manifest.includes('<ContentComponent id="0" contentType="video"/>') &&
+    manifest.includes('<ContentComponent id="1" contentType="audio"/>'),
+    'labelled with a content component per stream.');
+  t.ok(manifest.includes('mimeType="video/mp4" codecs="mp4v.6C,mp4a.40.2"'),
+    'with the codecs of every stream.');
+  fs.rmSync(top, { recursive: true });
+  t.end();
+});
+
+test('Creating a segmenting muxer', t => {
+  let mx = beamcoder.muxer({ format_name: 'mp4', segmenter: { duration: 2 } });
+  t.ok(mx, 'is truthy.');
+  t.deepEqual(mx.segments(), [], 'has no segments before writing.');
+  t.throws(() => beamcoder.muxer({ format_name: 'wav', segmenter: { duration: 2 } }),
+    'throws for a format that cannot be fragmented.');
+  t.end();
+});
+
+test('Cutting fragments from muxed packets', async t => {
+  let enc = beamcoder.encoder({ name: 'mjpeg', width: 64, height: 64,
+    pix_fmt: 'yuvj420p', time_base: [1, 25] });
+  let packets = await media.encodeVideo(enc, media.frameTimes(75));
+  let mx = beamcoder.muxer({ format_name: 'mp4', segmenter: { duration: 1 } });
+  let stream = mx.newStream({ name: 'mjpeg', time_base: [1, 25] });
+  Object.assign(stream.codecpar, { width: 64, height: 64, format: 'yuvj420p' });
+  await mx.writeHeader();
+  let init = mx.segments();
+  t.deepEqual(init.map(s => [ s.type, s.sequence ]), [ [ 'init', 0 ] ],
+    'cuts the init segment when the header is written.');
+  t.ok(init[0].data.includes('moov') && !init[0].data.includes('mdat'),
+    'which holds the movie header and no media.');
+
+  // Keyframes every 10 frames, so fragments wait for one after each second
+  let scale = stream.time_base[1] / (25 * stream.time_base[0]);
+  let sizes = packets.map(p => p.size);
+  let segments = [];
+  for ( let p of packets ) {
+    p.flags = { KEY: p.pts % 10 === 0 };
+    p.duration = scale;
+    p.pts = p.dts = p.pts * scale;
+    p.stream_index = 0;
+    await mx.writeFrame(p);
+    segments = segments.concat(mx.segments());
+  }
+  await mx.writeTrailer();
+  segments = segments.concat(mx.segments());
+
+  t.deepEqual(segments.map(s => s.sequence), [ 1, 2, 3 ], 'cuts three media segments.');
+  t.deepEqual(segments.map(s => s.pts / scale), [ 0, 30, 60 ],
+    'at the first keyframe after each second.');
+  t.deepEqual(segments.map(s => s.duration / scale), [ 30, 30, 15 ], 'with their durations.');
+  t.ok(segments.every(s => s.keyframe), 'each starting with a keyframe.');
+  t.ok(segments.every(s => s.data.toString('ascii', 4, 8) === 'moof'), 'each starts with a moof.');
+  let mdat = segments.map(s => s.data.readUInt32BE(s.data.indexOf('mdat') - 4) - 8);
+  let sum = (first, last) => sizes.slice(first, last).reduce((x, y) => x + y, 0);
+  t.deepEqual(mdat, [ sum(0, 30), sum(30, 60), sum(60, 75) ],
+    'and holds the data of exactly its packets.');
+  t.end();
+});
+
+test('Muxing to memory', async t => {
+  let mx = beamcoder.muxer({ format_name: 'wav', memory: true });
+  let stream = mx.newStream({ name: 'pcm_s16le', time_base: [1, 48000], interleaved: false });
+  Object.assign(stream.codecpar, {
+    channels: 1, sample_rate: 48000, format: 's16',
+    channel_layout: 'mono', block_align: 2, bits_per_coded_sample: 16, bit_rate: 48000 * 16
+  });
+  await mx.writeHeader();
+  await mx.writeFrame(beamcoder.packet({ pts: 0, dts: 0, stream_index: 0,
+    data: Buffer.alloc(9600), duration: 4800 }));
+  let out = await mx.writeTrailer();
+  t.ok(Buffer.isBuffer(out), 'resolves to a Buffer.');
+  t.equal(out.toString('ascii', 0, 4), 'RIFF', 'starts with a RIFF header.');
+  t.equal(out.readUInt32LE(4), out.length - 8, 'has the RIFF size rewritten after seeking back.');
+  t.throws(() => beamcoder.muxer({ format_name: 'wav', memory: { chunk_size: 16 } }),
+    'throws for a tiny chunk size.');
+  t.end();
+});
+
+test('Writing arrays of packets and encoder results', async t => {
+  let mx = beamcoder.muxer({ format_name: 'wav', memory: true });
+  let stream = mx.newStream({ name: 'pcm_s16le', time_base: [1, 48000], interleaved: false });
+  Object.assign(stream.codecpar, {
+    channels: 1, sample_rate: 48000, format: 's16',
+    channel_layout: 'mono', block_align: 2, bits_per_coded_sample: 16, bit_rate: 48000 * 16
+  });
+  await mx.writeHeader();
+  let packets = [ 1, 2, 3 ].map(x => beamcoder.packet({ pts: (x - 1) * 480, dts: (x - 1) * 480,
+    stream_index: 0, data: Buffer.alloc(960, x), duration: 480 }));
+  t.equal(await mx.writeFrame(packets), undefined, 'resolves for an array of packets.');
+  let enc = beamcoder.encoder({ name: 'pcm_s16le', sample_rate: 48000, sample_fmt: 's16',
+    channel_layout: 'mono', channels: 1, time_base: [1, 48000] });
+  let frames = [ 4, 5 ].map(x => {
+    let frame = beamcoder.frame({ pts: (x - 1) * 480, nb_samples: 480, sample_rate: 48000,
+      format: 's16', channel_layout: 'mono', channels: 1 }).alloc();
+    frame.data[0].fill(x);
+    return frame;
+  });
+  let encoded = await enc.encode(frames);
+  t.equal(encoded.packets.length, 2, 'encodes a packet per frame.');
+  t.equal(await mx.writeFrame(encoded), undefined, 'resolves for an encoder result.');
+  try {
+    await mx.writeFrame([ packets[0], 'wibble' ]);
+    t.fail('Did not reject an array holding something other than packets.');
+  } catch (e) {
+    t.ok(e.message.match(/every element/), 'rejects an array holding something other than packets.');
+  }
+  let out = await mx.writeTrailer();
+  let data = out.indexOf('data', 12);
+  t.equal(out.readUInt32LE(data + 4), 5 * 960, 'writes every packet.');
+  let body = out.slice(data + 8, data + 8 + 5 * 960);
+  t.ok([ 1, 2, 3, 4, 5 ].every((x, i) => body.slice(i * 960, (i + 1) * 960).every(b => b === x)),
+    'in the order given.');
+  t.end();
+});
+
+test('Interleaving packets from two streams', async t => {
+  let mx = beamcoder.muxer({ format_name: 'nut', memory: true });
+  for ( let s = 0 ; s < 2 ; s++ ) {
+    let stream = mx.newStream({ name: 'pcm_s16le', time_base: [1, 48000] });
+    Object.assign(stream.codecpar, { sample_rate: 48000, channels: 1,
+      channel_layout: 'mono', format: 's16' });
+  }
+  mx.max_interleave_delta = 100000; // 4800 samples
+  await mx.writeHeader();
+  // Each packet's data is filled with its own id, to find it in the output
+  let packets = (ids, dts) => ids.map((id, x) => beamcoder.packet({ pts: dts[x], dts: dts[x],
+    duration: 1024, data: Buffer.alloc(2048, id), flags: { KEY: true } }));
+  let options = (stream_index, ids, dts) =>
+    ({ packets: packets(ids, dts), stream_index, time_base: [1, 48000] });
+
+  let result = await mx.interleave(options(1, [ 10, 11, 12 ], [ 0, 1024, 2048 ]));
+  t.deepEqual([ result.written, result.queued ], [ 0, 3 ],
+    'holds packets while another stream has none queued.');
+  result = await mx.interleave(options(0, [ 0, 1 ], [ 0, 1024 ]));
+  t.deepEqual([ result.written, result.queued ], [ 3, 2 ],
+    'writes in dts order once both streams have packets.');
+  result = await mx.interleave(options(1, [ 13, 14, 15, 16, 17 ],
+    [ 3072, 4096, 5120, 6144, 7168 ]));
+  t.deepEqual([ result.written, result.queued ], [ 2, 5 ],
+    'releases a stalled queue beyond max_interleave_delta.');
+  result = await mx.interleave({ stream_index: 0, final: true });
+  t.deepEqual([ result.written, result.queued ], [ 5, 0 ],
+    'writes the rest once the stalled stream has ended.');
+  let out = await mx.writeTrailer();
+
+  let dm = await beamcoder.demuxer({ buffer: out });
+  let order = [];
+  for ( let p = await dm.read() ; p !== null ; p = await dm.read() )
+    order.push(p.data[0]);
+  t.deepEqual(order, [ 0, 10, 1, 11, 12, 13, 14, 15, 16, 17 ],
+    'with equal timestamps written in stream index order.');
+
+  let unbounded = beamcoder.muxer({ format_name: 'nut', memory: true });
+  let stream = unbounded.newStream({ name: 'pcm_s16le', time_base: [1, 48000] });
+  Object.assign(stream.codecpar, { sample_rate: 48000, channels: 1,
+    channel_layout: 'mono', format: 's16' });
+  unbounded.max_interleave_delta = 0;
+  await unbounded.writeHeader();
+  try {
+    await unbounded.interleave(options(0, [ 0 ], [ 0 ]));
+    t.fail('Did not reject interleaving without a max_interleave_delta.');
+  } catch (e) {
+    t.ok(e.message.match(/max_interleave_delta/),
+      'rejects interleaving without a max_interleave_delta.');
+  }
+  t.end();
+});
+
+test('Force closing a muxer while writing', async t => {
+  let mx = beamcoder.muxer({ format_name: 'wav', memory: true });
+  let stream = mx.newStream({ name: 'pcm_s16le', time_base: [1, 48000], interleaved: false });
+  Object.assign(stream.codecpar, {
+    channels: 1, sample_rate: 48000, format: 's16',
+    channel_layout: 'mono', block_align: 2, bits_per_coded_sample: 16, bit_rate: 48000 * 16
+  });
+  await mx.writeHeader();
+  let packets = [];
+  for ( let x = 0 ; x < 100 ; x++ )
+    packets.push(beamcoder.packet({ pts: x * 480, dts: x * 480, stream_index: 0,
+      data: Buffer.alloc(960, x), duration: 480 }));
+  let writing = mx.writeFrame(packets).then(() => 'written', e => e.message);
+  mx.forceClose();
+  let outcome = await writing;
+  t.ok(outcome === 'written' || outcome.match(/cancelled/),
+    'finishes or cancels the write in progress.');
+  try {
+    await mx.writeFrame(packets[0]);
+    t.fail('Did not reject a write after force closing.');
+  } catch (e) {
+    t.ok(e.message.match(/cancelled/), 'rejects later writes as cancelled.');
+  }
+  t.end();
+});
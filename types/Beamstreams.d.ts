@@ -57,6 +57,8 @@ export interface BeamstreamSource {
 	streamIndex?: number
 	iformat?: InputFormat
   options?: { [key: string]: any }
+	/** Open the source with the low latency demuxer profile for live input */
+	lowLatency?: boolean
 }
 /** Codec definition for the destination channel */
 export interface BeamstreamStream {
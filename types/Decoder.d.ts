@@ -18,6 +18,54 @@ export interface DecodedFrames {
 	readonly total_time: number
 }
 
+/**
+ * Fixed output format for a decoder. Frames are converted on the decoding thread.
+ * Properties that are not set keep the values of the decoded frames.
+ */
+export interface DecoderOutputFormat {
+	/** Video pixel format, e.g. 'rgb24' */
+	pix_fmt?: string
+	/** Video width. Set only one of width and height to keep the aspect ratio. */
+	width?: number
+	/** Video height */
+	height?: number
+	/** Scaling algorithm, default 'bicubic' */
+	algorithm?: 'fast_bilinear' | 'bilinear' | 'bicubic' | 'experimental' | 'neighbor' |
+	  'area' | 'bicublin' | 'gauss' | 'sinc' | 'lanczos' | 'spline'
+	/** Audio sample format, e.g. 'fltp' */
+	sample_fmt?: string
+	/** Audio sample rate */
+	sample_rate?: number
+	/** Audio channel layout, e.g. 'stereo' */
+	channel_layout?: string
+}
+
+/**
+ * Decoder speed profiles, from best quality to fastest. Each sets flags2 FAST,
+ * skip_loop_filter, skip_idct, skip_frame and lowres, as supported by the codec.
+ */
+export type DecoderSpeedProfile = 'quality' | 'fast' | 'faster' | 'fastest'
+
+/** The StreamedFrames object is the result of a decodeStream operation with a callback */
+export interface StreamedFrames {
+	/** Object name. */
+	readonly type: 'frames'
+	/** Number of frames delivered to the callback */
+	readonly frames: number
+	/** True if the callback returned false and decoding stopped early */
+	readonly cancelled: boolean
+	/** Total time in microseconds that the decode operation took to complete */
+	readonly total_time: number
+}
+
+/** The PulledFrames object is returned as the result of a pull operation */
+export interface PulledFrames extends DecodedFrames {
+	/** True once the stream has ended and the decoder has been drained */
+	readonly eof: boolean
+	/** Number of packets read from the demuxer for this stream */
+	readonly packets: number
+}
+
 export interface Decoder extends Omit<CodecContext,
 	'bit_rate_tolerance' | 'global_quality' | 'compression_level' |
 	'max_b_frames' | 'b_quant_factor' |	'b_quant_offset' |
@@ -88,6 +136,33 @@ export interface Decoder extends Omit<CodecContext,
    * @returns a promise that resolves to a DecodedFrames object when the flush has completed successfully
 	 */
 	flush(): Promise<DecodedFrames>
+	/**
+	 * For a decoder created with a demuxer and stream_index, read packets for that stream
+	 * directly from the demuxer and decode them on the worker thread. Packets for other
+	 * streams are held natively for their own pulling decoders or for demuxer.read().
+	 * The decoder is flushed automatically at the end of the stream.
+	 * @param options Resolve once maxFrames frames (default 1) have been decoded
+	 * @returns a promise that resolves to a PulledFrames object
+	 */
+	pull(options?: { maxFrames?: number, max_frames?: number }): Promise<PulledFrames>
+	/**
+	 * Decode an array of packets on the worker thread, delivering each frame as soon as
+	 * the decoder returns it. At most highWaterMark frames (default 4) are in flight before
+	 * the worker waits for the consumer. The decoder is not flushed at the end.
+	 * @param packets An array of packets to decode
+	 * @returns an async iterator of decoded frames
+	 */
+	decodeStream(packets: Array<Packet>, options?: { highWaterMark?: number }): AsyncIterableIterator<Frame>
+	/**
+	 * Decode an array of packets on the worker thread, calling back with each frame as soon
+	 * as the decoder returns it. Return false from the callback to stop decoding.
+	 * @param packets An array of packets to decode
+	 * @param callback Called with each frame, or an options object with a callback property
+	 * @returns a promise that resolves to a StreamedFrames object
+	 */
+	decodeStream(packets: Array<Packet>,
+	  callback: ((frame: Frame) => boolean | void) |
+	    { callback: (frame: Frame) => boolean | void, highWaterMark?: number }): Promise<StreamedFrames>
 	/**
 	 * Extract the CodecPar object for the Decoder
 	 * @returns A CodecPar object
@@ -109,29 +184,126 @@ export function decoders(): { [key: string]: Codec }
 /** 
  * Create a decoder by name
  * @param name The codec name required
+ * @param output_format Optional fixed output format for decoded frames
+ * @param speed_profile Optional trade of picture quality for decoding speed
+ * @param frame_pool Allocate aligned, padded frame planes from beam coder's buffer pool
  * @param ... Any non-readonly parameters from the Decoder object as required
  * @returns A Decoder object - note creation is synchronous
  */
-export function decoder(options: { name: string, [key: string]: any }): Decoder
+export function decoder(options: { name: string, output_format?: DecoderOutputFormat, speed_profile?: DecoderSpeedProfile, frame_pool?: boolean, [key: string]: any }): Decoder
 /**
  * Create a decoder by codec_id
  * @param codec_id The codec ID from AV_CODEC_ID_xxx
+ * @param output_format Optional fixed output format for decoded frames
+ * @param speed_profile Optional trade of picture quality for decoding speed
+ * @param frame_pool Allocate aligned, padded frame planes from beam coder's buffer pool
  * @param ... Any non-readonly parameters from the Decoder object as required
  * @returns A Decoder object - note creation is synchronous
  */
-export function decoder(options: { codec_id: number, [key: string]: any }): Decoder
+export function decoder(options: { codec_id: number, output_format?: DecoderOutputFormat, speed_profile?: DecoderSpeedProfile, frame_pool?: boolean, [key: string]: any }): Decoder
 /**
  * Create a decoder from a demuxer and a stream_index
  * @param demuxer An initialised Demuxer object
  * @param stream_index The stream number of the demuxer object to be used to initialise the decoder
+ * @param output_format Optional fixed output format for decoded frames
+ * @param speed_profile Optional trade of picture quality for decoding speed
+ * @param frame_pool Allocate aligned, padded frame planes from beam coder's buffer pool
  * @param ... Any non-readonly parameters from the Decoder object as required
  * @returns A Decoder object - note creation is synchronous
  */
-export function decoder(options: { demuxer: Demuxer, stream_index: number, [key: string]: any }): Decoder
+export function decoder(options: { demuxer: Demuxer, stream_index: number, output_format?: DecoderOutputFormat, speed_profile?: DecoderSpeedProfile, frame_pool?: boolean, [key: string]: any }): Decoder
 /**
  * Create a decoder from a CodecPar object
  * @param params CodecPar object whose codec name or id will be used to initialise the decoder
+ * @param output_format Optional fixed output format for decoded frames
+ * @param speed_profile Optional trade of picture quality for decoding speed
+ * @param frame_pool Allocate aligned, padded frame planes from beam coder's buffer pool
  * @param ... Any non-readonly parameters from the Decoder object as required
  * @returns A Decoder object - note creation is synchronous
  */
-export function decoder(options: { params: CodecPar, [key: string]: any }): Decoder
+export function decoder(options: { params: CodecPar, output_format?: DecoderOutputFormat, speed_profile?: DecoderSpeedProfile, frame_pool?: boolean, [key: string]: any }): Decoder
+
+/** Options for sampling thumbnails from a demuxer */
+export interface ThumbnailOptions {
+	/** Demuxer to sample. Demuxers opened from a URL are reopened by each sampler. */
+	demuxer: Demuxer
+	/** Video stream to sample, default is the best video stream */
+	stream_index?: number
+	/** Target times in seconds from the start_time of the stream */
+	times?: Array<number>
+	/** Number of evenly spaced samples, used when times are not given */
+	count?: number
+	/** Return decoded frames (default) or JPEG-encoded Buffers */
+	format?: 'frame' | 'jpeg'
+	/** Pixel format of returned frames, default 'rgb24' */
+	pix_fmt?: string
+	/** Output width. Set only one of width and height to keep the aspect ratio. */
+	width?: number
+	/** Output height */
+	height?: number
+	/** Scaling algorithm, default 'bicubic' */
+	algorithm?: DecoderOutputFormat['algorithm']
+	/** Reduced resolution decoding for decoders that support it, 0 to 3 */
+	lowres?: number
+	/** JPEG quality scale from 2 (best) to 31, default 5 */
+	quality?: number
+	/** Number of samplers working in parallel, default is the number of cores up to 4 */
+	parallel?: number
+}
+
+/** A sampled picture. Frame or data is null if no keyframe was found after the time. */
+export interface Thumbnail {
+	/** Target time in seconds */
+	readonly time: number
+	/** Presentation timestamp of the sampled keyframe in stream time base units */
+	readonly pts: number | null
+	/** Sampled frame, for the 'frame' format */
+	readonly frame?: Frame | null
+	/** JPEG data, for the 'jpeg' format */
+	readonly data?: Buffer | null
+}
+
+/**
+ * Sample keyframes near the given times, or evenly spaced through the stream,
+ * decoding only keyframes and scaling them on worker threads.
+ * @param options A ThumbnailOptions object
+ * @returns a promise that resolves to the sampled thumbnails in target order
+ */
+export function thumbnails(options: ThumbnailOptions): Promise<{
+	readonly type: 'thumbnails'
+	readonly thumbnails: Array<Thumbnail>
+	/** Number of samplers that ran, 1 for a demuxer that cannot be reopened */
+	readonly samplers: number
+	readonly total_time: number
+}>
+
+/** thread_count decision for a decoder or encoder */
+export interface CodecThreadGrant {
+	readonly id: number
+	readonly type: 'decoder' | 'encoder'
+	readonly codec: string
+	readonly width: number
+	readonly height: number
+	/** thread_count given to the codec */
+	readonly threads: number
+	/** Why that number of threads was given */
+	readonly reason: 'resolution' | 'budget' | 'fair_share' | 'single' | 'explicit'
+}
+
+/**
+ * Configure and examine the process-wide codec thread budget. Decoders and encoders
+ * created without an explicit thread_count are given a share of the budget.
+ * @param options Enable or disable the allocator, set the budget (0 for one thread
+ * per core) and the most threads given to a single codec.
+ * @returns the current budget and the decision for each active codec
+ */
+export function codecThreads(options?: { enabled?: boolean, budget?: number, max_per_session?: number }): {
+	readonly enabled: boolean
+	readonly budget: number
+	readonly cores: number
+	readonly max_per_session: number
+	readonly allocated: number
+	/** Threads allocated beyond the budget, from single thread and explicit grants */
+	readonly overrun: number
+	readonly sessions: Array<CodecThreadGrant>
+}
@@ -43,6 +43,95 @@ export interface SeekOptions {
  * The process of demuxing (de-multiplexing) extracts time-labelled packets of data 
  * contained in a media stream or file.
  */
+export interface ScanOptions {
+	/** Indexes of the streams to scan. Default is all streams. */
+	streams?: Array<number>
+	/**
+	 * Time in seconds to scan from, starting at the key frame before. Default is the current position.
+	 * Times are from the start_time of the stream when scanning one stream, otherwise of the format.
+	 */
+	start?: number
+	/** Time in seconds to stop before. Default is the end of the file. */
+	end?: number
+}
+
+/** Packet metadata from a scan, with missing timestamps as AV_NOPTS_VALUE */
+export interface PacketScan {
+	readonly type: 'packet_scan'
+	readonly count: number
+	readonly stream_index: Int32Array
+	readonly pts: BigInt64Array
+	readonly dts: BigInt64Array
+	readonly duration: BigInt64Array
+	readonly pos: BigInt64Array
+	readonly size: Int32Array
+	/** Packet flags: 1 key, 2 corrupt, 4 discard, 8 trusted, 16 disposable */
+	readonly flags: Uint8Array
+	/** Microseconds taken to scan */
+	readonly total_time: number
+}
+
+export interface AnalysisOptions extends ScanOptions {
+	/** Seconds per windowed bitrate value. Default is 1. */
+	window?: number
+	/** Seconds of forward timestamp jump reported as a discontinuity. Default is 1. */
+	gap?: number
+	/** Video buffering verifier model, in bits per second and bits */
+	vbv?: { max_rate: number, buffer_size: number }
+}
+
+export interface StreamAnalysis {
+	readonly index: number
+	readonly codec_type: string
+	readonly packets: number
+	readonly bytes: number
+	/** Seconds from the first to the end of the last packet */
+	readonly duration: number
+	/** Bits per second */
+	readonly average_bitrate: number
+	/** Largest windowed bitrate, bits per second */
+	readonly peak_bitrate: number
+	/** GOP structure of video streams, null for other streams */
+	readonly gop: {
+		readonly count: number
+		readonly min: number
+		readonly max: number
+		readonly mean: number
+		/** Number of GOPs with leading pictures that reference the previous GOP */
+		readonly open: number
+		readonly closed: number
+		/** Mean seconds between key frames */
+		readonly keyframe_interval: number
+		/** Packets in each GOP, starting at each key frame */
+		readonly lengths: Int32Array
+		/** 1 for each open GOP, 0 for each closed GOP */
+		readonly open_flags: Uint8Array
+		readonly keyframe_intervals: Float64Array
+	} | null
+	/** Most packets decoded before a packet that are presented after it. Video only. */
+	readonly reorder_depth?: number
+	/** Bits per second of each packet over its duration */
+	readonly instant_bitrate: Float32Array
+	/** Bits per second of each window from the first packet */
+	readonly window_bitrate: Float64Array
+	/** Indexes of the stream's packets where timestamps go backwards or jump */
+	readonly discontinuities: Int32Array
+	/** Result of the VBV model when requested, with buffer fullness after each packet */
+	readonly vbv: {
+		readonly underflows: number
+		readonly min_fullness: number
+		readonly fullness: Float32Array
+	} | null
+}
+
+export interface Analysis {
+	readonly type: 'analysis'
+	readonly window: number
+	readonly streams: Array<StreamAnalysis>
+	/** Microseconds taken to scan and analyse */
+	readonly total_time: number
+}
+
 export interface Demuxer extends Omit<FormatContext,
 	'oformat' | 'max_interleave_delta' | 'avoid_negative_ts' | 'audio_preload' |
   'max_chunk_duration' | 'max_chunk_size' | 'flush_packets' | 'metadata_header_padding'
@@ -73,9 +162,40 @@ export interface Demuxer extends Omit<FormatContext,
 	 */
 	read(): Promise<Packet>
 	/**
-	 * Abandon the demuxing process and forcibly close the file or stream without waiting for it to finish
+	 * Read packets natively without creating Packet objects or keeping payloads,
+	 * resolving to their metadata as typed arrays with one entry per packet.
+	 * The demuxer is left positioned where the scan stopped.
+	 * https://github.com/Streampunk/beamcoder#scanning-packets
+	 * @param options Streams to include and the time range to scan
+	 * @returns a promise that resolves to the packet metadata
+	 */
+	scan(options?: ScanOptions): Promise<PacketScan>
+	/**
+	 * Scan packets natively and report GOP structure, bitrates and timestamp
+	 * discontinuities for each stream, computed on a worker thread.
+	 * The demuxer is left positioned where the scan stopped.
+	 * https://github.com/Streampunk/beamcoder#analysing-packets
+	 * @param options Streams, time range and settings for the analysis
+	 * @returns a promise that resolves to the analysis report
+	 */
+	analyse(options?: AnalysisOptions): Promise<Analysis>
+	/**
+	 * Abandon the demuxing process and forcibly close the file or stream without waiting for it to finish.
+	 * Any read blocked on the input is cancelled first, releasing its worker thread.
 	 */
 	forceClose(): undefined
+	/**
+	 * Interrupt any blocking read or seek in progress. Cancelling is permanent - later
+	 * operations reject straight away with an error ending 'operation cancelled.'
+	 */
+	cancel(): undefined
+	/** Whether the demuxer has been cancelled, either directly or by its abort signal */
+	readonly cancelled: boolean
+	/**
+	 * Limit in milliseconds for each blocking read or seek, after which it rejects with an
+	 * error ending 'operation timed out.' Zero, the default, waits indefinitely.
+	 */
+	timeout: number
 }
 
 /**
@@ -97,10 +217,27 @@ export function demuxer(url: string): Promise<Demuxer>
 export interface DemuxerCreateOptions {
 	/** String describing the source to be read from (may contain %d for a sequence of numbered files). */
 	url?: string
+	/** Complete source data held in memory, read and seeked in place */
+	buffer?: Buffer
 	/** Object that provides format details */
 	iformat?: InputFormat
 	/** Object allowing additional information to be provided */
 	options?: { [key: string]: any }
+	/**
+	 * Open a live source for the lowest delay: sets fflags +nobuffer, probesize 32, analyzeduration 0,
+	 * fpsprobesize 0 and avioflags direct unless given in options, and skips decoding packets to find
+	 * stream parameters when the input's header already describes every stream.
+	 */
+	lowLatency?: boolean
+	/**
+	 * Most packets held for other streams while decoders pull from this demuxer, after which
+	 * a pull rejects. Default 4096, 0 for no limit.
+	 */
+	max_pending?: number
+	/** Milliseconds allowed for opening the input and then for each read or seek */
+	timeout?: number
+	/** Cancels opening the input, and the demuxer once it is open, when aborted */
+	signal?: AbortSignal
 }
 /**
  * For formats that require additional metadata, such as the rawvideo format,
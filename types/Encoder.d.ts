@@ -16,6 +16,21 @@ export interface EncodedPackets {
 	/** Total time in microseconds that the encode operation took to complete */
 	readonly total_time: number
 }
+/** The EncodedStats object is returned by encode operations of an attached encoder */
+export interface EncodedStats {
+	/** Object name. */
+	readonly type: 'encoded'
+	/** Number of packets produced by this operation */
+	readonly packets: number
+	/** Total size in bytes of the packets produced */
+	readonly bytes: number
+	/** Number of packets, from any stream, written to the muxer by this operation */
+	readonly written: number
+	/** Number of packets still held by the muxer's interleaving queue */
+	readonly queued: number
+	/** Total time in microseconds that the encode operation took to complete */
+	readonly total_time: number
+}
 /**
  * Encoder takes a stream of uncompressed data in the form of Frames and converts them into coded Packets.
  * Encoding takes place on a single type of stream, for example audio or video.
@@ -40,7 +55,7 @@ export interface Encoder extends Omit<CodecContext,
 	 * @param frame A Frame or an array of Frames to be encoded
    * @returns a promise that resolves to a EncodedPackets object when the encode has completed successfully
 	 */
-  encode(frame: Frame | Frame[]): Promise<EncodedPackets>
+  encode(frame: Frame | Frame[]): Promise<EncodedPackets | EncodedStats>
 	/**
 	 * Encode a number of Frames passed as separate parameters and create compressed Packets
 	 * Encoders may need more than one Frame to produce a Packet and may subsequently
@@ -48,7 +63,7 @@ export interface Encoder extends Omit<CodecContext,
 	 * @param frames An arbitrary number of Frames to be encoded
    * @returns a promise that resolves to a EncodedPackets object when the encode has completed successfully
 	 */
-	encode(...frames: Frame[]): Promise<EncodedPackets>
+	encode(...frames: Frame[]): Promise<EncodedPackets | EncodedStats>
   /**
 	 * Once all Frames have been passed to the encoder, it is necessary to call its
 	 * asynchronous flush() method. If any Packets are yet to be delivered by the encoder
@@ -59,7 +74,16 @@ export interface Encoder extends Omit<CodecContext,
 	 * garbage collection process, so make sure that the reference to the encoder goes out of scope.
    * @returns a promise that resolves to a EncodedPackets object when the flush has completed successfully
 	 */
-	flush(): Promise<EncodedPackets>
+	flush(): Promise<EncodedPackets | EncodedStats>
+	/**
+	 * Attach the encoder to a stream of a muxer. Packets produced by encode() and flush()
+	 * are then rescaled from the encoder time_base to the stream time_base and written
+	 * through the muxer's interleaving queue on the worker thread, and both methods resolve
+	 * with EncodedStats. Flushing an attached encoder marks its stream as finished.
+	 * @param muxer Muxer to write to, or null to detach
+	 * @param stream Muxer stream or its index
+	 */
+	attach(muxer: any | null, stream?: { index: number } | number): void
 	/**
 	 * Extract the CodecPar object for the Encoder
 	 * @returns A CodecPar object
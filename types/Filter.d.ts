@@ -214,6 +214,10 @@ export interface FiltererResult {
 export interface Filterer {
 	readonly type: 'Filterer'
 	readonly graph: FilterGraph
+	/** Map of input pad names to the handles used to index frame arrays passed to filter */
+	readonly inputHandles: { [name: string]: number }
+	/** Map of output pad names to the handles used to index frame arrays returned by filter */
+	readonly outputHandles: { [name: string]: number }
 
   /**
 	 * Filter an array of frames
@@ -233,6 +237,41 @@ export interface Filterer {
 	 * @returns Array of objects containing Frame arrays for each output pad of the filter
    */
 	filter(framesArr: Array<{ name: string, frames: Array<Frame> }>): Promise<Array<FiltererResult> & { total_time: number }>
+  /**
+	 * Filter an array of frames
+	 * Pass an array of frame arrays indexed by the handles given in inputHandles,
+	 * avoiding pad name lookups on every call. Missing entries may be null.
+	 * @param framesByHandle Array of Frame arrays, one per input handle
+	 * @returns Array of Frame arrays indexed by the handles given in outputHandles
+   */
+	filter(framesByHandle: Array<Array<Frame> | null>): Promise<Array<Array<Frame>> & { total_time: number }>
+  /**
+	 * Send a command to one or more filters in the graph, applied immediately
+	 * @param target Filter instance name, filter name or 'all'
+	 * @param command Command name, e.g. a filter option that supports runtime changes
+	 * @param arg Argument for the command
+	 * @param options Set one to stop after the first matching filter, fast to only allow fast commands
+	 * @returns The response string from the filter
+	 */
+	sendCommand(target: string, command: string, arg: string, options?: { one?: boolean, fast?: boolean }): string
+  /**
+	 * Queue a command to one or more filters in the graph, applied when frames reach the given time
+	 * @param target Filter instance name, filter name or 'all'
+	 * @param command Command name
+	 * @param arg Argument for the command
+	 * @param time Time in seconds at which the command is applied
+	 * @param options Set one to stop after the first matching filter, fast to only allow fast commands
+	 */
+	queueCommand(target: string, command: string, arg: string, time: number, options?: { one?: boolean, fast?: boolean }): void
+  /**
+	 * Reconfigure the video buffer sources whose picture parameters have changed without rebuilding the graph.
+	 * Only the values provided are changed, the rest of each source's parameters are kept.
+	 * The first filter after a source must adapt to the new frames, as scale does.
+	 * Changes to a time base or to an audio input reject.
+	 * @param inputParams Array of partial input parameters, named as in the filterer inputParams
+	 * @returns Names of the sources that were reconfigured
+	 */
+	reinit(inputParams: Array<Partial<AudioInputParam> | Partial<VideoInputParam>>): Promise<{ reconfigured: Array<string>, total_time: number }>
 }
 
 /**
@@ -297,6 +336,12 @@ export interface FiltererOptions {
 	/** The filter type - video or audio */
 	filterType: MediaType
 	filterSpec: string
+	/** Maximum number of threads used by filters in the graph, sets nb_threads. 0 for automatic. */
+	threads?: number
+	/** Type of multithreading allowed for the graph, sets thread_type. 'slice' or 1 for slice threading, 'none' or 0 to disable. */
+	threadType?: 'slice' | 'none' | number
+	/** Run slice jobs on the process-wide pool shared by all filter graphs rather than per-graph threads */
+	sharedThreads?: boolean
 }
 
 export interface FiltererVideoOptions extends FiltererOptions {
@@ -322,3 +367,10 @@ export interface FiltererAudioOptions extends FiltererOptions {
  * @returns Promise that resolve to a Filterer on success
  */
 export function filterer(options: FiltererVideoOptions | FiltererAudioOptions): Promise<Filterer>
+
+/**
+ * Configure and report on the process-wide slice thread pool used by filter graphs created with sharedThreads
+ * @param options Set threads to resize the pool, 0 for one thread less than the number of cores
+ * @returns The current number of pool threads and the number of batches of slice jobs run
+ */
+export function filterThreads(options?: { threads?: number }): { threads: number, batches: number }
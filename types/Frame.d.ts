@@ -88,8 +88,15 @@ export interface Frame {
 	 * see avcodec_align_dimensions2(). Some filters and swscale can read
 	 * up to 16 bytes beyond the planes, if these filters are to be used,
 	 * then 16 extra bytes must be allocated.
+	 * The array read back is frozen - set a new array to replace planes.
 	 */
 	data: Array<Buffer>
+	/**
+	 * Typed array views of each row of each plane of a video frame, stepping by
+	 * the linesize and excluding line padding. Uint16Array for formats deeper
+	 * than 8 bits. Null for audio and hardware frames.
+	 */
+	readonly rows: ReadonlyArray<ReadonlyArray<Uint8Array | Uint16Array>> | null
 	/**
 	 * Additional data that can be provided by the container.
 	 * Frame can contain several types of side information.
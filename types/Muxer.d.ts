@@ -81,18 +81,117 @@ export interface Muxer extends Omit<FormatContext,
 	 * @returns Promise that resolves to _undefined_ on success
 	 */
 	writeFrame(options: { frame: Frame, stream_index: number }) : Promise<undefined>
+  /**
+	 * Write media data to the file by sending a batch of packets, written in a single asynchronous operation.
+	 * @param packets Array of Packets, or the result of an encode, each of which must contain the stream index
+	 * and timestamps measured in the `time_base` of the stream.
+	 * @returns Promise that resolves to _undefined_ on success
+	 */
+	writeFrame(packets: Array<Packet> | { packets: Array<Packet> }) : Promise<undefined>
+
+  /**
+	 * Queue packets from any stream on the muxer's native interleaving queue. Packets are written in dts order
+	 * as soon as every active stream has a packet queued, or when the queue spans more than max_interleave_delta,
+	 * which must be greater than zero.
+	 * @param packets Array of packets, or the result of an encode, each with stream index and timestamps
+	 * in the `time_base` of its stream.
+	 * @returns Promise that resolves to the number of packets written by this call and the number still queued
+	 */
+	interleave(packets: Array<Packet> | { packets: Array<Packet> }) : Promise<{ written: number, queued: number }>
+  /**
+	 * Queue packets from any stream on the muxer's native interleaving queue.
+	 * @param options Object containing the packets, optionally the stream_index to apply to the packets, the time_base
+	 * the packet timestamps are measured in if not that of the stream, and a final flag to mark that the stream has ended.
+	 * @returns Promise that resolves to the number of packets written by this call and the number still queued
+	 */
+	interleave(options: {
+		packets?: Array<Packet> | { packets: Array<Packet> }
+		stream_index?: number
+		time_base?: Array<number>
+		final?: boolean
+	}) : Promise<{ written: number, queued: number }>
 
   /**
 	 * Write the trailer at the end of the file or stream. It is written after the muxer has drained its
 	 * buffers of all remaining packets and frames. Writing the trailer also closes the file or stream.
-	 * @returns Promise that resolves to _undefined_ on success
+	 * @returns Promise that resolves to _undefined_ on success, or to the output for a memory muxer
 	 */
-	writeTrailer(): Promise<undefined>
+	writeTrailer(): Promise<undefined | Buffer | Array<Buffer>>
 
 	/**
 	 * Abandon the muxing process and forcibly close the file or stream without completing it
 	 */
 	forceClose(): undefined
+
+	/**
+	 * Interrupt any blocking IO in progress. Cancelling is permanent - later
+	 * operations reject straight away with an error ending 'operation cancelled.'
+	 */
+	cancel(): undefined
+	/** Whether the muxer has been cancelled, either directly or by its abort signal */
+	readonly cancelled: boolean
+	/**
+	 * Limit in milliseconds for each of openIO, writeHeader, initOutput, writeFrame, interleave
+	 * and writeTrailer, after which it rejects with an error ending 'operation timed out.'
+	 * Zero, the default, waits indefinitely.
+	 */
+	timeout: number
+
+	/**
+	 * Collect the segments completed by a segmenting muxer since the last call.
+	 * Returns an empty array for muxers created without a segmenter.
+	 */
+	segments(): Array<Segment>
+}
+
+/** A segment of fragmented MP4 output from a segmenting muxer */
+export interface Segment {
+	/** Initialisation segment (ftyp+moov) or media fragment (moof+mdat) */
+	type: 'init' | 'media'
+	/** 0 for the init segment, then counting up from 1 */
+	sequence: number
+	/** Earliest presentation timestamp of the fragment on the reference stream */
+	pts?: number | null
+	/** Duration of the fragment on the reference stream */
+	duration?: number
+	/** Time base of pts and duration */
+	time_base?: Array<number>
+	/** Whether the fragment starts with a keyframe */
+	keyframe?: boolean
+	/** Segment bytes, allocated from a pool */
+	data: Buffer
+}
+
+/** Fragment boundary policy for a segmenting muxer */
+export interface SegmenterOptions {
+	/** Target fragment duration in seconds */
+	duration?: number
+	/** Only start fragments at keyframes of the reference stream. Defaults to true. */
+	keyframes?: boolean
+	/** Reference stream index, defaults to the first video stream */
+	stream_index?: number
+}
+
+/** Chunking of output collected in memory */
+export interface MemoryOutputOptions {
+	/** Size in bytes of each chunk of output. Defaults to 1MiB. */
+	chunk_size?: number
+	/** Resolve writeTrailer() with one Buffer per chunk rather than a single Buffer */
+	chunks?: boolean
+}
+
+/** Local HLS or DASH packaging of fragmented MP4 output */
+export interface PackagerOptions extends SegmenterOptions {
+	/** Directory to write segments and the playlist to, created with any missing parents */
+	directory: string
+	/** Playlist flavour. Defaults to 'hls'. */
+	type?: 'hls' | 'dash'
+	/** Playlist file name. Defaults to index.m3u8 for HLS and manifest.mpd for DASH. */
+	playlist?: string
+	/** Segment file name prefix. Defaults to 'segment'. */
+	prefix?: string
+	/** Number of segments kept in a live playlist, 0 (default) to keep all */
+	window?: number
 }
 
 /**
@@ -110,6 +209,16 @@ export interface MuxerCreateOptions {
 	filename?: string
 	/** Object that provides format details */
 	oformat?: OutputFormat
+	/** Cut fragmented MP4 output into in-memory segments, collected with segments() */
+	segmenter?: SegmenterOptions
+	/** Write segments and an HLS or DASH playlist to a local directory */
+	packager?: PackagerOptions
+	/** Collect seekable output in memory, resolved by writeTrailer() */
+	memory?: boolean | MemoryOutputOptions
+	/** Milliseconds allowed for each blocking muxer operation */
+	timeout?: number
+	/** Cancels the muxer when aborted */
+	signal?: AbortSignal
 	/** Object allowing additional information to be provided */
 	[key: string]: any
 }
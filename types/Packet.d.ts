@@ -73,6 +73,11 @@ export interface Packet {
 	duration: number
 	/** byte position in stream, -1 if unknown */
 	pos: number
+	/**
+	 * Monotonic time in microseconds when a demuxer read this packet, comparable with
+	 * beamcoder.monotonicTime(). Null for packets that were not read by a demuxer.
+	 */
+	arrival_time: number | null
 }
 
 /**